@@ -29,6 +29,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -43,6 +44,8 @@
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -51,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get the username and user id.
  *
  * =============================================================================
@@ -83,6 +87,8 @@
 
 #include "ifftools.h"
 #include "smart_menu.h"
+#include "trace.h"
+#include "anim.h"
 
 //
 // Defines for windows
@@ -194,7 +200,9 @@ static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
   { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
   { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
   { { 0x12,M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_REDRAW_SCREEN,
-  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_SHOW_TAX
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { { 0x10,M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
 };
 
 static struct KeyCodeType RunKeyMap = { '5', M_NUMPAD };
@@ -985,7 +993,7 @@ static void GetTile(int x, int y, int *TileId)
   /* Handle walls */
   if (*TileId == objtilelist[OWALL])
   {
-    *TileId = WALL_TILES + iarg[x][y];
+    *TileId = WALL_TILES + wallmask[x][y];
   }
 }
 
@@ -1012,6 +1020,8 @@ static void PaintMap(void)
   int TileX;
   int TileY;
 
+  TRACE_BEGIN(TRACE_PAINTMAP);
+
   mx = MapTileLeft + MapTileWidth;
   my = MapTileTop + MapTileHeight;
 
@@ -1078,6 +1088,8 @@ static void PaintMap(void)
       TileWidth, TileHeight,
       0xe0);
   }
+
+  TRACE_END(TRACE_PAINTMAP);
 }
 
 /* =============================================================================
@@ -1099,6 +1111,8 @@ static void PaintTextWindow(void)
   int sx, ex, y;
   FormatType Fmt;
 
+  TRACE_BEGIN(TRACE_PAINTTEXT);
+
   SetAPen(UlarnRP, WHITE_PEN);
   SetDrMd(UlarnRP, JAM1);
   RectFill(UlarnRP, TLeft, TTop, TLeft + TWidth -1, TTop + THeight - 1);
@@ -1143,6 +1157,7 @@ static void PaintTextWindow(void)
     }
   }
 
+  TRACE_END(TRACE_PAINTTEXT);
 }
 
 /* =============================================================================
@@ -2282,6 +2297,17 @@ void set_display(DisplayModeType Mode)
   PaintWindow();
 }
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  //
+  // Drawing is presented by the window system as it happens, so there is
+  // nothing to hold.
+  //
+}
+
 /* =============================================================================
  * FUNCTION: IncCursorY
  *
@@ -2429,6 +2455,9 @@ void Printc(char c)
 {
   int incx;
 
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
+
   switch (c)
   {
     case '\t':
@@ -2585,15 +2614,27 @@ void ClearToEOPage(int x, int y)
 
 }
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  /* The message window does not keep a history */
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+}
+
 /* =============================================================================
  * FUNCTION: show1cell
  */
 void show1cell(int x, int y)
 {
-  int TileId;
-  int sx, sy;
-  int TileX, TileY;
-
   /* see nothing if blind   */
   if (c[BLINDCOUNT]) return;
 
@@ -2604,6 +2645,32 @@ void show1cell(int x, int y)
     stealth[x][y] |= STEALTH_SEEN;
   }
 
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+
+  GetTile(x, y, &TileId);
+
+  return TileId;
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  int sx, sy;
+  int TileX, TileY;
+
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
   sx = x - MapTileLeft;
   sy = y - MapTileTop;
 
@@ -2617,10 +2684,8 @@ void show1cell(int x, int y)
     return;
   }
 
-  GetTile(x, y, &TileId);
-
-  TileX = (TileId % 16) * TileWidth;
-  TileY = (TileId / 16) * TileHeight;
+  TileX = (Glyph % 16) * TileWidth;
+  TileY = (Glyph / 16) * TileHeight;
 
   BltBitMapRastPort(
     UlarnGfx,
@@ -2629,7 +2694,6 @@ void show1cell(int x, int y)
     MapLeft + sx*TileWidth, MapTop + sy*TileHeight,
     TileWidth, TileHeight,
     0xc0);
-
 }
 
 /* =============================================================================
@@ -3025,11 +3089,27 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame)
  */
 void nap(int delay)
 {
+  TRACE_BEGIN(TRACE_NAP);
+
   //
   // Delay for delay/20 ticks (50 ticks per second)
   //
   Delay(delay/20);
 
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  //
+  // Key presses are not checked during the delay.
+  //
+  nap(delay);
+
+  return 0;
 }
 
 //
@@ -14,6 +14,7 @@
  * EXPORTED FUNCTIONS
  *
  * run       : Move in a direction until something interesting happens
+ * travel    : Travel to a selected destination on the known map
  * wield     : Wield an item
  * wear      : Wear armour or shield
  * dropobj   : Drop an object
@@ -27,6 +28,8 @@
  * =============================================================================
  */
 
+#include <string.h>
+
 #include "ularn_game.h"
 #include "ularn_win.h"
 #include "ularn_ask.h"
@@ -53,6 +56,31 @@
 static char *SelectItemAns = "abcdefghijklmnopqrstuvwxyz*\033";
 static char *SelectDropAns = "abcdefghijklmnopqrstuvwxyz*.\033";
 static char *SelectWieldAns = "abcdefghijklmnopqrstuvwxyz*-\033";
+static char *TravelAns = "<>bsh.\033";
+static char *TravelPickAns = "hjklyubnHJKLYUBN.\015\033";
+
+/*
+ * Objects that are destinations for each travel target
+ */
+static const int TravelUp[] = { OSTAIRSUP, OVOLUP, OUNKNOWN };
+static const int TravelDown[] = { OSTAIRSDOWN, OENTRANCE, OVOLDOWN, OUNKNOWN };
+static const int TravelBank[] = { OBANK, OBANK2, OUNKNOWN };
+static const int TravelStore[] = { ODNDSTORE, OTRADEPOST, OUNKNOWN };
+static const int TravelHome[] = { OHOME, OUNKNOWN };
+
+/*
+ * The cost of a travel step onto a square holding an object, which would
+ * interrupt the travel.
+ */
+#define TRAVEL_OBJECT_COST 5
+#define TRAVEL_NO_PATH     0x7fff
+
+/*
+ * Travel path planning data
+ */
+static short TravelDist[MAXX][MAXY];
+static char TravelFrom[MAXX][MAXY];
+static char TravelPath[MAXX * MAXY];
 
 /*
  * Types of uses of an item
@@ -71,7 +99,7 @@ typedef enum UseType
 /*
  * String for each use
  */
-static char *UseStrings[USE_COUNT] =
+static char *const UseStrings[USE_COUNT] =
 {
   "wield",
   "quaff",
@@ -242,18 +270,586 @@ static int whatitem (UseType Use)
 }
 
 
+/* =============================================================================
+ * FUNCTION: run_exits
+ *
+ * DESCRIPTION:
+ * Count the number of open squares orthogonally adjacent to a location.
+ * A change in this count while running indicates a branch or opening.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the location
+ *
+ *   y : The y coordinate of the location
+ *
+ * RETURN VALUE:
+ *
+ *   The number of adjacent open squares.
+ */
+static int run_exits(int x, int y)
+{
+  int exits;
+  int dir;
+  int k, m;
+
+  exits = 0;
+  for (dir = 1 ; dir <= 4 ; dir++)
+  {
+    k = x + diroffx[dir];
+    m = y + diroffy[dir];
+
+    if ((k >= 0) && (k < MAXX) && (m >= 0) && (m < MAXY) &&
+        (item[k][m] != OWALL) && (item[k][m] != OCLOSEDDOOR))
+    {
+      exits++;
+    }
+  }
+
+  return exits;
+}
+
+/* =============================================================================
+ * FUNCTION: run_sees_something
+ *
+ * DESCRIPTION:
+ * Check whether showcell at a location will reveal a monster or an object
+ * that the player hasn't yet seen.
+ * This must be called before showcell is called for the location.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the location
+ *
+ *   y : The y coordinate of the location
+ *
+ * RETURN VALUE:
+ *
+ *   1 if something new will be seen, otherwise 0.
+ */
+static int run_sees_something(int x, int y)
+{
+  int range;
+  int mx, my;
+
+  if (c[BLINDCOUNT]) return 0;
+
+  range = (c[AWARENESS]) ? 3 : 1;
+
+  for (mx = x - range ; mx <= x + range ; mx++)
+  {
+    for (my = y - range ; my <= y + range ; my++)
+    {
+      if ((mx < 0) || (mx >= MAXX) || (my < 0) || (my >= MAXY)) continue;
+
+      if ((mitem[mx][my].mon != MONST_NONE) &&
+          ((stealth[mx][my] & STEALTH_SEEN) == 0))
+      {
+        return 1;
+      }
+
+      if ((know[mx][my] != item[mx][my]) &&
+          (item[mx][my] != ONOTHING) &&
+          (item[mx][my] != OWALL))
+      {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: travel_cost
+ *
+ * DESCRIPTION:
+ * Get the cost of stepping onto a square when travelling, based only on
+ * what the player knows about the square.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the square
+ *
+ *   y : The y coordinate of the square
+ *
+ * RETURN VALUE:
+ *
+ *   The step cost, or 0 if the square cannot be travelled through.
+ */
+static int travel_cost(int x, int y)
+{
+  switch (know[x][y])
+  {
+    case OUNKNOWN:
+    case OWALL:
+    case OCLOSEDDOOR:
+    case OPIT:
+    case OTELEPORTER:
+    case OTRAPARROW:
+    case ODARTRAP:
+    case OTRAPDOOR:
+    case OELEVATORUP:
+    case OELEVATORDOWN:
+    case OANNIHILATION:
+      return 0;
+
+    /* Invisible traps look like an empty floor to the player */
+    case ONOTHING:
+    case OOPENDOOR:
+    case OTRAPARROWIV:
+    case OIVDARTRAP:
+    case OIVTRAPDOOR:
+    case OIVTELETRAP:
+      return 1;
+
+    default:
+      return TRAVEL_OBJECT_COST;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: travel_is_dest
+ *
+ * DESCRIPTION:
+ * Check whether a square is a travel destination.
+ *
+ * PARAMETERS:
+ *
+ *   x       : The x coordinate of the square
+ *
+ *   y       : The y coordinate of the square
+ *
+ *   Objects : The list of destination objects, terminated by OUNKNOWN, or
+ *             NULL if the destination is a map location.
+ *
+ *   tx      : The x coordinate of the destination map location
+ *
+ *   ty      : The y coordinate of the destination map location
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the square is a destination, otherwise 0.
+ */
+static int travel_is_dest(int x, int y, const int *Objects, int tx, int ty)
+{
+  int i;
+
+  if (know[x][y] == OUNKNOWN) return 0;
+
+  if (Objects == NULL)
+  {
+    return ((x == tx) && (y == ty));
+  }
+
+  for (i = 0 ; Objects[i] != OUNKNOWN ; i++)
+  {
+    if (know[x][y] == Objects[i]) return 1;
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: travel_plan
+ *
+ * DESCRIPTION:
+ * Calculate the shortest travel distance from the player to every square
+ * of the known map.
+ * TravelDist holds the distance to each square and TravelFrom holds the
+ * direction of the last step onto that square.
+ * Destination squares may always be entered, even if they would otherwise
+ * be avoided.
+ *
+ * PARAMETERS:
+ *
+ *   Objects : The list of destination objects, terminated by OUNKNOWN, or
+ *             NULL if the destination is a map location.
+ *
+ *   tx      : The x coordinate of the destination map location
+ *
+ *   ty      : The y coordinate of the destination map location
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void travel_plan(const int *Objects, int tx, int ty)
+{
+  static char done[MAXX][MAXY];
+  int x, y;
+  int bx, by;
+  int nx, ny;
+  int dir;
+  int cost;
+  int best;
+
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      TravelDist[x][y] = TRAVEL_NO_PATH;
+      TravelFrom[x][y] = 0;
+      done[x][y] = 0;
+    }
+  }
+
+  TravelDist[playerx][playery] = 0;
+
+  while (1)
+  {
+    /* find the closest square not yet done */
+    best = TRAVEL_NO_PATH;
+    bx = 0;
+    by = 0;
+    for (x = 0 ; x < MAXX ; x++)
+    {
+      for (y = 0 ; y < MAXY ; y++)
+      {
+        if (!done[x][y] && (TravelDist[x][y] < best))
+        {
+          best = TravelDist[x][y];
+          bx = x;
+          by = y;
+        }
+      }
+    }
+
+    if (best == TRAVEL_NO_PATH) return;
+
+    done[bx][by] = 1;
+
+    for (dir = 1 ; dir <= 8 ; dir++)
+    {
+      nx = bx + diroffx[dir];
+      ny = by + diroffy[dir];
+
+      if ((nx < 0) || (nx >= MAXX) || (ny < 0) || (ny >= MAXY)) continue;
+      if (done[nx][ny]) continue;
+
+      if (travel_is_dest(nx, ny, Objects, tx, ty))
+      {
+        cost = 1;
+      }
+      else
+      {
+        cost = travel_cost(nx, ny);
+      }
+
+      if ((cost > 0) && (best + cost < TravelDist[nx][ny]))
+      {
+        TravelDist[nx][ny] = (short) (best + cost);
+        TravelFrom[nx][ny] = (char) dir;
+      }
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: travel_find
+ *
+ * DESCRIPTION:
+ * Plan the travel paths and find the closest reachable destination.
+ *
+ * PARAMETERS:
+ *
+ *   Objects : The list of destination objects, terminated by OUNKNOWN, or
+ *             NULL if the destination is a map location.
+ *
+ *   tx      : The x coordinate of the destination map location. Set to the
+ *             x coordinate of the closest destination found.
+ *
+ *   ty      : The y coordinate of the destination map location. Set to the
+ *             y coordinate of the closest destination found.
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a reachable destination was found, otherwise 0.
+ */
+static int travel_find(const int *Objects, int *tx, int *ty)
+{
+  int x, y;
+  int best;
+  int Found;
+
+  travel_plan(Objects, *tx, *ty);
+
+  Found = 0;
+  best = TRAVEL_NO_PATH;
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      if (travel_is_dest(x, y, Objects, *tx, *ty) &&
+          (TravelDist[x][y] < best))
+      {
+        best = TravelDist[x][y];
+        Found = 1;
+      }
+    }
+  }
+
+  if (!Found) return 0;
+
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      if (travel_is_dest(x, y, Objects, *tx, *ty) &&
+          (TravelDist[x][y] == best))
+      {
+        *tx = x;
+        *ty = y;
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: travel_pick
+ *
+ * DESCRIPTION:
+ * Let the player pick a square on the map using the direction keys.
+ *
+ * PARAMETERS:
+ *
+ *   tx : Set to the x coordinate of the selected square.
+ *
+ *   ty : Set to the y coordinate of the selected square.
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a square was selected, 0 if the selection was aborted.
+ */
+static int travel_pick(int *tx, int *ty)
+{
+  /* The movement keys in the order of the diroffx/diroffy directions */
+  static char *PickKeys = "jlkhuynb";
+  char *key;
+  char ch;
+  int x, y;
+  int dir;
+  int step;
+
+  Print("\nSelect the destination (hjklyubn move, HJKLYUBN move 8, . select): ");
+
+  x = playerx;
+  y = playery;
+  do
+  {
+    mapeffect(x, y, EFFECT_MLE, 0);
+
+    ch = get_prompt_input("", TravelPickAns, 0);
+
+    draws(0, MAXX, 0, MAXY);
+
+    step = 1;
+    if ((ch >= 'A') && (ch <= 'Z'))
+    {
+      ch = (char) (ch - 'A' + 'a');
+      step = 8;
+    }
+
+    key = strchr(PickKeys, ch);
+    if (key != NULL)
+    {
+      dir = (int) (key - PickKeys) + 1;
+      x += diroffx[dir] * step;
+      y += diroffy[dir] * step;
+
+      if (x < 0) x = 0;
+      if (x >= MAXX) x = MAXX - 1;
+      if (y < 0) y = 0;
+      if (y >= MAXY) y = MAXY - 1;
+    }
+
+  } while ((ch != '.') && (ch != '\015') && (ch != ESC));
+
+  showplayer();
+
+  if (ch == ESC)
+  {
+    Print(" aborted.");
+    return 0;
+  }
+
+  *tx = x;
+  *ty = y;
+  return 1;
+}
+
 /* =============================================================================
  * Exported functions
  */
 
+/* =============================================================================
+ * FUNCTION: travel
+ */
+void travel (void)
+{
+  const int *Objects;
+  int tx, ty;
+  int x, y;
+  int Len;
+  int Step;
+  int i;
+  int exits;
+  int last_exits;
+  int present;
+  char ch;
+
+  /* No time passes unless the player actually moves */
+  nomove = 1;
+
+  ch = get_prompt_input(
+    "\nTravel to: < up, > down, b bank, s store, h home, . select ",
+    TravelAns, 1);
+
+  tx = -1;
+  ty = -1;
+  switch (ch)
+  {
+    case '<':
+      Objects = TravelUp;
+      if (level == 1)
+      {
+        /* The way out of the dungeon */
+        Objects = NULL;
+        tx = 33;
+        ty = MAXY - 1;
+      }
+      break;
+
+    case '>':
+      Objects = TravelDown;
+      break;
+
+    case 'b':
+      Objects = TravelBank;
+      break;
+
+    case 's':
+      Objects = TravelStore;
+      break;
+
+    case 'h':
+      Objects = TravelHome;
+      break;
+
+    case '.':
+      if (!travel_pick(&tx, &ty)) return;
+      Objects = NULL;
+      break;
+
+    default:
+      Print(" aborted.");
+      return;
+  }
+
+  if (!travel_find(Objects, &tx, &ty))
+  {
+    Print("\nYou don't know a way there.");
+    return;
+  }
+
+  if ((tx == playerx) && (ty == playery))
+  {
+    Print("\nYou are already there.");
+    return;
+  }
+
+  /* Build the list of steps from the player to the destination */
+  Len = 0;
+  x = tx;
+  y = ty;
+  while ((x != playerx) || (y != playery))
+  {
+    Step = TravelFrom[x][y];
+    TravelPath[Len++] = (char) Step;
+    x -= diroffx[Step];
+    y -= diroffy[Step];
+  }
+
+  nomove = 0;
+
+  /* Present the display only when something new is seen, as for run */
+  set_display_hold(1);
+  last_exits = run_exits(playerx, playery);
+
+  i = 1;
+  while (i && (Len > 0))
+  {
+    Step = TravelPath[--Len];
+    x = playerx + diroffx[Step];
+    y = playery + diroffy[Step];
+
+    i = moveplayer(Step);
+
+    /* Open doors are passed through without stopping */
+    if ((i == 0) && (Len > 0) && (playerx == x) && (playery == y) &&
+        (item[x][y] == OOPENDOOR))
+    {
+      i = 1;
+    }
+
+    /* Stop if the player didn't end up where expected (eg confusion) */
+    if ((playerx != x) || (playery != y))
+    {
+      i = 0;
+    }
+
+    if (i>0)
+    {
+      if (c[HASTEMONST]) movemonst();
+
+      movemonst();
+      randmonst();
+      regen();
+    }
+    if (hitflag) i=0;
+    if ((i!=0) && (Len > 0))
+    {
+      exits = run_exits(playerx, playery);
+      present = run_sees_something(playerx, playery) || (exits != last_exits);
+      last_exits = exits;
+
+      showcell(playerx,playery);
+
+      if (present)
+      {
+        set_display_hold(0);
+        set_display_hold(1);
+      }
+    }
+  }
+
+  /* The turn for the final step has already been taken */
+  if (i > 0) nomove = 1;
+
+  set_display_hold(0);
+}
+
 /* =============================================================================
  * FUNCTION: run
  */
 void run (int dir)
 {
   int i;
+  int exits;
+  int last_exits;
+  int present;
   i=1;
 
+  /*
+   * Intermediate steps of the run are not presented. The display is only
+   * presented when something new comes into view or the run stops.
+   */
+  set_display_hold(1);
+  last_exits = run_exits(playerx, playery);
+
   while (i)
   {
     i = moveplayer(dir);
@@ -266,8 +862,23 @@ void run (int dir)
       regen();
     }
     if (hitflag) i=0;
-    if (i!=0) showcell(playerx,playery);
+    if (i!=0)
+    {
+      exits = run_exits(playerx, playery);
+      present = run_sees_something(playerx, playery) || (exits != last_exits);
+      last_exits = exits;
+
+      showcell(playerx,playery);
+
+      if (present)
+      {
+        set_display_hold(0);
+        set_display_hold(1);
+      }
+    }
   }
+
+  set_display_hold(0);
 }
 
 /* =============================================================================
@@ -548,12 +1159,14 @@ void readscr (void)
         {
           read_scroll(ivenarg[i-'a']);
           iven[i-'a'] = ONOTHING;
+          inventory_changed(i-'a');
           return;
         }
         if (iven[i-'a']==OBOOK)
         {
           readbook(ivenarg[i-'a']);
           iven[i-'a'] = ONOTHING;
+          inventory_changed(i-'a');
           return;
         }
         if (iven[i-'a'] == ONOTHING)
@@ -592,6 +1205,7 @@ void eatcookie (void)
       {
         Print("\nThe cookie was delicious.");
         iven[i-'a'] = ONOTHING;
+        inventory_changed(i-'a');
         if (!c[BLINDCOUNT])
         {
           p = fortune(fortfile);
@@ -642,6 +1256,7 @@ void quaff (void)
       {
         quaffpotion(ivenarg[i-'a']);
         iven[i-'a'] = ONOTHING;
+        inventory_changed(i-'a');
         return;
       }
       else if (iven[i-'a'] == ONOTHING)
@@ -786,7 +1401,7 @@ void closedoor(void)
       }
       else
       {
-        item[dx][dy] = OCLOSEDDOOR;
+        set_item(dx, dy, OCLOSEDDOOR);
         iarg[dx][dy] = 0;            /* Clear traps on door */
         Print("\nThe door closes.");
       }
@@ -804,7 +1419,7 @@ void closedoor(void)
 
     Print("\nThe door closes.");
     forget();
-    item[playerx][playery]=OCLOSEDDOOR;
+    set_item(playerx, playery, OCLOSEDDOOR);
     iarg[playerx][playery]=0;
 
     dropflag=1; /* So we won't be asked to open it */
@@ -14,6 +14,7 @@
  * EXPORTED FUNCTIONS
  *
  * run       : Move in a direction until something interesting happens
+ * travel    : Travel to a selected destination on the known map
  * wield     : Wield an item
  * wear      : Wear armour or shield
  * dropobj   : Drop an object
@@ -49,6 +50,24 @@
  */
 void run (int dir);
 
+/* =============================================================================
+ * FUNCTION: travel
+ *
+ * DESCRIPTION:
+ * Ask the player for a destination and travel there along the shortest
+ * path over the known map, avoiding known traps.
+ * Travel is interrupted under the same conditions as run.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void travel (void);
+
 /* =============================================================================
  * FUNCTION: wield
  *
@@ -0,0 +1,284 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: agent.c
+ *
+ * DESCRIPTION:
+ * Agent interface module.
+ * This module lets a program play the game directly, without a display or
+ * keyboard: it observes the game state in place, queues an action together
+ * with the answers to any prompts the action raises, and steps the game one
+ * turn at a time.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * agent_init       : Initialise the game for agent play
+ * agent_new_game   : Start a new game
+ * agent_observe    : Get a view of the current game state
+ * agent_monster_at : Get the monster the player can see at a location
+ * agent_act        : Queue the action for the next step
+ * agent_step       : Play one turn of the game
+ * agent_game_over  : Check if the game has ended
+ * agent_next_action : Get the queued action (display interface use only)
+ * agent_next_answer : Get the next prompt answer (display interface use only)
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "header.h"
+#include "ularn_game.h"
+#include "ularn_win.h"
+#include "ularn.h"
+#include "agent.h"
+#include "dungeon.h"
+#include "monster.h"
+#include "player.h"
+#include "sphere.h"
+#include "scores.h"
+#include "snapshot.h"
+#include "itm.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The action queued for the next step.
+ */
+static ActionType QueuedAction = ACTION_NULL;
+
+/*
+ * The prompt answers queued for the next step and the next one to use.
+ */
+static char Answers[AGENT_MAX_ANSWERS + 1];
+static int AnswerPos = 0;
+
+/*
+ * The game state after agent_init, which every new game starts from.
+ * This resets the stores, genocided monsters etc. left by earlier games.
+ */
+static GameSnapshotType *InitialState = NULL;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: agent_init
+ */
+int agent_init(char *LibDir)
+{
+  if (strlen(LibDir) > MAXPATHLEN - 16) return 0;
+
+  strcpy(libdir, LibDir);
+  sprintf(scorefile, "%.*s/%s", MAXPATHLEN - 16, libdir, SCORENAME);
+  sprintf(helpfile, "%.*s/%s", MAXPATHLEN - 16, libdir, HELPNAME);
+  sprintf(larnlevels, "%.*s/%s", MAXPATHLEN - 16, libdir, LEVELSNAME);
+  sprintf(fortfile, "%.*s/%s", MAXPATHLEN - 16, libdir, FORTSNAME);
+
+  strcpy(savefilename, "ularn_agent.sav");
+  strcpy(ckpfile, "ularn_agent.ckp");
+
+  /* Agents don't watch the animations */
+  nonap = 1;
+
+  if (!init_app()) return 0;
+
+  GetUser(loginname, &userid);
+  strcpy(logname, loginname);
+
+  init_cells();
+
+  InitialState = snapshot_take();
+  if (InitialState == NULL) return 0;
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_new_game
+ */
+void agent_new_game(unsigned Seed, int Hard, char Class)
+{
+  snapshot_restore(InitialState);
+  game_over = 0;
+
+  initialtime = (time_t) Seed;
+  game_srand(Seed);
+
+  restorflag = 0;
+
+  char_picked = Class;
+  makeplayer();
+  newcavelevel(0);
+
+  sethard(Hard);
+
+  set_display(DISPLAY_MAP);
+  showplayer();
+
+  yrepcount = 0;
+  hit2flag = 0;
+
+  QueuedAction = ACTION_NULL;
+  Answers[0] = 0;
+  AnswerPos = 0;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_observe
+ */
+void agent_observe(AgentObservationType *Obs)
+{
+  /* c[] holds the time left for each effect as at when it was scheduled */
+  sync_effects();
+
+  Obs->know = know;
+  Obs->mitem = mitem;
+  Obs->stealth = stealth;
+  Obs->hitp = hitp;
+  Obs->c = c;
+  Obs->iven = iven;
+  Obs->ivenarg = ivenarg;
+  Obs->playerx = playerx;
+  Obs->playery = playery;
+  Obs->level = level;
+  Obs->gtime = gtime;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_monster_at
+ */
+MonsterIdType agent_monster_at(int x, int y)
+{
+  MonsterIdType Monst;
+
+  if (c[BLINDCOUNT] != 0) return MONST_NONE;
+  if (know[x][y] == OUNKNOWN) return MONST_NONE;
+
+  Monst = mitem[x][y].mon;
+  if (Monst == MONST_NONE) return MONST_NONE;
+
+  if ((stealth[x][y] & (STEALTH_SEEN | STEALTH_AWAKE)) == 0)
+  {
+    return MONST_NONE;
+  }
+
+  if ((Monst == INVISIBLESTALKER) && (c[SEEINVISIBLE] == 0))
+  {
+    return MONST_NONE;
+  }
+
+  /* demons are invisible if not have the eye */
+  if ((Monst >= DEMONLORD) && (Monst <= LUCIFER) && (c[EYEOFLARN] == 0))
+  {
+    return MONST_NONE;
+  }
+
+  return Monst;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_act
+ */
+void agent_act(ActionType Action, char *NewAnswers)
+{
+  QueuedAction = Action;
+
+  if (NewAnswers == NULL)
+  {
+    Answers[0] = 0;
+  }
+  else
+  {
+    strncpy(Answers, NewAnswers, AGENT_MAX_ANSWERS);
+    Answers[AGENT_MAX_ANSWERS] = 0;
+  }
+  AnswerPos = 0;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_step
+ */
+ActionType agent_step(void)
+{
+  jmp_buf EndJump;
+  jmp_buf *OldJump;
+  ActionType Action;
+
+  if (game_over) return ACTION_NULL;
+
+  /* If the game ends, endgame returns here instead of exiting */
+  OldJump = game_end_jump;
+  if (setjmp(EndJump) == 0)
+  {
+    game_end_jump = &EndJump;
+    Action = do_one_turn();
+  }
+  else
+  {
+    Action = ACTION_NULL;
+  }
+  game_end_jump = OldJump;
+
+  /* Anything not used in this turn is not carried over to the next */
+  QueuedAction = ACTION_NULL;
+  Answers[0] = 0;
+  AnswerPos = 0;
+
+  return Action;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_game_over
+ */
+int agent_game_over(GameResultType *Result)
+{
+  if (!game_over) return 0;
+
+  if (Result != NULL)
+  {
+    *Result = game_result;
+  }
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_next_action
+ */
+ActionType agent_next_action(void)
+{
+  ActionType Action;
+
+  if (QueuedAction == ACTION_NULL) return ACTION_WAIT;
+
+  Action = QueuedAction;
+  QueuedAction = ACTION_NULL;
+
+  return Action;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_next_answer
+ */
+int agent_next_answer(void)
+{
+  if (Answers[AnswerPos] == 0) return -1;
+
+  return (unsigned char) Answers[AnswerPos++];
+}
@@ -0,0 +1,247 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: agent.h
+ *
+ * DESCRIPTION:
+ * Agent interface module.
+ * This module lets a program play the game directly, without a display or
+ * keyboard: it observes the game state in place, queues an action together
+ * with the answers to any prompts the action raises, and steps the game one
+ * turn at a time.
+ *
+ * Programs using this module link with ularn_winagent.o (the headless
+ * display interface) and with ularn.c compiled with ULARN_NO_MAIN.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * agent_init       : Initialise the game for agent play
+ * agent_new_game   : Start a new game
+ * agent_observe    : Get a view of the current game state
+ * agent_monster_at : Get the monster the player can see at a location
+ * agent_act        : Queue the action for the next step
+ * agent_step       : Play one turn of the game
+ * agent_game_over  : Check if the game has ended
+ * agent_next_action : Get the queued action (display interface use only)
+ * agent_next_answer : Get the next prompt answer (display interface use only)
+ *
+ * =============================================================================
+ */
+
+#ifndef __AGENT_H
+#define __AGENT_H
+
+#include "ularn_win.h"
+#include "dungeon.h"
+#include "monster.h"
+#include "scores.h"
+
+/*
+ * The maximum number of prompt answers that can be queued with an action.
+ */
+#define AGENT_MAX_ANSWERS 255
+
+/*
+ * A view of the game state as the player knows it.
+ * The array members point directly at the game's own storage, so they are
+ * only valid until the next call to agent_step and must not be modified.
+ * Each map array is indexed [x][y] and is MAXX by MAXY.
+ */
+typedef struct
+{
+  char (*know)[MAXY];            /* what the player believes is at each cell */
+  struct_mitem (*mitem)[MAXY];   /* the monster at each cell (see below)     */
+  char (*stealth)[MAXY];         /* monster seen/awake flags for each cell   */
+  short (*hitp)[MAXY];           /* monster hit points for each cell         */
+  long *c;                       /* player attributes (see agent_observe)    */
+  char *iven;                    /* inventory items, IVENSIZE entries        */
+  short *ivenarg;                /* inventory item args, IVENSIZE entries    */
+  int playerx;                   /* the player location                      */
+  int playery;
+  int level;                     /* the current dungeon level                */
+  long gtime;                    /* the game clock                           */
+} AgentObservationType;
+
+/* =============================================================================
+ * FUNCTION: agent_init
+ *
+ * DESCRIPTION:
+ * Initialise the game for agent play. This must be called once before any
+ * other agent function.
+ *
+ * PARAMETERS:
+ *
+ *   LibDir : The directory holding the game data files (Umaps etc.)
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the game could not be initialised.
+ */
+int agent_init(char *LibDir);
+
+/* =============================================================================
+ * FUNCTION: agent_new_game
+ *
+ * DESCRIPTION:
+ * Start a new game on the home level.
+ * Every game starts from the state the game had after agent_init, so this
+ * may be called again at any time, including after a game has ended.
+ * Games started with the same seed, difficulty and character class play out
+ * the same way for the same sequence of actions.
+ *
+ * PARAMETERS:
+ *
+ *   Seed  : The random number seed for the game
+ *
+ *   Hard  : The difficulty level
+ *
+ *   Class : The character class letter, as picked at the start of a game
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void agent_new_game(unsigned Seed, int Hard, char Class);
+
+/* =============================================================================
+ * FUNCTION: agent_observe
+ *
+ * DESCRIPTION:
+ * Get a view of the current game state. No game data is copied.
+ * The monster arrays hold every monster on the level: use agent_monster_at
+ * to find out which of them the player can see.
+ * The time remaining for timed effects (HERO, HASTESELF, STEALTH, BLINDCOUNT
+ * etc.) is only brought up to date in c when the game is observed, so the
+ * c view is valid only until the next call to agent_step, after which the
+ * game must be observed again.
+ *
+ * PARAMETERS:
+ *
+ *   Obs : The observation to fill in
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void agent_observe(AgentObservationType *Obs);
+
+/* =============================================================================
+ * FUNCTION: agent_monster_at
+ *
+ * DESCRIPTION:
+ * Get the monster that the player can see at a location, using the same
+ * rules as the map display.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the location
+ *
+ *   y : The y coordinate of the location
+ *
+ * RETURN VALUE:
+ *
+ *   The monster the player sees there, or MONST_NONE.
+ */
+MonsterIdType agent_monster_at(int x, int y);
+
+/* =============================================================================
+ * FUNCTION: agent_act
+ *
+ * DESCRIPTION:
+ * Queue the action to perform in the next step, with the answers to any
+ * prompts that the action raises.
+ * The answers are the keys that would be typed at each prompt, in order.
+ * Numbers and passwords are ended with '\r'. Directions use the movement
+ * keys: h j k l y u b n.
+ * If a prompt is raised after the answers have run out then the most
+ * cautious answer is taken: escape if allowed, otherwise the first answer.
+ *
+ * PARAMETERS:
+ *
+ *   Action  : The action to perform
+ *
+ *   Answers : The prompt answers, or NULL if there are none
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void agent_act(ActionType Action, char *Answers);
+
+/* =============================================================================
+ * FUNCTION: agent_step
+ *
+ * DESCRIPTION:
+ * Play one turn of the game (one call of do_one_turn) using the queued
+ * action. If the action did not use up the turn, or no action was queued,
+ * the player waits for the rest of the turn.
+ * If the game ends during the turn then the turn stops there, and
+ * agent_game_over reports the result until a new game is started.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The last action performed in the turn, or ACTION_NULL if the game
+ *   ended or had already ended.
+ */
+ActionType agent_step(void);
+
+/* =============================================================================
+ * FUNCTION: agent_game_over
+ *
+ * DESCRIPTION:
+ * Check if the game has ended, and get the result if it has.
+ *
+ * PARAMETERS:
+ *
+ *   Result : Set to the result of the game if it has ended (may be NULL)
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the game has ended, 0 if it is still being played.
+ */
+int agent_game_over(GameResultType *Result);
+
+/* =============================================================================
+ * FUNCTION: agent_next_action
+ *
+ * DESCRIPTION:
+ * Get the queued action, removing it from the queue.
+ * This is called by the display interface to get the player's command.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The queued action, or ACTION_WAIT if there is none.
+ */
+ActionType agent_next_action(void);
+
+/* =============================================================================
+ * FUNCTION: agent_next_answer
+ *
+ * DESCRIPTION:
+ * Get the next queued prompt answer, removing it from the queue.
+ * This is called by the display interface when the game prompts for input.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The next answer key, or -1 if there are no answers left.
+ */
+int agent_next_answer(void);
+
+#endif
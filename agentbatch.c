@@ -0,0 +1,496 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: agentbatch.c
+ *
+ * DESCRIPTION:
+ * Batched agent interface module.
+ * This module steps a batch of games in lockstep: each step takes one action
+ * for every game and returns the observations of all of the games in one
+ * array. Games that end are replaced with new games automatically.
+ *
+ * Each game is played by a worker process forked from the caller. The
+ * actions and observations are passed in a shared memory buffer, and each
+ * worker has a pair of pipes: the caller writes a byte to start a step and
+ * the worker writes a byte back when the step is done. When a game ends the
+ * worker starts the next game in its slot. If a worker is lost, which the
+ * caller sees as end of file on its reply pipe, a new worker is forked to
+ * play the next game.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * agent_batch_open  : Start a batch of games
+ * agent_batch_step  : Play one turn of every game in the batch
+ * agent_batch_close : Stop a batch of games
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "header.h"
+
+#ifdef UNIX
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <errno.h>
+#endif
+
+#include "agent.h"
+#include "agentbatch.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The shared memory for each game in the batch.
+ */
+struct BatchSlotType
+{
+  long Started;                 /* The number of games started in the slot */
+  ActionType Action;
+  char Answers[AGENT_MAX_ANSWERS + 1];
+  AgentBatchObsType Obs;
+};
+
+struct AgentBatchType
+{
+  int Games;
+  unsigned Seed;
+  int Hard;
+  char Class;
+  struct BatchSlotType *Slots;  /* Games slots, shared with the workers */
+  size_t SlotsSize;
+  pid_t *Pid;                   /* The worker process for each slot */
+  int *CmdFd;                   /* Write end of each worker's command pipe */
+  int *ReplyFd;                 /* Read end of each worker's reply pipe */
+};
+
+/* =============================================================================
+ * Local functions
+ */
+
+#ifdef UNIX
+
+/* =============================================================================
+ * FUNCTION: read_byte
+ *
+ * DESCRIPTION:
+ * Read a byte from a pipe, retrying if interrupted by a signal.
+ *
+ * PARAMETERS:
+ *
+ *   fd : The read end of the pipe
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a byte was read, 0 at end of file or on error.
+ */
+static int read_byte(int fd)
+{
+  char Byte;
+  ssize_t Len;
+
+  while (((Len = read(fd, &Byte, 1)) < 0) && (errno == EINTR))
+  {
+  }
+
+  return (Len == 1);
+}
+
+/* =============================================================================
+ * FUNCTION: observe
+ *
+ * DESCRIPTION:
+ * Copy the current game state into a batch observation.
+ * The game is observed first, as that brings the time remaining for timed
+ * effects in c up to date.
+ *
+ * PARAMETERS:
+ *
+ *   Obs : The observation to fill in
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void observe(AgentBatchObsType *Obs)
+{
+  AgentObservationType View;
+  int x, y;
+
+  agent_observe(&View);
+
+  memcpy(Obs->know, View.know, sizeof(Obs->know));
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      Obs->monst[x][y] = (char) agent_monster_at(x, y);
+    }
+  }
+  /* agent_observe has synced the timed effects, so c is current */
+  memcpy(Obs->c, View.c, sizeof(Obs->c));
+  memcpy(Obs->iven, View.iven, sizeof(Obs->iven));
+  memcpy(Obs->ivenarg, View.ivenarg, sizeof(Obs->ivenarg));
+  Obs->playerx = View.playerx;
+  Obs->playery = View.playery;
+  Obs->level = View.level;
+  Obs->gtime = View.gtime;
+}
+
+/* =============================================================================
+ * FUNCTION: start_game
+ *
+ * DESCRIPTION:
+ * Start the next game in a slot.
+ *
+ * PARAMETERS:
+ *
+ *   Batch : The batch of games
+ *
+ *   n     : The slot number
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void start_game(AgentBatchType *Batch, int n)
+{
+  struct BatchSlotType *Slot;
+  unsigned Seed;
+
+  Slot = &Batch->Slots[n];
+
+  Seed = Batch->Seed + (unsigned) n +
+         (unsigned) Slot->Started * (unsigned) Batch->Games;
+  Slot->Started++;
+
+  agent_new_game(Seed, Batch->Hard, Batch->Class);
+  Slot->Obs.seed = Seed;
+}
+
+/* =============================================================================
+ * FUNCTION: run_worker
+ *
+ * DESCRIPTION:
+ * The worker process for one slot of a batch. This starts a game and plays
+ * one step each time the caller asks, starting a new game whenever a game
+ * ends, until the caller closes the command pipe.
+ *
+ * PARAMETERS:
+ *
+ *   Batch   : The batch of games
+ *
+ *   n       : The slot number
+ *
+ *   CmdFd   : The read end of the command pipe
+ *
+ *   ReplyFd : The write end of the reply pipe
+ *
+ * RETURN VALUE:
+ *
+ *   Does not return.
+ */
+static void run_worker(AgentBatchType *Batch, int n, int CmdFd, int ReplyFd)
+{
+  struct BatchSlotType *Slot;
+  char Byte;
+
+  Slot = &Batch->Slots[n];
+
+  start_game(Batch, n);
+  observe(&Slot->Obs);
+
+  Byte = 0;
+  while (write(ReplyFd, &Byte, 1) == 1)
+  {
+    if (!read_byte(CmdFd)) break;
+
+    agent_act(Slot->Action, (Slot->Answers[0] != 0) ? Slot->Answers : NULL);
+    agent_step();
+
+    Slot->Obs.done = agent_game_over(&Slot->Obs.result);
+    if (Slot->Obs.done)
+    {
+      start_game(Batch, n);
+    }
+
+    observe(&Slot->Obs);
+  }
+
+  _exit(0);
+}
+
+/* =============================================================================
+ * FUNCTION: start_worker
+ *
+ * DESCRIPTION:
+ * Fork the worker process for a slot and wait for it to start its first
+ * game.
+ *
+ * PARAMETERS:
+ *
+ *   Batch : The batch of games
+ *
+ *   n     : The slot number
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the worker could not be started.
+ */
+static int start_worker(AgentBatchType *Batch, int n)
+{
+  int CmdPipe[2];
+  int ReplyPipe[2];
+  pid_t Pid;
+  int i;
+
+  if (pipe(CmdPipe) != 0) return 0;
+  if (pipe(ReplyPipe) != 0)
+  {
+    close(CmdPipe[0]);
+    close(CmdPipe[1]);
+    return 0;
+  }
+
+  /* Don't let the worker inherit unwritten output */
+  fflush(NULL);
+
+  Pid = fork();
+  if (Pid == 0)
+  {
+    /*
+     * Close the other workers' pipes, so that each worker only holds its
+     * own and they see end of file when the caller closes them.
+     */
+    for (i = 0 ; i < Batch->Games ; i++)
+    {
+      if (Batch->Pid[i] > 0)
+      {
+        close(Batch->CmdFd[i]);
+        close(Batch->ReplyFd[i]);
+      }
+    }
+    close(CmdPipe[1]);
+    close(ReplyPipe[0]);
+
+    run_worker(Batch, n, CmdPipe[0], ReplyPipe[1]);
+  }
+
+  close(CmdPipe[0]);
+  close(ReplyPipe[1]);
+
+  if (Pid < 0)
+  {
+    close(CmdPipe[1]);
+    close(ReplyPipe[0]);
+    return 0;
+  }
+
+  Batch->Pid[n] = Pid;
+  Batch->CmdFd[n] = CmdPipe[1];
+  Batch->ReplyFd[n] = ReplyPipe[0];
+
+  /* Wait for the game to start */
+  return read_byte(Batch->ReplyFd[n]);
+}
+
+/* =============================================================================
+ * FUNCTION: stop_worker
+ *
+ * DESCRIPTION:
+ * Close a slot's pipes and wait for its worker process to end.
+ *
+ * PARAMETERS:
+ *
+ *   Batch : The batch of games
+ *
+ *   n     : The slot number
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void stop_worker(AgentBatchType *Batch, int n)
+{
+  if (Batch->Pid[n] <= 0) return;
+
+  close(Batch->CmdFd[n]);
+  close(Batch->ReplyFd[n]);
+
+  while ((waitpid(Batch->Pid[n], NULL, 0) < 0) && (errno == EINTR))
+  {
+  }
+
+  Batch->Pid[n] = 0;
+}
+
+#endif
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: agent_batch_open
+ */
+AgentBatchType *agent_batch_open(int Games, unsigned Seed, int Hard, char Class,
+                                 AgentBatchObsType *Obs)
+{
+#ifdef UNIX
+  AgentBatchType *Batch;
+  void *Mem;
+  int n;
+
+  if (Games <= 0) return NULL;
+
+  Batch = (AgentBatchType *) calloc(1, sizeof(AgentBatchType));
+  if (Batch == NULL) return NULL;
+
+  Batch->Games = Games;
+  Batch->Seed = Seed;
+  Batch->Hard = Hard;
+  Batch->Class = Class;
+
+  Batch->Pid = (pid_t *) calloc(Games, sizeof(pid_t));
+  Batch->CmdFd = (int *) calloc(Games, sizeof(int));
+  Batch->ReplyFd = (int *) calloc(Games, sizeof(int));
+
+  Batch->SlotsSize = (size_t) Games * sizeof(struct BatchSlotType);
+  Mem = mmap(NULL, Batch->SlotsSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  Batch->Slots = (Mem != MAP_FAILED) ? (struct BatchSlotType *) Mem : NULL;
+  if (Batch->Slots != NULL)
+  {
+    memset(Batch->Slots, 0, Batch->SlotsSize);
+  }
+
+  if ((Batch->Pid == NULL) ||
+      (Batch->CmdFd == NULL) || (Batch->ReplyFd == NULL) ||
+      (Batch->Slots == NULL))
+  {
+    agent_batch_close(Batch);
+    return NULL;
+  }
+
+  /* The workers all start their games at the same time */
+  for (n = 0 ; n < Games ; n++)
+  {
+    if (!start_worker(Batch, n))
+    {
+      agent_batch_close(Batch);
+      return NULL;
+    }
+  }
+
+  for (n = 0 ; n < Games ; n++)
+  {
+    memcpy(&Obs[n], &Batch->Slots[n].Obs, sizeof(AgentBatchObsType));
+  }
+
+  return Batch;
+#else
+  return NULL;
+#endif
+}
+
+/* =============================================================================
+ * FUNCTION: agent_batch_step
+ */
+int agent_batch_step(AgentBatchType *Batch, ActionType *Actions,
+                     char **Answers, AgentBatchObsType *Obs)
+{
+#ifdef UNIX
+  struct BatchSlotType *Slot;
+  char Byte;
+  int Ended;
+  int n;
+
+  /* Start every game's step */
+  Byte = 0;
+  for (n = 0 ; n < Batch->Games ; n++)
+  {
+    Slot = &Batch->Slots[n];
+
+    Slot->Action = Actions[n];
+    if ((Answers == NULL) || (Answers[n] == NULL))
+    {
+      Slot->Answers[0] = 0;
+    }
+    else
+    {
+      strncpy(Slot->Answers, Answers[n], AGENT_MAX_ANSWERS);
+      Slot->Answers[AGENT_MAX_ANSWERS] = 0;
+    }
+
+    if (write(Batch->CmdFd[n], &Byte, 1) != 1) return -1;
+  }
+
+  /* Wait for them all to finish */
+  Ended = 0;
+  for (n = 0 ; n < Batch->Games ; n++)
+  {
+    if (!read_byte(Batch->ReplyFd[n]))
+    {
+      /* The worker was lost, so end its game and start a new worker */
+      stop_worker(Batch, n);
+      if (!start_worker(Batch, n)) return -1;
+
+      Batch->Slots[n].Obs.done = 1;
+      Batch->Slots[n].Obs.result.Score = 0;
+      Batch->Slots[n].Obs.result.Reason = DIED_INTERNAL_COMPLICATIONS;
+      Batch->Slots[n].Obs.result.Monster = 0;
+      Batch->Slots[n].Obs.result.Level = 0;
+      Batch->Slots[n].Obs.result.Win = 0;
+    }
+
+    if (Batch->Slots[n].Obs.done) Ended++;
+
+    memcpy(&Obs[n], &Batch->Slots[n].Obs, sizeof(AgentBatchObsType));
+  }
+
+  return Ended;
+#else
+  return -1;
+#endif
+}
+
+/* =============================================================================
+ * FUNCTION: agent_batch_close
+ */
+void agent_batch_close(AgentBatchType *Batch)
+{
+  int n;
+
+  if (Batch == NULL) return;
+
+#ifdef UNIX
+  if (Batch->Pid != NULL)
+  {
+    for (n = 0 ; n < Batch->Games ; n++)
+    {
+      stop_worker(Batch, n);
+    }
+  }
+
+  if (Batch->Slots != NULL)
+  {
+    munmap(Batch->Slots, Batch->SlotsSize);
+  }
+#endif
+
+  free(Batch->Pid);
+  free(Batch->CmdFd);
+  free(Batch->ReplyFd);
+  free(Batch);
+}
@@ -0,0 +1,142 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: agentbatch.h
+ *
+ * DESCRIPTION:
+ * Batched agent interface module.
+ * This module steps a batch of games in lockstep: each step takes one action
+ * for every game and returns the observations of all of the games in one
+ * array. Games that end are replaced with new games automatically.
+ *
+ * The game state is held in global variables, so each game in the batch is
+ * played by its own worker process (UNIX only). The workers are forked from
+ * the calling process after agent_init, share the observation buffer with
+ * it, and all step at the same time. Each step waits for every game before
+ * returning. A worker starts its next game itself when a game ends.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * agent_batch_open  : Start a batch of games
+ * agent_batch_step  : Play one turn of every game in the batch
+ * agent_batch_close : Stop a batch of games
+ *
+ * =============================================================================
+ */
+
+#ifndef __AGENTBATCH_H
+#define __AGENTBATCH_H
+
+#include "ularn_win.h"
+#include "dungeon.h"
+#include "player.h"
+#include "scores.h"
+
+/*
+ * The observation of one game in a batch.
+ * Unlike AgentObservationType this is a copy of the game state, laid out so
+ * that a batch of observations is one contiguous array.
+ * Each map array is indexed [x][y].
+ */
+typedef struct
+{
+  char know[MAXX][MAXY];         /* what the player believes is at each cell */
+  char monst[MAXX][MAXY];        /* the monster the player sees at each cell */
+  long c[ATTRIBUTE_COUNT];       /* player attributes, by AttributeType      */
+  char iven[IVENSIZE];           /* inventory items                          */
+  short ivenarg[IVENSIZE];       /* inventory item args                      */
+  int playerx;                   /* the player location                      */
+  int playery;
+  int level;                     /* the current dungeon level                */
+  long gtime;                    /* the game clock                           */
+  unsigned seed;                 /* the seed the game was started with       */
+  int done;                      /* set if the previous game ended in the    */
+                                 /* last step and this is a new game         */
+  GameResultType result;         /* how the previous game ended, if done     */
+} AgentBatchObsType;
+
+/*
+ * A batch of games, as returned by agent_batch_open.
+ */
+typedef struct AgentBatchType AgentBatchType;
+
+/* =============================================================================
+ * FUNCTION: agent_batch_open
+ *
+ * DESCRIPTION:
+ * Start a batch of games. agent_init must have been called first.
+ * Game n of the batch is started with seed Seed + n, and each game that
+ * replaces it adds Games to the seed, so a batch plays the same way for the
+ * same actions.
+ *
+ * PARAMETERS:
+ *
+ *   Games : The number of games in the batch
+ *
+ *   Seed  : The random number seed for the first game
+ *
+ *   Hard  : The difficulty level
+ *
+ *   Class : The character class letter, as picked at the start of a game
+ *
+ *   Obs   : An array of Games observations, set to the start of each game
+ *
+ * RETURN VALUE:
+ *
+ *   The batch, or NULL if it could not be started.
+ */
+AgentBatchType *agent_batch_open(int Games, unsigned Seed, int Hard, char Class,
+                                 AgentBatchObsType *Obs);
+
+/* =============================================================================
+ * FUNCTION: agent_batch_step
+ *
+ * DESCRIPTION:
+ * Play one turn of every game in the batch, as agent_act and agent_step do
+ * for a single game, and wait for all of them to finish.
+ * A game that ends is replaced by a new game, and its observation is the
+ * start of the new game with done set and the result of the game that
+ * ended.
+ *
+ * PARAMETERS:
+ *
+ *   Batch   : The batch of games
+ *
+ *   Actions : The action for each game
+ *
+ *   Answers : The prompt answers for each game (see agent_act), or NULL if
+ *             there are none for any game. Entries may be NULL.
+ *
+ *   Obs     : An array of observations, set to the state of each game
+ *             after the step
+ *
+ * RETURN VALUE:
+ *
+ *   The number of games that ended in this step, or -1 if a replacement
+ *   game could not be started.
+ */
+int agent_batch_step(AgentBatchType *Batch, ActionType *Actions,
+                     char **Answers, AgentBatchObsType *Obs);
+
+/* =============================================================================
+ * FUNCTION: agent_batch_close
+ *
+ * DESCRIPTION:
+ * Stop all of the games in a batch and free the batch.
+ *
+ * PARAMETERS:
+ *
+ *   Batch : The batch of games (may be NULL)
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void agent_batch_close(AgentBatchType *Batch);
+
+#endif
@@ -0,0 +1,662 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: agentdemo.c
+ *
+ * DESCRIPTION:
+ * Example program for the agent interface.
+ * This plays games with an agent that walks in random directions, going
+ * down any stairs and opening any doors it finds and attacking any monster
+ * it sees next to it, and reports how many steps per second were played.
+ * When a game ends the next game is started with the next seed.
+ *
+ * With -k, every interval steps it also takes a snapshot of the game, plays
+ * ahead, restores the snapshot and plays the same steps again, checking that
+ * the game plays out the same way and reporting the snapshot costs. Every
+ * other check first summons monsters next to the player and attacks them,
+ * so that the snapshot is taken in the middle of a fight.
+ *
+ * With -b, it plays a batch of games in lockstep using the batched agent
+ * interface instead.
+ *
+ * Usage: ularn-agentdemo [-n steps] [-s seed] [-l libdir] [-k interval]
+ *                        [-b games]
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * main : The program entry point
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "header.h"
+#include "ularn_game.h"
+#include "getopt.h"
+#include "agent.h"
+#include "agentbatch.h"
+#include "snapshot.h"
+#include "itm.h"
+#include "monster.h"
+#include "player.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The offset to the cell in each movement direction and the action that
+ * moves there.
+ */
+static int DirX[8] = { -1, 1, 0, 0, 1, -1, 1, -1 };
+static int DirY[8] = { 0, 0, 1, -1, -1, -1, 1, 1 };
+
+static ActionType DirAction[8] =
+{
+  ACTION_MOVE_WEST,
+  ACTION_MOVE_EAST,
+  ACTION_MOVE_SOUTH,
+  ACTION_MOVE_NORTH,
+  ACTION_MOVE_NORTHEAST,
+  ACTION_MOVE_NORTHWEST,
+  ACTION_MOVE_SOUTHEAST,
+  ACTION_MOVE_SOUTHWEST
+};
+
+/*
+ * The agent's random number state. The agent has its own generator so that
+ * its choices do not change the game's random numbers.
+ */
+static unsigned long AgentRand = 1;
+
+/*
+ * The seed of the current game and the number of games that have ended.
+ */
+static unsigned GameSeed = 1;
+static long GamesEnded = 0;
+
+/*
+ * The number of steps played ahead of each snapshot by the -k check.
+ */
+#define LOOKAHEAD_STEPS 50
+
+/*
+ * The monsters summoned for the -k fight checks, and the most steps spent
+ * trying to hit one before the snapshot is taken. The last monster hit moves
+ * before the others, which only changes the game if the others are of a
+ * different kind, so two kinds are summoned.
+ */
+#define FIGHT_MONSTER_1 HOBGOBLIN
+#define FIGHT_MONSTER_2 KOBOLD
+#define FIGHT_STEPS     8
+
+/*
+ * The parts of the game state compared by the -k check.
+ */
+typedef struct
+{
+  long Attr[ATTRIBUTE_COUNT];
+  long Time;
+  unsigned long Rand;
+  int Level;
+  int x;
+  int y;
+  int HitX;
+  int HitY;
+} FingerprintType;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: now_us
+ *
+ * DESCRIPTION:
+ * Get a monotonic time stamp.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The time in microseconds.
+ */
+static double now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+}
+
+/* =============================================================================
+ * FUNCTION: agent_rand
+ *
+ * DESCRIPTION:
+ * Get the agent's next random number.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   A random number in the range 0 to 32767.
+ */
+static int agent_rand(void)
+{
+  AgentRand = AgentRand * 1103515245UL + 12345UL;
+
+  return (int) ((AgentRand >> 16) & 0x7fff);
+}
+
+/* =============================================================================
+ * FUNCTION: choose_action
+ *
+ * DESCRIPTION:
+ * Choose the agent's next action.
+ *
+ * PARAMETERS:
+ *
+ *   Here    : What the player knows is at the player's location
+ *
+ *   px      : The player's x coordinate
+ *
+ *   py      : The player's y coordinate
+ *
+ *   Monst   : The monster the player sees at each cell, or NULL to use
+ *             agent_monster_at
+ *
+ *   Answers : Set to the prompt answers for the action
+ *
+ * RETURN VALUE:
+ *
+ *   The action to take.
+ */
+static ActionType choose_action(int Here, int px, int py, char (*Monst)[MAXY],
+                                char **Answers)
+{
+  int Dir;
+  int x, y;
+  int Seen;
+
+  /*
+   * The game asks what to do about the object the player is standing on at
+   * the start of the turn, before asking for the next action.
+   */
+  switch (Here)
+  {
+    case OSTAIRSDOWN:
+      *Answers = "d";
+      break;
+    case OVOLDOWN:
+      *Answers = "c";
+      break;
+    case OENTRANCE:
+      *Answers = "g";
+      break;
+    case OCLOSEDDOOR:
+      *Answers = "o";
+      break;
+    default:
+      *Answers = NULL;
+      break;
+  }
+
+  /* Attack the first monster in sight next to the player */
+  for (Dir = 0 ; Dir < 8 ; Dir++)
+  {
+    x = px + DirX[Dir];
+    y = py + DirY[Dir];
+
+    if ((x < 0) || (x >= MAXX) || (y < 0) || (y >= MAXY)) continue;
+
+    Seen = (Monst != NULL) ? Monst[x][y] : agent_monster_at(x, y);
+    if (Seen != MONST_NONE)
+    {
+      return DirAction[Dir];
+    }
+  }
+
+  return DirAction[agent_rand() % 8];
+}
+
+/* =============================================================================
+ * FUNCTION: play
+ *
+ * DESCRIPTION:
+ * Play a number of steps with the agent.
+ *
+ * PARAMETERS:
+ *
+ *   Steps        : The number of steps to play
+ *
+ *   DeepestLevel : Updated with the deepest level reached
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void play(long Steps, int *DeepestLevel)
+{
+  AgentObservationType Obs;
+  ActionType Action;
+  char *Answers;
+  long Step;
+
+  for (Step = 0 ; Step < Steps ; Step++)
+  {
+    agent_observe(&Obs);
+    if (Obs.level > *DeepestLevel) *DeepestLevel = Obs.level;
+
+    Action = choose_action(Obs.know[Obs.playerx][Obs.playery],
+                           Obs.playerx, Obs.playery, NULL, &Answers);
+
+    agent_act(Action, Answers);
+    agent_step();
+
+    if (agent_game_over(NULL))
+    {
+      GamesEnded++;
+      GameSeed++;
+      agent_new_game(GameSeed, 0, 'a');
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: play_batch
+ *
+ * DESCRIPTION:
+ * Play a batch of games in lockstep, each with its own agent.
+ *
+ * PARAMETERS:
+ *
+ *   Games        : The number of games in the batch
+ *
+ *   Seed         : The seed for the first game
+ *
+ *   Steps        : The number of steps to play
+ *
+ *   DeepestLevel : Updated with the deepest level reached
+ *
+ * RETURN VALUE:
+ *
+ *   The number of games that ended, or -1 if the batch failed.
+ */
+static long play_batch(int Games, unsigned Seed, long Steps,
+                       int *DeepestLevel)
+{
+  AgentBatchType *Batch;
+  AgentBatchObsType *Obs;
+  ActionType *Actions;
+  char **Answers;
+  long Step;
+  long Ended;
+  int Count;
+  int n;
+
+  Obs = (AgentBatchObsType *) malloc(Games * sizeof(AgentBatchObsType));
+  Actions = (ActionType *) malloc(Games * sizeof(ActionType));
+  Answers = (char **) malloc(Games * sizeof(char *));
+  Batch = NULL;
+  if ((Obs != NULL) && (Actions != NULL) && (Answers != NULL))
+  {
+    Batch = agent_batch_open(Games, Seed, 0, 'a', Obs);
+  }
+
+  Ended = (Batch != NULL) ? 0 : -1;
+  for (Step = 0 ; (Batch != NULL) && (Step < Steps) ; Step++)
+  {
+    for (n = 0 ; n < Games ; n++)
+    {
+      if (Obs[n].level > *DeepestLevel) *DeepestLevel = Obs[n].level;
+
+      Actions[n] = choose_action(Obs[n].know[Obs[n].playerx][Obs[n].playery],
+                                 Obs[n].playerx, Obs[n].playery, Obs[n].monst,
+                                 &Answers[n]);
+    }
+
+    Count = agent_batch_step(Batch, Actions, Answers, Obs);
+    if (Count < 0)
+    {
+      Ended = -1;
+      break;
+    }
+    Ended += Count;
+  }
+
+  agent_batch_close(Batch);
+
+  free(Obs);
+  free(Actions);
+  free(Answers);
+
+  return Ended;
+}
+
+/* =============================================================================
+ * FUNCTION: fingerprint
+ *
+ * DESCRIPTION:
+ * Record the parts of the game state compared by the -k check.
+ *
+ * PARAMETERS:
+ *
+ *   Print : The fingerprint to fill in
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void fingerprint(FingerprintType *Print)
+{
+  AgentObservationType Obs;
+
+  agent_observe(&Obs);
+
+  memset(Print, 0, sizeof(FingerprintType));
+  memcpy(Print->Attr, Obs.c, sizeof(Print->Attr));
+  Print->Time = Obs.gtime;
+  Print->Rand = rand_state;
+  Print->Level = Obs.level;
+  Print->x = Obs.playerx;
+  Print->y = Obs.playery;
+  Print->HitX = last_monst_hx;
+  Print->HitY = last_monst_hy;
+}
+
+/* =============================================================================
+ * FUNCTION: start_fight
+ *
+ * DESCRIPTION:
+ * Summon monsters next to the player and attack them until one has been
+ * hit, so that the next snapshot is taken with the last monster hit by the
+ * player still alive.
+ *
+ * PARAMETERS:
+ *
+ *   Steps : Incremented by the number of steps played
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a monster has been hit and is still alive, 0 otherwise.
+ */
+static int start_fight(long *Steps)
+{
+  AgentObservationType Obs;
+  int Dir;
+  int x, y;
+  int Step;
+
+  createmonster(FIGHT_MONSTER_1);
+  createmonster(FIGHT_MONSTER_2);
+
+  for (Step = 0 ; Step < FIGHT_STEPS ; Step++)
+  {
+    agent_observe(&Obs);
+
+    for (Dir = 0 ; Dir < 8 ; Dir++)
+    {
+      x = Obs.playerx + DirX[Dir];
+      y = Obs.playery + DirY[Dir];
+
+      if ((x >= 0) && (x < MAXX) && (y >= 0) && (y < MAXY) &&
+          (Obs.mitem[x][y].mon != MONST_NONE))
+      {
+        break;
+      }
+    }
+
+    if (Dir == 8) return 0;
+
+    agent_act(DirAction[Dir], NULL);
+    agent_step();
+    (*Steps)++;
+
+    if (agent_game_over(NULL))
+    {
+      GamesEnded++;
+      GameSeed++;
+      agent_new_game(GameSeed, 0, 'a');
+      return 0;
+    }
+
+    if ((last_monst_hx >= 0) && (last_monst_hx < MAXX) &&
+        (last_monst_hy >= 0) && (last_monst_hy < MAXY) &&
+        (mitem[last_monst_hx][last_monst_hy].mon != MONST_NONE))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: check_snapshot
+ *
+ * DESCRIPTION:
+ * Take a snapshot, play ahead, restore the snapshot and play ahead again,
+ * checking that the restore returns to the state the snapshot was taken in
+ * and that both plays end in the same state. The game is left at the end of
+ * the second play.
+ *
+ * PARAMETERS:
+ *
+ *   DeepestLevel : Updated with the deepest level reached
+ *
+ *   TakeTime     : Incremented by the time taken by snapshot_take (us)
+ *
+ *   RestoreTime  : Incremented by the time taken by snapshot_restore (us)
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the restore and both plays ended in the same state, 0 otherwise.
+ */
+static int check_snapshot(int *DeepestLevel, double *TakeTime,
+                          double *RestoreTime)
+{
+  GameSnapshotType *Snap;
+  FingerprintType Taken;
+  FingerprintType Restored;
+  FingerprintType First;
+  FingerprintType Second;
+  unsigned long StartRand;
+  unsigned StartSeed;
+  long StartEnded;
+  double Start;
+  int Ok;
+
+  StartRand = AgentRand;
+  StartSeed = GameSeed;
+  StartEnded = GamesEnded;
+
+  Start = now_us();
+  Snap = snapshot_take();
+  *TakeTime += now_us() - Start;
+
+  if (Snap == NULL) return 0;
+
+  fingerprint(&Taken);
+  play(LOOKAHEAD_STEPS, DeepestLevel);
+  fingerprint(&First);
+
+  Start = now_us();
+  Ok = snapshot_restore(Snap);
+  *RestoreTime += now_us() - Start;
+  fingerprint(&Restored);
+
+  AgentRand = StartRand;
+  GameSeed = StartSeed;
+  GamesEnded = StartEnded;
+  play(LOOKAHEAD_STEPS, DeepestLevel);
+  fingerprint(&Second);
+
+  snapshot_free(Snap);
+
+  return Ok &&
+         (memcmp(&Taken, &Restored, sizeof(FingerprintType)) == 0) &&
+         (memcmp(&First, &Second, sizeof(FingerprintType)) == 0);
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: main
+ */
+int main(int argc, char *argv[])
+{
+  AgentObservationType Obs;
+  char *LibDir;
+  long Steps;
+  long Step;
+  long Interval;
+  long Ended;
+  int Games;
+  long Checks;
+  long Fights;
+  long FightSteps;
+  long Failures;
+  unsigned Seed;
+  int DeepestLevel;
+  double Start;
+  double Elapsed;
+  double TakeTime;
+  double RestoreTime;
+  int opt;
+
+  Steps = 100000;
+  Seed = 1;
+  LibDir = "lib";
+  Interval = 0;
+  Games = 0;
+
+  while ((opt = ugetopt(argc, argv, "n:s:l:k:b:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        Steps = atol(optarg);
+        break;
+      case 's':
+        Seed = (unsigned) atol(optarg);
+        break;
+      case 'l':
+        LibDir = optarg;
+        break;
+      case 'k':
+        Interval = atol(optarg);
+        break;
+      case 'b':
+        Games = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+          "Usage: %s [-n steps] [-s seed] [-l libdir] [-k interval] "
+          "[-b games]\n",
+          argv[0]);
+        return 2;
+    }
+  }
+
+  if (!agent_init(LibDir))
+  {
+    fprintf(stderr, "Cannot initialise the game\n");
+    return 1;
+  }
+
+  AgentRand = Seed;
+  DeepestLevel = 0;
+  Checks = 0;
+  Fights = 0;
+  FightSteps = 0;
+  Failures = 0;
+  TakeTime = 0.0;
+  RestoreTime = 0.0;
+
+  if (Games > 0)
+  {
+    Start = now_us();
+    Ended = play_batch(Games, Seed, Steps, &DeepestLevel);
+    Elapsed = now_us() - Start;
+
+    if (Ended < 0)
+    {
+      fprintf(stderr, "Cannot run the batch of games\n");
+      return 1;
+    }
+
+    Steps *= Games;
+    printf("%ld steps of %d games in %.3f s (%.0f steps/s)\n",
+      Steps, Games, Elapsed / 1000000.0,
+      (double) Steps * 1000000.0 / Elapsed);
+    printf("%ld games ended, deepest level %d\n", Ended, DeepestLevel);
+
+    return 0;
+  }
+
+  GameSeed = Seed;
+  agent_new_game(GameSeed, 0, 'a');
+
+  Start = now_us();
+
+  if (Interval <= 0)
+  {
+    play(Steps, &DeepestLevel);
+  }
+  else
+  {
+    for (Step = 0 ; Step < Steps ; Step += Interval + LOOKAHEAD_STEPS)
+    {
+      play(Interval, &DeepestLevel);
+
+      if (((Checks & 1) != 0) && start_fight(&FightSteps))
+      {
+        Fights++;
+      }
+
+      if (!check_snapshot(&DeepestLevel, &TakeTime, &RestoreTime))
+      {
+        Failures++;
+      }
+      Checks++;
+    }
+
+    /* Count the steps played twice */
+    Steps = Checks * (Interval + 2 * LOOKAHEAD_STEPS) + FightSteps;
+  }
+
+  Elapsed = now_us() - Start;
+
+  agent_observe(&Obs);
+  printf("%ld steps in %.3f s (%.0f steps/s)\n",
+    Steps, Elapsed / 1000000.0, (double) Steps * 1000000.0 / Elapsed);
+  printf("%ld games ended, deepest level %d\n", GamesEnded, DeepestLevel);
+  printf("last game: game time %ld, level %d, HP %ld/%ld\n",
+    Obs.gtime, Obs.level, Obs.c[HP], Obs.c[HPMAX]);
+
+  if (Checks > 0)
+  {
+    printf("%ld snapshot checks (%ld in a fight), %ld failed, "
+      "snapshot %.1f us, restore %.1f us\n",
+      Checks, Fights, Failures, TakeTime / (double) Checks,
+      RestoreTime / (double) Checks);
+  }
+
+  return (Failures == 0) ? 0 : 1;
+}
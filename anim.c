@@ -0,0 +1,383 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: anim.c
+ *
+ * DESCRIPTION:
+ * This module contains the animation queue used to present spell effects.
+ * The game logic resolves spells immediately and records the frames of the
+ * effect in the queue, along with the glyph of each cell redisplayed and any
+ * messages held while the effect was resolved. The queue is played back once
+ * the command has been processed, and may be skipped by pressing any key.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * effect_speed : The effect playback speed as a percentage of normal speed.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * anim_dir_effect   : Queue a directional effect tile
+ * anim_magic_effect : Queue a frame of a magic effect
+ * anim_show_cell    : Queue the redisplay of a map cell
+ * anim_delay        : Queue a delay
+ * anim_hold_text    : Hold messages in the queue while resolving an effect
+ * anim_printc       : Queue a message character if messages are held
+ * anim_play         : Play the queued animation
+ *
+ * =============================================================================
+ */
+
+#include <string.h>
+
+#include "ularn_win.h"
+#include "dungeon.h"
+#include "player.h"
+#include "anim.h"
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int effect_speed = 100;
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The maximum number of operations held in the queue.
+ * If the queue fills then it is played immediately.
+ */
+#define MAX_ANIM_OPS 2048
+
+/*
+ * The maximum number of message characters held in the queue.
+ */
+#define MAX_ANIM_TEXT 4096
+
+typedef enum
+{
+  ANIM_DIR_EFFECT,
+  ANIM_MAGIC_EFFECT,
+  ANIM_SHOW_CELL,
+  ANIM_DELAY,
+  ANIM_TEXT
+} AnimOpType;
+
+struct AnimOp
+{
+  AnimOpType Op;
+  short x, y;
+  short Effect;    /* The effect or the text length */
+  int Arg;         /* The direction, frame, delay, cell's glyph or text */
+};
+
+static struct AnimOp AnimQueue[MAX_ANIM_OPS];
+static int AnimCount = 0;
+
+static char AnimText[MAX_ANIM_TEXT];
+static int AnimTextLen = 0;
+
+/*
+ * Whether messages are being held in the queue, and whether the queue is
+ * being played, in which case nothing is held.
+ */
+static int AnimHoldText = 0;
+static int AnimPlaying = 0;
+
+/*
+ * The level on which the queued animation is to be displayed.
+ */
+static int AnimLevel;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: anim_push
+ *
+ * DESCRIPTION:
+ * Add an operation to the animation queue.
+ * Nothing is queued if delays are disabled, so games run without a display
+ * pay nothing for effects.
+ *
+ * PARAMETERS:
+ *
+ *   Op     : The operation type
+ *
+ *   x      : The x location for the operation
+ *
+ *   y      : The y location for the operation
+ *
+ *   Effect : The effect to display, or the text length
+ *
+ *   Arg    : The direction, frame, delay, cell's glyph or text offset
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void anim_push(AnimOpType Op, int x, int y, int Effect, int Arg)
+{
+  struct AnimOp *Entry;
+
+  if (nonap || (effect_speed <= 0)) return;
+
+  if (AnimCount == MAX_ANIM_OPS)
+  {
+    anim_play();
+  }
+
+  if (AnimCount == 0)
+  {
+    AnimLevel = level;
+  }
+
+  Entry = &AnimQueue[AnimCount++];
+  Entry->Op = Op;
+  Entry->x = (short) x;
+  Entry->y = (short) y;
+  Entry->Effect = (short) Effect;
+  Entry->Arg = Arg;
+}
+
+/* =============================================================================
+ * FUNCTION: anim_draw_cell
+ *
+ * DESCRIPTION:
+ * Draw a map cell with the glyph recorded when its redisplay was queued.
+ *
+ * PARAMETERS:
+ *
+ *   Entry : The queued ANIM_SHOW_CELL operation
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void anim_draw_cell(struct AnimOp *Entry)
+{
+  if ((Entry->x == playerx) && (Entry->y == playery))
+  {
+    showplayer();
+    return;
+  }
+
+  show_cell_glyph(Entry->x, Entry->y, Entry->Arg);
+}
+
+/* =============================================================================
+ * FUNCTION: anim_print_text
+ *
+ * DESCRIPTION:
+ * Print the message text held by a queued ANIM_TEXT operation.
+ *
+ * PARAMETERS:
+ *
+ *   Entry : The queued ANIM_TEXT operation
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void anim_print_text(struct AnimOp *Entry)
+{
+  int i;
+
+  for (i = 0 ; i < Entry->Effect ; i++)
+  {
+    Printc(AnimText[Entry->Arg + i]);
+  }
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: anim_dir_effect
+ */
+void anim_dir_effect(int x, int y, DirEffectsType effect, int dir)
+{
+  anim_push(ANIM_DIR_EFFECT, x, y, effect, dir);
+}
+
+/* =============================================================================
+ * FUNCTION: anim_magic_effect
+ */
+void anim_magic_effect(int x, int y, MagicEffectsType fx, int frame)
+{
+  anim_push(ANIM_MAGIC_EFFECT, x, y, fx, frame);
+}
+
+/* =============================================================================
+ * FUNCTION: anim_show_cell
+ */
+void anim_show_cell(int x, int y)
+{
+  anim_push(ANIM_SHOW_CELL, x, y, 0, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: anim_delay
+ */
+void anim_delay(int delay)
+{
+  if (delay > 0)
+  {
+    anim_push(ANIM_DELAY, 0, 0, 0, delay);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: anim_hold_text
+ */
+void anim_hold_text(int Hold)
+{
+  AnimHoldText = Hold;
+}
+
+/* =============================================================================
+ * FUNCTION: anim_printc
+ */
+int anim_printc(char c)
+{
+  struct AnimOp *Entry;
+
+  if (!AnimHoldText || AnimPlaying || nonap || (effect_speed <= 0))
+  {
+    return 0;
+  }
+
+  if ((AnimTextLen == MAX_ANIM_TEXT) || (AnimCount == MAX_ANIM_OPS))
+  {
+    anim_play();
+  }
+
+  /* Extend the last operation if it is text, otherwise start a new one */
+  if ((AnimCount == 0) || (AnimQueue[AnimCount - 1].Op != ANIM_TEXT))
+  {
+    anim_push(ANIM_TEXT, 0, 0, 0, AnimTextLen);
+  }
+
+  Entry = &AnimQueue[AnimCount - 1];
+  AnimText[AnimTextLen++] = c;
+  Entry->Effect++;
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: anim_play
+ */
+void anim_play(void)
+{
+  struct AnimOp *Entry;
+  char Shown[MAXX][MAXY];
+  int Skip;
+  int i;
+
+  if (AnimCount == 0) return;
+
+  AnimPlaying = 1;
+
+  /* The player has left the level the effects were queued for */
+  if (AnimLevel != level)
+  {
+    for (i = 0 ; i < AnimCount ; i++)
+    {
+      if (AnimQueue[i].Op == ANIM_TEXT) anim_print_text(&AnimQueue[i]);
+    }
+
+    AnimCount = 0;
+    AnimTextLen = 0;
+    AnimPlaying = 0;
+    return;
+  }
+
+  /*
+   * The effect was resolved before playback, so start by showing each cell
+   * as it was when it was first queued.
+   */
+  memset(Shown, 0, sizeof(Shown));
+  for (i = 0 ; i < AnimCount ; i++)
+  {
+    Entry = &AnimQueue[i];
+    if ((Entry->Op == ANIM_SHOW_CELL) && !Shown[Entry->x][Entry->y])
+    {
+      Shown[Entry->x][Entry->y] = 1;
+      anim_draw_cell(Entry);
+    }
+  }
+
+  Skip = 0;
+  for (i = 0 ; i < AnimCount ; i++)
+  {
+    Entry = &AnimQueue[i];
+
+    switch (Entry->Op)
+    {
+      case ANIM_DIR_EFFECT:
+        if (!Skip)
+        {
+          mapeffect(Entry->x, Entry->y, (DirEffectsType) Entry->Effect,
+                    Entry->Arg);
+        }
+        break;
+
+      case ANIM_MAGIC_EFFECT:
+        if (!Skip)
+        {
+          magic_effect(Entry->x, Entry->y, (MagicEffectsType) Entry->Effect,
+                       Entry->Arg);
+        }
+        break;
+
+      case ANIM_SHOW_CELL:
+        if (!Skip)
+        {
+          anim_draw_cell(Entry);
+        }
+        break;
+
+      case ANIM_DELAY:
+        if (!Skip)
+        {
+          Skip = nap_until_key((Entry->Arg * 100) / effect_speed);
+        }
+        break;
+
+      case ANIM_TEXT:
+        /* Always print held messages, even when skipping */
+        anim_print_text(Entry);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  /* Leave each cell showing its current contents */
+  for (i = 0 ; i < AnimCount ; i++)
+  {
+    Entry = &AnimQueue[i];
+    if ((Entry->Op == ANIM_SHOW_CELL) && Shown[Entry->x][Entry->y])
+    {
+      Shown[Entry->x][Entry->y] = 0;
+      if ((Entry->x == playerx) && (Entry->y == playery))
+      {
+        showplayer();
+      }
+      else
+      {
+        show1cell(Entry->x, Entry->y);
+      }
+    }
+  }
+
+  AnimCount = 0;
+  AnimTextLen = 0;
+  AnimPlaying = 0;
+}
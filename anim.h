@@ -0,0 +1,178 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: anim.h
+ *
+ * DESCRIPTION:
+ * This module contains the animation queue used to present spell effects.
+ * The game logic resolves spells immediately and records the frames of the
+ * effect in the queue, along with the glyph of each cell redisplayed and any
+ * messages held while the effect was resolved. The queue is played back once
+ * the command has been processed, and may be skipped by pressing any key.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * effect_speed : The effect playback speed as a percentage of normal speed.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * anim_dir_effect   : Queue a directional effect tile
+ * anim_magic_effect : Queue a frame of a magic effect
+ * anim_show_cell    : Queue the redisplay of a map cell
+ * anim_delay        : Queue a delay
+ * anim_hold_text    : Hold messages in the queue while resolving an effect
+ * anim_printc       : Queue a message character if messages are held
+ * anim_play         : Play the queued animation
+ *
+ * =============================================================================
+ */
+
+#ifndef __ANIM_H
+#define __ANIM_H
+
+#include "ularn_win.h"
+
+/*
+ * The effect playback speed as a percentage of the normal speed.
+ * 0 disables effect animations.
+ */
+extern int effect_speed;
+
+/* =============================================================================
+ * FUNCTION: anim_dir_effect
+ *
+ * DESCRIPTION:
+ * Queue the display of a directional effect at a map location.
+ *
+ * PARAMETERS:
+ *
+ *   x      : The x location of the effect
+ *
+ *   y      : The y location of the effect
+ *
+ *   effect : The directional effect to show
+ *
+ *   dir    : The direction of the effect
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_dir_effect(int x, int y, DirEffectsType effect, int dir);
+
+/* =============================================================================
+ * FUNCTION: anim_magic_effect
+ *
+ * DESCRIPTION:
+ * Queue the display of a single frame of a magic effect at a map location.
+ *
+ * PARAMETERS:
+ *
+ *   x     : The x location of the effect
+ *
+ *   y     : The y location of the effect
+ *
+ *   fx    : The magic effect to show
+ *
+ *   frame : The frame of the magic effect to show
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_magic_effect(int x, int y, MagicEffectsType fx, int frame);
+
+/* =============================================================================
+ * FUNCTION: anim_show_cell
+ *
+ * DESCRIPTION:
+ * Queue the redisplay of a map cell, restoring the cell after an effect.
+ * The cell's glyph is recorded now, so later changes to the cell are shown
+ * in order during playback. Every cell queued is left showing its current
+ * contents once playback ends, even if the animation is skipped.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x location of the cell
+ *
+ *   y : The y location of the cell
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_show_cell(int x, int y);
+
+/* =============================================================================
+ * FUNCTION: anim_delay
+ *
+ * DESCRIPTION:
+ * Queue a delay between animation frames.
+ *
+ * PARAMETERS:
+ *
+ *   delay : The delay in milliseconds at normal effect speed.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_delay(int delay);
+
+/* =============================================================================
+ * FUNCTION: anim_hold_text
+ *
+ * DESCRIPTION:
+ * Start or stop holding messages in the queue.
+ * While messages are held, text printed to the message window is queued so
+ * it is shown at the matching point of the effect rather than before it.
+ * Held messages are always printed, even if the animation is skipped.
+ * Messages are not held while effects are disabled.
+ *
+ * PARAMETERS:
+ *
+ *   Hold : Non-zero to hold messages, 0 to print them immediately
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_hold_text(int Hold);
+
+/* =============================================================================
+ * FUNCTION: anim_printc
+ *
+ * DESCRIPTION:
+ * Queue a character printed to the message window if messages are held.
+ * The display backends call this at the start of Printc.
+ *
+ * PARAMETERS:
+ *
+ *   c : The character printed
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the character was queued, 0 if it should be printed now.
+ */
+int anim_printc(char c);
+
+/* =============================================================================
+ * FUNCTION: anim_play
+ *
+ * DESCRIPTION:
+ * Play the queued animation and empty the queue.
+ * If a key is pressed during playback then the remaining frames are skipped
+ * and the key is left for the next command.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void anim_play(void);
+
+#endif
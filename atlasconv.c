@@ -0,0 +1,578 @@
+/* =============================================================================
+ * PROGRAM:  ularn-atlasconv
+ * FILENAME: atlasconv.c
+ *
+ * DESCRIPTION:
+ * Tile atlas converter.
+ *
+ * Converts the tile graphics from a BMP or XPM file to the tile atlas format
+ * described in tileatlas.h, which the SDL and X11 displays map into memory
+ * at startup instead of decoding the image.
+ *
+ * BMP files must be uncompressed 24 or 32 bits per pixel.
+ * XPM files must use #RRGGBB (or #RRRRGGGGBBBB) colours and None. A mask
+ * plane is only written if the image has transparent (None) pixels.
+ *
+ * Usage: ularn-atlasconv <image.bmp|image.xpm> <atlas file>
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * main - The converter entry point
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tileatlas.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The converted image.
+ * Pixels holds 0x00RRGGBB values, Opaque holds 1 for each pixel that is
+ * drawn and 0 for transparent pixels.
+ */
+static int Width;
+static int Height;
+static unsigned long *Pixels = NULL;
+static unsigned char *Opaque = NULL;
+static int HasMask = 0;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: read_file
+ *
+ * DESCRIPTION:
+ * Read the whole of a file into memory. The data is followed by a 0 byte so
+ * text files can be parsed as a string.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the file
+ *
+ *   Len      : This is set to the length of the file
+ *
+ * RETURN VALUE:
+ *
+ *   The file data, or NULL if the file could not be read.
+ */
+static unsigned char *read_file(char *FileName, long *Len)
+{
+  FILE *fp;
+  unsigned char *Data;
+
+  fp = fopen(FileName, "rb");
+  if (fp == NULL) return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  *Len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  Data = (unsigned char *) malloc(*Len + 1);
+  if (Data == NULL)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  if (fread(Data, 1, *Len, fp) != (size_t) *Len)
+  {
+    free(Data);
+    fclose(fp);
+    return NULL;
+  }
+
+  Data[*Len] = 0;
+  fclose(fp);
+
+  return Data;
+}
+
+/* =============================================================================
+ * FUNCTION: alloc_image
+ *
+ * DESCRIPTION:
+ * Allocate the converted image, with every pixel black and opaque.
+ *
+ * PARAMETERS:
+ *
+ *   w : The width in pixels
+ *
+ *   h : The height in pixels
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the image is too large.
+ */
+static int alloc_image(int w, int h)
+{
+  if ((w <= 0) || (h <= 0) || (w > 65536) || (h > 65536)) return 0;
+
+  Width = w;
+  Height = h;
+  Pixels = (unsigned long *) calloc((size_t) w * h, sizeof(unsigned long));
+  Opaque = (unsigned char *) malloc((size_t) w * h);
+  if ((Pixels == NULL) || (Opaque == NULL)) return 0;
+
+  memset(Opaque, 1, (size_t) w * h);
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: get_le
+ *
+ * DESCRIPTION:
+ * Read a little endian value from a BMP header.
+ *
+ * PARAMETERS:
+ *
+ *   Buf   : The value to read
+ *
+ *   Bytes : The size of the value in bytes
+ *
+ * RETURN VALUE:
+ *
+ *   The value.
+ */
+static unsigned long get_le(const unsigned char *Buf, int Bytes)
+{
+  unsigned long Value = 0;
+
+  while (Bytes > 0)
+  {
+    Bytes--;
+    Value = (Value << 8) | Buf[Bytes];
+  }
+
+  return Value;
+}
+
+/* =============================================================================
+ * FUNCTION: convert_bmp
+ *
+ * DESCRIPTION:
+ * Convert an uncompressed 24 or 32 bit BMP file.
+ *
+ * PARAMETERS:
+ *
+ *   Data : The file data
+ *
+ *   Len  : The length of the file data
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the file is not a supported BMP.
+ */
+static int convert_bmp(const unsigned char *Data, long Len)
+{
+  unsigned long Offset;
+  long w, h;
+  int Bits;
+  int BottomUp;
+  long Stride;
+  const unsigned char *Row;
+  int x, y;
+
+  if ((Len < 54) || (Data[0] != 'B') || (Data[1] != 'M')) return 0;
+
+  Offset = get_le(Data + 10, 4);
+  w = (long) (int) get_le(Data + 18, 4);
+  h = (long) (int) get_le(Data + 22, 4);
+  Bits = (int) get_le(Data + 28, 2);
+
+  // Negative heights are stored top row first.
+  if (h < 0)
+  {
+    h = -h;
+    BottomUp = 0;
+  }
+  else
+  {
+    BottomUp = 1;
+  }
+
+  if (((Bits != 24) && (Bits != 32)) || (get_le(Data + 30, 4) != 0))
+  {
+    fprintf(stderr, "Only uncompressed 24 and 32 bit BMP files are supported\n");
+    return 0;
+  }
+
+  if (!alloc_image((int) w, (int) h)) return 0;
+
+  Stride = ((w * Bits / 8) + 3) & ~3L;
+  if ((long) Offset + Stride * h > Len) return 0;
+
+  for (y = 0 ; y < Height ; y++)
+  {
+    Row = Data + Offset + Stride * (BottomUp ? (Height - 1 - y) : y);
+
+    for (x = 0 ; x < Width ; x++)
+    {
+      Pixels[y * Width + x] = get_le(Row, 3);
+      Row += Bits / 8;
+    }
+  }
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: next_string
+ *
+ * DESCRIPTION:
+ * Find the next quoted string in XPM data and terminate it.
+ *
+ * PARAMETERS:
+ *
+ *   Pos : The position to search from. This is updated to the character after
+ *         the end of the string.
+ *
+ * RETURN VALUE:
+ *
+ *   The start of the string contents, or NULL if there are no more strings.
+ */
+static char *next_string(char **Pos)
+{
+  char *Start;
+  char *End;
+
+  Start = strchr(*Pos, '"');
+  if (Start == NULL) return NULL;
+  Start++;
+
+  End = strchr(Start, '"');
+  if (End == NULL) return NULL;
+
+  *End = 0;
+  *Pos = End + 1;
+
+  return Start;
+}
+
+/* =============================================================================
+ * FUNCTION: hex_value
+ *
+ * DESCRIPTION:
+ * Read a hexadecimal colour component.
+ *
+ * PARAMETERS:
+ *
+ *   Str    : The hex digits
+ *
+ *   Digits : The number of digits in the component
+ *
+ * RETURN VALUE:
+ *
+ *   The most significant 8 bits of the component.
+ */
+static unsigned long hex_value(const char *Str, int Digits)
+{
+  char Buf[5];
+
+  memcpy(Buf, Str, Digits);
+  Buf[Digits] = 0;
+
+  return strtoul(Buf, NULL, 16) >> ((Digits - 2) * 4);
+}
+
+/* =============================================================================
+ * FUNCTION: convert_xpm
+ *
+ * DESCRIPTION:
+ * Convert an XPM file.
+ *
+ * PARAMETERS:
+ *
+ *   Data : The file data, terminated by a 0 byte
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the file is not a supported XPM.
+ */
+static int convert_xpm(char *Data)
+{
+  char *Pos = Data;
+  char *Str;
+  char *Value;
+  int w, h, Colours, Chars;
+  int Digits;
+  char (*Keys)[4];
+  unsigned long *Colour;
+  int i, x, y;
+  int Len;
+
+  if (strstr(Data, "XPM") == NULL) return 0;
+
+  Str = next_string(&Pos);
+  if ((Str == NULL) ||
+      (sscanf(Str, "%d %d %d %d", &w, &h, &Colours, &Chars) != 4) ||
+      (Colours <= 0) || (Chars < 1) || (Chars > 3))
+  {
+    return 0;
+  }
+
+  if (!alloc_image(w, h)) return 0;
+
+  Keys = malloc(Colours * sizeof(*Keys));
+  Colour = malloc(Colours * sizeof(unsigned long));
+  if ((Keys == NULL) || (Colour == NULL)) return 0;
+
+  //
+  // Read the colour table. Transparent pixels are given the colour
+  // 0xff000000, which no real colour can have.
+  //
+  for (i = 0 ; i < Colours ; i++)
+  {
+    Str = next_string(&Pos);
+    if ((Str == NULL) || ((int) strlen(Str) < Chars)) return 0;
+
+    memcpy(Keys[i], Str, Chars);
+
+    Value = strstr(Str + Chars, "c ");
+    if (Value == NULL) Value = strstr(Str + Chars, "c\t");
+    if (Value == NULL) return 0;
+    Value += 2;
+    while ((*Value == ' ') || (*Value == '\t')) Value++;
+
+    if (strncmp(Value, "None", 4) == 0)
+    {
+      Colour[i] = 0xff000000UL;
+    }
+    else if (*Value == '#')
+    {
+      Value++;
+      Len = (int) strspn(Value, "0123456789abcdefABCDEF");
+      if ((Len != 6) && (Len != 12))
+      {
+        fprintf(stderr, "Unsupported XPM colour: %s\n", Value - 1);
+        return 0;
+      }
+
+      Digits = Len / 3;
+      Colour[i] = (hex_value(Value, Digits) << 16) |
+                  (hex_value(Value + Digits, Digits) << 8) |
+                  hex_value(Value + Digits * 2, Digits);
+    }
+    else
+    {
+      fprintf(stderr, "Unsupported XPM colour: %s\n", Value);
+      return 0;
+    }
+  }
+
+  //
+  // Read the pixels. The colour keys are found with a linear search of the
+  // table, which is fast enough for an offline conversion.
+  //
+  for (y = 0 ; y < Height ; y++)
+  {
+    Str = next_string(&Pos);
+    if ((Str == NULL) || ((int) strlen(Str) < Width * Chars)) return 0;
+
+    for (x = 0 ; x < Width ; x++)
+    {
+      for (i = 0 ; i < Colours ; i++)
+      {
+        if (memcmp(Keys[i], Str + x * Chars, Chars) == 0) break;
+      }
+
+      if (i == Colours) return 0;
+
+      if (Colour[i] == 0xff000000UL)
+      {
+        Opaque[y * Width + x] = 0;
+        HasMask = 1;
+      }
+      else
+      {
+        Pixels[y * Width + x] = Colour[i];
+      }
+    }
+  }
+
+  free(Keys);
+  free(Colour);
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: put_le32
+ *
+ * DESCRIPTION:
+ * Store a 32 bit value in little endian byte order.
+ *
+ * PARAMETERS:
+ *
+ *   Buf   : Where to store the value
+ *
+ *   Value : The value
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void put_le32(unsigned char *Buf, unsigned long Value)
+{
+  Buf[0] = (unsigned char) (Value & 0xff);
+  Buf[1] = (unsigned char) ((Value >> 8) & 0xff);
+  Buf[2] = (unsigned char) ((Value >> 16) & 0xff);
+  Buf[3] = (unsigned char) ((Value >> 24) & 0xff);
+}
+
+/* =============================================================================
+ * FUNCTION: write_atlas
+ *
+ * DESCRIPTION:
+ * Write the converted image as a tile atlas.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the atlas file
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the file could not be written.
+ */
+static int write_atlas(char *FileName)
+{
+  unsigned char *Atlas;
+  unsigned char *Row;
+  size_t Stride;
+  size_t MaskStride;
+  size_t PixelOffset;
+  size_t MaskOffset;
+  size_t Size;
+  FILE *fp;
+  int x, y;
+  int ok;
+
+  Stride = (size_t) Width * 4;
+  PixelOffset = (ATLAS_HEADER_SIZE + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+  Size = PixelOffset + Stride * Height;
+
+  MaskStride = 0;
+  MaskOffset = 0;
+  if (HasMask)
+  {
+    MaskStride = ((size_t) Width + 7) / 8;
+    MaskOffset = Size;
+    Size += MaskStride * Height;
+  }
+
+  Atlas = (unsigned char *) calloc(Size, 1);
+  if (Atlas == NULL) return 0;
+
+  memcpy(Atlas, ATLAS_MAGIC, 4);
+  put_le32(Atlas + 4, ATLAS_VERSION);
+  put_le32(Atlas + 8, ATLAS_FORMAT_XRGB8888);
+  put_le32(Atlas + 12, Width);
+  put_le32(Atlas + 16, Height);
+  put_le32(Atlas + 20, Stride);
+  put_le32(Atlas + 24, PixelOffset);
+  put_le32(Atlas + 28, MaskOffset);
+  put_le32(Atlas + 32, MaskStride);
+
+  for (y = 0 ; y < Height ; y++)
+  {
+    Row = Atlas + PixelOffset + Stride * y;
+
+    for (x = 0 ; x < Width ; x++)
+    {
+      // Transparent pixels stay black for the SDL colour key.
+      if (Opaque[y * Width + x])
+      {
+        put_le32(Row + x * 4, Pixels[y * Width + x]);
+      }
+
+      if (HasMask && Opaque[y * Width + x])
+      {
+        Atlas[MaskOffset + MaskStride * y + x / 8] |= 1 << (x % 8);
+      }
+    }
+  }
+
+  fp = fopen(FileName, "wb");
+  if (fp == NULL)
+  {
+    free(Atlas);
+    return 0;
+  }
+
+  ok = (fwrite(Atlas, 1, Size, fp) == Size);
+  if (fclose(fp) != 0) ok = 0;
+
+  free(Atlas);
+
+  return ok;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: main
+ */
+int main(int argc, char *argv[])
+{
+  unsigned char *Data;
+  long Len;
+  int ok;
+
+  if (argc != 3)
+  {
+    fprintf(stderr, "Usage: ularn-atlasconv <image.bmp|image.xpm> <atlas file>\n");
+    return 1;
+  }
+
+  Data = read_file(argv[1], &Len);
+  if (Data == NULL)
+  {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return 1;
+  }
+
+  if ((Len >= 2) && (Data[0] == 'B') && (Data[1] == 'M'))
+  {
+    ok = convert_bmp(Data, Len);
+  }
+  else
+  {
+    ok = convert_xpm((char *) Data);
+  }
+
+  free(Data);
+
+  if (!ok)
+  {
+    fprintf(stderr, "Cannot convert %s\n", argv[1]);
+    return 1;
+  }
+
+  if (!write_atlas(argv[2]))
+  {
+    fprintf(stderr, "Cannot write %s\n", argv[2]);
+    return 1;
+  }
+
+  printf("%s: %d x %d%s\n", argv[2], Width, Height,
+         HasMask ? " with mask" : "");
+
+  return 0;
+}
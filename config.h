@@ -52,6 +52,15 @@
 #define UNIX
 #endif
 
+/*
+ * LEVEL_THREAD:
+ * Define this symbol to make the layouts of unvisited levels on a
+ * background thread (requires POSIX threads).
+ */
+#ifdef UNIX
+#define LEVEL_THREAD
+#endif
+
 /*
  * LIBDIR:
  * This symbol indicates where the data files will reside.
@@ -4,6 +4,8 @@
  *
  * DESCRIPTION:
  * Diagnostic dump module.
+ * The dumps only read the game state, so they can be taken at any time
+ * during a game without changing it.
  *
  * =============================================================================
  * EXPORTED VARIABLES
@@ -13,12 +15,20 @@
  * =============================================================================
  * EXPORTED FUNCTIONS
  *
- * diag - Print diagnostic information
+ * diag           - Print diagnostic information
+ * diagdrawscreen - Draw the current level map as text
+ * diagdump       - Write a snapshot of the game state to a file
+ * diagfiledump   - Write a snapshot of the game state to a named file
+ * diag_start     - Enable dumps on request
+ * diag_poll      - Write a requested dump
  *
  * =============================================================================
  */
 
+#include <signal.h>
+
 #include "header.h"
+#include "patchlevel.h"
 #include "diag.h"
 #include "ularn_game.h"
 #include "itm.h"
@@ -38,7 +48,7 @@
  * Character attribute strings.
  * The strings must match the order of the AttributeType enumeration
  */
-static char *cdef[] = {
+static char *const cdef[] = {
   "STRENGTH", "INTELLIGENCE", "WISDOM", "CONSTITUTION", "DEXTERITY",
   "CHARISMA", "HPMAX", "HP", "GOLD", "EXPERIENCE",
   "LEVEL", "REGEN", "WCLASS", "AC", "BANKACCOUNT",
@@ -63,7 +73,7 @@ static char *cdef[] = {
 /*
  * Names for inventory items
  */
-static char *ivendef[] = {
+static char *const ivendef[] = {
   "",
   "OALTAR", "OTHRONE", "OORB", "OPIT", "OSTAIRSUP",
   "OELEVATORUP", "OFOUNTAIN", "OSTATUE", "OTELEPORTER", "OSCHOOL",
@@ -87,180 +97,489 @@ static char *ivendef[] = {
   "OSHROOMS", "OCOKE", "OPAD", "" };
 
 /*
- * Pointer to the debug output file
+ * The size of the output buffer used when writing a dump file.
  */
-static FILE *dfile;
+#define DIAG_BUFSIZE 65536
 
+/*
+ * Set by the dump signal to request a machine readable dump at the next
+ * turn.
+ */
+static volatile sig_atomic_t DumpRequested = 0;
 
 /* =============================================================================
  * Local functions
  */
 
 /* =============================================================================
- * FUNCTION: drawdiagscreen
+ * FUNCTION: json_string
  *
  * DESCRIPTION:
- * Draw the ASCII map to the diag file.
+ * Write a string as a quoted JSON string.
  *
  * PARAMETERS:
  *
+ *   fp  : The file to write to
+ *
+ *   str : The string to write
+ *
+ * RETURN VALUE:
+ *
  *   None.
+ */
+static void json_string(FILE *fp, char *str)
+{
+  putc('"', fp);
+
+  for ( ; *str != 0 ; str++)
+  {
+    if ((*str == '"') || (*str == '\\'))
+    {
+      putc('\\', fp);
+      putc(*str, fp);
+    }
+    else if ((unsigned char) *str < ' ')
+    {
+      fprintf(fp, "\\u%04x", (unsigned char) *str);
+    }
+    else
+    {
+      putc(*str, fp);
+    }
+  }
+
+  putc('"', fp);
+}
+
+/* =============================================================================
+ * FUNCTION: level_row
+ *
+ * DESCRIPTION:
+ * Get one row of the ASCII map of a level, showing the monster at each
+ * location or the item if there is no monster.
+ *
+ * PARAMETERS:
+ *
+ *   View : The level to draw
+ *
+ *   y    : The row to draw
+ *
+ *   Row  : The buffer for the row. Must be at least MAXX + 1 characters.
  *
  * RETURN VALUE:
  *
  *   None.
  */
-static void diagdrawscreen(void)
+static void level_row(LevelViewType *View, int y, char *Row)
 {
-  int i, j;
+  int x;
   MonsterIdType Monst;
 
-  /* east west walls of this line */
-  for (i = 0; i < MAXY; i++)
+  for (x = 0 ; x < MAXX ; x++)
   {
-    for (j = 0; j < MAXX; j++)
+    Monst = View->mitem[x][y].mon;
+    if (Monst != MONST_NONE)
     {
-      Monst = mitem[j][i].mon;
-      if (Monst != MONST_NONE)
-      {
-        fprintf(dfile, "%c", monstnamelist[Monst]);
-      }
-      else
-      {
-        fprintf(dfile, "%c", objnamelist[(int) item[j][i]]);
-      }
+      Row[x] = monstnamelist[Monst];
+    }
+    else
+    {
+      Row[x] = objnamelist[(int) View->item[x][y]];
     }
-    fprintf(dfile, "\n");
   }
+  Row[MAXX] = 0;
 }
 
 /* =============================================================================
- * Exported functions
+ * FUNCTION: draw_level
+ *
+ * DESCRIPTION:
+ * Draw the ASCII map of a level, one line per row.
+ *
+ * PARAMETERS:
+ *
+ *   fp   : The file to write the map to
+ *
+ *   View : The level to draw
+ *
+ * RETURN VALUE:
+ *
+ *   None.
  */
+static void draw_level(FILE *fp, LevelViewType *View)
+{
+  char Row[MAXX + 2];
+  int y;
 
+  for (y = 0 ; y < MAXY ; y++)
+  {
+    level_row(View, y, Row);
+    Row[MAXX] = '\n';
+    Row[MAXX + 1] = 0;
+    fputs(Row, fp);
+  }
+}
 
 /* =============================================================================
- * FUNCTION: diag
+ * FUNCTION: diag_text
+ *
+ * DESCRIPTION:
+ * Write the human readable diagnostic dump.
+ *
+ * PARAMETERS:
+ *
+ *   fp : The file to write to
+ *
+ * RETURN VALUE:
+ *
+ *   None.
  */
-void diag(void)
+static void diag_text(FILE *fp)
 {
   int i, j;
   MonsterIdType Monst;
+  LevelViewType View;
 
-  if ((dfile = fopen(diagfile, "w")) == (FILE *)NULL) return;
-
-  Print("\nDiagnosing . . .\n");
-
-  fprintf(dfile, "\n-------- Beginning of DIAG diagnostics ---------\n\n");
+  fprintf(fp, "\n-------- Beginning of DIAG diagnostics ---------\n\n");
 
-  fprintf(dfile, "Hit points: %2ld(%2ld)\n", c[HP], c[HPMAX]);
+  fprintf(fp, "Hit points: %2ld(%2ld)\n", c[HP], c[HPMAX]);
 
-  fprintf(dfile, "gold: %ld  Experience: %ld  Character level: %ld  Level in caverns: %d\n",
+  fprintf(fp, "gold: %ld  Experience: %ld  Character level: %ld  Level in caverns: %d\n",
     (long) c[GOLD],
     (long) c[EXPERIENCE],
     (long) c[LEVEL],
     level);
 
-  fprintf(dfile, "\nFor the c[] array:\n");
-  fflush(dfile);
+  fprintf(fp, "\nFor the c[] array:\n");
 
   for( j=0; j<100; j++)
   {
-    fprintf(dfile, "c[%d]\t%-20s\t= %ld\n", j, cdef[j], c[j]);
+    fprintf(fp, "c[%d]\t%-20s\t= %ld\n", j, cdef[j], c[j]);
   }
-  fprintf(dfile, "\n\n");
-  fflush(dfile);
+  fprintf(fp, "\n\n");
 
-  fprintf(dfile, "Inventory\n");
+  fprintf(fp, "Inventory\n");
   for (j=0; j<IVENSIZE; j++)
   {
-    fprintf (dfile, "iven[%d] %-12s = %d",
+    fprintf (fp, "iven[%d] %-12s = %d",
     j, ivendef[(int) iven[j]], iven[j] );
-    fprintf (dfile, "\t%s", objectname[(int) iven[j]] );
-    fprintf (dfile, "\t+ %d\n", ivenarg[j] );
+    fprintf (fp, "\t%s", objectname[(int) iven[j]] );
+    fprintf (fp, "\t+ %d\n", ivenarg[j] );
   }
 
-  fprintf(dfile, "\nHere are the maps:\n\n");
- 
-  i = level;
+  fprintf(fp, "\nHere are the maps:\n\n");
+
   for (j = 0; j < NLEVELS; j++)
   {
-    newcavelevel(j);
-    fprintf(dfile, "\n-------------------------------------------------------------------\n");
-    fprintf(dfile, "Map %s    level %d\n", levelname[level], level);
-    fprintf(dfile, "-------------------------------------------------------------------\n");
-    diagdrawscreen();
-    fflush(dfile);
+    fprintf(fp, "\n-------------------------------------------------------------------\n");
+    fprintf(fp, "Map %s    level %d\n", levelname[j], j);
+    fprintf(fp, "-------------------------------------------------------------------\n");
+
+    if (peeklevel(j, &View))
+    {
+      draw_level(fp, &View);
+    }
+    else
+    {
+      fprintf(fp, "(not visited)\n");
+    }
   }
-  level = (char) i;
-  getlevel();
 
-  fprintf(dfile, "\n\nNow for the monster data:\n\n");
-  fprintf(dfile, "\nTotal types of monsters: %d\n\n", MAXMONST + 8);
-  fprintf(dfile, "   Monster Name      LEV  AC   DAM  ATT  GOLD   HP     EXP\n");
-  fprintf(dfile, "-----------------------------------------------------------------\n");
-  fflush(dfile);
+  fprintf(fp, "\n\nNow for the monster data:\n\n");
+  fprintf(fp, "\nTotal types of monsters: %d\n\n", MAXMONST + 8);
+  fprintf(fp, "   Monster Name      LEV  AC   DAM  ATT  GOLD   HP     EXP\n");
+  fprintf(fp, "-----------------------------------------------------------------\n");
 
   for (Monst = MONST_NONE ; Monst < MONST_COUNT ; Monst++)
   {
-    fprintf(dfile, "%19s  %2d  %3d ",
+    fprintf(fp, "%19s  %2d  %3d ",
       monster[Monst].name,
       monster[Monst].level,
       monster[Monst].armorclass);
-    fprintf(dfile, " %3d  %3d ",
+    fprintf(fp, " %3d  %3d ",
       monster[Monst].damage,
       monster[Monst].attack);
-    fprintf(dfile, "%6d  %3d   %6ld\n",
+    fprintf(fp, "%6d  %3d   %6ld\n",
       monster[Monst].gold,
       monster[Monst].hitpoints,
      (long) monster[Monst].experience);
-
-    fflush(dfile);
   }
 
-  fprintf(dfile, "\nAvailable potions:\n\n");
+  fprintf(fp, "\nAvailable potions:\n\n");
   for (i = 0; i < MAXPOTION; i++)
   {
-    fprintf(dfile, "%20s\n", &potionname[i][1]);
+    fprintf(fp, "%20s\n", &potionname[i][1]);
   }
-  fflush(dfile);
 
-  fprintf(dfile, "\nAvailable scrolls:\n\n");
+  fprintf(fp, "\nAvailable scrolls:\n\n");
   for (i = 0; i < MAXSCROLL; i++)
   {
-    fprintf(dfile, "%20s\n", &scrollname[i][1]);
+    fprintf(fp, "%20s\n", &scrollname[i][1]);
   }
-  fflush(dfile);
 
-  fprintf(dfile, "\nSpell list:\n\n");
-  fprintf(dfile, "spell#  name           description\n");
-  fprintf(dfile, "-------------------------------------------------\n\n");
+  fprintf(fp, "\nSpell list:\n\n");
+  fprintf(fp, "spell#  name           description\n");
+  fprintf(fp, "-------------------------------------------------\n\n");
 
   for (j = 0 ; j < SPELL_COUNT ; j++)
   {
-    fprintf(dfile, "%-10s", spelcode[j]);
-    fprintf(dfile, " %21s\n", spelname[j]);
-    fprintf(dfile, "%s\n", speldescript[j]);
+    fprintf(fp, "%-10s", spelcode[j]);
+    fprintf(fp, " %21s\n", spelname[j]);
+    fprintf(fp, "%s\n", speldescript[j]);
   }
-  fflush(dfile);
 
-  fprintf(dfile, "\nObject list\n\n");
-  fprintf(dfile, "\nj \tObject \tName\n");
-  fprintf(dfile, "---------------------------------\n");
+  fprintf(fp, "\nObject list\n\n");
+  fprintf(fp, "\nj \tObject \tName\n");
+  fprintf(fp, "---------------------------------\n");
   for (j = 0; j < OCOUNT; j++)
   {
-    fprintf(dfile, "%d \t%c \t%s\n",
+    fprintf(fp, "%d \t%c \t%s\n",
       j,
       objnamelist[j],
       objectname[j] );
   }
-  fflush(dfile);
 
-  fprintf(dfile,"\n-------- End of DIAG diagnostics ---------\n");
-  fflush(dfile);
-  fclose(dfile);
+  fprintf(fp,"\n-------- End of DIAG diagnostics ---------\n");
+}
+
+/* =============================================================================
+ * FUNCTION: json_level
+ *
+ * DESCRIPTION:
+ * Write the contents of a level as a JSON object.
+ * Walls are only shown in the map and not listed as items.
+ *
+ * PARAMETERS:
+ *
+ *   fp   : The file to write to
+ *
+ *   lev  : The level number
+ *
+ *   View : The level contents
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void json_level(FILE *fp, int lev, LevelViewType *View)
+{
+  char Row[MAXX + 1];
+  int x, y;
+  int First;
+  MonsterIdType Monst;
+  int Item;
+
+  fprintf(fp, "{\"level\":%d,\"name\":", lev);
+  json_string(fp, levelname[lev]);
+
+  fprintf(fp, ",\"map\":[");
+  for (y = 0 ; y < MAXY ; y++)
+  {
+    level_row(View, y, Row);
+    if (y != 0) putc(',', fp);
+    fprintf(fp, "\n");
+    json_string(fp, Row);
+  }
+  fprintf(fp, "],\n\"monsters\":[");
+
+  First = 1;
+  for (y = 0 ; y < MAXY ; y++)
+  {
+    for (x = 0 ; x < MAXX ; x++)
+    {
+      Monst = View->mitem[x][y].mon;
+      if (Monst == MONST_NONE) continue;
+
+      fprintf(fp, "%s{\"x\":%d,\"y\":%d,\"id\":%d,\"name\":",
+        First ? "" : ",", x, y, (int) Monst);
+      json_string(fp, monster[Monst].name);
+      fprintf(fp, ",\"hp\":%d}", View->hitp[x][y]);
+      First = 0;
+    }
+  }
+  fprintf(fp, "],\n\"items\":[");
+
+  First = 1;
+  for (y = 0 ; y < MAXY ; y++)
+  {
+    for (x = 0 ; x < MAXX ; x++)
+    {
+      Item = View->item[x][y];
+      if ((Item == ONOTHING) || (Item == OWALL)) continue;
+
+      fprintf(fp, "%s{\"x\":%d,\"y\":%d,\"id\":%d,\"name\":",
+        First ? "" : ",", x, y, Item);
+      json_string(fp, ivendef[Item]);
+      fprintf(fp, ",\"arg\":%d}", View->iarg[x][y]);
+      First = 0;
+    }
+  }
+  fprintf(fp, "]}");
+}
+
+/* =============================================================================
+ * FUNCTION: diag_json
+ *
+ * DESCRIPTION:
+ * Write the machine readable diagnostic dump as a single JSON object.
+ * The c[] array is written in AttributeType order.
+ *
+ * PARAMETERS:
+ *
+ *   fp : The file to write to
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void diag_json(FILE *fp)
+{
+  int j;
+  int First;
+  LevelViewType View;
+
+  fprintf(fp, "{\"version\":\"%s.%s\",\"gtime\":%ld,\"level\":%d,",
+    LARN_VERSION, LARN_PATCHLEVEL, gtime, level);
+  fprintf(fp, "\"player\":{\"x\":%d,\"y\":%d,\"name\":", playerx, playery);
+  json_string(fp, logname);
+  fprintf(fp, "},\n\"c\":[");
+
+  for (j = 0 ; j < 100 ; j++)
+  {
+    fprintf(fp, "%s%ld", (j == 0) ? "" : ",", c[j]);
+  }
+  fprintf(fp, "],\n\"inventory\":[");
+
+  for (j = 0 ; j < IVENSIZE ; j++)
+  {
+    fprintf(fp, "%s{\"slot\":%d,\"id\":%d,\"name\":",
+      (j == 0) ? "" : ",", j, (int) iven[j]);
+    json_string(fp, objectname[(int) iven[j]]);
+    fprintf(fp, ",\"arg\":%d}", ivenarg[j]);
+  }
+  fprintf(fp, "],\n\"levels\":[");
+
+  First = 1;
+  for (j = 0 ; j < NLEVELS ; j++)
+  {
+    if (!peeklevel(j, &View)) continue;
+
+    if (!First) putc(',', fp);
+    fprintf(fp, "\n");
+    json_level(fp, j, &View);
+    First = 0;
+  }
+  fprintf(fp, "]}\n");
+}
+
+#ifdef UNIX
+
+/* =============================================================================
+ * FUNCTION: dump_signal
+ *
+ * DESCRIPTION:
+ * Signal handler to request a machine readable dump.
+ * The dump itself is done by diag_poll at the next turn.
+ *
+ * PARAMETERS:
+ *
+ *   sig : The signal received
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void dump_signal(int sig)
+{
+  DumpRequested = 1;
+  signal(sig, dump_signal);
+}
+
+#endif
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: diagdrawscreen
+ */
+void diagdrawscreen(FILE *fp)
+{
+  LevelViewType View;
+
+  peeklevel(level, &View);
+  draw_level(fp, &View);
+}
+
+/* =============================================================================
+ * FUNCTION: diagdump
+ */
+int diagdump(FILE *fp, int Json)
+{
+  /* bring the effect times in c[] up to date */
+  sync_effects();
+
+  if (Json)
+  {
+    diag_json(fp);
+  }
+  else
+  {
+    diag_text(fp);
+  }
+
+  return ferror(fp) ? -1 : 0;
+}
+
+/* =============================================================================
+ * FUNCTION: diagfiledump
+ */
+int diagfiledump(char *FileName, int Json)
+{
+  FILE *fp;
+  int Err;
+
+  if ((fp = fopen(FileName, "w")) == (FILE *)NULL) return -1;
+
+  setvbuf(fp, NULL, _IOFBF, DIAG_BUFSIZE);
+
+  Err = diagdump(fp, Json);
+  if (fclose(fp) != 0) Err = -1;
+
+  return Err;
+}
+
+/* =============================================================================
+ * FUNCTION: diag
+ */
+void diag(void)
+{
+  Print("\nDiagnosing . . .\n");
+
+  diagfiledump(diagfile, 0);
 
   Print("\nDone Diagnosing.\n");
 }
 
+/* =============================================================================
+ * FUNCTION: diag_start
+ */
+void diag_start(void)
+{
+#ifdef UNIX
+  signal(SIGUSR2, dump_signal);
+#endif
+}
 
+/* =============================================================================
+ * FUNCTION: diag_poll
+ */
+void diag_poll(void)
+{
+  if (DumpRequested)
+  {
+    DumpRequested = 0;
+    diagfiledump(diagjsonfile, 1);
+  }
+}
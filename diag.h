@@ -4,6 +4,8 @@
  *
  * DESCRIPTION:
  * Diagnostic dump module.
+ * The dumps only read the game state, so they can be taken at any time
+ * during a game without changing it.
  *
  * =============================================================================
  * EXPORTED VARIABLES
@@ -13,7 +15,12 @@
  * =============================================================================
  * EXPORTED FUNCTIONS
  *
- * diag - Print diagnostic information
+ * diag           - Print diagnostic information
+ * diagdrawscreen - Draw the current level map as text
+ * diagdump       - Write a snapshot of the game state to a file
+ * diagfiledump   - Write a snapshot of the game state to a named file
+ * diag_start     - Enable dumps on request
+ * diag_poll      - Write a requested dump
  *
  * =============================================================================
  */
@@ -21,6 +28,8 @@
 #ifndef __DIAG_H
 #define __DIAG_H
 
+#include <stdio.h>
+
 /* =============================================================================
  * FUNCTION: diag
  *
@@ -37,4 +46,93 @@
  */
 void diag(void);
 
+/* =============================================================================
+ * FUNCTION: diagdrawscreen
+ *
+ * DESCRIPTION:
+ * Draw the ASCII map of the current level, one line per row, showing the
+ * monster at each location or the item if there is no monster.
+ *
+ * PARAMETERS:
+ *
+ *   fp : The file to write the map to
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void diagdrawscreen(FILE *fp);
+
+/* =============================================================================
+ * FUNCTION: diagdump
+ *
+ * DESCRIPTION:
+ * Write a snapshot of the game state: the player attributes, inventory, the
+ * maps of all visited levels and the game data tables (text format only).
+ * Levels that have not been visited are not generated.
+ *
+ * PARAMETERS:
+ *
+ *   fp   : The file to write to
+ *
+ *   Json : Set to write a single JSON object instead of the text format
+ *
+ * RETURN VALUE:
+ *
+ *   0 on success, -1 if there was an error writing the file.
+ */
+int diagdump(FILE *fp, int Json);
+
+/* =============================================================================
+ * FUNCTION: diagfiledump
+ *
+ * DESCRIPTION:
+ * Write a snapshot of the game state to a named file using diagdump.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the file to create
+ *
+ *   Json     : Set to write JSON instead of the text format
+ *
+ * RETURN VALUE:
+ *
+ *   0 on success, -1 if the file could not be written.
+ */
+int diagfiledump(char *FileName, int Json);
+
+/* =============================================================================
+ * FUNCTION: diag_start
+ *
+ * DESCRIPTION:
+ * Enable dumps on request. On UNIX a JSON dump to diagjsonfile is requested
+ * by sending SIGUSR2 to the game.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void diag_start(void);
+
+/* =============================================================================
+ * FUNCTION: diag_poll
+ *
+ * DESCRIPTION:
+ * Write the JSON dump if one has been requested since the last poll.
+ * This is called once per turn so the dump never sees a half finished move.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void diag_poll(void);
+
 #endif
@@ -15,11 +15,14 @@
  * stealth   : The monster stealth status for each dungeon location
  * hitp      : The monster hit points for each dungeon location
  * iarg      : The item arg for each dungeon location
+ * wallmask  : The wall connectivity for each dungeon location
  * screen    : Screen data used in moving monsters
  * mitem     : The monster and items it has stolen for each dungeon location
  * beenhere  : Which dungeon levels have been visited
  * level     : The current dungeon level
  * levelname : The name of each dungeon level
+ * placement_retries  : The number of stale cells dropped by random placement
+ * placement_failures : The number of random placements that found no cell
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -29,10 +32,15 @@
  * cgood          : Check if a cell is empty (monster and/or item)
  * dropgold       : Drop gold around the player
  * fillmonst      : Attempt to put a monster into the dungeon
+ * random_empty_cell : Pick a random cell with no item, monster or player
+ * update_free_cell  : Update the free cell index after a cell has changed
+ * invalidate_free_cells : Mark the free cell index as out of date
  * eat            : Eat a maze in a level filled with walls
  * savelevel      : Save the current dungeon level into storage
  * getlevel       : Get the current level from storage.
+ * peeklevel      : Get read only access to any visited level
  * AnalyseWalls   : Calculate wall tiles based on adjacent walls.
+ * UpdateWall     : Update wall tiles after a single cell has changed.
  * newcavelevel   : Function to go to a different cave level, creating if reqd
  * verifyxy       : Verify x and y coordinates are on the map, adjusting if reqd
  * createitem     : Create an item
@@ -57,6 +65,12 @@
 #include "scroll.h"
 #include "saveutils.h"
 #include "scores.h"
+#include "trace.h"
+#include "mapfile.h"
+
+#ifdef LEVEL_THREAD
+#include <pthread.h>
+#endif
 
 /* =============================================================================
  * Exported variables
@@ -68,6 +82,7 @@ char moved[MAXX][MAXY];     /* monster movement flags  */
 char stealth[MAXX][MAXY];   /* See Stealth flags */
 short hitp[MAXX][MAXY];     /* monster hp on level  */
 short iarg[MAXX][MAXY];     /* arg for the item array */
+unsigned char wallmask[MAXX][MAXY]; /* wall connectivity for wall tiles */
 short screen[MAXX][MAXY];   /* The screen as the player knows it */
 struct_mitem mitem[MAXX][MAXY]; /* Items stolen by monstes array */
 
@@ -77,7 +92,10 @@ char beenhere[NLEVELS] =
 
 int level=0;               /* cavelevel player is on = c[CAVELEVEL]*/
 
-char *levelname[] =
+long placement_retries = 0;
+long placement_failures = 0;
+
+char *const levelname[] =
 {
   " H"," 1"," 2"," 3"," 4"," 5",
   " 6"," 7"," 8"," 9","10","11","12","13","14","15",
@@ -88,26 +106,70 @@ char *levelname[] =
  * Local variables
  */
 
+/*
+ * Bit planes of the wall-like cells (walls and doors) on the current level.
+ * There is one word per column with bit y set if the cell at y is wall-like.
+ * MAXY must not exceed the number of bits in an unsigned long.
+ */
+static unsigned long WallPlane[MAXX];
+
+#define WALL_LIKE(it) \
+  (((it) == OWALL) | ((it) == OOPENDOOR) | ((it) == OCLOSEDDOOR))
+
+/*
+ * Free cell index.
+ *
+ * Random placement picks from sets of the free cells in the interior of the
+ * current level rather than retrying random locations, so a placement takes
+ * logarithmic time and a full level is reported rather than retried forever.
+ * Each set counts its cells in a binary indexed tree, and the n'th free cell
+ * is picked in cell order. This makes the pick depend only on which cells
+ * are free, so a game restored from a snapshot or save file places things
+ * exactly where the original game would.
+ *
+ * The sets are built on first use for each level and are kept up to date by
+ * set_item and set_monst, which all changes to the items and monsters of the
+ * current level during play go through. Code that rebuilds a whole level
+ * writes the arrays directly and calls invalidate_free_cells instead.
+ * Cells filled by code that doesn't update the index are found and dropped
+ * when picked, and the sets are rebuilt before a level is reported full in
+ * case cells were emptied by such code.
+ */
+#define CELL_MAX (MAXX * MAXY)
+#define CELL_ID(x, y) ((x) * MAXY + (y))
+
+struct CellSetType
+{
+  int Count;                  /* The number of cells in the set */
+  char In[CELL_MAX];          /* Non-zero for each CELL_ID in the set */
+  short Tree[CELL_MAX + 1];   /* Binary indexed tree of In, from 1 */
+};
+
+static struct CellSetType NoItemCells;  /* Cells with no item */
+static struct CellSetType EmptyCells;   /* Cells with no item or monster */
+
+static int FreeCellLevel = -1;  /* The level the sets were built for */
+
 /*
  * Data and macros for finding the number of +s for items.
  */
 #define NUM_LEATHER_PTS 15
 #define NUM_H_LEATHER_PTS 12
-static char nlpts[NUM_LEATHER_PTS] = { 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 7 };
+static const char nlpts[NUM_LEATHER_PTS] = { 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 7 };
 
 #define NUM_CHAIN_PTS 10
-static char nch[NUM_CHAIN_PTS] = { 0, 0, 0, 1, 1, 1, 2, 2, 3, 4 };
+static const char nch[NUM_CHAIN_PTS] = { 0, 0, 0, 1, 1, 1, 2, 2, 3, 4 };
 
 #define NUM_PLATE_PTS 10
 #define NUM_H_PLATE_PTS 3
-static char nplt[NUM_PLATE_PTS] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 4 };
+static const char nplt[NUM_PLATE_PTS] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 4 };
 
 #define NUM_DAGGER_PTS 13
-static char ndgg[NUM_DAGGER_PTS] = { 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 5 };
+static const char ndgg[NUM_DAGGER_PTS] = { 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 5 };
 
 #define NUM_SWORD_PTS 13
 #define NUM_H_SWORD_PTS 6
-static char nsw[] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 2, 3 };
+static const char nsw[] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 2, 3 };
 
 /* return the + points on created leather armor */
 #define newleather() (nlpts[rund(c[HARDGAME]?(NUM_H_LEATHER_PTS):(NUM_LEATHER_PTS))])
@@ -139,24 +201,278 @@ typedef struct save_lev_str
   Char_Ary  know;
 } Saved_Level;
 
-static Saved_Level *saved_levels[NLEVELS] =
+/*
+ * Level storage is shared between the game and any dungeon snapshots that
+ * were taken while the level was unchanged. Refs counts the users of the
+ * storage, and it is copied before being changed if it is shared.
+ */
+struct LevelStoreType
+{
+  int Refs;
+  Saved_Level Level;
+};
+
+static struct LevelStoreType *saved_levels[NLEVELS] =
 {
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL
 };
 
+/*
+ * A snapshot of the dungeon: the storage of every level, shared with the
+ * game, and a copy of the working arrays of the current level.
+ */
+struct DungeonSnapshotType
+{
+  int Level;
+  char Beenhere[NLEVELS];
+  unsigned int Sums[NLEVELS];
+  struct LevelStoreType *Stores[NLEVELS];
+  Short_Ary Hitp;
+  Mitem_Ary Mitem;
+  Char_Ary  Item;
+  Short_Ary Iarg;
+  Char_Ary  Know;
+  Char_Ary  Stealth;
+  Char_Ary  Moved;
+};
+
 static unsigned int level_sums[NLEVELS];
 
+/*
+ * Level layouts.
+ *
+ * The layout of a new level (the canned or random maze and its open spaces)
+ * depends only on the level number and a seed for the level derived from
+ * the game seed, so the layouts of the levels next to the player can be
+ * made ahead of time on a background thread. Objects and monsters depend on
+ * the player's state, so they are placed when the level is entered, using
+ * the level's random number sequence continued from where the layout ended.
+ * A level is the same whether or not its layout was made in advance.
+ */
+typedef enum
+{
+  LAYOUT_EMPTY,     /* No layout */
+  LAYOUT_QUEUED,    /* Waiting for the layout thread */
+  LAYOUT_BUSY,      /* Being made, or being used by newcavelevel */
+  LAYOUT_READY      /* Made, waiting to be entered */
+} LayoutStateType;
+
+/* Contents of a layout cell chosen when the level is entered */
+#define FILL_NONE     0
+#define FILL_OBJECT   1   /* A random object for the level below */
+#define FILL_MONSTER  2   /* A random monster for the level below */
+#define FILL_ROOM     3   /* The monster for open space n is FILL_ROOM + n */
+
+struct LevelLayoutType
+{
+  LayoutStateType State;
+  unsigned long Seed;   /* The level seed the layout was made from */
+  unsigned long Rand;   /* The level random number state after the layout */
+  int Canned;           /* Non-zero if the layout was read from the file */
+  int Rooms;            /* The number of monster filled open spaces */
+  Char_Ary  Item;
+  Short_Ary Arg;
+  Char_Ary  Monst;      /* Fixed monsters */
+  Char_Ary  Fill;       /* See FILL_xxx */
+};
+
+static struct LevelLayoutType Layouts[NLEVELS];
+
+#ifdef LEVEL_THREAD
+static pthread_t LayoutThread;
+static pthread_mutex_t LayoutLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t LayoutCond = PTHREAD_COND_INITIALIZER;
+static int LayoutThreadState = 0;  /* 0 = not started, 1 = running, -1 = failed */
+static int LayoutForkHandlers = 0; /* Non-zero once the fork handlers are set */
+#endif
+
+/*
+ * The pre-made levels file, mapped the first time a level is read from it
+ * and kept for the life of the process.
+ */
+static MappedFileType LevelsFile;
+static int LevelsFileMapped = 0;
+
+/*
+ * Random numbers for layouts, drawn from the layout's own state so that
+ * layouts may be made off the main thread.
+ */
+#define layout_rnd(Rand, x)  ((int)(layout_rand(Rand) % (x)) + 1)
+#define layout_rund(Rand, x) ((int)(layout_rand(Rand) % (x)))
+
 /* =============================================================================
  * Local functions
  */
 
+/* =============================================================================
+ * FUNCTION: layout_rand
+ *
+ * DESCRIPTION:
+ * Generate the next number in a level's random number sequence (xorshift).
+ *
+ * PARAMETERS:
+ *
+ *   Rand : The random number state, which must be non-zero.
+ *
+ * RETURN VALUE:
+ *
+ *   The next random number.
+ */
+static unsigned long layout_rand(unsigned long *Rand)
+{
+  unsigned long x = *Rand;
+
+  x ^= (x << 13) & 0xffffffffUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xffffffffUL;
+  *Rand = x;
+
+  return x;
+}
+
+/* =============================================================================
+ * FUNCTION: level_seed
+ *
+ * DESCRIPTION:
+ * Get the seed for a level's random number sequence in the current game.
+ * This depends on the game's start time and level salt.
+ *
+ * PARAMETERS:
+ *
+ *   lev : The dungeon level
+ *
+ * RETURN VALUE:
+ *
+ *   The level seed (never 0).
+ */
+static unsigned long level_seed(int lev)
+{
+  unsigned long Seed;
+
+  Seed = ((unsigned long) initialtime ^ level_salt ^
+          ((unsigned long) (lev + 1) * 0x9e3779b9UL)) & 0xffffffffUL;
+  Seed = ((Seed ^ (Seed >> 16)) * 0x45d9f3bUL) & 0xffffffffUL;
+  Seed = ((Seed ^ (Seed >> 16)) * 0x45d9f3bUL) & 0xffffffffUL;
+  Seed ^= Seed >> 16;
+
+  return (Seed != 0) ? Seed : 1;
+}
+
+/* =============================================================================
+ * FUNCTION: eat_cells
+ *
+ * DESCRIPTION:
+ * Eat a maze into a level filled with walls.
+ *
+ * PARAMETERS:
+ *
+ *   Cells : The item array to be eaten
+ *
+ *   xx    : The x location to start eating
+ *
+ *   yy    : The y location to start eating
+ *
+ *   Rand  : The level random number state, or NULL to use rnd.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void eat_cells(char Cells[MAXX][MAXY], int xx, int yy,
+                      unsigned long *Rand)
+{
+  int dir;
+  int attempt;
+
+  dir = (Rand != NULL) ? layout_rnd(Rand, 4) : rnd(4);
+  attempt = 2;
+  while (attempt)
+  {
+    switch (dir)
+    {
+      case 1:
+        if (xx <= 2) break; /*  west  */
+        if ((Cells[xx-1][yy]!=OWALL) || (Cells[xx-2][yy]!=OWALL)) break;
+        Cells[xx-1][yy] = ONOTHING;
+        Cells[xx-2][yy] = ONOTHING;
+        eat_cells(Cells, xx-2, yy, Rand);
+        break;
+      case 2:
+        if (xx >= MAXX-3) break;  /*  east  */
+        if ((Cells[xx+1][yy]!=OWALL) || (Cells[xx+2][yy]!=OWALL)) break;
+        Cells[xx+1][yy] = ONOTHING;
+        Cells[xx+2][yy] = ONOTHING;
+        eat_cells(Cells, xx+2, yy, Rand);
+        break;
+      case 3:
+        if (yy <= 2) break; /*  south */
+        if ((Cells[xx][yy-1]!=OWALL) || (Cells[xx][yy-2]!=OWALL)) break;
+        Cells[xx][yy-1] = ONOTHING;
+        Cells[xx][yy-2] = ONOTHING;
+        eat_cells(Cells, xx, yy-2, Rand);
+        break;
+      case 4:
+        if (yy >= MAXY-3 ) break; /*north */
+        if ((Cells[xx][yy+1]!=OWALL) || (Cells[xx][yy+2]!=OWALL)) break;
+        Cells[xx][yy+1] = ONOTHING;
+        Cells[xx][yy+2] = ONOTHING;
+        eat_cells(Cells, xx, yy+2, Rand);
+        break;
+    }
+
+    if (++dir > 4)
+    {
+      dir = 1;
+      --attempt;
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: open_levels_file
+ *
+ * DESCRIPTION:
+ * Get the mapped pre-made levels file, mapping it if this is the first use.
+ * Layouts may be made on the layout thread, so the first mapping is done
+ * under the layout lock.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The mapped file, or NULL if it could not be opened.
+ */
+static MappedFileType *open_levels_file(void)
+{
+  MappedFileType *File = NULL;
+
+#ifdef LEVEL_THREAD
+  pthread_mutex_lock(&LayoutLock);
+#endif
+
+  if (!LevelsFileMapped)
+  {
+    LevelsFileMapped = mapfile_open(larnlevels, &LevelsFile);
+  }
+
+  if (LevelsFileMapped) File = &LevelsFile;
+
+#ifdef LEVEL_THREAD
+  pthread_mutex_unlock(&LayoutLock);
+#endif
+
+  return File;
+}
+
 /* =============================================================================
  * FUNCTION: cannedlevel
  *
  * DESCRIPTION:
- * Function to read in a maze from a data file
+ * Function to read in a maze layout from a data file
  *
  * Only read in a maze 50% of time.
  *
@@ -174,20 +490,28 @@ static unsigned int level_sums[NLEVELS];
  *    . random monster      ~ eye of larn
  *    ! cure dianthroritis  - random object
  *
+ *  Random monsters and objects are chosen when the level is entered.
+ *
  * PARAMETERS:
  *
- *   lev : The dungeon level being read.
+ *   Layout : The layout to be filled
+ *
+ *   lev    : The dungeon level being read.
+ *
+ *   Rand   : The level's random number state
  *
  * RETURN VALUE:
  *
  *   1 for success
  *  -1 for error/use random maze
  */
-static int cannedlevel (int lev)
+static int cannedlevel (struct LevelLayoutType *Layout, int lev,
+                        unsigned long *Rand)
 {
   int i, j, k;
-  int it, arg, marg;
-  FILE *fp;
+  int it, arg, fill;
+  MappedFileType *File;
+  size_t Pos;
   char *row, buf[128];
   MonsterIdType Monst;
 
@@ -197,15 +521,16 @@ static int cannedlevel (int lev)
      * The bottom levels are always read from the file.
      * Only read a maze from file around half the time for regular levels.
      */
-    if (rnd(100) < 50) return -1;
+    if (layout_rnd(Rand, 100) < 50) return -1;
   }
 
-  fp = fopen(larnlevels, "r");
+  File = open_levels_file();
 
-  if (fp == (FILE *)NULL)
+  if (File == NULL)
   {
     return -1;
   }
+  Pos = 0;
 
   /*
    * Umap format
@@ -222,7 +547,7 @@ static int cannedlevel (int lev)
    * use different EOL (CR/LF vs CR or LF).
    * Also, be a bit more forgiving of white space after the map line.
    */
-  i = rund(20);
+  i = layout_rund(Rand, 20);
   for (j = 0 ; j < i ; j++)
   {
     /*
@@ -230,11 +555,9 @@ static int cannedlevel (int lev)
     */
     for (k=0; k < (MAXY+1); k++)
     {
-      row = fgets(buf, 128, fp);
+      row = mapfile_gets(File, &Pos, buf, 128);
       if (row == (char *)NULL)
       {
-        perror("fgets");
-        fclose(fp);
         return (-1);
       }
     }
@@ -245,11 +568,9 @@ static int cannedlevel (int lev)
    */
   for (i = 0 ; i < MAXY ; i++)
   {
-    row = fgets(buf, 128, fp);
+    row = mapfile_gets(File, &Pos, buf, 128);
     if (row == (char *)NULL)
     {
-      perror("fgets");
-      fclose(fp);
       return (-1);
     }
 
@@ -258,7 +579,7 @@ static int cannedlevel (int lev)
       it = ONOTHING;
       Monst = MONST_NONE;
       arg = 0;
-      marg = 0;
+      fill = FILL_NONE;
       switch(*row++)
       {
         case '#':
@@ -266,39 +587,34 @@ static int cannedlevel (int lev)
           break;
         case 'D':
           it = OCLOSEDDOOR;
-          arg = rnd(30);
+          arg = layout_rnd(Rand, 30);
           break;
         case '~':
           if (lev != DBOTTOM) break;
           it = OLARNEYE;
           Monst = DEMONPRINCE;
-          marg = monster[Monst].hitpoints;
           break;
         case '!':
           if (lev!=VBOTTOM) break;
           it = OPOTION;
           arg = 21;
           Monst = LUCIFER;
-          marg = monster[Monst].hitpoints;
           break;
         case '.':
           if (lev<=DBOTTOM-5)  break;
-          Monst = makemonst(lev+1);
-          marg = monster[Monst].hitpoints;
+          fill = FILL_MONSTER;
           break;
         case '-':
-          it = newobject(lev+1,&arg);
+          fill = FILL_OBJECT;
           break;
       }
-      item[j][i] = (char) it;
-      iarg[j][i] = (short) arg;
-      mitem[j][i].mon = (char) Monst;
-      hitp[j][i] = (short) marg;
-      know[j][i] = (char) ((wizard) ? item[j][i] : OUNKNOWN);
+      Layout->Item[j][i] = (char) it;
+      Layout->Arg[j][i] = (short) arg;
+      Layout->Monst[j][i] = (char) Monst;
+      Layout->Fill[j][i] = (char) fill;
     }
   }
 
-  fclose(fp);
   return(1);
 }
 
@@ -455,6 +771,194 @@ static void treasureroom(int lv)
   }
 }
 
+/* =============================================================================
+ * FUNCTION: cellset_update
+ *
+ * DESCRIPTION:
+ * Add or remove a cell from a cell set.
+ *
+ * PARAMETERS:
+ *
+ *   Set : The cell set to update
+ *
+ *   Id  : The CELL_ID of the cell
+ *
+ *   In  : Non-zero if the cell should be in the set
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void cellset_update(struct CellSetType *Set, int Id, int In)
+{
+  int Delta;
+  int i;
+
+  In = (In != 0);
+  if (Set->In[Id] == In) return;
+
+  Delta = In ? 1 : -1;
+  Set->In[Id] = (char) In;
+  Set->Count += Delta;
+
+  for (i = Id + 1 ; i <= CELL_MAX ; i += i & -i)
+  {
+    Set->Tree[i] = (short) (Set->Tree[i] + Delta);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: cellset_select
+ *
+ * DESCRIPTION:
+ * Find the n'th cell of a cell set in CELL_ID order.
+ *
+ * PARAMETERS:
+ *
+ *   Set : The cell set to search
+ *
+ *   n   : The index of the cell to find, from 0 to Set->Count - 1
+ *
+ * RETURN VALUE:
+ *
+ *   The CELL_ID of the cell.
+ */
+static int cellset_select(struct CellSetType *Set, int n)
+{
+  int Step;
+  int Pos;
+
+  for (Step = 1 ; (Step << 1) <= CELL_MAX ; Step <<= 1) ;
+
+  /* Descend the tree, skipping each subtree with no more than n cells */
+  Pos = 0;
+  for ( ; Step > 0 ; Step >>= 1)
+  {
+    if ((Pos + Step <= CELL_MAX) && (Set->Tree[Pos + Step] <= n))
+    {
+      Pos += Step;
+      n -= Set->Tree[Pos];
+    }
+  }
+
+  return Pos;
+}
+
+/* =============================================================================
+ * FUNCTION: build_free_cells
+ *
+ * DESCRIPTION:
+ * Build the free cell sets for the current level if they are out of date.
+ * The sets are out of date when the current level has changed or the index
+ * has been invalidated.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void build_free_cells(void)
+{
+  int x, y;
+
+  if (FreeCellLevel == level) return;
+
+  memset(&NoItemCells, 0, sizeof(NoItemCells));
+  memset(&EmptyCells, 0, sizeof(EmptyCells));
+
+  for (x = 1 ; x < MAXX - 1 ; x++)
+  {
+    for (y = 1 ; y < MAXY - 1 ; y++)
+    {
+      if (item[x][y] == ONOTHING)
+      {
+        cellset_update(&NoItemCells, CELL_ID(x, y), 1);
+
+        if (mitem[x][y].mon == MONST_NONE)
+        {
+          cellset_update(&EmptyCells, CELL_ID(x, y), 1);
+        }
+      }
+    }
+  }
+
+  FreeCellLevel = level;
+}
+
+/* =============================================================================
+ * FUNCTION: random_cell
+ *
+ * DESCRIPTION:
+ * Pick a cell uniformly at random from a free cell set.
+ * Cells in the set that have been filled since it was built are dropped,
+ * and the sets are rebuilt once before the set is reported empty.
+ *
+ * PARAMETERS:
+ *
+ *   Set : The cell set to pick from
+ *
+ *   x   : Set to the x coordinate of the cell picked
+ *
+ *   y   : Set to the y coordinate of the cell picked
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a cell was picked, 0 if the set is empty.
+ */
+static int random_cell(struct CellSetType *Set, int *x, int *y)
+{
+  int PlayerId;
+  int PlayerIn;
+  int Id;
+  int Rebuilt = 0;
+
+  build_free_cells();
+
+  for (;;)
+  {
+    /* Keep the player's cell out of the set while picking */
+    PlayerId = CELL_ID(playerx, playery);
+    PlayerIn = Set->In[PlayerId];
+    cellset_update(Set, PlayerId, 0);
+
+    Id = -1;
+    if (Set->Count > 0) Id = cellset_select(Set, rund(Set->Count));
+
+    cellset_update(Set, PlayerId, PlayerIn);
+
+    if ((Id < 0) && !Rebuilt)
+    {
+      /* Pick up any cells emptied by code that doesn't update the index */
+      invalidate_free_cells();
+      build_free_cells();
+      Rebuilt = 1;
+      continue;
+    }
+
+    if (Id < 0)
+    {
+      placement_failures++;
+      return 0;
+    }
+
+    *x = Id / MAXY;
+    *y = Id % MAXY;
+
+    if ((item[*x][*y] == ONOTHING) &&
+        ((Set == &NoItemCells) || (mitem[*x][*y].mon == MONST_NONE)))
+    {
+      return 1;
+    }
+
+    /* Filled by code that doesn't update the index */
+    placement_retries++;
+    update_free_cell(*x, *y);
+  }
+}
+
 /* =============================================================================
  * FUNCTION: fillroom
  *
@@ -476,20 +980,10 @@ static void fillroom (int what, int arg)
 {
   int x, y;
 
-  x = rnd(MAXX-2);
-  y = rnd(MAXY-2);
-
-  while (item[x][y] != ONOTHING)
-  {
-    x += rnd(3)-2;
-    y += rnd(3)-2;
+  /* Nothing can be placed if the level is full */
+  if (!random_cell(&NoItemCells, &x, &y)) return;
 
-    if (x > MAXX-2) x = 1;
-    if (x < 1)      x = MAXX-2;
-    if (y > MAXY-2) y = 1;
-    if (y < 1)      y = MAXY-2;
-  }
-  item[x][y] = (char) what;
+  set_item(x, y, what);
   iarg[x][y] = (short) arg;
 }
 
@@ -559,36 +1053,36 @@ static void froom(int n, int itm, int arg)
  * The items in the set from which only one can be created per dungeon level
  * must be specified first.
  */
-static int UniqueItem[UNIQUE_COUNT] = {
+static const int UniqueItem[UNIQUE_COUNT] = {
   OBRASSLAMP, OWWAND, OORBOFDRAGON, OSPIRITSCARAB, OCUBEofUNDEAD, ONOTHEFT,
   OSPHTALISMAN, OHANDofFEAR, OORB, OELVENCHAIN,
   OSWORDofSLASHING, OHAMMER, OSLAYER, OVORPAL, OPSTAFF, OLIFEPRESERVER };
 
 /* The character flags associated with the creation of each unique item */
-static AttributeType UniqueFlag[UNIQUE_COUNT] = {
+static const AttributeType UniqueFlag[UNIQUE_COUNT] = {
   LAMP, WAND, DRAGSLAY, NEGATE, CUBEUNDEAD, DEVICE,
   TALISMAN, HAND, ORB, ELVEN,
   SLASH, BESSMANN, SLAY, VORPAL, STAFF, LIFE_PRESERVER };
 
 /* The minimum dungeon level for this item to occur */
-static int UniqueMinLevel[UNIQUE_COUNT] = {
+static const int UniqueMinLevel[UNIQUE_COUNT] = {
  0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
  0, 0, 10, 0, 8, 5 };
 
 /* The die to roll for determining if this item is created */
-static int UniqueRoll[UNIQUE_COUNT] = {
+static const int UniqueRoll[UNIQUE_COUNT] = {
   120, 120, 120, 120, 120, 120, 120, 120, 120, 120,
   120, 120, 100, 120, 100, 100 };
 
 /* The max roll for item creation */
-static int UniqueProb[UNIQUE_COUNT] = {
+static const int UniqueProb[UNIQUE_COUNT] = {
   8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
   8, 8, 15, 8, 15, 15 };
 
 /* The increase in probability for each level in the dungeon above the minimum
  * required for the item
  */
-static int UniqueProbLevelMod[UNIQUE_COUNT] = {
+static const int UniqueProbLevelMod[UNIQUE_COUNT] = {
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
   0, 0, 1, 0, 1, 0 };
 
@@ -910,7 +1404,7 @@ static void sethp (int flg)
       i = level-10;
       for (j = 1 ; j <= i ; j++)
       {
-        while (fillmonst(DEMONLORD+rund(7))==-1) ;
+        fillmonst(DEMONLORD+rund(7));
       }
     }
 
@@ -926,8 +1420,8 @@ static void sethp (int flg)
       i=level-DBOTTOM;
       for (j = 1 ; j <= i ; j++)
       {
-        /* Keep trying until the demon prince has been placed */
-        while (fillmonst(DEMONPRINCE)==-1) ;
+        /* This only fails if the level is full */
+        fillmonst(DEMONPRINCE);
       }
     }
   }
@@ -958,41 +1452,57 @@ static void checkgen (void)
     {
       if ((monster[(int) mitem[x][y].mon].flags & FL_GENOCIDED) != 0)
       {
-        mitem[x][y].mon = 0; /* no more monster */
+        set_monst(x, y, MONST_NONE); /* no more monster */
       }
     }
   }
 }
 
 /* =============================================================================
- * FUNCTION: makemaze
+ * FUNCTION: makelayout
  *
  * DESCRIPTION:
- * Function to make the caverns for a given level.
- * Only walls are made (except for canned levels).
+ * Function to make the layout of the caverns for a given level.
+ * Only walls and open spaces are made (except for canned levels).
+ * This uses no game state other than the layout, so it may be called from
+ * the layout thread.
  *
  * PARAMETERS:
  *
- *   lev : The dungeon level to be made.
+ *   Layout : The layout to be made. Layout->Seed must be set.
+ *
+ *   lev    : The dungeon level to be made.
  *
  * RETURN VALUE:
  *
  *   None.
  */
-static void makemaze (int lev)
+static void makelayout (struct LevelLayoutType *Layout, int lev)
 {
+  unsigned long Rand;
   int mx, mxl, mxh;
   int my, myl, myh;
   int tmp2;
   int i, j;
   int tmp;
-  MonsterIdType Monst;
+  int fill;
+
+  Rand = Layout->Seed;
+  Layout->Canned = 0;
+  Layout->Rooms = 0;
+  memset(Layout->Arg, 0, sizeof(Short_Ary));
+  memset(Layout->Monst, MONST_NONE, sizeof(Char_Ary));
+  memset(Layout->Fill, FILL_NONE, sizeof(Char_Ary));
 
   if (lev > 0)
   {
     /* read maze from data file */
-    if (cannedlevel(lev) == 1)
+    if (cannedlevel(Layout, lev, &Rand) == 1)
+    {
+      Layout->Canned = 1;
+      Layout->Rand = Rand;
       return;
+    }
   }
 
   if (lev==0)
@@ -1005,55 +1515,51 @@ static void makemaze (int lev)
   }
 
   /* fill up maze */
-  for (i = 0 ; i < MAXY ; i++)
-  {
-    for (j = 0 ; j < MAXX ; j++)
-    {
-      item[j][i] = (char) tmp;
-    }
-  }
+  memset(Layout->Item, tmp, sizeof(Char_Ary));
 
   /* don't need to do anymore for level 0 */
   if (lev == 0)
+  {
+    Layout->Rand = Rand;
     return;
+  }
 
-  eat(1, 1);
+  eat_cells(Layout->Item, 1, 1, &Rand);
 
   /*  now for open spaces -- not on level 15 or V5 */
   if ((lev != DBOTTOM) && (lev != VBOTTOM))
   {
-    tmp2 = rnd(3)+3;
+    tmp2 = layout_rnd(&Rand, 3)+3;
     for (tmp=0; tmp<tmp2; tmp++)
     {
-      my = rnd(11)+2;
-      myl = my - rnd(2);
-      myh = my + rnd(2);
+      my = layout_rnd(&Rand, 11)+2;
+      myl = my - layout_rnd(&Rand, 2);
+      myh = my + layout_rnd(&Rand, 2);
       if (lev <= DBOTTOM)
       {
         /* in dungeon */
-        mx = rnd(44)+5;
-        mxl = mx - rnd(4);
-        mxh = mx + rnd(12)+3;
-        Monst=0;
+        mx = layout_rnd(&Rand, 44)+5;
+        mxl = mx - layout_rnd(&Rand, 4);
+        mxh = mx + layout_rnd(&Rand, 12)+3;
+        fill = FILL_NONE;
       }
       else
       {
-        /* in volcano */
-        mx = rnd(60)+3;
-        mxl = mx - rnd(2);
-        mxh = mx + rnd(2);
-        Monst = makemonst(lev);
+        /* in volcano, the open space is filled with a monster */
+        mx = layout_rnd(&Rand, 60)+3;
+        mxl = mx - layout_rnd(&Rand, 2);
+        mxh = mx + layout_rnd(&Rand, 2);
+        fill = FILL_ROOM + Layout->Rooms++;
       }
 
       for (i = mxl ; i < mxh ; i++)
       {
         for (j = myl ; j < myh ; j++)
         {
-          item[i][j] = ONOTHING;
-          if (Monst != MONST_NONE)
+          Layout->Item[i][j] = ONOTHING;
+          if (fill != FILL_NONE)
           {
-            mitem[i][j].mon = (char) Monst;
-            hitp[i][j] = monster[Monst].hitpoints;
+            Layout->Fill[i][j] = (char) fill;
           }
         }
       }
@@ -1063,21 +1569,417 @@ static void makemaze (int lev)
 
   if (lev!=DBOTTOM && lev!=VBOTTOM)
   {
-    my = rnd(MAXY-2);
+    my = layout_rnd(&Rand, MAXY-2);
     for (i = 1 ; i < MAXX-1 ; i++)
     {
-      item[i][my] = ONOTHING;
+      Layout->Item[i][my] = ONOTHING;
+    }
+  }
+
+  Layout->Rand = Rand;
+}
+
+/* =============================================================================
+ * FUNCTION: set_layout_state
+ *
+ * DESCRIPTION:
+ * Set the state of a layout, waking the layout thread and any waiters.
+ *
+ * PARAMETERS:
+ *
+ *   Layout : The layout
+ *
+ *   State  : The new state
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void set_layout_state(struct LevelLayoutType *Layout,
+                             LayoutStateType State)
+{
+#ifdef LEVEL_THREAD
+  pthread_mutex_lock(&LayoutLock);
+  Layout->State = State;
+  pthread_cond_broadcast(&LayoutCond);
+  pthread_mutex_unlock(&LayoutLock);
+#else
+  Layout->State = State;
+#endif
+}
+
+#ifdef LEVEL_THREAD
+
+/* =============================================================================
+ * FUNCTION: layout_thread
+ *
+ * DESCRIPTION:
+ * The layout thread. Makes queued layouts, lowest level first.
+ *
+ * PARAMETERS:
+ *
+ *   Arg : Unused.
+ *
+ * RETURN VALUE:
+ *
+ *   Does not return.
+ */
+static void *layout_thread(void *Arg)
+{
+  struct LevelLayoutType *Layout;
+  int lev;
+
+  pthread_mutex_lock(&LayoutLock);
+
+  for (;;)
+  {
+    for (lev = 0 ; lev < NLEVELS ; lev++)
+    {
+      if (Layouts[lev].State == LAYOUT_QUEUED) break;
+    }
+
+    if (lev == NLEVELS)
+    {
+      pthread_cond_wait(&LayoutCond, &LayoutLock);
+      continue;
+    }
+
+    Layout = &Layouts[lev];
+    Layout->State = LAYOUT_BUSY;
+    pthread_mutex_unlock(&LayoutLock);
+
+    makelayout(Layout, lev);
+
+    pthread_mutex_lock(&LayoutLock);
+    Layout->State = LAYOUT_READY;
+    pthread_cond_broadcast(&LayoutCond);
+  }
+
+  return NULL;
+}
+
+/* =============================================================================
+ * FUNCTION: layout_fork_prepare
+ *
+ * DESCRIPTION:
+ * Called before a fork. Holds the layout lock so the child is not forked
+ * part way through a change to the layouts.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void layout_fork_prepare(void)
+{
+  pthread_mutex_lock(&LayoutLock);
+}
+
+/* =============================================================================
+ * FUNCTION: layout_fork_parent
+ *
+ * DESCRIPTION:
+ * Called in the parent after a fork. Releases the layout lock.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void layout_fork_parent(void)
+{
+  pthread_mutex_unlock(&LayoutLock);
+}
+
+/* =============================================================================
+ * FUNCTION: layout_fork_child
+ *
+ * DESCRIPTION:
+ * Called in the child after a fork. The layout thread is not copied into
+ * the child, so any layout it was making or had queued would be waited
+ * for forever. Forget all layouts and let the next queue_layout start a
+ * new layout thread.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void layout_fork_child(void)
+{
+  int lev;
+
+  pthread_mutex_init(&LayoutLock, NULL);
+  pthread_cond_init(&LayoutCond, NULL);
+  LayoutThreadState = 0;
+
+  for (lev = 0 ; lev < NLEVELS ; lev++)
+  {
+    Layouts[lev].State = LAYOUT_EMPTY;
+  }
+}
+
+#endif
+
+/* =============================================================================
+ * FUNCTION: queue_layout
+ *
+ * DESCRIPTION:
+ * Queue the layout of an unvisited level to be made by the layout thread.
+ * Does nothing if layouts are not made in the background.
+ *
+ * PARAMETERS:
+ *
+ *   lev : The dungeon level
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void queue_layout(int lev)
+{
+#ifdef LEVEL_THREAD
+  struct LevelLayoutType *Layout;
+  unsigned long Seed;
+
+  if ((lev < 0) || (lev >= NLEVELS) || beenhere[lev]) return;
+
+  Layout = &Layouts[lev];
+  Seed = level_seed(lev);
+
+  pthread_mutex_lock(&LayoutLock);
+
+  if (LayoutThreadState == 0)
+  {
+    /* Forked children start without the thread, so must reset the layouts */
+    if (!LayoutForkHandlers)
+    {
+      LayoutForkHandlers = (pthread_atfork(layout_fork_prepare,
+                                           layout_fork_parent,
+                                           layout_fork_child) == 0);
+    }
+
+    if (LayoutForkHandlers)
+    {
+      LayoutThreadState =
+        (pthread_create(&LayoutThread, NULL, layout_thread, NULL) == 0) ? 1 : -1;
+    }
+    else
+    {
+      LayoutThreadState = -1;
+    }
+  }
+
+  if ((LayoutThreadState == 1) &&
+      ((Layout->State == LAYOUT_EMPTY) ||
+       ((Layout->State == LAYOUT_READY) && (Layout->Seed != Seed))))
+  {
+    Layout->Seed = Seed;
+    Layout->State = LAYOUT_QUEUED;
+    pthread_cond_broadcast(&LayoutCond);
+  }
+
+  pthread_mutex_unlock(&LayoutLock);
+#endif
+}
+
+/* =============================================================================
+ * FUNCTION: release_store
+ *
+ * DESCRIPTION:
+ * Release a user's reference to level storage, freeing the storage if it
+ * has no users left.
+ *
+ * PARAMETERS:
+ *
+ *   Store : The level storage (may be NULL)
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void release_store(struct LevelStoreType *Store)
+{
+  if (Store == NULL) return;
+
+  Store->Refs--;
+  if (Store->Refs == 0)
+  {
+    free(Store);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: own_level
+ *
+ * DESCRIPTION:
+ * Get the storage for a level ready to be changed, copying it first if it
+ * is shared with a snapshot.
+ *
+ * PARAMETERS:
+ *
+ *   lev : The dungeon level
+ *
+ * RETURN VALUE:
+ *
+ *   The level storage, owned only by the game.
+ */
+static Saved_Level *own_level(int lev)
+{
+  struct LevelStoreType *Store;
+
+  if (saved_levels[lev]->Refs > 1)
+  {
+    Store = (struct LevelStoreType *) malloc(sizeof(struct LevelStoreType));
+    if (Store == NULL)
+    {
+      died(DIED_MALLOC_FAILURE, 0);
+    }
+
+    memcpy((char *) &Store->Level, (char *) &saved_levels[lev]->Level,
+           sizeof(Saved_Level));
+    Store->Refs = 1;
+
+    release_store(saved_levels[lev]);
+    saved_levels[lev] = Store;
+  }
+
+  return &saved_levels[lev]->Level;
+}
+
+/* =============================================================================
+ * FUNCTION: get_layout
+ *
+ * DESCRIPTION:
+ * Get the layout of a level about to be entered, waiting for the layout
+ * thread if it is making the layout, or making it now if it has not been
+ * made. The layout is held by the caller until released by setting its
+ * state to LAYOUT_EMPTY.
+ *
+ * PARAMETERS:
+ *
+ *   lev : The dungeon level
+ *
+ * RETURN VALUE:
+ *
+ *   The layout for the level.
+ */
+static struct LevelLayoutType *get_layout(int lev)
+{
+  struct LevelLayoutType *Layout;
+  unsigned long Seed;
+  int Make;
+
+  Layout = &Layouts[lev];
+  Seed = level_seed(lev);
+
+#ifdef LEVEL_THREAD
+  pthread_mutex_lock(&LayoutLock);
+  while (Layout->State == LAYOUT_BUSY)
+  {
+    pthread_cond_wait(&LayoutCond, &LayoutLock);
+  }
+#endif
+
+  Make = (Layout->State != LAYOUT_READY) || (Layout->Seed != Seed);
+  Layout->Seed = Seed;
+  Layout->State = LAYOUT_BUSY;
+
+#ifdef LEVEL_THREAD
+  pthread_mutex_unlock(&LayoutLock);
+#endif
+
+  if (Make)
+  {
+    makelayout(Layout, lev);
+  }
+
+  return Layout;
+}
+
+/* =============================================================================
+ * FUNCTION: makemaze
+ *
+ * DESCRIPTION:
+ * Function to make the caverns for a given level from its layout.
+ * Only walls are made (except for canned levels and the volcano, and the
+ * treasure rooms below level 4).
+ * The level's random number sequence is seeded for the rest of the level
+ * generation.
+ *
+ * PARAMETERS:
+ *
+ *   lev : The dungeon level to be made.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void makemaze (int lev)
+{
+  struct LevelLayoutType *Layout;
+  MonsterIdType RoomMonst[FILL_ROOM + 8];
+  MonsterIdType Monst;
+  int Canned;
+  int i, j;
+  int fill;
+
+  Layout = get_layout(lev);
+
+  game_srand(Layout->Rand);
+
+  for (i = 0 ; i < Layout->Rooms ; i++)
+  {
+    RoomMonst[FILL_ROOM + i] = makemonst(lev);
+  }
+
+  for (i = 0 ; i < MAXY ; i++)
+  {
+    for (j = 0 ; j < MAXX ; j++)
+    {
+      item[j][i] = Layout->Item[j][i];
+      iarg[j][i] = Layout->Arg[j][i];
+      Monst = (MonsterIdType) Layout->Monst[j][i];
+
+      fill = Layout->Fill[j][i];
+      if (fill == FILL_OBJECT)
+      {
+        item[j][i] = (char) newobject(lev+1, &fill);
+        iarg[j][i] = (short) fill;
+      }
+      else if (fill == FILL_MONSTER)
+      {
+        Monst = makemonst(lev+1);
+      }
+      else if (fill >= FILL_ROOM)
+      {
+        Monst = RoomMonst[fill];
+      }
+
+      mitem[j][i].mon = (char) Monst;
+      hitp[j][i] = (short) ((Monst != MONST_NONE) ? monster[Monst].hitpoints : 0);
     }
   }
 
+  Canned = Layout->Canned;
+  set_layout_state(Layout, LAYOUT_EMPTY);
+
   /* no treasure rooms above level 5 */
-  if (lev > 4)
+  if ((lev > 4) && !Canned)
   {
     treasureroom(lev);
   }
 }
 
-
 /* =============================================================================
  * Exported functions
  */
@@ -1091,11 +1993,12 @@ void init_cells(void)
 
   for (i = 0; i < NLEVELS; i++)
   {
-    if ((saved_levels[i] = (Saved_Level * )
-          malloc(sizeof(Saved_Level))) == (Saved_Level *)NULL)
+    if ((saved_levels[i] = (struct LevelStoreType * )
+          malloc(sizeof(struct LevelStoreType))) == NULL)
     {
       died(DIED_MALLOC_FAILURE, 0);
     }
+    saved_levels[i]->Refs = 1;
   }
 }
 
@@ -1108,10 +2011,8 @@ void free_cells(void)
 
   for (i = 0; i < NLEVELS; i++)
   {
-    if (saved_levels[i] != (Saved_Level * ) NULL)
-    {
-      free(saved_levels[i]);
-    }
+    release_store(saved_levels[i]);
+    saved_levels[i] = NULL;
   }
 }
 
@@ -1172,78 +2073,76 @@ void dropgold(int amount)
  */
 int fillmonst (int what)
 {
-  int x,y,trys;
+  int x,y;
 
-  /* max # of creation attempts */
-  for (trys = 10 ; trys > 0 ; --trys)
+  if (!random_empty_cell(&x, &y))
   {
-    x = rnd(MAXX-2);
-    y = rnd(MAXY-2);
-
-    if ((item[x][y] == ONOTHING) &&
-        (mitem[x][y].mon == MONST_NONE) &&
-        ((playerx!=x) || (playery!=y)))
-    {
-      mitem[x][y].mon = (char) what;
-      stealth[x][y] = 0;
-      hitp[x][y] = monster[what].hitpoints;
-      return(0);
-    }
+    return(-1); /* creation failure, the level is full */
   }
 
-  return(-1); /* creation failure */
+  set_monst(x, y, what);
+  stealth[x][y] = 0;
+  hitp[x][y] = monster[what].hitpoints;
+
+  return(0);
 }
 
 /* =============================================================================
- * FUNCTION: eat
+ * FUNCTION: random_empty_cell
  */
-void eat (int xx, int yy)
+int random_empty_cell(int *x, int *y)
 {
-  int dir;
-  int attempt;
+  return random_cell(&EmptyCells, x, y);
+}
 
-  dir = rnd(4);
-  attempt = 2;
-  while (attempt)
-  {
-    switch (dir)
-    {
-      case 1:
-        if (xx <= 2) break; /*  west  */
-        if ((item[xx-1][yy]!=OWALL) || (item[xx-2][yy]!=OWALL)) break;
-        item[xx-1][yy] = ONOTHING;
-        item[xx-2][yy] = ONOTHING;
-        eat(xx-2,yy);
-        break;
-      case 2:
-        if (xx >= MAXX-3) break;  /*  east  */
-        if ((item[xx+1][yy]!=OWALL) || (item[xx+2][yy]!=OWALL)) break;
-        item[xx+1][yy] = ONOTHING;
-        item[xx+2][yy] = ONOTHING;
-        eat(xx+2,yy);
-        break;
-      case 3:
-        if (yy <= 2) break; /*  south */
-        if ((item[xx][yy-1]!=OWALL) || (item[xx][yy-2]!=OWALL)) break;
-        item[xx][yy-1] = ONOTHING;
-        item[xx][yy-2] = ONOTHING;
-        eat(xx,yy-2);
-        break;
-      case 4:
-        if (yy >= MAXY-3 ) break; /*north */
-        if ((item[xx][yy+1]!=OWALL) || (item[xx][yy+2]!=OWALL)) break;
-        item[xx][yy+1] = ONOTHING;
-        item[xx][yy+2] = ONOTHING;
-        eat(xx,yy+2);
-        break;
-    }
+/* =============================================================================
+ * FUNCTION: update_free_cell
+ */
+void update_free_cell(int x, int y)
+{
+  int Id;
 
-    if (++dir > 4)
-    {
-      dir = 1;
-      --attempt;
-    }
-  }
+  if (FreeCellLevel != level) return;
+  if ((x < 1) || (x >= MAXX - 1) || (y < 1) || (y >= MAXY - 1)) return;
+
+  Id = CELL_ID(x, y);
+  cellset_update(&NoItemCells, Id, item[x][y] == ONOTHING);
+  cellset_update(&EmptyCells, Id,
+                 (item[x][y] == ONOTHING) && (mitem[x][y].mon == MONST_NONE));
+}
+
+/* =============================================================================
+ * FUNCTION: set_item
+ */
+void set_item(int x, int y, int it)
+{
+  item[x][y] = (char) it;
+  update_free_cell(x, y);
+}
+
+/* =============================================================================
+ * FUNCTION: set_monst
+ */
+void set_monst(int x, int y, int monst)
+{
+  mitem[x][y].mon = (char) monst;
+  update_free_cell(x, y);
+}
+
+/* =============================================================================
+ * FUNCTION: invalidate_free_cells
+ */
+void invalidate_free_cells(void)
+{
+  FreeCellLevel = -1;
+}
+
+/* =============================================================================
+ * FUNCTION: eat
+ */
+void eat (int xx, int yy)
+{
+  eat_cells(item, xx, yy, NULL);
 }
 
 /* =============================================================================
@@ -1251,7 +2150,7 @@ void eat (int xx, int yy)
  */
 void savelevel(void)
 {
-  Saved_Level *storage = saved_levels[level];
+  Saved_Level *storage = own_level(level);
 
   memcpy((char *)storage->hitp,  (char *)hitp,  sizeof(Short_Ary));
   memcpy((char *)storage->mitem, (char *)mitem, sizeof(Mitem_Ary));
@@ -1268,7 +2167,7 @@ void getlevel(void)
 {
   unsigned int i;
 
-  Saved_Level *storage = saved_levels[level];
+  Saved_Level *storage = &saved_levels[level]->Level;
 
   memcpy((char *)hitp,  (char *)storage->hitp,  sizeof(Short_Ary));
   memcpy((char *)mitem, (char *)storage->mitem, sizeof(Mitem_Ary));
@@ -1276,6 +2175,10 @@ void getlevel(void)
   memcpy((char *)iarg,  (char *)storage->iarg,  sizeof(Short_Ary));
   memcpy((char *)know,  (char *)storage->know,  sizeof(Char_Ary));
 
+  /* The wall planes are not saved, so rebuild them for this level */
+  AnalyseWalls(0, 0, MAXX-1, MAXY-1);
+  invalidate_free_cells();
+
   if (level_sums[level] > 0)
   {
     if ((i = sum((unsigned char *)storage,sizeof(Saved_Level)))
@@ -1295,12 +2198,45 @@ void getlevel(void)
   }
 }
 
+/* =============================================================================
+ * FUNCTION: peeklevel
+ */
+int peeklevel(int lev, LevelViewType *View)
+{
+  Saved_Level *storage;
+
+  if ((lev < 0) || (lev >= NLEVELS)) return 0;
+
+  if (lev == level)
+  {
+    View->item = item;
+    View->iarg = iarg;
+    View->mitem = mitem;
+    View->hitp = hitp;
+    View->know = know;
+    return 1;
+  }
+
+  if (!beenhere[lev] || (saved_levels[lev] == NULL)) return 0;
+  storage = &saved_levels[lev]->Level;
+
+  View->item = storage->item;
+  View->iarg = storage->iarg;
+  View->mitem = storage->mitem;
+  View->hitp = storage->hitp;
+  View->know = storage->know;
+
+  return 1;
+}
+
 /* =============================================================================
  * FUNCTION: AnalyseWalls
  */
 void AnalyseWalls(int x1, int y1, int x2, int y2)
 {
-  int WallArg;
+  unsigned long Bits;
+  unsigned long Keep;
+  unsigned long Left, Down, Right, Up;
   int x, y;
   int sx, sy;
   int ex, ey;
@@ -1311,63 +2247,57 @@ void AnalyseWalls(int x1, int y1, int x2, int y2)
   ex = (x2 >= MAXX) ? (MAXX-1) : (x2);
   ey = (y2 >= MAXY) ? (MAXY-1) : (y2);
 
+  if ((sx > ex) || (sy > ey)) return;
+
+  /* Refresh the wall plane bits for the cells in the area */
+  Keep = ~(((2UL << ey) - 1) & ~((1UL << sy) - 1));
+
   for (x = sx ; x <= ex ; x++)
   {
+    Bits = 0;
     for (y = sy ; y <= ey ; y++)
     {
-      if (item[x][y] == OWALL)
-      {
-        /* There is a wall here, so analyse connectivity with other walls */
-        
-        WallArg = 0;
-
-        if (x > 0)
-        {
-          if ((item[x-1][y] == OWALL) ||
-              (item[x-1][y] == OOPENDOOR) ||
-              (item[x-1][y] == OCLOSEDDOOR))
-          {
-            WallArg += 1;
-          }
-        }
-
-        if (y < (MAXY-1))
-        {
-          if ((item[x][y+1] == OWALL) ||
-              (item[x][y+1] == OOPENDOOR) ||
-              (item[x][y+1] == OCLOSEDDOOR))
-          {
-            WallArg += 2;
-          }
-        }
-
-        if (x < (MAXX-1))
-        {
-          if ((item[x+1][y] == OWALL) ||
-              (item[x+1][y] == OOPENDOOR) ||
-              (item[x+1][y] == OCLOSEDDOOR))
-          {
-            WallArg += 4;
-          }
-        }
+      Bits |= (unsigned long) WALL_LIKE(item[x][y]) << y;
+    }
 
-        if (y > 0)
-        {
-          if ((item[x][y-1] == OWALL) ||
-              (item[x][y-1] == OOPENDOOR) ||
-              (item[x][y-1] == OCLOSEDDOOR))
-          {
-            WallArg += 8;
-          }
-        }
+    WallPlane[x] = (WallPlane[x] & Keep) | Bits;
+  }
 
-        iarg[x][y] = (short) WallArg;
+  /*
+   * The connectivity of the cells bordering the area may also have changed,
+   * so recalculate the masks for the area grown by one cell.
+   * The neighbours of each column are found by shifting the column planes.
+   */
+  sx = (sx > 0) ? (sx - 1) : 0;
+  sy = (sy > 0) ? (sy - 1) : 0;
+  ex = (ex < (MAXX-1)) ? (ex + 1) : (MAXX-1);
+  ey = (ey < (MAXY-1)) ? (ey + 1) : (MAXY-1);
 
-      } /* if a wall is here */
+  for (x = sx ; x <= ex ; x++)
+  {
+    Left = (x > 0) ? WallPlane[x-1] : 0;
+    Down = WallPlane[x] >> 1;
+    Right = (x < (MAXX-1)) ? WallPlane[x+1] : 0;
+    Up = WallPlane[x] << 1;
 
+    for (y = sy ; y <= ey ; y++)
+    {
+      wallmask[x][y] = (unsigned char)
+        (((Left >> y) & 1) |
+         (((Down >> y) & 1) << 1) |
+         (((Right >> y) & 1) << 2) |
+         (((Up >> y) & 1) << 3));
     }
   }
-  
+
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateWall
+ */
+void UpdateWall(int x, int y)
+{
+  AnalyseWalls(x, y, x, y);
 }
 
 /* =============================================================================
@@ -1376,6 +2306,9 @@ void AnalyseWalls(int x1, int y1, int x2, int y2)
 void newcavelevel (int x)
 {
   int i,j;
+  unsigned long Next;
+
+  TRACE_BEGIN(TRACE_NEWCAVELEVEL);
 
   if (beenhere[level])
   {
@@ -1411,6 +2344,13 @@ void newcavelevel (int x)
   }
   else
   {
+    /*
+     * New levels are made from the level's own random number sequence,
+     * so they depend only on the game seed and the player's state.
+     * The game's sequence is resumed afterwards.
+     */
+    Next = rand_state;
+
     /* never been here before, so don't know anything, and no monsters */
     for (i = 0; i < MAXY ; i++)
     {
@@ -1422,6 +2362,7 @@ void newcavelevel (int x)
     }
 
     makemaze(x);
+    invalidate_free_cells();
 
     /* if this is level 1 */
     if (x == 1)
@@ -1452,10 +2393,34 @@ void newcavelevel (int x)
     /* wipe out any genocided monsters */
     checkgen();
 
+    rand_state = Next;
+
     /* Position the player on the map */
     positionplayer();
 
   }
+
+  /*
+   * Make the layouts of the unvisited levels the player can reach next
+   * while the player is on this level.
+   */
+  if (x == 0)
+  {
+    queue_layout(1);
+    queue_layout(DBOTTOM + 1);
+  }
+  else if (x <= DBOTTOM)
+  {
+    queue_layout(x - 1);
+    if (x < DBOTTOM) queue_layout(x + 1);
+  }
+  else
+  {
+    if (x > DBOTTOM + 1) queue_layout(x - 1);
+    if (x < VBOTTOM) queue_layout(x + 1);
+  }
+
+  TRACE_END(TRACE_NEWCAVELEVEL);
 }
 
 /* =============================================================================
@@ -1525,7 +2490,7 @@ void createitem(int x, int y, int it, int arg)
       if (cgood(ox, oy, 1, 0))
       {
         /* if we can create an item here */
-        item[ox][oy] = (char) it;
+        set_item(ox, oy, it);
         iarg[ox][oy] = (short) arg;
         return;
       }
@@ -1546,7 +2511,7 @@ void createitem(int x, int y, int it, int arg)
           {
             i = iarg[ox][oy];
             iarg[ox][oy] = (short)((10L * i + arg) / 10);
-            item[ox][oy] = ODGOLD;
+            set_item(ox, oy, ODGOLD);
             return;
           }
         case OMAXGOLD:
@@ -1554,7 +2519,7 @@ void createitem(int x, int y, int it, int arg)
           {
             i = (int) ((100L * iarg[ox][oy]) + arg);
             iarg[ox][oy] = (short) (i / 100);
-            item[ox][oy] = OMAXGOLD;
+            set_item(ox, oy, OMAXGOLD);
             return;
           }
         case OKGOLD:
@@ -1562,7 +2527,7 @@ void createitem(int x, int y, int it, int arg)
           {
             i = iarg[ox][oy];
             iarg[ox][oy] = (short)((1000L*i+arg) / 1000);
-            item[ox][oy] = OKGOLD;
+            set_item(ox, oy, OKGOLD);
             return;
           }
           else
@@ -1573,7 +2538,7 @@ void createitem(int x, int y, int it, int arg)
         default:
           if (cgood(ox, oy, 1, 0))
           {
-            item[ox][oy] = (char) it;
+            set_item(ox, oy, it);
             if (it == OMAXGOLD)
             {
               iarg[ox][oy] = (short) (arg / 100);
@@ -1621,7 +2586,7 @@ void something(int x, int y, int lev)
 #define LEV_0to3_LAST 32
 #define LEV_4to6_LAST 35
 #define LEV_6plus_LAST 37
-static char nobjtab[] = {
+static const char nobjtab[] = {
   0,
   OSCROLL, OSCROLL, OSCROLL, OSCROLL,
   OPOTION, OPOTION, OPOTION, OPOTION,
@@ -1750,7 +2715,7 @@ int write_levels(FILE *fp)
   {
     if (beenhere[i])
     {
-      storage = saved_levels[i];
+      storage = &saved_levels[i]->Level;
       bwrite(fp, (char * )storage, sizeof(Saved_Level));
     }
   }
@@ -1783,7 +2748,7 @@ int read_levels(FILE *fp)
   {
     if (beenhere[i])
     {
-      storage = saved_levels[i];
+      storage = own_level(i);
       bread(fp, (char * )storage, sizeof(Saved_Level));
     }
   }
@@ -1791,4 +2756,85 @@ int read_levels(FILE *fp)
   return 0;
 }
 
+/* =============================================================================
+ * FUNCTION: dungeon_snapshot
+ */
+DungeonSnapshotType *dungeon_snapshot(void)
+{
+  DungeonSnapshotType *Snap;
+  int i;
+
+  Snap = (DungeonSnapshotType *) malloc(sizeof(DungeonSnapshotType));
+  if (Snap == NULL) return NULL;
+
+  Snap->Level = level;
+  memcpy(Snap->Beenhere, beenhere, sizeof(beenhere));
+  memcpy(Snap->Sums, level_sums, sizeof(level_sums));
+
+  /* The stored levels are shared until one side changes them */
+  for (i = 0; i < NLEVELS; i++)
+  {
+    Snap->Stores[i] = saved_levels[i];
+    saved_levels[i]->Refs++;
+  }
+
+  /* The current level changes every turn, so it is always copied */
+  memcpy((char *)Snap->Hitp,    (char *)hitp,    sizeof(Short_Ary));
+  memcpy((char *)Snap->Mitem,   (char *)mitem,   sizeof(Mitem_Ary));
+  memcpy((char *)Snap->Item,    (char *)item,    sizeof(Char_Ary));
+  memcpy((char *)Snap->Iarg,    (char *)iarg,    sizeof(Short_Ary));
+  memcpy((char *)Snap->Know,    (char *)know,    sizeof(Char_Ary));
+  memcpy((char *)Snap->Stealth, (char *)stealth, sizeof(Char_Ary));
+  memcpy((char *)Snap->Moved,   (char *)moved,   sizeof(Char_Ary));
+
+  return Snap;
+}
+
+/* =============================================================================
+ * FUNCTION: dungeon_restore
+ */
+void dungeon_restore(DungeonSnapshotType *Snap)
+{
+  int i;
+
+  level = Snap->Level;
+  memcpy(beenhere, Snap->Beenhere, sizeof(beenhere));
+  memcpy(level_sums, Snap->Sums, sizeof(level_sums));
+
+  for (i = 0; i < NLEVELS; i++)
+  {
+    Snap->Stores[i]->Refs++;
+    release_store(saved_levels[i]);
+    saved_levels[i] = Snap->Stores[i];
+  }
+
+  memcpy((char *)hitp,    (char *)Snap->Hitp,    sizeof(Short_Ary));
+  memcpy((char *)mitem,   (char *)Snap->Mitem,   sizeof(Mitem_Ary));
+  memcpy((char *)item,    (char *)Snap->Item,    sizeof(Char_Ary));
+  memcpy((char *)iarg,    (char *)Snap->Iarg,    sizeof(Short_Ary));
+  memcpy((char *)know,    (char *)Snap->Know,    sizeof(Char_Ary));
+  memcpy((char *)stealth, (char *)Snap->Stealth, sizeof(Char_Ary));
+  memcpy((char *)moved,   (char *)Snap->Moved,   sizeof(Char_Ary));
+
+  /* The wall planes and the free cell index are derived from the level */
+  AnalyseWalls(0, 0, MAXX-1, MAXY-1);
+  invalidate_free_cells();
+}
+
+/* =============================================================================
+ * FUNCTION: dungeon_snapshot_free
+ */
+void dungeon_snapshot_free(DungeonSnapshotType *Snap)
+{
+  int i;
+
+  if (Snap == NULL) return;
+
+  for (i = 0; i < NLEVELS; i++)
+  {
+    release_store(Snap->Stores[i]);
+  }
+
+  free(Snap);
+}
 
@@ -15,11 +15,14 @@
  * stealth   : The monster stealth status for each dungeon location
  * hitp      : The monster hit points for each dungeon location
  * iarg      : The item arg for each dungeon location
+ * wallmask  : The wall connectivity for each dungeon location
  * screen    : Screen data used in moving monsters
  * mitem     : The monster and items it has stolen for each dungeon location
  * beenhere  : Which dungeon levels have been visited
  * level     : The current dungeon level
  * levelname : The name of each dungeon level
+ * placement_retries  : The number of stale cells dropped by random placement
+ * placement_failures : The number of random placements that found no cell
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -29,10 +32,17 @@
  * cgood          : Check if a cell is empty (monster and/or item)
  * dropgold       : Drop gold around the player
  * fillmonst      : Attempt to put a monster into the dungeon
+ * random_empty_cell : Pick a random cell with no item, monster or player
+ * update_free_cell  : Update the free cell index after a cell has changed
+ * set_item       : Set the item at a location of the current level
+ * set_monst      : Set the monster at a location of the current level
+ * invalidate_free_cells : Mark the free cell index as out of date
  * eat            : Eat a maze in a level filled with walls
  * savelevel      : Save the current dungeon level into storage
  * getlevel       : Get the current level from storage.
+ * peeklevel      : Get read only access to any visited level
  * AnalyseWalls   : Calculate wall tiles based on adjacent walls.
+ * UpdateWall     : Update wall tiles after a single cell has changed.
  * newcavelevel   : Function to go to a different cave level, creating if reqd
  * verifyxy       : Verify x and y coordinates are on the map, adjusting if reqd
  * checkxy        : Just check if x, y are on the map, making no changes.
@@ -41,6 +51,9 @@
  * newobject      : Return a randomly selected item
  * write_levels   : Write dungeon levels to the save file
  * read_levels    : Read dungeon levels from the save file
+ * dungeon_snapshot      : Take an in-memory snapshot of the dungeon
+ * dungeon_restore       : Restore the dungeon from a snapshot
+ * dungeon_snapshot_free : Free a dungeon snapshot
  *
  * =============================================================================
  */
@@ -108,9 +121,39 @@ extern char moved[MAXX][MAXY];        /* monster movement flags  */
 extern char stealth[MAXX][MAXY];      /* 0=sleeping 1=awake monst    */
 extern short hitp[MAXX][MAXY];        /* monster hp on level  */
 extern short iarg[MAXX][MAXY];        /* arg for the item array */
+
+/*
+ * The wall connectivity of each cell, used to select the wall tile.
+ * The mask is the sum of:
+ *   1 : The cell to the left is a wall or door
+ *   2 : The cell below is a wall or door
+ *   4 : The cell to the right is a wall or door
+ *   8 : The cell above is a wall or door
+ * This is maintained by AnalyseWalls and UpdateWall.
+ */
+extern unsigned char wallmask[MAXX][MAXY];
+
 extern short screen[MAXX][MAXY];      /* The screen as the player knows it */
 extern struct_mitem mitem[MAXX][MAXY]; /* Items stolen by monstes array */
 
+/*
+ * A read only view of the contents of a level, as returned by peeklevel.
+ * Each member points to a [MAXX][MAXY] array.
+ */
+typedef struct
+{
+  char (*item)[MAXY];
+  short (*iarg)[MAXY];
+  struct_mitem (*mitem)[MAXY];
+  short (*hitp)[MAXY];
+  char (*know)[MAXY];
+} LevelViewType;
+
+/*
+ * An in-memory snapshot of the dungeon, as returned by dungeon_snapshot.
+ */
+typedef struct DungeonSnapshotType DungeonSnapshotType;
+
 /*
  * This serves two purposes:
  *   1. Indicates which levels have been visited by the player.
@@ -127,7 +170,13 @@ extern char beenhere[NLEVELS];
 
 extern int level;        /* cavelevel player is on = c[CAVELEVEL]*/
 
-extern char *levelname[]; /* Dungeon level names */
+extern char *const levelname[]; /* Dungeon level names */
+
+/*
+ * Random placement statistics, for measuring level generation.
+ */
+extern long placement_retries;
+extern long placement_failures;
 
 /*
  * MACRO: forget
@@ -136,8 +185,8 @@ extern char *levelname[]; /* Dungeon level names */
  */
 #define forget()               \
 {                              \
-  item[playerx][playery] = ONOTHING;  \
-  know[playerx][playery] = ONOTHING;  \
+  set_item(playerx, playery, ONOTHING); \
+  know[playerx][playery] = ONOTHING;    \
 }
 
 /*
@@ -147,7 +196,7 @@ extern char *levelname[]; /* Dungeon level names */
  */
 #define disappear(x,y) \
 {                      \
-  mitem[x][y].mon = 0; \
+  set_monst(x, y, MONST_NONE); \
   if (know[x][y] != OUNKNOWN) show1cell(x, y); \
 }
 
@@ -247,10 +296,112 @@ void dropgold(int amount);
  * RETURN VALUE:
  *
  *   0 if the monster could be created
- *  -1 if no location for the monster could be found
+ *  -1 if the level is full
  */
 int fillmonst (int what);
 
+/* =============================================================================
+ * FUNCTION: random_empty_cell
+ *
+ * DESCRIPTION:
+ * Pick a location uniformly at random from the interior cells of the current
+ * level that have no item or monster and are not occupied by the player.
+ * This takes constant time using the free cell index.
+ *
+ * PARAMETERS:
+ *
+ *   x : Set to the x coordinate of the location picked
+ *
+ *   y : Set to the y coordinate of the location picked
+ *
+ * RETURN VALUE:
+ *
+ *   1 if a location was picked
+ *   0 if there are no empty locations on the level
+ */
+int random_empty_cell(int *x, int *y);
+
+/* =============================================================================
+ * FUNCTION: update_free_cell
+ *
+ * DESCRIPTION:
+ * Update the free cell index after the item or monster at a location has
+ * changed. The index is only rebuilt when the level changes, so code that
+ * empties a location must call this for later placements to pick it.
+ * set_item and set_monst call this, so it is only needed directly by code
+ * that changes a cell some other way.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the changed location
+ *
+ *   y : The y coordinate of the changed location
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void update_free_cell(int x, int y);
+
+/* =============================================================================
+ * FUNCTION: set_item
+ *
+ * DESCRIPTION:
+ * Set the item at a location of the current level and update the free cell
+ * index. All changes to item[][] during play should use this.
+ *
+ * PARAMETERS:
+ *
+ *   x  : The x coordinate of the location
+ *
+ *   y  : The y coordinate of the location
+ *
+ *   it : The new item
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void set_item(int x, int y, int it);
+
+/* =============================================================================
+ * FUNCTION: set_monst
+ *
+ * DESCRIPTION:
+ * Set the monster at a location of the current level and update the free
+ * cell index. All changes to mitem[][].mon during play should use this.
+ *
+ * PARAMETERS:
+ *
+ *   x     : The x coordinate of the location
+ *
+ *   y     : The y coordinate of the location
+ *
+ *   monst : The new monster, or MONST_NONE to remove the monster
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void set_monst(int x, int y, int monst);
+
+/* =============================================================================
+ * FUNCTION: invalidate_free_cells
+ *
+ * DESCRIPTION:
+ * Mark the free cell index as out of date so it is rebuilt on next use.
+ * This must be called when the contents of the current level are replaced.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void invalidate_free_cells(void);
+
 /* =============================================================================
  * FUNCTION: eat
  *
@@ -301,6 +452,28 @@ void savelevel(void);
  */
 void getlevel(void);
 
+/* =============================================================================
+ * FUNCTION: peeklevel
+ *
+ * DESCRIPTION:
+ * Get a view of the contents of a level without making it the current level
+ * and without generating it if it has not been visited.
+ * The view of the current level is the live level arrays, as the stored copy
+ * is only brought up to date when the player leaves the level.
+ * The arrays in the view must not be modified.
+ *
+ * PARAMETERS:
+ *
+ *   lev  : The level to view
+ *
+ *   View : Set to point to the level arrays
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the level exists, 0 if it has not been visited.
+ */
+int peeklevel(int lev, LevelViewType *View);
+
 /* =============================================================================
  * FUNCTION: AnalyseWalls
  *
@@ -324,6 +497,26 @@ void getlevel(void);
  */
 void AnalyseWalls(int x1, int y1, int x2, int y2);
 
+/* =============================================================================
+ * FUNCTION: UpdateWall
+ *
+ * DESCRIPTION:
+ * Function to update the wall tiles after the item at a single location has
+ * changed to or from a wall or door.
+ * Only the location and its 8 neighbours are recalculated.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x position of the changed location
+ *
+ *   y : The y position of the changed location
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void UpdateWall(int x, int y);
+
 /* =============================================================================
  * FUNCTION: newcavelevel
  *
@@ -482,4 +675,57 @@ int write_levels(FILE *fp);
  */
 int read_levels(FILE *fp);
 
+/* =============================================================================
+ * FUNCTION: dungeon_snapshot
+ *
+ * DESCRIPTION:
+ * Take an in-memory snapshot of the dungeon levels.
+ * Only the working arrays of the current level are copied. The storage of
+ * the other levels is shared with the game until the game next changes it,
+ * so taking a snapshot costs the same however many levels have been visited.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The snapshot, or NULL if there is not enough memory.
+ */
+DungeonSnapshotType *dungeon_snapshot(void);
+
+/* =============================================================================
+ * FUNCTION: dungeon_restore
+ *
+ * DESCRIPTION:
+ * Restore the dungeon levels from a snapshot, including the current level.
+ * The snapshot is not changed and may be restored again.
+ * The caller is responsible for redrawing the screen.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to restore
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void dungeon_restore(DungeonSnapshotType *Snap);
+
+/* =============================================================================
+ * FUNCTION: dungeon_snapshot_free
+ *
+ * DESCRIPTION:
+ * Free a dungeon snapshot.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to free (may be NULL)
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void dungeon_snapshot_free(DungeonSnapshotType *Snap);
+
 #endif
@@ -36,6 +36,7 @@
 #include "header.h"
 #include "player.h"
 #include "monster.h"
+#include "dungeon.h"
 #include "potion.h"
 #include "scores.h"
 #include "itm.h"
@@ -63,7 +64,7 @@ static void ohear(void)
   Print("\nYou have been heard!");
   if (c[ALTPRO]==0)
     c[MOREDEFENSES] += ALTAR_PRO_BOOST;
-  c[ALTPRO] += 800; /* protection field */
+  add_effect(ALTPRO, 800); /* protection field */
   recalc();
   UpdateEffects();
 }
@@ -245,7 +246,7 @@ void oopendoor(int x, int y)
     switch (iarg[x][y])
     {
       case 6:
-        c[AGGRAVATE] += rnd(400);
+        add_effect(AGGRAVATE, rnd(400));
         break;
 
       case 7:
@@ -271,7 +272,7 @@ void oopendoor(int x, int y)
   }
   else
   {
-    item[x][y] = OOPENDOOR;
+    set_item(x, y, OOPENDOOR);
     show1cell(x, y);
   }
 }
@@ -342,7 +343,7 @@ void oaltar(void)
                 Print(" Cheapskate! The Gods are insulted by such a tiny offering!");
                 forget();
                 createmonster(DEMONPRINCE);
-                c[AGGRAVATE] += 1500;
+                add_effect(AGGRAVATE, 1500);
                 /* God takes more gold anyway */ 
                 c[GOLD] -= k;
               }
@@ -355,7 +356,7 @@ void oaltar(void)
                  * amount doneted is.
                  */
                 createmonster(makemonst(level+2));
-                c[AGGRAVATE] += 500;
+                add_effect(AGGRAVATE, 500);
                 /* God takes more gold anyway */
                 c[GOLD] -= k;
               }
@@ -401,7 +402,7 @@ void oaltar(void)
         if (rnd(100)<60)
         {
           createmonster(makemonst(level+3)+8);
-          c[AGGRAVATE] += 2500;
+          add_effect(AGGRAVATE, 2500);
         }
         else if(rnd(100)<5)
         {
@@ -425,7 +426,7 @@ void oaltar(void)
         if (rnd(100)<30)
         {
           createmonster(makemonst(level+2));
-          c[AGGRAVATE] += rnd(450);
+          add_effect(AGGRAVATE, rnd(450));
         }
         else
         {
@@ -462,12 +463,12 @@ void othrone(int arg)
         {
           creategem(); /*gems pop off the throne*/
         }
-        item[playerx][playery] = ODEADTHRONE;
+        set_item(playerx, playery, ODEADTHRONE);
       }
       else if ((k<40) && (arg==0))
       {
         createmonster(GNOMEKING);
-        item[playerx][playery] = OTHRONE2;
+        set_item(playerx, playery, OTHRONE2);
       }
       else
       {
@@ -481,7 +482,7 @@ void othrone(int arg)
       if ((k<30) && (arg==0))
       {
         createmonster(GNOMEKING);
-        item[playerx][playery] = OTHRONE2;
+        set_item(playerx, playery, OTHRONE2);
       }
       else if (k<35)
       {
@@ -585,7 +586,7 @@ void ofountain(void)
         }
         else if (x<14)
         {
-          c[HALFDAM] += 200+rnd(200);
+          add_effect(HALFDAM, 200+rnd(200));
           Print("\nThe water makes you vomit.");
         }
         else if (x<17)
@@ -593,7 +594,7 @@ void ofountain(void)
           /* Same effect as giant strength */
           Print("\n  You now have incredible bulging muscles!");
           if (c[GIANTSTR]==0) c[STREXTRA] += PGIANTSTR_BOOST;
-          c[GIANTSTR] += 700;
+          add_effect(GIANTSTR, 700);
           UpdateEffects();
         }
         else if (x < 45)
@@ -613,7 +614,7 @@ void ofountain(void)
         {
           Print("\nThe fountains bubbling slowly quietens.");
           /* dead fountain */
-          item[playerx][playery] = ODEADFOUNTAIN;
+          set_item(playerx, playery, ODEADFOUNTAIN);
         }
       }
       break;
@@ -643,7 +644,7 @@ void ofountain(void)
            * Managed to get rid of the itching powder, so set it so the
            * next call to regen will cancel the effect.
            */
-          c[ITCHING] = 1;
+          set_effect(ITCHING, 1);
         }
       }
       else if (rnd(100) < 31)
@@ -0,0 +1,648 @@
+/* =============================================================================
+ * PROGRAM:  ularn-bench
+ * FILENAME: enginebench.c
+ *
+ * DESCRIPTION:
+ * Engine micro-benchmarks for the turn loop hot paths.
+ *
+ * Each benchmark runs an engine function repeatedly against a fixture built
+ * from a fixed seed. The fixture (level, player and inventory) is restored
+ * before every run, outside the timed region, so each run sees exactly the
+ * same state.
+ *
+ * The display is initialised with its output sent to /dev/null so that the
+ * display calls made by the engine, and the map repaint benchmark, cost what
+ * they cost when playing.
+ *
+ * Results are written as JSON lines, one object per benchmark:
+ *   {"benchmark":"movemonst_crowded","iterations":2000,"mean_ns":...,
+ *    "p50_ns":...,"p99_ns":...,"min_ns":...,"max_ns":...}
+ * preceded by one line describing the run.
+ *
+ * Usage: ularn-bench [-i iterations] [-f filter] [-l libdir] [-o file]
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * main - The benchmark entry point
+ *
+ * =============================================================================
+ */
+
+#include <time.h>
+#include <curses.h>
+
+#include "header.h"
+#include "patchlevel.h"
+#include "ularn_game.h"
+#include "ularn_win.h"
+#include "getopt.h"
+#include "savegame.h"
+#include "dungeon.h"
+#include "monster.h"
+#include "player.h"
+#include "spell.h"
+#include "itm.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/* The seed all fixtures are made from */
+#define BENCH_SEED 1000
+
+/* The levels used for the fixtures */
+#define BENCH_LEVEL      8
+#define BENCH_LEVEL_NEXT 9
+
+/* The file used for the save and restore benchmarks */
+#define BENCH_SAVE_FILE "ularn-bench.sav"
+
+/* The results file */
+static FILE *Out;
+
+/* Only run benchmarks with names containing this string, if not NULL */
+static char *Filter = NULL;
+
+/* The number of timed runs of each benchmark */
+static int Iterations = 2000;
+
+/* The run times for the current benchmark, in nanoseconds */
+static double *Samples;
+
+/*
+ * The fixture state restored before each run.
+ */
+struct FixtureType
+{
+  char Item[MAXX][MAXY];
+  short Iarg[MAXX][MAXY];
+  struct_mitem Mitem[MAXX][MAXY];
+  short Hitp[MAXX][MAXY];
+  char Stealth[MAXX][MAXY];
+  char Know[MAXX][MAXY];
+  long C[ATTRIBUTE_COUNT];
+  char Iven[IVENSIZE];
+  short Ivenarg[IVENSIZE];
+  int PlayerX, PlayerY;
+  long Gtime;
+};
+
+static struct FixtureType Fixture;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: now_ns
+ *
+ * DESCRIPTION:
+ * Get a monotonic time.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The time in nanoseconds.
+ */
+static double now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec * 1000000000.0 + (double) ts.tv_nsec;
+}
+
+/* =============================================================================
+ * FUNCTION: compare_samples
+ *
+ * DESCRIPTION:
+ * qsort comparison function for run times.
+ *
+ * PARAMETERS:
+ *
+ *   a : The first sample
+ *
+ *   b : The second sample
+ *
+ * RETURN VALUE:
+ *
+ *   <0, 0 or >0 as a is less than, equal to or greater than b.
+ */
+static int compare_samples(const void *a, const void *b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return (da < db) ? -1 : ((da > db) ? 1 : 0);
+}
+
+/* =============================================================================
+ * FUNCTION: save_fixture
+ *
+ * DESCRIPTION:
+ * Record the current level, player and inventory as the fixture.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void save_fixture(void)
+{
+  sync_effects();
+
+  memcpy(Fixture.Item, item, sizeof(Fixture.Item));
+  memcpy(Fixture.Iarg, iarg, sizeof(Fixture.Iarg));
+  memcpy(Fixture.Mitem, mitem, sizeof(Fixture.Mitem));
+  memcpy(Fixture.Hitp, hitp, sizeof(Fixture.Hitp));
+  memcpy(Fixture.Stealth, stealth, sizeof(Fixture.Stealth));
+  memcpy(Fixture.Know, know, sizeof(Fixture.Know));
+  memcpy(Fixture.C, c, sizeof(Fixture.C));
+  memcpy(Fixture.Iven, iven, sizeof(Fixture.Iven));
+  memcpy(Fixture.Ivenarg, ivenarg, sizeof(Fixture.Ivenarg));
+  Fixture.PlayerX = playerx;
+  Fixture.PlayerY = playery;
+  Fixture.Gtime = gtime;
+}
+
+/* =============================================================================
+ * FUNCTION: restore_fixture
+ *
+ * DESCRIPTION:
+ * Restore the fixture recorded by save_fixture.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void restore_fixture(void)
+{
+  memcpy(item, Fixture.Item, sizeof(Fixture.Item));
+  memcpy(iarg, Fixture.Iarg, sizeof(Fixture.Iarg));
+  memcpy(mitem, Fixture.Mitem, sizeof(Fixture.Mitem));
+  memcpy(hitp, Fixture.Hitp, sizeof(Fixture.Hitp));
+  memcpy(stealth, Fixture.Stealth, sizeof(Fixture.Stealth));
+  memcpy(know, Fixture.Know, sizeof(Fixture.Know));
+  memcpy(c, Fixture.C, sizeof(Fixture.C));
+  memcpy(iven, Fixture.Iven, sizeof(Fixture.Iven));
+  memcpy(ivenarg, Fixture.Ivenarg, sizeof(Fixture.Ivenarg));
+  playerx = Fixture.PlayerX;
+  playery = Fixture.PlayerY;
+  gtime = Fixture.Gtime;
+  last_monst_hx = -1;
+  last_monst_hy = -1;
+
+  reset_effects();
+  inventory_changed(-1);
+  AnalyseWalls(0, 0, MAXX-1, MAXY-1);
+  invalidate_free_cells();
+}
+
+/* =============================================================================
+ * FUNCTION: new_player
+ *
+ * DESCRIPTION:
+ * Start a new game from the benchmark seed, on the home level.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void new_player(void)
+{
+  int i;
+
+  initialtime = BENCH_SEED;
+  game_srand(BENCH_SEED);
+
+  for (i = 0 ; i < NLEVELS ; i++)
+  {
+    beenhere[i] = 0;
+  }
+  level = 0;
+
+  makeplayer();
+
+  /* Tough enough to survive anything the fixtures can do in one turn */
+  c[HPMAX] = 999;
+  c[HP] = 999;
+
+  newcavelevel(0);
+  set_display(DISPLAY_MAP);
+}
+
+/* =============================================================================
+ * FUNCTION: make_monster_fixture
+ *
+ * DESCRIPTION:
+ * Make a fixture on the benchmark level with monsters placed around the
+ * player, nearest first, inside the largest monster movement window.
+ *
+ * PARAMETERS:
+ *
+ *   Count     : The number of monsters to place (-1 to fill the window)
+ *
+ *   Monst     : The monster to place
+ *
+ *   Farthest  : Place the monsters farthest from the player first
+ *
+ *   Aggravate : Non-zero if the player aggravates monsters
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void make_monster_fixture(int Count, MonsterIdType Monst, int Farthest,
+                                 int Aggravate)
+{
+  int x, y;
+  int d, dmin, dmax, step;
+  int Placed;
+
+  new_player();
+  newcavelevel(BENCH_LEVEL);
+
+  /* Remove the level's own monsters */
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      mitem[x][y].mon = MONST_NONE;
+      hitp[x][y] = 0;
+      know[x][y] = item[x][y];
+    }
+  }
+
+  /* Place monsters in rings of increasing (or decreasing) distance */
+  dmin = 1;
+  dmax = 10;
+  step = 1;
+  d = dmin;
+  if (Farthest)
+  {
+    d = dmax;
+    step = -1;
+  }
+
+  Placed = 0;
+  for ( ; (d >= dmin) && (d <= dmax) ; d += step)
+  {
+    for (y = playery - 5 ; y <= playery + 5 ; y++)
+    {
+      for (x = playerx - d ; x <= playerx + d ; x++)
+      {
+        if ((Count >= 0) && (Placed >= Count)) break;
+        if ((x < 1) || (x >= MAXX - 1) || (y < 1) || (y >= MAXY - 1)) continue;
+        if (max(abs(x - playerx), abs(y - playery)) != d) continue;
+        if ((item[x][y] != ONOTHING) || (mitem[x][y].mon != MONST_NONE)) continue;
+
+        mitem[x][y].mon = (char) Monst;
+        hitp[x][y] = (short) monster[Monst].hitpoints;
+        stealth[x][y] = STEALTH_AWAKE | STEALTH_SEEN;
+        Placed++;
+      }
+    }
+  }
+
+  /* The fixture's monsters were placed directly */
+  invalidate_free_cells();
+
+  set_effect(STEALTH, 0);
+  set_effect(AGGRAVATE, Aggravate ? 1000 : 0);
+
+  save_fixture();
+}
+
+/* =============================================================================
+ * FUNCTION: make_inventory_fixture
+ *
+ * DESCRIPTION:
+ * Make a fixture with a full pack of mixed items, wearing armour and a
+ * shield and wielding a weapon.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void make_inventory_fixture(void)
+{
+  static int Pack[IVENSIZE] =
+  {
+    OPLATEARMOR, OLONGSWORD, OSHIELD, OPROTRING, OREGENRING,
+    ODAMRING, OBELT, OENERGYRING, OCHEST, OPOTION,
+    OSCROLL, OBOOK, ODIAMOND, OCOOKIE, OAMULET,
+    OLANCE, OSTRRING, ODEXRING, OCLEVERRING, OSPEED,
+    OSHROOMS, OACID, OHASH, OCOKE, OPAD, OLEATHER
+  };
+  int i;
+
+  new_player();
+
+  for (i = 0 ; i < IVENSIZE ; i++)
+  {
+    iven[i] = (char) Pack[i % (sizeof(Pack) / sizeof(Pack[0]))];
+    ivenarg[i] = (short) ((i % 3) + 1);
+  }
+  c[WEAR] = 0;
+  c[WIELD] = 1;
+  c[SHIELD] = 2;
+  inventory_changed(-1);
+
+  save_fixture();
+}
+
+/* =============================================================================
+ * FUNCTION: run_bench
+ *
+ * DESCRIPTION:
+ * Time a benchmark and write its results.
+ *
+ * PARAMETERS:
+ *
+ *   Name  : The benchmark name
+ *
+ *   Setup : Function called before each run, outside the timed region
+ *
+ *   Op    : The function to be timed
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void run_bench(char *Name, void (*Setup)(void), void (*Op)(void))
+{
+  double Start;
+  double Total;
+  int i;
+
+  if ((Filter != NULL) && (strstr(Name, Filter) == NULL)) return;
+
+  Total = 0.0;
+  for (i = 0 ; i < Iterations ; i++)
+  {
+    if (Setup != NULL) Setup();
+
+    Start = now_ns();
+    Op();
+    Samples[i] = now_ns() - Start;
+    Total += Samples[i];
+  }
+
+  qsort(Samples, Iterations, sizeof(double), compare_samples);
+
+  fprintf(Out,
+    "{\"benchmark\":\"%s\",\"iterations\":%d,\"mean_ns\":%.0f,"
+    "\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"min_ns\":%.0f,\"max_ns\":%.0f}\n",
+    Name, Iterations, Total / (double) Iterations,
+    Samples[Iterations / 2],
+    Samples[(Iterations * 99) / 100],
+    Samples[0],
+    Samples[Iterations - 1]);
+  fflush(Out);
+}
+
+/* =============================================================================
+ * Benchmark operations
+ */
+
+static void op_movemonst(void)
+{
+  movemonst();
+}
+
+static void op_newcavelevel(void)
+{
+  newcavelevel(BENCH_LEVEL_NEXT);
+}
+
+static void setup_first_visit(void)
+{
+  newcavelevel(BENCH_LEVEL);
+  beenhere[BENCH_LEVEL_NEXT] = 0;
+}
+
+static void setup_repeat_visit(void)
+{
+  newcavelevel(BENCH_LEVEL);
+}
+
+static void op_savegame(void)
+{
+  savegame(BENCH_SAVE_FILE);
+}
+
+static void setup_restoregame(void)
+{
+  savegame(BENCH_SAVE_FILE);
+  free_cells();
+}
+
+static void op_restoregame(void)
+{
+  restoregame(BENCH_SAVE_FILE);
+}
+
+static void op_godirect(void)
+{
+  /* Answer the direction prompt: east */
+  ungetch('l');
+  godirect(SPELL_MLE, 200, "  The magic missile hits the %s.", 0, EFFECT_MLE);
+}
+
+static void op_omnidirect(void)
+{
+  omnidirect(SPELL_CKL, 40, "  The %s gasps for air!", MAGIC_CLOUD);
+}
+
+static void op_recalc(void)
+{
+  recalc();
+}
+
+static void op_packweight(void)
+{
+  (void) packweight();
+}
+
+static void op_inventory_changed(void)
+{
+  inventory_changed(0);
+}
+
+static void op_paintmap(void)
+{
+  drawscreen();
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: main
+ */
+int main(int argc, char *argv[])
+{
+  char *OutName;
+  int opt;
+
+  OutName = NULL;
+
+  while ((opt = ugetopt(argc, argv, "i:f:l:o:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'i':
+        Iterations = atoi(optarg);
+        break;
+      case 'f':
+        Filter = optarg;
+        break;
+      case 'l':
+        strncpy(libdir, optarg, MAXPATHLEN - 1);
+        break;
+      case 'o':
+        OutName = optarg;
+        break;
+      default:
+        fprintf(stderr,
+          "Usage: %s [-i iterations] [-f filter] [-l libdir] [-o file]\n",
+          argv[0]);
+        return 2;
+    }
+  }
+
+  if (Iterations < 1) Iterations = 1;
+
+  Samples = (double *) malloc(Iterations * sizeof(double));
+  if (Samples == NULL)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  /*
+   * Results go to the requested file or the original stdout.
+   * The display writes to /dev/null.
+   */
+  if (OutName != NULL)
+  {
+    Out = fopen(OutName, "w");
+  }
+  else
+  {
+    Out = fdopen(dup(fileno(stdout)), "w");
+  }
+
+  if (Out == NULL)
+  {
+    perror((OutName != NULL) ? OutName : "stdout");
+    return 1;
+  }
+
+  if (freopen("/dev/null", "w", stdout) == NULL)
+  {
+    perror("/dev/null");
+    return 1;
+  }
+
+  if (getenv("TERM") == NULL)
+  {
+    setenv("TERM", "vt100", 1);
+  }
+
+  sprintf(larnlevels, "%.*s/%s", MAXPATHLEN - 16, libdir, LEVELSNAME);
+
+  nonap = 1;
+  char_picked = 'a';
+
+  init_app();
+  init_cells();
+
+  fprintf(Out,
+    "{\"suite\":\"ularn-bench\",\"version\":\"%s.%s\",\"seed\":%d,"
+    "\"iterations\":%d}\n",
+    LARN_VERSION, LARN_PATCHLEVEL, BENCH_SEED, Iterations);
+
+  /* Monster movement */
+  make_monster_fixture(0, TROLL, 0, 0);
+  run_bench("movemonst_empty", restore_fixture, op_movemonst);
+  set_effect(AGGRAVATE, 1000);
+  save_fixture();
+  run_bench("movemonst_empty_aggravate", restore_fixture, op_movemonst);
+
+  make_monster_fixture(12, TROLL, 0, 0);
+  run_bench("movemonst_medium", restore_fixture, op_movemonst);
+  make_monster_fixture(12, TROLL, 0, 1);
+  run_bench("movemonst_medium_aggravate", restore_fixture, op_movemonst);
+
+  make_monster_fixture(-1, TROLL, 0, 0);
+  run_bench("movemonst_crowded", restore_fixture, op_movemonst);
+  make_monster_fixture(-1, TROLL, 0, 1);
+  run_bench("movemonst_crowded_aggravate", restore_fixture, op_movemonst);
+
+  /* Intelligent monsters far from the player search the whole window */
+  make_monster_fixture(8, ELF, 1, 1);
+  run_bench("smart_move_far_aggravate", restore_fixture, op_movemonst);
+  make_monster_fixture(-1, ELF, 0, 1);
+  run_bench("smart_move_crowded_aggravate", restore_fixture, op_movemonst);
+
+  /* Spell resolution */
+  make_monster_fixture(-1, TROLL, 0, 0);
+  run_bench("godirect", restore_fixture, op_godirect);
+  run_bench("omnidirect", restore_fixture, op_omnidirect);
+
+  /* Map repaint */
+  make_monster_fixture(12, TROLL, 0, 0);
+  run_bench("paintmap", restore_fixture, op_paintmap);
+
+  /* Level changes */
+  new_player();
+  newcavelevel(BENCH_LEVEL);
+  run_bench("newcavelevel_first_visit", setup_first_visit, op_newcavelevel);
+  run_bench("newcavelevel_repeat_visit", setup_repeat_visit, op_newcavelevel);
+
+  /* Save and restore */
+  run_bench("savegame", NULL, op_savegame);
+  run_bench("restoregame", setup_restoregame, op_restoregame);
+  unlink(BENCH_SAVE_FILE);
+
+  /* Derived player stats */
+  make_inventory_fixture();
+  run_bench("recalc", NULL, op_recalc);
+  run_bench("packweight", NULL, op_packweight);
+  run_bench("inventory_changed_slot", NULL, op_inventory_changed);
+
+  fclose(Out);
+  endwin();
+
+  free_cells();
+  free(Samples);
+
+  return 0;
+}
@@ -24,6 +24,7 @@
 
 #include "header.h"
 #include "fortune.h"
+#include "mapfile.h"
 
 /* =============================================================================
  * Local variables
@@ -32,19 +33,20 @@
 #define MAX_FORTUNE_LEN 80
 
 /*
- * Data structure for a linked list of fortune strings read from the
- * fortune file
+ * The fortune file is mapped the first time a fortune is needed. Each line
+ * of up to MAX_FORTUNE_LEN - 1 characters is a fortune, and only the
+ * offsets of the lines are kept in memory.
  */
-struct FortuneType
-{
-  char Line[MAX_FORTUNE_LEN];
-  struct FortuneType *Next;
-};
-
-static struct FortuneType *fortunes = NULL;
+static MappedFileType FortuneFile;
+static size_t *FortuneLine = NULL;
 static int fortune_read = 0;   /* true if we have loaded the fortune info */
 static int nlines = 0;         /* # lines in fortune database */
 
+/*
+ * The fortune returned by the last call to fortune.
+ */
+static char FortuneBuf[MAX_FORTUNE_LEN];
+
 /* =============================================================================
  * Exported functions
  */
@@ -55,78 +57,71 @@ static int nlines = 0;         /* # lines in fortune database */
 
 char *fortune(char *file)
 {
-  FILE *fp;
-  char *Line;
-  char Buffer[80];
-  struct FortuneType *NewFortune;
+  char Buffer[MAX_FORTUNE_LEN];
+  size_t Pos;
+  size_t Start;
+  size_t *NewLine;
+  int Size;
   int Len;
-  int Pos;
 
   if (fortune_read == 0)
   {
-    /* open the file */
-    fp = fopen(file, "r");
-    if (fp == NULL)
+    /* map the file */
+    if (!mapfile_open(file, &FortuneFile))
     {
       /* can't find file */
       return(0);
     }
 
-    /* Read the fortune lines from the file */
-    while (!feof(fp))
+    /* Find the start of each fortune line in the file */
+    Pos = 0;
+    Size = 0;
+    Start = Pos;
+    while (mapfile_gets(&FortuneFile, &Pos, Buffer, MAX_FORTUNE_LEN) != NULL)
     {
-      Line = fgets(Buffer, MAX_FORTUNE_LEN, fp);
-      if (Line != NULL)
+      if (nlines == Size)
       {
-        /* trim white space and CR/LF fromt he end of the line */
-        Len = strlen(Buffer);
-        Len--;
-        while ((Len > 0) && isspace((int) Buffer[Len]))
-        {
-          Buffer[Len] = 0;
-          Len--;
-        }
-
-        /* Allocate a new fortune */
-        NewFortune = (struct FortuneType *) malloc(sizeof(struct FortuneType));
+        Size = (Size == 0) ? 64 : Size * 2;
+        NewLine = (size_t *) realloc(FortuneLine, Size * sizeof(size_t));
 
-        if (NewFortune == NULL)
+        if (NewLine == NULL)
         {
+          mapfile_close(&FortuneFile);
+          nlines = 0;
           return NULL;
         }
 
-        strcpy(NewFortune->Line, Buffer);
-        NewFortune->Next = fortunes;
-        fortunes = NewFortune;
-        nlines++;
-
+        FortuneLine = NewLine;
       }
+
+      FortuneLine[nlines] = Start;
+      nlines++;
+      Start = Pos;
     }
 
     fortune_read = 1;
-
-    fclose(fp);
   }
 
-  if (fortune_read)
+  if (nlines > 0)
   {
-    if (nlines > 0)
+    /*
+     * Fortunes used to be kept in a list with the last line first, so count
+     * back from the end of the file to pick the same fortune as before for
+     * each random number.
+     */
+    Pos = FortuneLine[nlines - 1 - rund(nlines)];
+    mapfile_gets(&FortuneFile, &Pos, FortuneBuf, MAX_FORTUNE_LEN);
+
+    /* trim white space and CR/LF from the end of the line */
+    Len = strlen(FortuneBuf);
+    Len--;
+    while ((Len > 0) && isspace((int) FortuneBuf[Len]))
     {
-      Pos = rund(nlines);
-      NewFortune = fortunes;
-
-      while (Pos > 0)
-      {
-        NewFortune = NewFortune->Next;
-        Pos--;
-      }
-
-      return (NewFortune->Line);
-    }
-    else
-    {
-      return (NULL);
+      FortuneBuf[Len] = 0;
+      Len--;
     }
+
+    return (FortuneBuf);
   }
   else
   {
@@ -139,12 +134,13 @@ char *fortune(char *file)
  */
 void free_fortunes(void)
 {
-  struct FortuneType *Fortune;
-
-  while (fortunes != NULL)
+  if (fortune_read)
   {
-    Fortune = fortunes->Next;
-    free(fortunes);
-    fortunes = Fortune;
+    mapfile_close(&FortuneFile);
   }
+
+  free(FortuneLine);
+  FortuneLine = NULL;
+  fortune_read = 0;
+  nlines = 0;
 }
@@ -29,8 +29,8 @@
  * DESCRIPTION:
  * This function returns a random fortune from the ularn fortune file.
  * If the fortune file cannot be read the NULL is returned.
- * On the first call to this function the fortune file is read and the fortunes
- * are stored in memory.
+ * On the first call to this function the fortune file is mapped into memory
+ * and the start of each fortune is found.
  *
  * PARAMETERS:
  *
@@ -38,7 +38,8 @@
  *
  * RETURN VALUE:
  *
- *   A pointer to the fortune textm or NULL if the file couldn't be read.
+ *   A pointer to the fortune text, which is valid until the next call, or
+ *   NULL if the file couldn't be read.
  */
 char *fortune(char *file);
 
@@ -63,12 +63,19 @@
 # endif
 #endif /* RANDOM */
 
+/*
+ * The game's random number generator (see ularn_game.c).
+ * The game uses its own generator rather than the C library's so that its
+ * state can be saved and restored along with the rest of the game.
+ */
+long game_rand(void);
+
 // Generate a random number between 1 and x
-#define rnd(x)  ((int)(rand() % (x)) + 1)
-#define rndl(x)  ((long)(rand() % (x)) + 1)
+#define rnd(x)  ((int)(game_rand() % (x)) + 1)
+#define rndl(x)  ((long)(game_rand() % (x)) + 1)
 // Generate a random number between 0 and x-1
-#define rund(x) ((int)(rand() % (x)))
-#define rundl(x) ((long)(rand() % (x)))
+#define rund(x) ((int)(game_rand() % (x)))
+#define rundl(x) ((long)(game_rand() % (x)))
 
 /* macros for miscellaneous data conversion */
 #ifndef min
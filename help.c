@@ -41,6 +41,8 @@
 #include "ularn_win.h"
 
 #include "player.h"
+#include "trace.h"
+#include "mapfile.h"
 
 /* =============================================================================
  * Local variables
@@ -57,9 +59,12 @@ typedef enum
 } HelpStateType;
 
 /*
- * A pointer to the help file handle.
+ * The help file, mapped the first time help is shown and kept for the life
+ * of the process, and the position of the next line to be read from it.
  */
-static FILE *help_fp;
+static MappedFileType HelpFile;
+static int HelpFileMapped = 0;
+static size_t HelpPos;
 
 /* =============================================================================
  * Local functions
@@ -106,9 +111,12 @@ static void retcont (void)
  */
 static int openhelp (void)
 {
-  help_fp = fopen(helpfile, "r");
+  if (!HelpFileMapped)
+  {
+    HelpFileMapped = mapfile_open(helpfile, &HelpFile);
+  }
 
-  if (help_fp == NULL)
+  if (!HelpFileMapped || (HelpFile.Len == 0))
   {
     Printf("Can't open help file \"%s\" ", helpfile);
 
@@ -116,7 +124,9 @@ static int openhelp (void)
     return -1;
   }
 
-  return (fgetc(help_fp) - '0');
+  HelpPos = 1;
+
+  return (HelpFile.Data[0] - '0');
 }
 
 /* =============================================================================
@@ -141,11 +151,14 @@ static void show_help_page(void)
   int line_pos;
   char tmbuf[128];
 
+  /* show the page in one update rather than a character at a time */
+  set_display_hold(1);
+
   ClearText();
 
   for (line = 0; line < 23 ; line++)
   {
-    fgets(tmbuf, 128, help_fp);
+    mapfile_gets(&HelpFile, &HelpPos, tmbuf, 128);
 
     line_len = strlen(tmbuf);
 
@@ -207,6 +220,7 @@ static void show_help_page(void)
     }
   }
 
+  set_display_hold(0);
 }
 
 /* =============================================================================
@@ -237,7 +251,7 @@ void help (void)
   /* skip over intro message */
   for (i = 0; i < 23 ; i++)
   {
-    fgets(tmbuf, 128, help_fp);
+    mapfile_gets(&HelpFile, &HelpPos, tmbuf, 128);
   }
 
   for (page = num_pages ; page > 0 ; page--)
@@ -257,7 +271,6 @@ void help (void)
 
       if ((i == '\015') || (i == ESC))
       {
-        fclose(help_fp);
         set_display(DISPLAY_MAP);
 
         return;
@@ -265,7 +278,6 @@ void help (void)
     }
   }
 
-  fclose(help_fp);
   retcont();
 
   set_display(DISPLAY_MAP);
@@ -287,7 +299,8 @@ void welcome (void)
 
   show_help_page();
 
-  fclose(help_fp);
+  /* the welcome page is the first screen of a new game */
+  trace_phase_done();
 
   /* press return to continue */
   retcont();
@@ -12,6 +12,7 @@
  * objnamelist : The character to display on the map for each object
  * objtilelist : The gfx tile to display on the map for each object
  * objectname  : The text name for each object.
+ * objprop     : The weight, armour class and weapon class of each object.
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -26,7 +27,7 @@
 /*
  * Character code for each item
  */
-char objnamelist[OCOUNT] =
+const char objnamelist[OCOUNT] =
 {
   ' ', ' ',
   /* Dungeon features */
@@ -62,7 +63,7 @@ char objnamelist[OCOUNT] =
   ':', ':', ':', ':', ':'
 };
 
-int objtilelist[OCOUNT] =
+const int objtilelist[OCOUNT] =
 {
   175, 191,
   /* Dungeon features */
@@ -101,7 +102,7 @@ int objtilelist[OCOUNT] =
 /*
  * Description for each item
  */
-char *objectname[OCOUNT] =
+char *const objectname[OCOUNT] =
 {
 "",
 "",
@@ -218,3 +219,51 @@ char *objectname[OCOUNT] =
 "some cocaine",
 };
 
+/*
+ * Properties for each item: Weight, AC, WC
+ */
+const ObjPropType objprop[OCOUNT] =
+{
+  {  1,  0,  0 }, {  0,  0,  0 },
+  /* Dungeon features */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 },
+  /* gold piles */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* eye of larn */
+  {  1,  0,  0 },
+  /* armour */
+  { 35,  9,  0 }, { 23,  6,  0 }, {  8,  2,  0 }, { 20,  5,  0 },
+  { 15,  3,  0 }, { 26,  7,  0 }, { 40, 10,  0 }, { 40, 12,  0 },
+  {  7,  2,  8 }, { 15, 15,  0 },
+  /* weapons */
+  { 15,  0, 30 }, { 30,  0, 35 }, { 20,  0, 32 }, { 23,  0, 26 },
+  {  8,  0, 10 }, {  1,  0,  3 }, { 23,  0, 17 }, { 20,  0, 22 },
+  { 20,  0, 14 }, { 15,  0, 20 }, {  1,  0, 22 }, { 15,  0, 30 },
+  /* rings */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* magic items */
+  {  4,  0,  7 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  { 30,  0,  0 }, {  4,  0,  0 }, {  1,  0,  0 }, {  4,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, { 20,  0, 10 },
+  {  1,  0,  0 },
+  /* gems */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* buildings/entrances */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* traps */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* misc */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  /* drugs */
+  {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 }, {  1,  0,  0 },
+  {  1,  0,  0 }
+};
@@ -12,6 +12,7 @@
  * objnamelist : The character to display on the map for each object
  * objtilelist : The gfx tile to display on the map for each object
  * objectname  : The text name for each object.
+ * objprop     : The weight, armour class and weapon class of each object.
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -160,10 +161,25 @@ typedef enum
 #define ENCH_SCROLL  0  /* Enchantment from reading a scroll */
 #define ENCH_ALTAR   1  /* Enchantment from an altar         */
 
-extern char objnamelist[OCOUNT];
+extern const char objnamelist[OCOUNT];
 
-extern int objtilelist[OCOUNT];
+extern const int objtilelist[OCOUNT];
 
-extern char *objectname[OCOUNT];
+extern char *const objectname[OCOUNT];
+
+/*
+ * Object properties.
+ * AC is the base armour class when worn and WC is the base weapon class when
+ * wielded. Enchantment (the item arg) is added to these. Objects that cannot
+ * be worn or wielded usefully have 0.
+ */
+typedef struct
+{
+  short Weight;  /* Weight when carried in the pack */
+  short AC;      /* Base armour class when worn */
+  short WC;      /* Base weapon class when wielded */
+} ObjPropType;
+
+extern const ObjPropType objprop[OCOUNT];
 
 #endif
@@ -0,0 +1,540 @@
+/* =============================================================================
+ * PROGRAM:  ularn-levelbench
+ * FILENAME: levelbench.c
+ *
+ * DESCRIPTION:
+ * Level generation benchmark and validation harness.
+ *
+ * For each seed, a new player is made and every dungeon level from the home
+ * level to the bottom of the volcano is generated in turn, exactly as when
+ * the player first enters it. The time taken by newcavelevel is recorded
+ * for each depth, along with the random placement statistics.
+ *
+ * Each level is then checked:
+ *   - the stairs, shafts and elevators the level should have are present
+ *   - all of them can be reached on foot from where the player arrives
+ *   - no monster is placed inside a wall
+ * The seed and map of each failing level are written to the failure file in
+ * the same text format as the diag map dump, so the level can be reproduced
+ * by generating the same seed.
+ *
+ * Usage: ularn-levelbench [-n seeds] [-s first_seed] [-l libdir] [-o file]
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * main - The benchmark entry point
+ *
+ * =============================================================================
+ */
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "header.h"
+#include "ularn_game.h"
+#include "getopt.h"
+#include "diag.h"
+#include "dungeon.h"
+#include "monster.h"
+#include "player.h"
+#include "itm.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * Generation times are kept as a histogram with 1 microsecond buckets so
+ * that percentiles can be found without keeping every sample.
+ * Times of HIST_BUCKETS microseconds or more go in the last bucket.
+ */
+#define HIST_BUCKETS 10000
+
+struct DepthStatsType
+{
+  long Levels;          /* The number of levels generated */
+  double TotalTime;     /* The total generation time in microseconds */
+  double MaxTime;       /* The longest generation time in microseconds */
+  long Retries;         /* The total placement retries */
+  long Failures;        /* The total placement failures */
+  long Invalid;         /* The number of levels that failed validation */
+  unsigned int Hist[HIST_BUCKETS];
+};
+
+static struct DepthStatsType DepthStats[NLEVELS];
+
+/* The file failing levels are written to */
+static FILE *FailFile;
+
+/* Scratch space for the reachability search */
+static char Reached[MAXX][MAXY];
+static short Queue[MAXX * MAXY];
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: now_us
+ *
+ * DESCRIPTION:
+ * Get a monotonic time.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The time in microseconds.
+ */
+static double now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+}
+
+/* =============================================================================
+ * FUNCTION: is_exit
+ *
+ * DESCRIPTION:
+ * Check if an item is a way off the level.
+ *
+ * PARAMETERS:
+ *
+ *   it : The item
+ *
+ * RETURN VALUE:
+ *
+ *   Non-zero if the item is stairs, a volcanic shaft, an elevator or the
+ *   dungeon entrance.
+ */
+static int is_exit(int it)
+{
+  return (it == OSTAIRSUP) || (it == OSTAIRSDOWN) ||
+         (it == OVOLUP) || (it == OVOLDOWN) ||
+         (it == OELEVATORUP) || (it == OELEVATORDOWN) ||
+         (it == OENTRANCE);
+}
+
+/* =============================================================================
+ * FUNCTION: count_item
+ *
+ * DESCRIPTION:
+ * Count the number of a given item on the current level.
+ *
+ * PARAMETERS:
+ *
+ *   it : The item to count
+ *
+ * RETURN VALUE:
+ *
+ *   The number of the item found.
+ */
+static int count_item(int it)
+{
+  int x, y;
+  int Count;
+
+  Count = 0;
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      if (item[x][y] == it) Count++;
+    }
+  }
+
+  return Count;
+}
+
+/* =============================================================================
+ * FUNCTION: mark_reachable
+ *
+ * DESCRIPTION:
+ * Mark the cells the player can walk to from their current location.
+ * Closed doors are treated as passable as they may be opened.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void mark_reachable(void)
+{
+  int Head, Tail;
+  int x, y;
+  int nx, ny;
+  int dir;
+
+  memset(Reached, 0, sizeof(Reached));
+
+  Head = 0;
+  Tail = 0;
+  Reached[(int) playerx][(int) playery] = 1;
+  Queue[Tail++] = (short) (playerx * MAXY + playery);
+
+  while (Head < Tail)
+  {
+    x = Queue[Head] / MAXY;
+    y = Queue[Head] % MAXY;
+    Head++;
+
+    for (dir = 1 ; dir <= 8 ; dir++)
+    {
+      nx = x + diroffx[dir];
+      ny = y + diroffy[dir];
+
+      if ((nx < 0) || (nx >= MAXX) || (ny < 0) || (ny >= MAXY)) continue;
+      if (Reached[nx][ny] || (item[nx][ny] == OWALL)) continue;
+
+      Reached[nx][ny] = 1;
+      Queue[Tail++] = (short) (nx * MAXY + ny);
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: validate_level
+ *
+ * DESCRIPTION:
+ * Check the current level is playable.
+ *
+ * PARAMETERS:
+ *
+ *   Reason : Set to a description of the first problem found.
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the level is valid, 0 otherwise.
+ */
+static int validate_level(char *Reason)
+{
+  int x, y;
+
+  /* The fixed ways off each level, as placed by makeobject */
+  if ((level == 0) &&
+      ((count_item(OENTRANCE) != 1) || (count_item(OVOLDOWN) != 1)))
+  {
+    strcpy(Reason, "missing dungeon entrance or volcanic shaft");
+    return 0;
+  }
+
+  if ((level == DBOTTOM + 1) && (count_item(OVOLUP) != 1))
+  {
+    strcpy(Reason, "missing volcanic shaft up");
+    return 0;
+  }
+
+  if ((level > 0) && (level != DBOTTOM) && (level < VBOTTOM - 2) &&
+      (count_item(OSTAIRSDOWN) != 1))
+  {
+    strcpy(Reason, "missing stairs down");
+    return 0;
+  }
+
+  if ((level > 1) && (level != DBOTTOM) && (count_item(OSTAIRSUP) != 1))
+  {
+    strcpy(Reason, "missing stairs up");
+    return 0;
+  }
+
+  mark_reachable();
+
+  for (x = 0 ; x < MAXX ; x++)
+  {
+    for (y = 0 ; y < MAXY ; y++)
+    {
+      if ((mitem[x][y].mon != MONST_NONE) && (item[x][y] == OWALL))
+      {
+        sprintf(Reason, "%s embedded in wall at %d,%d",
+                monster[(int) mitem[x][y].mon].name, x, y);
+        return 0;
+      }
+
+      if (is_exit(item[x][y]) && !Reached[x][y])
+      {
+        sprintf(Reason, "%s at %d,%d not reachable from %d,%d",
+                objectname[(int) item[x][y]], x, y, playerx, playery);
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: percentile
+ *
+ * DESCRIPTION:
+ * Find a percentile of the generation time for a depth.
+ *
+ * PARAMETERS:
+ *
+ *   Stats : The statistics for the depth
+ *
+ *   Pct   : The percentile required
+ *
+ * RETURN VALUE:
+ *
+ *   The generation time in microseconds at the percentile.
+ */
+static int percentile(struct DepthStatsType *Stats, double Pct)
+{
+  long Target;
+  long Count;
+  int i;
+
+  Target = (long) ((double) Stats->Levels * Pct / 100.0 + 0.5);
+  if (Target < 1) Target = 1;
+
+  Count = 0;
+  for (i = 0 ; i < HIST_BUCKETS ; i++)
+  {
+    Count += Stats->Hist[i];
+    if (Count >= Target) break;
+  }
+
+  return (i < HIST_BUCKETS) ? i : HIST_BUCKETS - 1;
+}
+
+/* =============================================================================
+ * FUNCTION: generate_seed
+ *
+ * DESCRIPTION:
+ * Generate and check every level for a seed.
+ *
+ * PARAMETERS:
+ *
+ *   Seed : The game seed
+ *
+ * RETURN VALUE:
+ *
+ *   The number of levels that failed validation.
+ */
+static int generate_seed(unsigned long Seed)
+{
+  struct DepthStatsType *Stats;
+  char Reason[128];
+  double Start, Time;
+  long Retries, Failures;
+  int Bad;
+  int lev;
+
+  initialtime = (time_t) Seed;
+  game_srand((unsigned long) Seed);
+
+  for (lev = 0 ; lev < NLEVELS ; lev++)
+  {
+    beenhere[lev] = 0;
+  }
+  level = 0;
+
+  makeplayer();
+
+  Bad = 0;
+  for (lev = 0 ; lev <= VBOTTOM ; lev++)
+  {
+    Stats = &DepthStats[lev];
+
+    Retries = placement_retries;
+    Failures = placement_failures;
+
+    Start = now_us();
+    newcavelevel(lev);
+    Time = now_us() - Start;
+
+    Stats->Levels++;
+    Stats->TotalTime += Time;
+    if (Time > Stats->MaxTime) Stats->MaxTime = Time;
+    Stats->Hist[(Time < HIST_BUCKETS) ? (int) Time : HIST_BUCKETS - 1]++;
+    Stats->Retries += placement_retries - Retries;
+    Stats->Failures += placement_failures - Failures;
+
+    if (!validate_level(Reason))
+    {
+      Stats->Invalid++;
+      Bad++;
+
+      if (FailFile != NULL)
+      {
+        fprintf(FailFile, "\n-------------------------------------------------------------------\n");
+        fprintf(FailFile, "Seed %lu    Map %s    level %d    %s\n",
+                Seed, levelname[level], level, Reason);
+        fprintf(FailFile, "-------------------------------------------------------------------\n");
+        diagdrawscreen(FailFile);
+      }
+    }
+  }
+
+  return Bad;
+}
+
+/* =============================================================================
+ * FUNCTION: report
+ *
+ * DESCRIPTION:
+ * Print the benchmark results.
+ *
+ * PARAMETERS:
+ *
+ *   Seeds   : The number of seeds generated
+ *
+ *   Elapsed : The total elapsed time in seconds
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void report(long Seeds, double Elapsed)
+{
+  struct DepthStatsType *Stats;
+  struct rusage Usage;
+  long Levels, Invalid;
+  int lev;
+
+  printf("%ld seeds in %.2f s\n\n", Seeds, Elapsed);
+  printf("Level    Levels   Mean(us)   p99(us)   Max(us)  Retries/lvl  Failures  Invalid\n");
+  printf("-----  --------  ---------  --------  --------  -----------  --------  -------\n");
+
+  Levels = 0;
+  Invalid = 0;
+  for (lev = 0 ; lev <= VBOTTOM ; lev++)
+  {
+    Stats = &DepthStats[lev];
+    if (Stats->Levels == 0) continue;
+
+    printf("%5s  %8ld  %9.1f  %7d%s  %8.0f  %11.3f  %8ld  %7ld\n",
+      levelname[lev],
+      Stats->Levels,
+      Stats->TotalTime / (double) Stats->Levels,
+      percentile(Stats, 99.0),
+      (percentile(Stats, 99.0) == HIST_BUCKETS - 1) ? "+" : " ",
+      Stats->MaxTime,
+      (double) Stats->Retries / (double) Stats->Levels,
+      Stats->Failures,
+      Stats->Invalid);
+
+    Levels += Stats->Levels;
+    Invalid += Stats->Invalid;
+  }
+
+  printf("\n%ld levels, %ld invalid", Levels, Invalid);
+  if (Elapsed > 0.0)
+  {
+    printf(", %.0f levels/s", (double) Levels / Elapsed);
+  }
+  printf("\n");
+
+  if (getrusage(RUSAGE_SELF, &Usage) == 0)
+  {
+    printf("Peak resident memory: %ld kB\n", (long) Usage.ru_maxrss);
+  }
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: main
+ */
+int main(int argc, char *argv[])
+{
+  unsigned long FirstSeed;
+  long Seeds;
+  long i;
+  char *FailName;
+  double Start;
+  int Bad;
+  int opt;
+
+  Seeds = 1000;
+  FirstSeed = 1;
+  FailName = "levelbench.fail";
+
+  while ((opt = ugetopt(argc, argv, "n:s:l:o:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        Seeds = atol(optarg);
+        break;
+      case 's':
+        FirstSeed = strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        strncpy(libdir, optarg, MAXPATHLEN - 1);
+        break;
+      case 'o':
+        FailName = optarg;
+        break;
+      default:
+        fprintf(stderr,
+          "Usage: %s [-n seeds] [-s first_seed] [-l libdir] [-o file]\n",
+          argv[0]);
+        return 2;
+    }
+  }
+
+  if (strlen(libdir) > MAXPATHLEN - 16)
+  {
+    fprintf(stderr, "Library directory name too long: %s\n", libdir);
+    return 2;
+  }
+
+  sprintf(larnlevels, "%.*s/%s", MAXPATHLEN - 16, libdir, LEVELSNAME);
+  if (access(larnlevels, 0) == -1)
+  {
+    fprintf(stderr, "Warning: %s not found, only random mazes will be made\n",
+            larnlevels);
+  }
+
+  FailFile = fopen(FailName, "w");
+  if (FailFile == NULL)
+  {
+    perror(FailName);
+  }
+
+  /* No delays or display during generation */
+  nonap = 1;
+  char_picked = 'a';
+
+  init_cells();
+
+  Bad = 0;
+  Start = now_us();
+  for (i = 0 ; i < Seeds ; i++)
+  {
+    Bad += generate_seed(FirstSeed + (unsigned long) i);
+  }
+
+  report(Seeds, (now_us() - Start) / 1000000.0);
+
+  if (FailFile != NULL)
+  {
+    fclose(FailFile);
+    if (Bad > 0)
+    {
+      printf("Failing levels written to %s\n", FailName);
+    }
+  }
+
+  free_cells();
+
+  return (Bad > 0) ? 1 : 0;
+}
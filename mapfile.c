@@ -0,0 +1,160 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: mapfile.c
+ *
+ * DESCRIPTION:
+ * Read only data file module.
+ * This module maps the game's read only data files into memory, shared
+ * between processes where the operating system allows it.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * mapfile_open  : Map a data file into memory
+ * mapfile_gets  : Read the next line of a mapped file
+ * mapfile_close : Unmap a data file
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mapfile.h"
+
+#ifdef UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: mapfile_open
+ */
+int mapfile_open(char *FileName, MappedFileType *File)
+{
+#ifdef UNIX
+  struct stat Info;
+  void *Map;
+  int fd;
+
+  File->Data = NULL;
+  File->Len = 0;
+  File->Mapped = 0;
+
+  fd = open(FileName, O_RDONLY);
+  if (fd < 0) return 0;
+
+  if (fstat(fd, &Info) != 0)
+  {
+    close(fd);
+    return 0;
+  }
+
+  // An empty file cannot be mapped, but is still a valid file.
+  if (Info.st_size == 0)
+  {
+    close(fd);
+    File->Data = "";
+    return 1;
+  }
+
+  Map = mmap(NULL, (size_t) Info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (Map == MAP_FAILED) return 0;
+
+  File->Data = (const char *) Map;
+  File->Len = (size_t) Info.st_size;
+  File->Mapped = 1;
+
+  return 1;
+#else
+  FILE *fp;
+  char *Data;
+  long Len;
+
+  File->Data = NULL;
+  File->Len = 0;
+  File->Mapped = 0;
+
+  fp = fopen(FileName, "rb");
+  if (fp == NULL) return 0;
+
+  fseek(fp, 0, SEEK_END);
+  Len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  Data = (char *) malloc((Len > 0) ? Len : 1);
+  if ((Data == NULL) || (fread(Data, 1, Len, fp) != (size_t) Len))
+  {
+    free(Data);
+    fclose(fp);
+    return 0;
+  }
+
+  fclose(fp);
+
+  File->Data = Data;
+  File->Len = (size_t) Len;
+
+  return 1;
+#endif
+}
+
+/* =============================================================================
+ * FUNCTION: mapfile_gets
+ */
+char *mapfile_gets(MappedFileType *File, size_t *Pos, char *Buf, int Size)
+{
+  const char *Start;
+  const char *End;
+  size_t Len;
+
+  if ((File->Data == NULL) || (*Pos >= File->Len) || (Size < 2)) return NULL;
+
+  Start = File->Data + *Pos;
+  Len = File->Len - *Pos;
+  if (Len > (size_t) (Size - 1)) Len = (size_t) (Size - 1);
+
+  End = (const char *) memchr(Start, '\n', Len);
+  if (End != NULL) Len = (size_t) (End - Start) + 1;
+
+  memcpy(Buf, Start, Len);
+  Buf[Len] = 0;
+  *Pos += Len;
+
+  return Buf;
+}
+
+/* =============================================================================
+ * FUNCTION: mapfile_close
+ */
+void mapfile_close(MappedFileType *File)
+{
+#ifdef UNIX
+  if (File->Mapped)
+  {
+    munmap((void *) File->Data, File->Len);
+  }
+#else
+  free((void *) File->Data);
+#endif
+
+  File->Data = NULL;
+  File->Len = 0;
+  File->Mapped = 0;
+}
@@ -0,0 +1,103 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: mapfile.h
+ *
+ * DESCRIPTION:
+ * Read only data file module.
+ * This module maps the game's read only data files (the maps, help and
+ * fortunes) into memory. On UNIX the files are mapped shared, so every ularn
+ * process on the machine uses the same pages of the page cache for them
+ * rather than reading them into its own heap. Other systems read the file
+ * into memory.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * mapfile_open  : Map a data file into memory
+ * mapfile_gets  : Read the next line of a mapped file
+ * mapfile_close : Unmap a data file
+ *
+ * =============================================================================
+ */
+
+#ifndef __MAPFILE_H
+#define __MAPFILE_H
+
+#include <stddef.h>
+
+/*
+ * A mapped data file.
+ */
+typedef struct
+{
+  const char *Data;  /* The file contents, or NULL if the file is not open */
+  size_t Len;        /* The length of the file                             */
+  int Mapped;        /* Set if Data is a mapping rather than heap memory   */
+} MappedFileType;
+
+/* =============================================================================
+ * FUNCTION: mapfile_open
+ *
+ * DESCRIPTION:
+ * Map a data file into memory read only. The contents are not terminated,
+ * so they must be accessed using the length.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the file
+ *
+ *   File     : The mapped file to fill in
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the file could not be opened.
+ */
+int mapfile_open(char *FileName, MappedFileType *File);
+
+/* =============================================================================
+ * FUNCTION: mapfile_gets
+ *
+ * DESCRIPTION:
+ * Copy the next line of a mapped file to a buffer, in the same way as fgets.
+ * The line is copied up to and including the newline, or until the buffer
+ * is full, and the copy is 0 terminated.
+ *
+ * PARAMETERS:
+ *
+ *   File : The mapped file
+ *
+ *   Pos  : The position in the file to read from. This is updated to the
+ *          position of the next character to be read.
+ *
+ *   Buf  : The buffer to copy the line to
+ *
+ *   Size : The size of the buffer
+ *
+ * RETURN VALUE:
+ *
+ *   Buf, or NULL if the end of the file has been reached.
+ */
+char *mapfile_gets(MappedFileType *File, size_t *Pos, char *Buf, int Size);
+
+/* =============================================================================
+ * FUNCTION: mapfile_close
+ *
+ * DESCRIPTION:
+ * Unmap a data file. Nothing may use its contents afterwards.
+ *
+ * PARAMETERS:
+ *
+ *   File : The mapped file
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void mapfile_close(MappedFileType *File);
+
+#endif
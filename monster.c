@@ -53,6 +53,7 @@
 #include "dungeon.h"
 #include "sphere.h"
 #include "show.h"
+#include "trace.h"
 
 /* =============================================================================
  * Exported variables
@@ -73,7 +74,7 @@ char monstnamelist[MONST_COUNT] =
 /*
  * Tile numbers to use for monsters
  */
-int monsttilelist[MONST_COUNT] =
+const int monsttilelist[MONST_COUNT] =
 {  0,
    0,  1,  2,  3,  4,  5,  6,  7,
    8,  9, 10, 11, 12, 13, 14, 15,
@@ -91,7 +92,7 @@ int monsttilelist[MONST_COUNT] =
  *
  *  array to do rnd() to create monsters <= a given level
  */
-char monstlevel[] = {5, 11, 17, 22, 27, 33, 39, 42, 46, 50, 53, 56};
+const char monstlevel[] = {5, 11, 17, 22, 27, 33, 39, 42, 46, 50, 53, 56};
 
 struct monst monster[MONST_COUNT] = {
 
@@ -198,7 +199,7 @@ static int movedx, movedy;
  */
 #define ARMORTYPES 6
 
-static short rustarm[ARMORTYPES][2] = {
+static const short rustarm[ARMORTYPES][2] = {
   { OSTUDLEATHER, -2 },
   { ORING,        -4 },
   { OCHAIN,       -5 },
@@ -419,7 +420,7 @@ static char *rust_armour(void)
  *   return, 0 otherwise
  */
 
-static char spsel[] = {1, 2, 3, 5, 6, 8, 9, 11, 13, 14};
+static const char spsel[] = {1, 2, 3, 5, 6, 8, 9, 11, 13, 14};
 
 static int spattack(int x, int xx, int yy)
 {
@@ -640,7 +641,7 @@ static int spattack(int x, int xx, int yy)
 
       p = "\nThe %s has confused you.";
       need_beep = 1;
-      c[CONFUSE] += 10 + rnd(10);
+      add_effect(CONFUSE, 10 + rnd(10));
       break;
 
     case 12:
@@ -771,14 +772,14 @@ static void mmove(int sx, int sy, int dx, int dy)
     mitem[sx][sy].it[i].itemarg = 0;
   }
   mitem[dx][dy].n = mitem[sx][sy].n;
-  mitem[dx][dy].mon = mitem[sx][sy].mon;
+  set_monst(dx, dy, mitem[sx][sy].mon);
 
   /* monsters that move are obviously awake */
   stealth[dx][dy] |= STEALTH_AWAKE;
   hitp[dx][dy] = hitp[sx][sy];
 
   /* clear the monster from the old location */
-  mitem[sx][sy].mon = MONST_NONE;
+  set_monst(sx, sy, MONST_NONE);
   mitem[sx][sy].n = 0;
   hitp[sx][sy] = 0;
 
@@ -794,7 +795,7 @@ static void mmove(int sx, int sy, int dx, int dy)
      */
     if (rnd(100) <= 2)
     {
-      mitem[sx][sy].mon = LEMMING;
+      set_monst(sx, sy, LEMMING);
       hitp[sx][sy] = hitp[dx][dy];
     }
   }
@@ -819,7 +820,7 @@ static void mmove(int sx, int sy, int dx, int dy)
           mitem[dx][dy].it[n].itemarg = iarg[dx][dy];
           mitem[dx][dy].n++;
         }
-        item[dx][dy] = ONOTHING;
+        set_item(dx, dy, ONOTHING);
         iarg[dx][dy] = 0;
         break;
 
@@ -864,7 +865,7 @@ static void mmove(int sx, int sy, int dx, int dy)
       {
         /* monster annihilated */
         trap_msg = "\nThe %s%s is destroyed by the sphere of annihilation!";
-        mitem[dx][dy].mon = MONST_NONE;
+        set_monst(dx, dy, MONST_NONE);
         mitem[dx][dy].n = 0;
         hitp[dx][dy] = 0;
         monst_killed = 1;
@@ -874,7 +875,7 @@ static void mmove(int sx, int sy, int dx, int dy)
     {
       /* monster annihilated */
       trap_msg = "\nThe %s%s is destroyed by the sphere of annihilation!";
-      mitem[dx][dy].mon = MONST_NONE;
+      set_monst(dx, dy, MONST_NONE);
       mitem[dx][dy].n = 0;
       hitp[dx][dy] = 0;
       monst_killed = 1;
@@ -907,7 +908,7 @@ static void mmove(int sx, int sy, int dx, int dy)
     {
       /* non-flying monsters can fall into pits and trap doors */
       trap_msg = "\nThe %s%s fell into a pit.";
-      mitem[dx][dy].mon = MONST_NONE;
+      set_monst(dx, dy, MONST_NONE);
       hitp[dx][dy] = 0;
       monst_killed = 1;
     }
@@ -918,7 +919,7 @@ static void mmove(int sx, int sy, int dx, int dy)
     {
       /* non-flying monsters can fall into pits and trap doors */
       trap_msg = "\nThe %s%s fell through a trapdoor.";
-      mitem[dx][dy].mon = MONST_NONE;
+      set_monst(dx, dy, MONST_NONE);
       hitp[dx][dy] = 0;
       monst_killed = 1;
     }
@@ -929,7 +930,7 @@ static void mmove(int sx, int sy, int dx, int dy)
     if (monst_id < DEMONLORD)
     {
       trap_msg = "\nThe %s%s is carried away by an elevator!";
-      mitem[dx][dy].mon = MONST_NONE;
+      set_monst(dx, dy, MONST_NONE);
       hitp[dx][dy] = 0;
       monst_killed = 1;
     }
@@ -943,7 +944,7 @@ static void mmove(int sx, int sy, int dx, int dy)
     if (hitp[dx][dy] <= 0)
     {
       /* the trap killed the monster */
-      mitem[dx][dy].mon = MONST_NONE;
+      set_monst(dx, dy, MONST_NONE);
       trap_msg = "\n%s hits and kills the %s.";
       monst_killed = 1;
     }
@@ -1406,6 +1407,8 @@ static void movemt(int x, int y)
     if ((gtime & 1) == 1) return;
   }
 
+  TRACE_BEGIN(TRACE_MOVEMT);
+
   /* choose destination randomly if scared */
 
   /* Check for hand of fear */
@@ -1451,6 +1454,7 @@ static void movemt(int x, int y)
     dumb_move(x, y);
   }
 
+  TRACE_END(TRACE_MOVEMT);
 }
 
 /* =============================================================================
@@ -1487,7 +1491,7 @@ void createmonster(MonsterIdType mon)
     /* if we can create a monster here */
     if (cgood(x, y, 0, 1))
     {
-      mitem[x][y].mon = (char) mon;
+      set_monst(x, y, mon);
       hitp[x][y] = monster[mon].hitpoints;
       stealth[x][y] = 0; /* New monsters are not seen or awake */
 
@@ -1645,6 +1649,7 @@ void hitmonster(int x, int y)
       /* Destroy the item */
       iven[c[WIELD]] = ONOTHING;
       ivenarg[c[WIELD]] = 0;
+      inventory_changed(c[WIELD]);
       /* No longer wielding anything */
       c[WIELD] = -1;
       /* Didn't hit after all... */
@@ -1669,7 +1674,7 @@ void hitmonster(int x, int y)
   {
     if (hitp[x][y] < 25 && hitp[x][y] > 0)
     {
-      mitem[x][y].mon = (char) (BRONZEDRAGON + rund(9));
+      set_monst(x, y, BRONZEDRAGON + rund(9));
       show1cell(x, y);
     }
   }
@@ -1714,7 +1719,7 @@ int hitm(int x, int y, int amt, int SpellFlag)
      * Set HOLDMONST counter to 1 so the next regen will cancel the effect.
      */
 
-    c[HOLDMONST] = 1;
+    set_effect(HOLDMONST, 1);
   }
 
   /* if a dragon and orb(s) of dragon slaying  */
@@ -2010,40 +2015,31 @@ void teleportmonst (int xx, int yy, int monst)
 {
   int i;
   int x, y;
-  int trys;
 
-  /* max # of teleport attempts */
-  for (trys = 10 ; trys > 0; --trys)
-  {
-    x = rnd(MAXX-2);
-    y = rnd(MAXY-2);
-    if ((item[x][y] == ONOTHING) && (mitem[x][y].mon == MONST_NONE) &&
-        ((playerx != x) || (playery != y)))
-    {
-      mitem[x][y].mon = (char) monst;
-      mitem[xx][yy].mon = MONST_NONE;
+  /* The monster stays where it is if the level is full */
+  if (!random_empty_cell(&x, &y)) return;
 
-      hitp[x][y] = monster[monst].hitpoints;
-      hitp[xx][yy]=0;
-      for (i = 0 ; i < mitem[xx][yy].n ; i++)
-      {
-        mitem[x][y].it[i].item = mitem[xx][yy].it[i].item;
-        mitem[x][y].it[i].itemarg = mitem[xx][yy].it[i].itemarg;
-        mitem[xx][yy].it[i].item = ONOTHING;
-        mitem[xx][yy].it[i].itemarg = 0;
-      }
-      mitem[x][y].n = mitem[xx][yy].n;
-      mitem[xx][yy].n = 0;
+  set_monst(x, y, monst);
+  set_monst(xx, yy, MONST_NONE);
 
-      /* store the new location */
-      movedx = x;
-      movedy = y;
+  hitp[x][y] = monster[monst].hitpoints;
+  hitp[xx][yy]=0;
+  for (i = 0 ; i < mitem[xx][yy].n ; i++)
+  {
+    mitem[x][y].it[i].item = mitem[xx][yy].it[i].item;
+    mitem[x][y].it[i].itemarg = mitem[xx][yy].it[i].itemarg;
+    mitem[xx][yy].it[i].item = ONOTHING;
+    mitem[xx][yy].it[i].itemarg = 0;
+  }
+  mitem[x][y].n = mitem[xx][yy].n;
+  mitem[xx][yy].n = 0;
 
-      show1cell(xx, yy);
 
-      return;
-    }
-  }
+  /* store the new location */
+  movedx = x;
+  movedy = y;
+
+  show1cell(xx, yy);
 }
 
 /* =============================================================================
@@ -2059,11 +2055,17 @@ void movemonst(void)
   /* Check for haste self */
   if (c[HASTESELF]) if ((c[HASTESELF]&1)==0) return;
 
+  TRACE_BEGIN(TRACE_MOVEMONST);
+
   /* move the spheres of annihilation if any */
   movsphere();
 
   /* no action if monsters are held */
-  if (c[HOLDMONST]) return;
+  if (c[HOLDMONST])
+  {
+    TRACE_END(TRACE_MOVEMONST);
+    return;
+  }
 
   if (c[AGGRAVATE])
   {
@@ -2163,6 +2165,7 @@ void movemonst(void)
     }
   }
 
+  TRACE_END(TRACE_MOVEMONST);
 }
 
 /* =============================================================================
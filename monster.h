@@ -157,7 +157,7 @@ extern char monstnamelist[MONST_COUNT];
 /*
  * Tile numbers to use for monsters
  */
-extern int monsttilelist[MONST_COUNT];
+extern const int monsttilelist[MONST_COUNT];
 
 /*
  * The monster data
@@ -321,7 +321,7 @@ void ogold(int arg)
   UpdateStatus();
 
   /* destroy gold */
-  item[playerx][playery] = ONOTHING;
+  set_item(playerx, playery, ONOTHING);
 }
 
 /* =============================================================================
@@ -356,7 +356,7 @@ void ochest(void)
       Print(" take");
       if (take(OCHEST,iarg[playerx][playery])==0)
       {
-        item[playerx][playery] = ONOTHING;
+        set_item(playerx, playery, ONOTHING);
       }
       break;
 
@@ -468,26 +468,26 @@ void oopenchest(void)
     switch (rnd(10))
     {
       case 1:
-        c[ITCHING]+= rnd(1000)+100;
+        add_effect(ITCHING, rnd(1000)+100);
         Print("\nYou feel an irritation spread over your skin!");
         UlarnBeep();
         break;
 
       case 2:
-        c[CLUMSINESS]+= rnd(1600)+200;
+        add_effect(CLUMSINESS, rnd(1600)+200);
         Print("\nYou begin to lose hand-eye co-ordination!");
         UlarnBeep();
         break;
 
       case 3:
-        c[HALFDAM]+= rnd(1600)+200;
+        add_effect(HALFDAM, rnd(1600)+200);
         Print("\nYou suddenly feel sick and BARF all over your shoes!");
         UlarnBeep();
         break;
     }
 
     /* Remove the chest */
-    item[playerx][playery] = ONOTHING;
+    set_item(playerx, playery, ONOTHING);
 
     /* create the items in the chest */
     if (rnd(100)<69)
@@ -716,7 +716,7 @@ void lookforobject(void)
 
     case OIVTELETRAP:
       if (rnd(11)<6) return;
-      item[playerx][playery] = OTELEPORTER;
+      set_item(playerx, playery, OTELEPORTER);
 
     case OTELEPORTER:
       /*
@@ -872,8 +872,8 @@ void lookforobject(void)
         playery = MAXY - 2;
 
         /* Make sure the entrance to the dungeon is clear */
-        item[33][MAXY-1] = ONOTHING;
-        mitem[33][MAXY-1].mon = MONST_NONE;
+        set_item(33, MAXY-1, ONOTHING);
+        set_monst(33, MAXY-1, MONST_NONE);
 
         draws(0,MAXX,0,MAXY);
         UpdateStatusAndEffects();
@@ -966,7 +966,7 @@ void lookforobject(void)
 
     case OTRAPARROWIV:
       if (rnd(17)<13) return; /* for an arrow trap */
-      item[playerx][playery] = OTRAPARROW;
+      set_item(playerx, playery, OTRAPARROW);
     case OTRAPARROW:
       Print("\nYou are hit by an arrow!");
       UlarnBeep(); /* for an arrow trap */
@@ -977,7 +977,7 @@ void lookforobject(void)
 
     case OIVDARTRAP:
       if (rnd(17)<13) return;   /* for a dart trap */
-      item[playerx][playery] = ODARTRAP;
+      set_item(playerx, playery, ODARTRAP);
     case ODARTRAP:
       Print("\nYou are hit by a dart!");
       UlarnBeep(); /* for a dart trap */
@@ -989,7 +989,7 @@ void lookforobject(void)
 
     case OIVTRAPDOOR:
       if (rnd(17)<13) return;   /* for a trap door */
-      item[playerx][playery] = OTRAPDOOR;
+      set_item(playerx, playery, OTRAPDOOR);
     case OTRAPDOOR:
       for (i=0;i<IVENSIZE;i++)
       {
@@ -1076,8 +1076,8 @@ void lookforobject(void)
       {
         Print("snort!");
         Print("\nOhwowmanlikethingstotallyseemtoslowdown!");
-        c[HASTESELF] += 200 + c[LEVEL];
-        c[HALFDAM] += 300 + rnd(200);
+        add_effect(HASTESELF, 200 + c[LEVEL]);
+        add_effect(HALFDAM, 300 + rnd(200));
         adjust_ability(INTELLIGENCE, -2);
         adjust_ability(WISDOM, -2);
         adjust_ability(CONSTITUTION, -2);
@@ -1107,8 +1107,8 @@ void lookforobject(void)
       {
         Print("eat!");
         Print("\nThings start to get real spacey...");
-        c[HASTEMONST] += rnd(75) + 25;
-        c[CONFUSE] += 30+rnd(10);
+        add_effect(HASTEMONST, rnd(75) + 25);
+        add_effect(CONFUSE, 30+rnd(10));
         adjust_ability(WISDOM, 2);
         adjust_ability(CHARISMA, 2);
         forget();
@@ -1135,11 +1135,11 @@ void lookforobject(void)
       {
         Print("eat!");
         Print("\nYou are now frying your ass off!");
-        c[CONFUSE] += 30 + rnd(10);
+        add_effect(CONFUSE, 30 + rnd(10));
         adjust_ability(WISDOM, 2);
         adjust_ability(INTELLIGENCE, 2);
-        c[AWARENESS] += 1500;
-        c[AGGRAVATE] += 1500;
+        add_effect(AWARENESS, 1500);
+        add_effect(AGGRAVATE, 1500);
         {
           int j, k; /* heal monsters */
           for(j = 0 ; j < MAXY ; j++)
@@ -1177,13 +1177,13 @@ void lookforobject(void)
       {
         Print("smoke!");
         Print("\nWOW! You feel stooooooned...");
-        c[HASTEMONST] += rnd(75)+25;
+        add_effect(HASTEMONST, rnd(75)+25);
         adjust_ability(INTELLIGENCE, 2);
         adjust_ability(WISDOM, 2);
         adjust_ability(CONSTITUTION, -2);
         adjust_ability(DEXTERITY, -2);
-        c[HALFDAM] += 300+rnd(200);
-        c[CLUMSINESS] += rnd(1800)+200;
+        add_effect(HALFDAM, 300+rnd(200));
+        add_effect(CLUMSINESS, rnd(1800)+200);
         forget();
         UpdateStatus();
       }
@@ -1216,7 +1216,7 @@ void lookforobject(void)
         {
           adjust_ability(i, 33);
         }
-        c[COKED] += 10;
+        add_effect(COKED, 10);
         forget();
         UpdateStatus();
       }
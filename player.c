@@ -21,6 +21,7 @@
  * lastpx            : The player's previous x coordinate
  * lastpy            : The player's previous y coordiante
  * initialtime       : The time play started
+ * level_salt        : The game's salt for the dungeon level seeds
  * gtime             : The clock for the game
  * outstanding_taxes : The taxes owed from the score file
  * c                 : The character attributes array
@@ -52,6 +53,7 @@
  * losespells      : Lose spell points
  * losemspells     : Decrease max spell points
  * positionplayer  : Position the player on a level
+ * inventory_changed : Update cached inventory stats after an inventory change
  * recalc          : Recalculate AC and WC
  * take            : Take an item
  * drop_object     : Drop an object
@@ -66,6 +68,10 @@
  * adjustcvalues   : Adjust attributes when dropping/losing an item
  * packweight      : Get the weight of the player's inventory
  * adjust_ability  : Adjust an ability score
+ * add_effect      : Add time to a time based effect
+ * set_effect      : Set the time remaining for a time based effect
+ * sync_effects    : Bring the time remaining for time based effects up to date
+ * reset_effects   : Reschedule time based effects from the attributes array
  * regen           : Regen player for passing of a turn
  * removecurse     : Remove curses inflicted upon player
  * adjusttime      : Adjust time base effects for the passage of time
@@ -108,7 +114,7 @@ static char aa7[] = "  novice guardian  ";
 static char aa8[] = "apprentice guardian";
 static char aa9[] = "    The Creator    ";
 
-char *class[]=
+char *const class[]=
 {
 "  novice explorer  ", "apprentice explorer", " practiced explorer",/*  -3*/
 "  expert explorer  ", " novice adventurer ", "     adventurer    ",/*  -6*/
@@ -151,7 +157,7 @@ char *class[]=
  * skill[c[LEVEL]] is the experience required to attain the next level
  */
 #define MEG 1000000
-long skill[] = {
+const long skill[] = {
 0, 10, 20, 40, 80, 160, 320, 640, 1280, 2560, 5120,                 /*  1-11 */
 10240, 20480, 40960, 100000, 200000, 400000, 700000, 1*MEG,         /* 12-19 */
 2*MEG,3*MEG,4*MEG,5*MEG,6*MEG,8*MEG,10*MEG,                         /* 20-26 */
@@ -176,6 +182,8 @@ char hitflag=0;   /* flag for if player has been hit when running */
 char hit2flag=0;  /* flag for if player has been hit when running */
 char hit3flag=0;  /* flag for if player has been hit flush input*/
 
+int HasteStep = 0;  /* fractions of moves taken when hasted */
+
 char char_class[20];    /* character class */
 int  class_num;         /* character class number */
 
@@ -188,6 +196,7 @@ int playerx, playery;  /* the room on the present level of the player*/
 int lastpx, lastpy;    /* 0 --- MAXX-1  or  0 --- MAXY-1   */
 
 long initialtime=0;       /* time playing began   */
+unsigned long level_salt=0; /* salt for the level seeds */
 long gtime=0;             /* the clock for the game */
 long outstanding_taxes=0; /* present tax bill from score file */
 
@@ -209,16 +218,11 @@ int spelknow[SPELL_COUNT];
 
 #define MAXPLEVEL 100   /* maximum player level allowed   */
 
-/*
- * Haste step to keep track of frations of moves when hasted
- */
-static int HasteStep = 0;
-
 /*
  * Character fields affected by the passage of time
  */
 #define TIME_CHANGED_COUNT 28
-static AttributeType time_change[TIME_CHANGED_COUNT] =
+static const AttributeType time_change[TIME_CHANGED_COUNT] =
 {
   HERO,
   ALTPRO,
@@ -254,7 +258,7 @@ static AttributeType time_change[TIME_CHANGED_COUNT] =
  * Character fields for curses
  */
 #define CURSE_COUNT 10
-static AttributeType curse[CURSE_COUNT] =
+static const AttributeType curse[CURSE_COUNT] =
 {
   BLINDCOUNT,
   CONFUSE,
@@ -268,6 +272,60 @@ static AttributeType curse[CURSE_COUNT] =
   HALFDAM
 };
 
+/*
+ * Time based effect scheduler.
+ *
+ * Rather than counting down every active effect each turn, each effect is
+ * scheduled to expire on a turn of the effect clock, and is placed in the
+ * slot of a timer wheel for that turn. Each regen only examines the effects
+ * in the slot for the current turn, so turns on which nothing expires cost
+ * nothing. Effects due more than one revolution of the wheel away are
+ * skipped until their turn comes round.
+ *
+ * While an effect is scheduled, c[] holds the time remaining as at the
+ * last time the effect was changed. sync_effects brings these up to date.
+ *
+ * EFFECT_WHEEL_SIZE must be a power of 2, and TIME_CHANGED_COUNT must not
+ * exceed the number of bits in an unsigned long.
+ */
+#define EFFECT_WHEEL_SIZE 256
+
+/* The effect clock. This only advances when time is not stopped. */
+static long EffectTurn = 0;
+
+/* The effect clock turn on which each effect expires, 0 if inactive */
+static long EffectExpiry[TIME_CHANGED_COUNT];
+
+/* The effects due in each slot of the wheel, bit n for time_change[n] */
+static unsigned long EffectWheel[EFFECT_WHEEL_SIZE];
+
+/* The index in time_change for each attribute, -1 if not time based */
+static signed char EffectIndex[ATTRIBUTE_COUNT];
+static int EffectIndexBuilt = 0;
+
+/*
+ * Cached inventory stats.
+ *
+ * The contribution of each inventory slot to the pack weight and to the
+ * ring based attributes is cached, along with the totals over the pack, so
+ * that recalc and packweight do not need to walk the inventory.
+ * inventory_changed must be called whenever iven[] or ivenarg[] changes.
+ *
+ * If CHECK_STATS is defined then the cached values are cross checked
+ * against a full recalculation each time they are used.
+ */
+struct SlotStatsType
+{
+  short Weight;
+  short AC;
+  short WC;
+  short Regen;
+  short Energy;
+};
+
+static struct SlotStatsType SlotStats[IVENSIZE];
+static struct SlotStatsType PackStats;
+
 #define MAX_CLASSES        8
 #define MAX_INITIAL_SPELLS 2
 #define MAX_INITIAL_ITEMS  3
@@ -540,6 +598,96 @@ char identify_class(char *class_str)
   }
 }
 
+/* =============================================================================
+ * FUNCTION: effect_index
+ *
+ * DESCRIPTION:
+ * Get the index of an attribute in the time based effects table.
+ *
+ * PARAMETERS:
+ *
+ *   Attr : The attribute to find
+ *
+ * RETURN VALUE:
+ *
+ *   The index in time_change, or -1 if the attribute is not time based.
+ */
+static int effect_index(AttributeType Attr)
+{
+  int i;
+
+  if (!EffectIndexBuilt)
+  {
+    for (i = 0 ; i < ATTRIBUTE_COUNT ; i++)
+    {
+      EffectIndex[i] = -1;
+    }
+
+    for (i = 0 ; i < TIME_CHANGED_COUNT ; i++)
+    {
+      EffectIndex[time_change[i]] = (signed char) i;
+    }
+
+    EffectIndexBuilt = 1;
+  }
+
+  return EffectIndex[Attr];
+}
+
+/* =============================================================================
+ * FUNCTION: unschedule_effect
+ *
+ * DESCRIPTION:
+ * Remove a time based effect from the timer wheel.
+ * c[] is brought up to date with the time remaining for the effect.
+ *
+ * PARAMETERS:
+ *
+ *   n : The index of the effect in time_change
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void unschedule_effect(int n)
+{
+  if (EffectExpiry[n] != 0)
+  {
+    EffectWheel[EffectExpiry[n] & (EFFECT_WHEEL_SIZE - 1)] &= ~(1UL << n);
+    c[time_change[n]] = EffectExpiry[n] - EffectTurn;
+    EffectExpiry[n] = 0;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: schedule_effect
+ *
+ * DESCRIPTION:
+ * Schedule the expiry of a time based effect from the time remaining in c[].
+ * The effect must not already be scheduled.
+ *
+ * PARAMETERS:
+ *
+ *   n : The index of the effect in time_change
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void schedule_effect(int n)
+{
+  AttributeType Attr = time_change[n];
+
+  if (c[Attr] <= 0)
+  {
+    c[Attr] = 0;
+    return;
+  }
+
+  EffectExpiry[n] = EffectTurn + c[Attr];
+  EffectWheel[EffectExpiry[n] & (EFFECT_WHEEL_SIZE - 1)] |= (1UL << n);
+}
+
 /* =============================================================================
  * FUNCTION: makeplayer
  */
@@ -609,9 +757,18 @@ void makeplayer (void)
   lastpx = 0;
   lastpy = 0;
 
+  /*
+   * The levels are made from seeds based on the start time, so draw a salt
+   * for them as well. Games started in the same second then only share
+   * their dungeon if they were seeded the same way.
+   */
+  level_salt = (unsigned long) game_rand();
+
   /*  time clock starts at zero */
   gtime = 0;
   cbak[SPELLS] = -50;
+  reset_effects();
+  inventory_changed(-1);
   recalc();
 }
 
@@ -778,23 +935,23 @@ void raiseexperience (long x)
     switch ((int)c[LEVEL])
     {
       case 94:  /* earth guardian */
-        c[WTW] = 99999L;
+        set_effect(WTW, 99999L);
         break;
       case 95:  /* air guardian */
-        c[INVISIBILITY] = 99999L;
+        set_effect(INVISIBILITY, 99999L);
         break;
       case 96:  /* fire guardian */
-        c[FIRERESISTANCE] = 99999L;
+        set_effect(FIRERESISTANCE, 99999L);
         break;
       case 97:  /* water guardian */
-        c[CANCELLATION] = 99999L;
+        set_effect(CANCELLATION, 99999L);
         break;
       case 98:  /* time guardian */
-        c[HASTESELF] = 99999L;
+        set_effect(HASTESELF, 99999L);
         break;
       case 99:  /* ethereal guardian */
-        c[STEALTH] = 99999L;
-        c[SPIRITPRO] = 99999L;
+        set_effect(STEALTH, 99999L);
+        set_effect(SPIRITPRO, 99999L);
         break;
       case 100:
         Print("\nYou are now The Creator!");
@@ -986,6 +1143,151 @@ void positionplayer (void)
   }
 }
 
+/* =============================================================================
+ * FUNCTION: slot_stats
+ *
+ * DESCRIPTION:
+ * Calculate the contribution of an inventory item to the pack weight and to
+ * the ring based attributes.
+ *
+ * PARAMETERS:
+ *
+ *   Item  : The item
+ *
+ *   Arg   : The item arg
+ *
+ *   Stats : Set to the contribution of the item
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void slot_stats(int Item, int Arg, struct SlotStatsType *Stats)
+{
+  Stats->AC = 0;
+  Stats->WC = 0;
+  Stats->Regen = 0;
+  Stats->Energy = 0;
+
+  switch (Item)
+  {
+    case OPROTRING:
+      Stats->AC     = (short) (Arg + 1);
+      break;
+    case ODAMRING:
+      Stats->WC     = (short) (Arg + 1);
+      break;
+    case OBELT:
+      Stats->WC     = (short) ((Arg << 1) + 2);
+      break;
+    case OREGENRING:
+      Stats->Regen  = (short) (Arg + 1);
+      break;
+    case ORINGOFEXTRA:
+      Stats->Regen  = (short) (5 * (Arg + 1));
+      break;
+    case OENERGYRING:
+      Stats->Energy = (short) (Arg + 1);
+      break;
+    default:
+      break;
+  }
+
+  Stats->Weight = objprop[Item].Weight;
+
+  /* The weight of a chest depends on its contents */
+  if (Item == OCHEST)
+  {
+    Stats->Weight = (short) (Stats->Weight + Arg);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: add_stats
+ *
+ * DESCRIPTION:
+ * Add or subtract the stats for an inventory slot from the pack totals.
+ *
+ * PARAMETERS:
+ *
+ *   Stats : The stats for the slot
+ *
+ *   Sign  : 1 to add the stats, -1 to subtract them
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void add_stats(struct SlotStatsType *Stats, int Sign)
+{
+  PackStats.Weight = (short) (PackStats.Weight + Sign * Stats->Weight);
+  PackStats.AC     = (short) (PackStats.AC + Sign * Stats->AC);
+  PackStats.WC     = (short) (PackStats.WC + Sign * Stats->WC);
+  PackStats.Regen  = (short) (PackStats.Regen + Sign * Stats->Regen);
+  PackStats.Energy = (short) (PackStats.Energy + Sign * Stats->Energy);
+}
+
+#ifdef CHECK_STATS
+/* =============================================================================
+ * FUNCTION: check_stats
+ *
+ * DESCRIPTION:
+ * Cross check the cached inventory stats against a full recalculation.
+ * Any difference means iven[] or ivenarg[] was changed without calling
+ * inventory_changed. This is reported and the cache is rebuilt.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void check_stats(void)
+{
+  struct SlotStatsType Stats;
+  int i;
+
+  for (i = 0 ; i < IVENSIZE ; i++)
+  {
+    slot_stats(iven[i], ivenarg[i], &Stats);
+    if (memcmp(&Stats, &SlotStats[i], sizeof(Stats)) != 0)
+    {
+      Printf("\nInventory stats for slot %c are out of date!", 'a' + i);
+      UlarnBeep();
+      inventory_changed(-1);
+      return;
+    }
+  }
+}
+#endif
+
+/* =============================================================================
+ * FUNCTION: inventory_changed
+ */
+void inventory_changed(int Slot)
+{
+  int i;
+
+  if (Slot < 0)
+  {
+    memset(&PackStats, 0, sizeof(PackStats));
+
+    for (i = 0 ; i < IVENSIZE ; i++)
+    {
+      slot_stats(iven[i], ivenarg[i], &SlotStats[i]);
+      add_stats(&SlotStats[i], 1);
+    }
+  }
+  else
+  {
+    add_stats(&SlotStats[Slot], -1);
+    slot_stats(iven[Slot], ivenarg[Slot], &SlotStats[Slot]);
+    add_stats(&SlotStats[Slot], 1);
+  }
+}
+
 /* =============================================================================
  * FUNCTION: recalc
  */
@@ -996,45 +1298,15 @@ void recalc (void)
   c[AC] = c[MOREDEFENSES];
   if (c[WEAR] >= 0)
   {
-    switch (iven[c[WEAR]])
+    i = iven[c[WEAR]];
+    if (objprop[i].AC > 0)
     {
-      case OSHIELD:
-        c[AC] += 2 + ivenarg[c[WEAR]];
-        break;
-      case OLEATHER:
-        c[AC] += 2 + ivenarg[c[WEAR]];
-        break;
-      case OSTUDLEATHER:
-        c[AC] += 3 + ivenarg[c[WEAR]];
-        break;
-      case ORING:
-        c[AC] += 5 + ivenarg[c[WEAR]];
-        break;
-      case OCHAIN:
-        c[AC] += 6 + ivenarg[c[WEAR]];
-        break;
-      case OSPLINT:
-        c[AC] += 7 + ivenarg[c[WEAR]];
-        break;
-      case OPLATE:
-        c[AC] += 9 + ivenarg[c[WEAR]];
-        break;
-      case OPLATEARMOR:
-        c[AC] += 10 + ivenarg[c[WEAR]];
-        break;
-      case OSSPLATE:
-        c[AC] += 12 + ivenarg[c[WEAR]];
-        break;
-      case OELVENCHAIN:
-        c[AC] += 15 + ivenarg[c[WEAR]];
-        break;
-      default:
-        break;
+      c[AC] += objprop[i].AC + ivenarg[c[WEAR]];
     }
   }
 
   if (c[SHIELD] >= 0 && iven[c[SHIELD]] == OSHIELD)
-    c[AC] += 2 + ivenarg[c[SHIELD]];
+    c[AC] += objprop[OSHIELD].AC + ivenarg[c[SHIELD]];
 
   c[LANCEDEATH] = 0;
 
@@ -1044,87 +1316,32 @@ void recalc (void)
   }
   else
   {
-    i = ivenarg[c[WIELD]];
-    switch (iven[c[WIELD]])
+    i = iven[c[WIELD]];
+    if (objprop[i].WC > 0)
     {
-      case ODAGGER:
-        c[WCLASS] =  3 + i;
-        break;
-      case OBELT:
-        c[WCLASS] =  7 + i;
-        break;
-      case OSHIELD:
-        c[WCLASS] =  8 + i;
-        break;
-      case OPSTAFF:
-      case OSPEAR:
-        c[WCLASS] = 10 + i;
-        break;
-      case OFLAIL:
-        c[WCLASS] = 14 + i;
-        break;
-      case OBATTLEAXE:
-        c[WCLASS] = 17 + i;
-        break;
-      case OLANCE:
-        c[LANCEDEATH] = 1;
-        c[WCLASS] = 20 + i;
-        break;
-      case OLONGSWORD:
-      case OVORPAL:
-        c[WCLASS] = 22 + i;
-        break;
-      case O2SWORD:
-        c[WCLASS] = 26 + i;
-        break;
-      case OSWORDofSLASHING:
-        c[WCLASS] = 30 + i;
-        break;
-      case OSLAYER:
-        c[WCLASS] = 30 + i;
-        break;
-      case OSWORD:
-        c[WCLASS] = 32 + i;
-        break;
-      case OHAMMER:
-        c[WCLASS] = 35 + i;
-        break;
-      default:
-        c[WCLASS] = 0;
+      c[WCLASS] = objprop[i].WC + ivenarg[c[WIELD]];
+    }
+    else
+    {
+      c[WCLASS] = 0;
     }
-  }
-  c[WCLASS] += c[MOREDAM];
-
-  /*  now for regeneration abilities based on rings */
-  c[REGEN]=1;
-  c[ENERGY]=0;
 
-  for (i = 0; i <= IVENSIZE ; i++)
-  {
-    switch (iven[i])
+    if (i == OLANCE)
     {
-      case OPROTRING:
-        c[AC]     += ivenarg[i] + 1;
-        break;
-      case ODAMRING:
-        c[WCLASS] += ivenarg[i] + 1;
-        break;
-      case OBELT:
-        c[WCLASS] += ((ivenarg[i]<<1)) + 2;
-        break;
-      case OREGENRING:
-        c[REGEN]  += ivenarg[i] + 1;
-        break;
-      case ORINGOFEXTRA:
-        c[REGEN]  += 5 * (ivenarg[i]+1);
-        break;
-      case OENERGYRING:
-        c[ENERGY] += ivenarg[i] + 1;
-        break;
-      default:
-        break;
+      c[LANCEDEATH] = 1;
     }
   }
+  c[WCLASS] += c[MOREDAM];
+
+#ifdef CHECK_STATS
+  check_stats();
+#endif
+
+  /*  now for regeneration abilities based on rings */
+  c[AC]     += PackStats.AC;
+  c[WCLASS] += PackStats.WC;
+  c[REGEN]   = 1 + PackStats.Regen;
+  c[ENERGY]  = PackStats.Energy;
 }
 
 /* =============================================================================
@@ -1167,6 +1384,7 @@ int take (int itm, int arg)
     need_recalc = 0;
     iven[slot] = (char) itm;
     ivenarg[slot] = (short) arg;
+    inventory_changed(slot);
     switch (itm)
     {
       case OPROTRING:
@@ -1195,7 +1413,7 @@ int take (int itm, int arg)
         break;
       case OORB:
         c[ORB]++;
-        c[AWARENESS]++;
+        add_effect(AWARENESS, 1);
         break;
       case OORBOFDRAGON:
         c[SLAYING]++;
@@ -1285,7 +1503,7 @@ int drop_object (int k)
 
   if (!pitflag)
   {
-    item[playerx][playery] = (char) itm;
+    set_item(playerx, playery, itm);
     iarg[playerx][playery] = (short) ivenarg[k];
   }
 
@@ -1295,6 +1513,7 @@ int drop_object (int k)
 
   /* Update the player's inventory and status */
   iven[k] = ONOTHING;
+  inventory_changed(k);
 
   if (c[WIELD]==k) c[WIELD]= -1;
   if (c[WEAR]==k) c[WEAR] = -1;
@@ -1320,6 +1539,7 @@ int drop_object (int k)
 void adjustivenarg(int Idx, int Amount)
 {
   ivenarg[Idx] += (short) Amount;
+  inventory_changed(Idx);
 
   switch (iven[Idx])
   {
@@ -1451,6 +1671,7 @@ void enchantarmor (int how)
       /* Destroy the armour */
       iven[c[which]] = ONOTHING;
       ivenarg[c[which]] = 0;
+      inventory_changed(c[which]);
       c[which] = -1;
 
       /* Recalculate player's AC */
@@ -1503,6 +1724,7 @@ void enchweapon (int how)
         /* destroy the weapon */
         iven[Idx] = ONOTHING;
         ivenarg[Idx] = 0;
+        inventory_changed(Idx);
         c[WIELD] = -1;
 
         /* Recalculate the player's WC */
@@ -1596,6 +1818,7 @@ int stealsomething (int x, int y)
 
         iven[i]=ONOTHING;
         ivenarg[i]=0;
+        inventory_changed(i);
         beenhere[level]++;
 
         return(1);
@@ -1685,7 +1908,7 @@ void adjustcvalues (int itm, int arg)
       break;
     case OORB:
       c[ORB]--;
-      c[AWARENESS]--;
+      add_effect(AWARENESS, -1);
       break;
     case OSWORDofSLASHING:
       c[DEXTERITY] -= 5;
@@ -1754,70 +1977,11 @@ void adjustcvalues (int itm, int arg)
  */
 int packweight (void)
 {
-  int i,j,k;
-
-  k=c[GOLD]/1000;
-  j=25;
-  while ((iven[j]==ONOTHING) && (j>0)) --j;
-
-  for (i=0; i<=j; i++)
-  {
-    switch (iven[i])
-    {
-      case ONOTHING: break;
-      case OSSPLATE:
-      case OPLATEARMOR:
-        k += 40;
-        break;
-      case OPLATE:
-        k += 35;
-        break;
-      case OHAMMER:
-        k += 30;
-        break;
-      case OSPLINT:
-        k += 26;
-        break;
-      case OCHAIN:
-      case OBATTLEAXE:
-      case O2SWORD:
-        k += 23;
-        break;
-      case OLONGSWORD:
-      case OPSTAFF:
-      case OSWORD:
-      case ORING:
-      case OFLAIL:
-        k += 20;
-        break;
-      case OELVENCHAIN:
-      case OSWORDofSLASHING:
-      case OLANCE:
-      case OSLAYER:
-      case OSTUDLEATHER:
-        k += 15;
-        break;
-      case OLEATHER:
-      case OSPEAR:
-        k += 8;
-        break;
-      case OORBOFDRAGON:
-      case OORB:
-      case OBELT:
-        k += 4;
-        break;
-      case OSHIELD:
-        k += 7;
-        break;
-      case OCHEST:
-        k += 30 + ivenarg[i];
-        break;
-      default:
-        k++;
-    }
-  }
+#ifdef CHECK_STATS
+  check_stats();
+#endif
 
-  return(k);
+  return (int) (c[GOLD]/1000) + PackStats.Weight;
 }
 
 /* =============================================================================
@@ -1838,6 +2002,79 @@ void adjust_ability(AttributeType ability, int amount)
   }
 }
 
+/* =============================================================================
+ * FUNCTION: add_effect
+ */
+void add_effect(AttributeType Attr, long Time)
+{
+  int n;
+
+  n = effect_index(Attr);
+  if (n < 0)
+  {
+    c[Attr] += Time;
+    return;
+  }
+
+  unschedule_effect(n);
+  c[Attr] += Time;
+  schedule_effect(n);
+}
+
+/* =============================================================================
+ * FUNCTION: set_effect
+ */
+void set_effect(AttributeType Attr, long Time)
+{
+  int n;
+
+  n = effect_index(Attr);
+  if (n < 0)
+  {
+    c[Attr] = Time;
+    return;
+  }
+
+  unschedule_effect(n);
+  c[Attr] = Time;
+  schedule_effect(n);
+}
+
+/* =============================================================================
+ * FUNCTION: sync_effects
+ */
+void sync_effects(void)
+{
+  int n;
+
+  for (n = 0 ; n < TIME_CHANGED_COUNT ; n++)
+  {
+    if (EffectExpiry[n] != 0)
+    {
+      c[time_change[n]] = EffectExpiry[n] - EffectTurn;
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: reset_effects
+ */
+void reset_effects(void)
+{
+  int n;
+
+  for (n = 0 ; n < EFFECT_WHEEL_SIZE ; n++)
+  {
+    EffectWheel[n] = 0;
+  }
+
+  for (n = 0 ; n < TIME_CHANGED_COUNT ; n++)
+  {
+    EffectExpiry[n] = 0;
+    schedule_effect(n);
+  }
+}
+
 /* =============================================================================
  * FUNCTION: regen
  */
@@ -1845,6 +2082,7 @@ void regen(void)
 {
   int i, j;
   AttributeType Attr;
+  unsigned long Due;
   int flag; // indicates whether effect and/or status need update.
             //   1 = Status, 2 = effects, 3 = both
 
@@ -1908,141 +2146,149 @@ void regen(void)
     }
   }
 
-  for (j = 0; j < TIME_CHANGED_COUNT ; j++)
+  EffectTurn++;
+
+  /* AWARENESS doesn't wear off if the player has the orb */
+  if (c[ORB] != 0)
   {
-    Attr = time_change[j];
-    if (c[Attr] != 0)
+    j = effect_index(AWARENESS);
+    if (EffectExpiry[j] != 0)
     {
-      /* Reduce time remaining for this effect */
-      c[Attr]--;
+      unschedule_effect(j);
+      c[AWARENESS]++;
+      schedule_effect(j);
+    }
+  }
 
-      /* AWARENESS doesn't wear off if the player has the orb */
-      if (Attr == AWARENESS)
-      {
-        if (c[ORB] != 0) c[AWARENESS]++;
-      }
+  /* Process the effects expiring on this turn */
+  Due = EffectWheel[EffectTurn & (EFFECT_WHEEL_SIZE - 1)];
 
-      if (c[Attr] == 0)
-      {
-        /* Effect has worn off, so perform appropriate action */
+  for (j = 0; Due != 0 ; j++, Due >>= 1)
+  {
+    if (((Due & 1) != 0) && (EffectExpiry[j] == EffectTurn))
+    {
+      unschedule_effect(j);
+      Attr = time_change[j];
 
-        switch (Attr)
-        {
-          case HERO:
-            for (i = ABILITY_FIRST ; i <= ABILITY_LAST; i++)
-            {
-              adjust_ability(i, -(PHEROISM_BOOST - 1));
-            }
-            flag |= 1;
-            break;
-
-          case COKED:
-            for (i = ABILITY_FIRST ; i <= ABILITY_LAST ; i++)
-            {
-              adjust_ability(i, -34);
-            }
-            flag |= 1;
-            break;
-
-          case ALTPRO:
-            c[MOREDEFENSES] -= ALTAR_PRO_BOOST;
-            flag |= 3;
-            break;
-
-          case PROTECTIONTIME:
-            c[MOREDEFENSES] -= SPELL_PRO_BOOST;
-            flag |= 3;
-            break;
-
-          case DEXCOUNT:
-            adjust_ability(DEXTERITY, SDEXTERITY_BOOST);
-            flag |= 3;
-            break;
-
-          case STRCOUNT:
-            c[STREXTRA] -= SSTRENGTH_BOOST;
-            flag |= 3;
-            break;
-
-          case BLINDCOUNT:
-            Print("\nThe blindness lifts.");
-            UlarnBeep();
-            break;
-
-          case CONFUSE:
-            Print("\nYou regain your senses.");
-            UlarnBeep();
-            break;
-
-          case GIANTSTR:
+      /* Effect has worn off, so perform appropriate action */
+
+      switch (Attr)
+      {
+        case HERO:
+          for (i = ABILITY_FIRST ; i <= ABILITY_LAST; i++)
+          {
+            adjust_ability(i, -(PHEROISM_BOOST - 1));
+          }
+          flag |= 1;
+          break;
+
+        case COKED:
+          for (i = ABILITY_FIRST ; i <= ABILITY_LAST ; i++)
+          {
+            adjust_ability(i, -34);
+          }
+          flag |= 1;
+          break;
+
+        case ALTPRO:
+          c[MOREDEFENSES] -= ALTAR_PRO_BOOST;
+          flag |= 3;
+          break;
+
+        case PROTECTIONTIME:
+          c[MOREDEFENSES] -= SPELL_PRO_BOOST;
+          flag |= 3;
+          break;
+
+        case DEXCOUNT:
+          adjust_ability(DEXTERITY, SDEXTERITY_BOOST);
+          flag |= 3;
+          break;
+
+        case STRCOUNT:
+          c[STREXTRA] -= SSTRENGTH_BOOST;
+          flag |= 3;
+          break;
+
+        case BLINDCOUNT:
+          Print("\nThe blindness lifts.");
+          UlarnBeep();
+          break;
+
+        case CONFUSE:
+          Print("\nYou regain your senses.");
+          UlarnBeep();
+          break;
+
+        case GIANTSTR:
+          /*
+           * Giant strength wears off, but the playre gets a permanent +1
+           * boost to extra strength.
+           * (unaffected by effects that lower strength).
+           */
+          c[STREXTRA] -= (PGIANTSTR_BOOST - 1);
+          flag |= 3;
+          break;
+
+        case GLOBE:
+          c[MOREDEFENSES] -= SPELL_GLOBE_BOOST;
+          flag |= 1;
+          break;
+
+        case HALFDAM:
+          Print("\nYou now feel better.");
+          UlarnBeep();
+          break;
+
+        case SEEINVISIBLE:
+          if (player_has_item(OAMULET))
+          {
             /*
-             * Giant strength wears off, but the playre gets a permanent +1
-             * boost to extra strength.
-             * (unaffected by effects that lower strength).
+             * See inv doesn't wear off if player has amulet of invisibility
              */
-            c[STREXTRA] -= (PGIANTSTR_BOOST - 1);
-            flag |= 3;
-            break;
-
-          case GLOBE:
-            c[MOREDEFENSES] -= SPELL_GLOBE_BOOST;
-            flag |= 1;
-            break;
-
-          case HALFDAM:
-            Print("\nYou now feel better.");
-            UlarnBeep();
-            break;
-
-          case SEEINVISIBLE:
-            if (player_has_item(OAMULET))
-            {
-              /*
-               * See inv doesn't wear off if player has amulet of invisibility
-               */
-              c[SEEINVISIBLE]++;
-            }
-            break;
-
-          case ITCHING:
-            Print("\nThe irritation subsides.");
-            UlarnBeep();
-            break;
-
-          case CLUMSINESS:
-            Print("\nYou now feel less awkward.");
-            UlarnBeep();
-            break;
-
-          case CHARMCOUNT:
-            flag |= 3;
-            break;
-
-          case INVISIBILITY:
-          case CANCELLATION:
-          case WTW:
-          case HASTESELF:
-          case SCAREMONST:
-          case STEALTH:
-          case HOLDMONST:
-          case FIRERESISTANCE:
-          case SPIRITPRO:
-          case UNDEADPRO:
-            flag |= 2;
-            break;
-
-          case AGGRAVATE:
-          case HASTEMONST:
-          case AWARENESS:
-            break;
-
-          default:
-            break;
-
-        } /* switch */
-      } /* if now expired */
-    } /* if active */
-  } /* for each time based effect */
+            c[SEEINVISIBLE] = 1;
+            schedule_effect(j);
+          }
+          break;
+
+        case ITCHING:
+          Print("\nThe irritation subsides.");
+          UlarnBeep();
+          break;
+
+        case CLUMSINESS:
+          Print("\nYou now feel less awkward.");
+          UlarnBeep();
+          break;
+
+        case CHARMCOUNT:
+          flag |= 3;
+          break;
+
+        case INVISIBILITY:
+        case CANCELLATION:
+        case WTW:
+        case HASTESELF:
+        case SCAREMONST:
+        case STEALTH:
+        case HOLDMONST:
+        case FIRERESISTANCE:
+        case SPIRITPRO:
+        case UNDEADPRO:
+          flag |= 2;
+          break;
+
+        case AGGRAVATE:
+        case HASTEMONST:
+        case AWARENESS:
+          break;
+
+        default:
+          break;
+
+      } /* switch */
+    } /* if expired */
+  } /* for each effect due this turn */
 
   /*
    * If the player is still itching then check to see if armour is to be
@@ -2113,7 +2359,7 @@ void removecurse (void)
        * Set the time remaining on each curse to 1 so that the next regen
        * will clear the curse
        */
-      c[curse[i]] = 1;
+      set_effect(curse[i], 1);
     }
   }
 }
@@ -2128,8 +2374,9 @@ void adjusttime(long tim)
   /* adjust time related parameters */
   for (j = 0; j < TIME_CHANGED_COUNT ; j++)
   {
-    if (c[time_change[j]])
+    if (EffectExpiry[j] != 0)
     {
+      unschedule_effect(j);
       c[time_change[j]] -= tim;
 
       if (c[time_change[j]] <= 0)
@@ -2139,7 +2386,9 @@ void adjusttime(long tim)
          * the next regen will cancel the effect
          */
         c[time_change[j]] = 1;
-       }
+      }
+
+      schedule_effect(j);
     }
   }
 
@@ -2158,8 +2407,10 @@ void write_player(FILE *fp)
   bwrite(fp, (char *) &playerx, sizeof(int));
   bwrite(fp, (char *) &playery, sizeof(int));
   bwrite(fp, (char *) &initialtime, sizeof(long));
+  bwrite(fp, (char *) &level_salt, sizeof(unsigned long));
   bwrite(fp, (char *) &gtime, sizeof(long));
   bwrite(fp, (char *) &outstanding_taxes, sizeof(long));
+  sync_effects();
   bwrite(fp, (char *) c, ATTRIBUTE_COUNT * sizeof(long));
   bwrite(fp, iven, IVENSIZE);
   bwrite(fp, (char *) ivenarg, IVENSIZE * sizeof(short));
@@ -2171,7 +2422,7 @@ void write_player(FILE *fp)
 /* =============================================================================
  * FUNCTION: read_player
  */
-void read_player(FILE *fp)
+void read_player(FILE *fp, int Version)
 {
   bread(fp, char_class, 20);
   bread(fp, &ramboflag, 1);
@@ -2180,11 +2431,21 @@ void read_player(FILE *fp)
   bread(fp, (char *) &playerx, sizeof(int));
   bread(fp, (char *) &playery, sizeof(int));
   bread(fp, (char *) &initialtime, sizeof(long));
+
+  /* Older games made their level seeds without a salt */
+  level_salt = 0;
+  if (Version >= 1)
+  {
+    bread(fp, (char *) &level_salt, sizeof(unsigned long));
+  }
+
   bread(fp, (char *) &gtime, sizeof(long));
   bread(fp, (char *) &outstanding_taxes, sizeof(long));
   bread(fp, (char *) c, ATTRIBUTE_COUNT * sizeof(long));
+  reset_effects();
   bread(fp, iven, IVENSIZE);
   bread(fp, (char *) ivenarg, IVENSIZE * sizeof(short));
+  inventory_changed(-1);
   bread(fp, (char *) potionknown, MAXPOTION * sizeof(int));
   bread(fp, (char *) scrollknown, MAXSCROLL * sizeof(int));
   bread(fp, (char *) spelknow, SPELL_COUNT * sizeof(int));
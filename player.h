@@ -21,6 +21,7 @@
  * lastpx            : The player's previous x coordinate
  * lastpy            : The player's previous y coordiante
  * initialtime       : The time play started
+ * level_salt        : The game's salt for the dungeon level seeds
  * gtime             : The clock for the game
  * outstanding_taxes : The taxes owed from the score file
  * c                 : The character attributes array
@@ -34,6 +35,7 @@
  * hitflag           : Hit flags for player, used for move processing
  * hit2flag          :
  * hit3flag          :
+ * HasteStep         : Fractions of moves taken when hasted
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -55,6 +57,7 @@
  * losespells      : Lose spell points
  * losemspells     : Decrease max spell points
  * positionplayer  : Position the player on a level
+ * inventory_changed : Update cached inventory stats after an inventory change
  * recalc          : Recalculate AC and WC
  * take            : Take an item
  * drop_object     : Drop an object
@@ -69,6 +72,10 @@
  * adjustcvalues   : Adjust attributes when dropping/losing an item
  * packweight      : Get the weight of the player's inventory
  * adjust_ability  : Adjust an ability score
+ * add_effect      : Add time to a time based effect
+ * set_effect      : Set the time remaining for a time based effect
+ * sync_effects    : Bring the time remaining for time based effects up to date
+ * reset_effects   : Reschedule time based effects from the attributes array
  * regen           : Regen player for passing of a turn
  * removecurse     : Remove curses inflicted upon player
  * adjusttime      : Adjust time base effects for the passage of time
@@ -227,6 +234,7 @@ extern int playerx, playery; /* the room on the present level of the player*/
 extern int lastpx, lastpy;   /* 0 --- MAXX-1  or  0 --- MAXY-1   */
 
 extern long initialtime;        /* time playing began   */
+extern unsigned long level_salt; /* salt for the level seeds */
 extern long gtime;              /* the clock for the game */
 extern long outstanding_taxes;  /* present tax bill from score file */
 
@@ -236,8 +244,8 @@ extern long cbak[ATTRIBUTE_COUNT]; /* Backup array for detecting changes */
 extern char iven[IVENSIZE];     /* inventory for player */
 extern short ivenarg[IVENSIZE]; /* inventory args for player  */
 
-extern char *class[];
-extern long skill[];
+extern char *const class[];
+extern const long skill[];
 
 /*
  * Array of which potions are known to the player.
@@ -264,6 +272,11 @@ extern char hitflag;
 extern char hit2flag;
 extern char hit3flag;
 
+/*
+ * Haste step to keep track of fractions of moves when hasted
+ */
+extern int HasteStep;
+
 
 /* =============================================================================
  * FUNCTION: identify_class
@@ -548,6 +561,25 @@ void losemspells (int x);
  */
 void positionplayer (void);
 
+/* =============================================================================
+ * FUNCTION: inventory_changed
+ *
+ * DESCRIPTION:
+ * Update the cached inventory stats used by recalc and packweight after
+ * an inventory slot has changed.
+ * This must be called whenever iven[] or ivenarg[] is modified.
+ *
+ * PARAMETERS:
+ *
+ *   Slot : The inventory slot that changed, or -1 if the whole inventory
+ *          has changed.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void inventory_changed(int Slot);
+
 /* =============================================================================
  * FUNCTION: recalc
  *
@@ -786,6 +818,85 @@ int packweight (void);
  */
 void adjust_ability(AttributeType ability, int amount);
 
+/* =============================================================================
+ * FUNCTION: add_effect
+ *
+ * DESCRIPTION:
+ * Add time to a time based effect such as HASTESELF or BLINDCOUNT, and
+ * reschedule the expiry of the effect.
+ * Time based effects must be changed through add_effect or set_effect
+ * rather than by writing c[] directly.
+ * On return c[Attr] holds the current time remaining.
+ *
+ * PARAMETERS:
+ *
+ *   Attr : The attribute for the effect
+ *
+ *   Time : The number of turns to add. This may be negative.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void add_effect(AttributeType Attr, long Time);
+
+/* =============================================================================
+ * FUNCTION: set_effect
+ *
+ * DESCRIPTION:
+ * Set the time remaining for a time based effect, and reschedule the expiry
+ * of the effect.
+ * Setting the time to 1 causes the effect to wear off on the next regen.
+ * Setting the time to 0 cancels the effect without any wear off action.
+ *
+ * PARAMETERS:
+ *
+ *   Attr : The attribute for the effect
+ *
+ *   Time : The number of turns remaining
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void set_effect(AttributeType Attr, long Time);
+
+/* =============================================================================
+ * FUNCTION: sync_effects
+ *
+ * DESCRIPTION:
+ * Update c[] with the current time remaining for all time based effects.
+ * Between changes, c[] only holds the time remaining as at the last change
+ * to each effect, so this must be called before the values are saved or
+ * displayed. Whether an effect is active may always be tested from c[].
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void sync_effects(void);
+
+/* =============================================================================
+ * FUNCTION: reset_effects
+ *
+ * DESCRIPTION:
+ * Reschedule all time based effects from the time remaining in c[].
+ * This must be called after c[] is loaded or initialised.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void reset_effects(void);
+
 /* =============================================================================
  * FUNCTION: regen
  *
@@ -859,12 +970,14 @@ void write_player(FILE *fp);
  *
  * PARAMETERS:
  *
- *  fp : A pointer to the save file being read.
+ *  fp      : A pointer to the save file being read.
+ *
+ *  Version : The version of the save file format (see savegame.h)
  *
  * RETURN VALUE:
  *
  *   None.
  */
-void read_player(FILE *fp);
+void read_player(FILE *fp, int Version);
 
 #endif
@@ -32,7 +32,7 @@
  */
 
 /*  name array for magic potions  */
-char *potionname[MAXPOTION] =
+char *const potionname[MAXPOTION] =
 {
   " sleep",
   " healing",
@@ -84,7 +84,7 @@ char *potionname[MAXPOTION] =
 
 #define POTION_PROB_SIZE 41
 
-static char potprob[POTION_PROB_SIZE] =
+static const char potprob[POTION_PROB_SIZE] =
 {
   PSLEEP, PSLEEP,
   PHEALING, PHEALING, PHEALING,
@@ -263,7 +263,7 @@ void quaffpotion(int pot)
 
     case PBLINDNESS:
       Print("\n  You can't see anything!");
-      c[BLINDCOUNT]+=250;  /* dang, that's a long time. */
+      add_effect(BLINDCOUNT, 250);  /* dang, that's a long time. */
       /* erase the character, too! */
 
       showplayer();
@@ -271,7 +271,7 @@ void quaffpotion(int pot)
 
     case PCONFUSION:
       Print("\n  You feel confused.");
-      c[CONFUSE]+= 20+rnd(9);
+      add_effect(CONFUSE, 20+rnd(9));
       return;
 
     case PHEROISM:
@@ -283,7 +283,7 @@ void quaffpotion(int pot)
           c[i] += PHEROISM_BOOST;
         }
       }
-      c[HERO] += 250;
+      add_effect(HERO, 250);
       break;
 
     case PSTURDINESS:
@@ -294,12 +294,12 @@ void quaffpotion(int pot)
     case PGIANTSTR:
       Print("\n  You now have incredible bulging muscles!");
       if (c[GIANTSTR]==0) c[STREXTRA] += PGIANTSTR_BOOST;
-      c[GIANTSTR] += 700;
+      add_effect(GIANTSTR, 700);
       break;
 
     case PFIRERESIST:
       Print("\n  You feel a chill run up your spine!");
-      c[FIRERESISTANCE] += 1000;
+      add_effect(FIRERESISTANCE, 1000);
       break;
 
     case PTREASURE:
@@ -332,12 +332,12 @@ void quaffpotion(int pot)
 
     case PPOISON:
       Print("\n  You feel a sickness engulf you!");
-      c[HALFDAM] += 200 + rnd(200);
+      add_effect(HALFDAM, 200 + rnd(200));
       return;
 
     case PSEEINVIS:
       Print("\n  You feel your vision sharpen.");
-      c[SEEINVISIBLE] += rnd(1000)+400;
+      add_effect(SEEINVISIBLE, rnd(1000)+400);
       monstnamelist[INVISIBLESTALKER] = 'I';
       return;
 
@@ -64,7 +64,7 @@
 /*
  * Names of all potions
  */
-extern char *potionname[MAXPOTION];
+extern char *const potionname[MAXPOTION];
 
 /* =============================================================================
  * FUNCTION: newpotion
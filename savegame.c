@@ -35,6 +35,7 @@
 #include "store.h"
 #include "scores.h"
 #include "itm.h"
+#include "trace.h"
 
 /* =============================================================================
  * Local functions
@@ -142,6 +143,10 @@ static void fcheat(void)
 int savegame(char *fname)
 {
   FILE *fp;
+  unsigned long Magic = SAVE_MAGIC;
+  int Version = SAVE_VERSION;
+
+  TRACE_BEGIN(TRACE_SAVEGAME);
 
   nosignal = 1;
 
@@ -160,11 +165,15 @@ int savegame(char *fname)
   {
     Printf("Can't open file <%s> to save game\n", fname);
     nosignal = 0;
+    TRACE_END(TRACE_SAVEGAME);
     return(-1);
   }
 
   FileSum = 0;
 
+  bwrite(fp, (char *) &Magic, sizeof(Magic));
+  bwrite(fp, (char *) &Version, sizeof(Version));
+
   write_player(fp);
   write_levels(fp);
   write_store(fp);
@@ -178,6 +187,8 @@ int savegame(char *fname)
 
   nosignal = 0;
 
+  TRACE_END(TRACE_SAVEGAME);
+
   return(0);
 }
 
@@ -190,6 +201,8 @@ void restoregame(char *fname)
   unsigned int thesum;
   unsigned int asum;
   int TotalAttr;
+  unsigned long Magic;
+  int Version;
   FILE *fp;
 
   fp = fopen(fname, "rb");
@@ -208,7 +221,30 @@ void restoregame(char *fname)
 
   FileSum = 0;
 
-  read_player(fp);
+  Version = 0;
+  bread(fp, (char *) &Magic, sizeof(Magic));
+  if (Magic == SAVE_MAGIC)
+  {
+    bread(fp, (char *) &Version, sizeof(Version));
+  }
+  else
+  {
+    /* Written before the format was versioned, so start again */
+    rewind(fp);
+    FileSum = 0;
+  }
+
+  if (Version > SAVE_VERSION)
+  {
+    Print("\nSorry but your savefile was written by a newer version of Ularn.");
+    fclose(fp);
+    nap(4000);
+    c[GOLD] = c[BANKACCOUNT] = 0;
+    died(DIED_OLD_SAVE_FILE, 0);
+    return;
+  }
+
+  read_player(fp, Version);
   read_levels(fp);
   read_store(fp);
   read_monster_data(fp);
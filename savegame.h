@@ -22,6 +22,16 @@
 #ifndef __SAVEGAME_H
 #define __SAVEGAME_H
 
+/*
+ * Save files start with SAVE_MAGIC followed by the version of the file
+ * format. Files without the magic number were written before the version
+ * was recorded, and are read as version 0.
+ *
+ * Version 1: The player data holds the game's level salt.
+ */
+#define SAVE_MAGIC   0x556c5376UL
+#define SAVE_VERSION 1
+
 /* =============================================================================
  * FUNCTION: savegame
  *
@@ -9,7 +9,9 @@
  * =============================================================================
  * EXPORTED VARIABLES
  *
- * None.
+ * game_over     : Set when the game has ended
+ * game_result   : How the game ended
+ * game_end_jump : Where endgame returns control to, if set
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -19,7 +21,7 @@
  * paytaxes      : Note the payment of taxes.
  * showscores    : Display the scoreboard
  * showallscores : Show scores including inventories.
- * endgame       : Game tidyup and exit function.
+ * endgame       : Game tidyup and end function.
  * died          : Function to handle player dying.
  *
  * =============================================================================
@@ -39,6 +41,17 @@
 #include "sphere.h"
 #include "show.h"
 #include "scores.h"
+#include "trace.h"
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int game_over = 0;
+
+GameResultType game_result;
+
+jmp_buf *game_end_jump = NULL;
 
 /* =============================================================================
  * Local variables
@@ -101,7 +114,7 @@ static struct score_type scoreboard[SCORESIZE];
 static struct win_score_type winboard[SCORESIZE];
 
 /* Died reason messages */
-static char *whydead[DIED_COUNT] =
+static char *const whydead[DIED_COUNT] =
 {
   "killed by a monster",
   "quit",
@@ -856,6 +869,7 @@ static int show_visitors(int show_inv)
               iven[n] = scoreboard[j].sciv[n][0];
               ivenarg[n] = scoreboard[j].sciv[n][1];
             }
+            inventory_changed(-1);
 
             for (n = 0; n < IVENSIZE; n++)
             {
@@ -1112,6 +1126,17 @@ void showallscores(void)
  */
 void endgame(void)
 {
+  /* write out the trace, if one is being recorded */
+  if (trace_enabled) trace_dump();
+
+  game_over = 1;
+
+  /* return to the program playing the game, if it wants to carry on */
+  if (game_end_jump != NULL)
+  {
+    longjmp(*game_end_jump, 1);
+  }
+
   /* deallocate any allocated memory */
 
   free_cells();
@@ -1180,6 +1205,14 @@ void died(DiedReasonType Reason, int Monster)
   if (ckpflag)
     unlink(ckpfile);
 
+  win = (Reason == DIED_WINNER);
+
+  game_result.Score = 0;
+  game_result.Reason = Reason;
+  game_result.Monster = Monster;
+  game_result.Level = level;
+  game_result.Win = win;
+
   /* if we are not to display the scores */
   if ((Reason == DIED_QUICK_QUIT) || (Reason == DIED_SUSPENDED))
   {
@@ -1190,10 +1223,9 @@ void died(DiedReasonType Reason, int Monster)
     endgame();
   }
 
-  win = (Reason == DIED_WINNER);
-
   /* Now calculate the player's final score */
   score = calc_score(win);
+  game_result.Score = score;
 
   set_display(DISPLAY_TEXT);
   ClearText();
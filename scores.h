@@ -9,7 +9,9 @@
  * =============================================================================
  * EXPORTED VARIABLES
  *
- * None.
+ * game_over     : Set when the game has ended
+ * game_result   : How the game ended
+ * game_end_jump : Where endgame returns control to, if set
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -19,7 +21,7 @@
  * paytaxes      : Note the payment of taxes.
  * showscores    : Display the scoreboard
  * showallscores : Show scores including inventories.
- * endgame       : Game tidyup and exit function.
+ * endgame       : Game tidyup and end function.
  * died          : Function to handle player dying.
  *
  * =============================================================================
@@ -28,6 +30,8 @@
 #ifndef __SCORES_H
 #define __SCORES_H
 
+#include <setjmp.h>
+
 /* max number of people on a scoreboard max */
 #define SCORESIZE 25
 
@@ -71,6 +75,33 @@ typedef enum
   DIED_COUNT
 } DiedReasonType;
 
+/*
+ * The result of a game, recorded by died when the game ends.
+ */
+typedef struct
+{
+  long Score;             /* The final score (0 for a quick quit or save) */
+  DiedReasonType Reason;  /* Why the game ended */
+  int Monster;            /* The monster involved, if any */
+  int Level;              /* The dungeon level the game ended on */
+  int Win;                /* Non-zero if the player won */
+} GameResultType;
+
+/*
+ * Set when the game has ended. game_result holds how it ended if it ended
+ * through died.
+ */
+extern int game_over;
+extern GameResultType game_result;
+
+/*
+ * A program that plays games without exiting when a game ends points this
+ * at a jmp_buf set with setjmp. endgame then jumps there when the game has
+ * been tidied up instead of exiting the program.
+ * If it is NULL then endgame exits the program.
+ */
+extern jmp_buf *game_end_jump;
+
 /* =============================================================================
  * FUNCTION: makeboard
  *
@@ -160,7 +191,10 @@ void showallscores(void);
  * FUNCTION: endgame
  *
  * DESCRIPTION:
- * Call all tidyup procedures and exit the program.
+ * Call all tidyup procedures and end the game.
+ * If game_end_jump is set then control returns there with the game's
+ * storage still allocated, so that another game can be started.
+ * Otherwise the game's storage is freed and the program exits.
  *
  * PARAMETERS:
  *
@@ -168,7 +202,7 @@ void showallscores(void);
  *
  * RETURN VALUE:
  *
- *   None.
+ *   Does not return.
  */
 void endgame(void);
 
@@ -178,6 +212,9 @@ void endgame(void);
  * DESCRIPTION:
  * Routine to note player death and the reason.
  * Called for all end game conditions, including winning.
+ * Unless the player is saved by life protection, this records the result
+ * in game_result, updates the scoreboard and removes the checkpoint file,
+ * and then ends the game with endgame.
  *
  * PARAMETERS:
  *
@@ -187,7 +224,7 @@ void endgame(void);
  *
  * RETURN VALUE:
  *
- *   None.
+ *   None. Only returns if the player is saved by life protection.
  */
 void died(DiedReasonType Reason, int Monster);
 
@@ -36,7 +36,7 @@
  */
 
 /*  name array for scrolls    */
-char *scrollname[MAXSCROLL] =
+char *const scrollname[MAXSCROLL] =
 {
   " enchant armor",
   " enchant weapon",
@@ -81,7 +81,7 @@ static int xh,yh,yl,xl;
  * List of attributes affected by spell extension
  */
 #define EXTENSION_COUNT 11
-static int exten[EXTENSION_COUNT] =
+static const int exten[EXTENSION_COUNT] =
 {
   PROTECTIONTIME,
   DEXCOUNT,
@@ -103,7 +103,7 @@ static int exten[EXTENSION_COUNT] =
 
 #define SCROLL_PROB_SIZE 81
 
-static char scprob[SCROLL_PROB_SIZE] =
+static const char scprob[SCROLL_PROB_SIZE] =
 {
   SENCHANTARM, SENCHANTARM, SENCHANTARM, SENCHANTARM,
   SENCHANTWEAP, SENCHANTWEAP, SENCHANTWEAP, SENCHANTWEAP, SENCHANTWEAP,
@@ -198,7 +198,7 @@ void read_scroll(int typ)
       return;
 
     case SAGGMONST:
-      c[AGGRAVATE]+=800;
+      add_effect(AGGRAVATE, 800);
       return;
 
     case STIMEWARP:
@@ -225,11 +225,11 @@ void read_scroll(int typ)
       return;
 
     case SAWARENESS:
-      c[AWARENESS] += 1800;
+      add_effect(AWARENESS, 1800);
       return;
 
     case SHASTEMONST:
-      c[HASTEMONST] += rnd(55)+12;
+      add_effect(HASTEMONST, rnd(55)+12);
       Printf("  You feel nervous.");
       return;
 
@@ -248,17 +248,17 @@ void read_scroll(int typ)
       return;
 
     case SSPIRITPROT:
-      c[SPIRITPRO] += 300 + rnd(200);
+      add_effect(SPIRITPRO, 300 + rnd(200));
       UpdateEffects();
       return;
 
     case SUNDEADPROT:
-      c[UNDEADPRO] += 300 + rnd(200);
+      add_effect(UNDEADPRO, 300 + rnd(200));
       UpdateEffects();
       return;
 
     case SSTEALTH:
-      c[STEALTH] += 250 + rnd(250);
+      add_effect(STEALTH, 250 + rnd(250));
       UpdateEffects();
       return;
 
@@ -279,7 +279,7 @@ void read_scroll(int typ)
       return;
 
     case SHOLDMONST:
-      c[HOLDMONST] += 30;
+      add_effect(HOLDMONST, 30);
       UpdateEffects();
       return;
 
@@ -299,6 +299,7 @@ void read_scroll(int typ)
               j = 2550;
             }
             ivenarg[i] = (short) j;
+            inventory_changed(i);
             break;
 
           default:
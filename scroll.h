@@ -55,7 +55,7 @@
 /*
  * Names of all scrolls
  */
-extern char *scrollname[MAXSCROLL];
+extern char *const scrollname[MAXSCROLL];
 
 /* =============================================================================
  * FUNCTION: newscroll
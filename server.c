@@ -0,0 +1,2162 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: server.c
+ *
+ * DESCRIPTION:
+ * Multi-session game server module.
+ * The server accepts players on a Unix domain socket and plays all of their
+ * games in one process, from a single epoll event loop.
+ *
+ * The game keeps its state in global variables, so only one game can be
+ * resident at a time. Each session's game runs on its own coroutine stack,
+ * and when the loop switches to a different session the resident game is
+ * saved to an in-memory snapshot and the next one restored. A game only
+ * gives up control while waiting for a key: delays for animation are sent
+ * to the player as timed output instead of stopping the game.
+ *
+ * A player that disconnects has their game saved, as if they had pressed S,
+ * and gets it back by connecting again with the same name. SIGINT and
+ * SIGTERM save every game before the server exits.
+ *
+ * Each game's display output is encoded once into an output stream of
+ * shared, unchanging chunks. The player and anyone watching them (on the
+ * watch socket) each keep their own position in the stream and are sent
+ * the chunks directly, so an extra watcher costs a system call per turn.
+ * A watcher who joins part way through a game is first sent a picture of
+ * the whole screen.
+ *
+ * Players and watchers connect with any program that passes a raw terminal
+ * through to a Unix socket, for example:
+ *
+ *   socat -,raw,echo=0 UNIX-CONNECT:/tmp/ularn.sock
+ *
+ * Usage: ularn-server [-l libdir] [-s savedir] [-d difficulty]
+ *                     [-m sessions] [-w watch socket] [-n] [-q] socket
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * server_get_key  : Get the next input byte for the current session
+ * server_peek_key : Look at the next input byte without removing it
+ * server_output   : Get the output buffer for the current session
+ * server_delay    : Delay the output that follows for the current session
+ * main            : The program entry point
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <ctype.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "header.h"
+#include "patchlevel.h"
+#include "ularn_game.h"
+#include "ularn_win.h"
+#include "ularn.h"
+#include "getopt.h"
+#include "dungeon.h"
+#include "player.h"
+#include "scores.h"
+#include "savegame.h"
+#include "help.h"
+#include "snapshot.h"
+#include "vterm.h"
+#include "server.h"
+#include "ularn_winserv.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The size of each session's coroutine stack. Only the pages a game
+ * touches use memory.
+ */
+#define STACK_SIZE (256 * 1024)
+
+/*
+ * The number of typed keys queued for a session. Any more are dropped.
+ */
+#define INPUT_SIZE 256
+
+/*
+ * A player or watcher who falls this far behind their output is
+ * disconnected.
+ */
+#define OUTPUT_LIMIT (1024 * 1024)
+
+/*
+ * The most chunks of output sent with one system call
+ */
+#define MAX_IOV 32
+
+/*
+ * The most players listed to a watcher
+ */
+#define MAX_LISTED 20
+
+#define MAX_EVENTS 256
+
+/*
+ * A chunk of a session's output stream. A chunk never changes once it has
+ * been added to the stream, and it is shared by the player and everyone
+ * watching them.
+ */
+typedef struct ChunkType
+{
+  struct ChunkType *Next;
+  int RefCount;                /* Readers in the chunk, plus one for the   */
+                               /* link from the chunk before it, plus one  */
+                               /* while it is the end of the stream        */
+  long long Due;               /* Not to be sent before this time          */
+  size_t Len;
+  char Data[1];
+} ChunkType;
+
+/*
+ * A session's output stream. The chunks that all of its readers have sent
+ * are freed.
+ */
+typedef struct StreamType
+{
+  ChunkType *Tail;
+  unsigned long long Total;    /* The number of bytes ever added           */
+  int RefCount;                /* The session and its watchers             */
+  int Ended;                   /* Set once the game has ended              */
+  struct ReaderType *Watchers;
+  int WatcherCount;
+} StreamType;
+
+typedef enum
+{
+  READER_PLAYER,
+  READER_WATCHER
+} ReaderKindType;
+
+/*
+ * A connection that is sent a session's output stream: either the player,
+ * or someone watching them.
+ */
+typedef struct ReaderType
+{
+  ReaderKindType Kind;
+  int Fd;                      /* The socket, or -1 once gone              */
+
+  StreamType *Stream;          /* The stream being read, if any            */
+  ChunkType *Chunk;            /* The chunk and offset of the next byte    */
+  size_t Offset;
+  unsigned long long Pos;      /* The stream position of the next byte     */
+
+  VTermBufType Prefix;         /* Output to send before the stream         */
+  size_t PrefixSent;
+
+  int WantWrite;               /* Set while waiting to be able to write    */
+  long long WakeAt;            /* When the next delayed chunk is due       */
+  int Timed;                   /* Set while on the timed output list       */
+  struct ReaderType *NextTimed;
+
+  struct SessionType *Session; /* The player's session                     */
+
+  struct ReaderType *PrevWatcher; /* The stream's watchers                 */
+  struct ReaderType *NextWatcher;
+  struct ReaderType *PrevConn;    /* All watcher connections               */
+  struct ReaderType *NextConn;
+  char Line[USERNAME_LENGTH + 1]; /* The name a watcher is typing          */
+  int LineLen;
+} ReaderType;
+
+typedef enum
+{
+  SESSION_START,     /* The game has not been started yet      */
+  SESSION_WAIT_KEY,  /* The game is waiting for a key          */
+  SESSION_DONE       /* The game has ended                     */
+} SessionStateType;
+
+typedef struct SessionType
+{
+  int Id;
+  SessionStateType State;
+  ReaderType Player;           /* The player's connection                  */
+  StreamType *Stream;          /* The output sent to the player            */
+
+  struct SessionType *Prev;    /* The list of all sessions                 */
+  struct SessionType *Next;
+  struct SessionType *NextReady;
+  int Ready;                   /* Set while on the ready queue             */
+
+  ucontext_t Context;          /* The game's coroutine                     */
+  char *Stack;
+  jmp_buf *EndJump;            /* Where endgame returns to for this game   */
+
+  GameSnapshotType *Game;      /* The game, while it is not resident       */
+  ServDisplayType *Display;
+
+  unsigned char Input[INPUT_SIZE];
+  int InputHead;
+  int InputCount;
+  int LastCR;                  /* Set if the last byte read was a CR       */
+
+  VTermBufType Pending;        /* Output not yet added to the stream       */
+  long long NextDue;           /* When the pending output is due           */
+  long long LastDue;           /* When the last delayed output is due      */
+
+  char Name[USERNAME_LENGTH + 1];
+  int UserId;
+} SessionType;
+
+/*
+ * The server settings
+ */
+static int Difficulty = -1;
+static int MaxSessions = 4096;
+static int MaxWatchers = 4096;
+
+/*
+ * The epoll instance and the listening sockets
+ */
+static int Epoll = -1;
+static int Listener = -1;
+static int WatchListener = -1;
+
+/*
+ * All sessions, and the sessions ready to run
+ */
+static SessionType *Sessions = NULL;
+static SessionType *ReadyHead = NULL;
+static SessionType *ReadyTail = NULL;
+static int SessionCount = 0;
+static int NextSessionId = 1;
+
+/*
+ * All watcher connections
+ */
+static ReaderType *Watchers = NULL;
+static int WatcherCount = 0;
+
+/*
+ * The readers with delayed output waiting to be sent
+ */
+static ReaderType *TimedList = NULL;
+
+/*
+ * The session whose game is running, and the session whose game is in the
+ * game's global variables.
+ */
+static SessionType *Current = NULL;
+static SessionType *Resident = NULL;
+
+/*
+ * The event loop's context, which sessions switch back to.
+ */
+static ucontext_t LoopContext;
+
+/*
+ * The game state every new game starts from.
+ */
+static GameSnapshotType *InitialState = NULL;
+
+/*
+ * Output made outside any session is discarded here.
+ */
+static VTermBufType Discard;
+
+static volatile sig_atomic_t Stopping = 0;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: now_ms
+ *
+ * DESCRIPTION:
+ * Get the time from a monotonic clock.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The time in milliseconds.
+ */
+static long long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* =============================================================================
+ * FUNCTION: stop_handler
+ *
+ * DESCRIPTION:
+ * Signal handler for SIGINT and SIGTERM. The event loop saves all games
+ * and exits.
+ *
+ * PARAMETERS:
+ *
+ *   Sig : The signal
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void stop_handler(int Sig)
+{
+  Stopping = 1;
+}
+
+/* =============================================================================
+ * FUNCTION: make_ready
+ *
+ * DESCRIPTION:
+ * Add a session to the queue of sessions to run.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void make_ready(SessionType *S)
+{
+  if (S->Ready || (S->State == SESSION_DONE)) return;
+
+  S->Ready = 1;
+  S->NextReady = NULL;
+
+  if (ReadyTail == NULL)
+  {
+    ReadyHead = S;
+  }
+  else
+  {
+    ReadyTail->NextReady = S;
+  }
+  ReadyTail = S;
+}
+
+/* =============================================================================
+ * FUNCTION: load_globals
+ *
+ * DESCRIPTION:
+ * Set the game globals that belong to a session but are not part of a game
+ * snapshot: the player's names, user id and files.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void load_globals(SessionType *S)
+{
+  strcpy(loginname, S->Name);
+  strcpy(logname, S->Name);
+  userid = S->UserId;
+
+  sprintf(savefilename, "%.*s/ularn_%s.sav", MAXPATHLEN - 64, savedir, S->Name);
+  sprintf(ckpfile, "%.*s/ularn_%s.ckp", MAXPATHLEN - 64, savedir, S->Name);
+}
+
+/* =============================================================================
+ * FUNCTION: chunk_release
+ *
+ * DESCRIPTION:
+ * Drop a reference to an output chunk, freeing it and any chunks after it
+ * that are no longer referenced.
+ *
+ * PARAMETERS:
+ *
+ *   Chunk : The chunk
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void chunk_release(ChunkType *Chunk)
+{
+  ChunkType *Next;
+
+  while ((Chunk != NULL) && (--Chunk->RefCount == 0))
+  {
+    Next = Chunk->Next;
+    free(Chunk);
+    Chunk = Next;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: chunk_new
+ *
+ * DESCRIPTION:
+ * Allocate an output chunk.
+ *
+ * PARAMETERS:
+ *
+ *   Data : The chunk's data
+ *
+ *   Len  : The length of the data
+ *
+ *   Due  : The time the chunk is due to be sent
+ *
+ * RETURN VALUE:
+ *
+ *   The chunk, with one reference, or NULL if there is not enough memory.
+ */
+static ChunkType *chunk_new(char *Data, size_t Len, long long Due)
+{
+  ChunkType *Chunk;
+
+  Chunk = (ChunkType *) malloc(sizeof(ChunkType) + Len);
+  if (Chunk == NULL) return NULL;
+
+  Chunk->Next = NULL;
+  Chunk->RefCount = 1;
+  Chunk->Due = Due;
+  Chunk->Len = Len;
+  if (Len > 0) memcpy(Chunk->Data, Data, Len);
+
+  return Chunk;
+}
+
+/* =============================================================================
+ * FUNCTION: stream_new
+ *
+ * DESCRIPTION:
+ * Create an empty output stream.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The stream, with one reference, or NULL if there is not enough memory.
+ */
+static StreamType *stream_new(void)
+{
+  StreamType *Stream;
+
+  Stream = (StreamType *) calloc(1, sizeof(StreamType));
+  if (Stream == NULL) return NULL;
+
+  /* The stream always ends in a chunk, so readers always have a position */
+  Stream->Tail = chunk_new(NULL, 0, 0);
+  if (Stream->Tail == NULL)
+  {
+    free(Stream);
+    return NULL;
+  }
+
+  Stream->RefCount = 1;
+
+  return Stream;
+}
+
+/* =============================================================================
+ * FUNCTION: stream_release
+ *
+ * DESCRIPTION:
+ * Drop a reference to an output stream, freeing it when unreferenced.
+ *
+ * PARAMETERS:
+ *
+ *   Stream : The stream
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void stream_release(StreamType *Stream)
+{
+  if (--Stream->RefCount > 0) return;
+
+  chunk_release(Stream->Tail);
+  free(Stream);
+}
+
+/* =============================================================================
+ * FUNCTION: reader_attach
+ *
+ * DESCRIPTION:
+ * Start a reader at the end of an output stream.
+ *
+ * PARAMETERS:
+ *
+ *   R      : The reader
+ *
+ *   Stream : The stream
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void reader_attach(ReaderType *R, StreamType *Stream)
+{
+  R->Stream = Stream;
+  R->Chunk = Stream->Tail;
+  R->Chunk->RefCount++;
+  R->Offset = R->Chunk->Len;
+  R->Pos = Stream->Total;
+
+  if (R->Kind == READER_WATCHER)
+  {
+    Stream->RefCount++;
+
+    R->PrevWatcher = NULL;
+    R->NextWatcher = Stream->Watchers;
+    if (Stream->Watchers != NULL) Stream->Watchers->PrevWatcher = R;
+    Stream->Watchers = R;
+    Stream->WatcherCount++;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: reader_detach
+ *
+ * DESCRIPTION:
+ * Stop a reader reading its output stream.
+ *
+ * PARAMETERS:
+ *
+ *   R : The reader
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void reader_detach(ReaderType *R)
+{
+  StreamType *Stream;
+
+  Stream = R->Stream;
+  if (Stream == NULL) return;
+
+  chunk_release(R->Chunk);
+  R->Chunk = NULL;
+  R->Offset = 0;
+  R->Stream = NULL;
+
+  if (R->Kind == READER_WATCHER)
+  {
+    if (R->PrevWatcher != NULL)
+    {
+      R->PrevWatcher->NextWatcher = R->NextWatcher;
+    }
+    else
+    {
+      Stream->Watchers = R->NextWatcher;
+    }
+    if (R->NextWatcher != NULL) R->NextWatcher->PrevWatcher = R->PrevWatcher;
+    Stream->WatcherCount--;
+
+    stream_release(Stream);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: hang_up
+ *
+ * DESCRIPTION:
+ * Close the connection to a session's player. The game is left to run to
+ * the point where it can be saved.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void hang_up(SessionType *S)
+{
+  if (S->Player.Fd < 0) return;
+
+  epoll_ctl(Epoll, EPOLL_CTL_DEL, S->Player.Fd, NULL);
+  close(S->Player.Fd);
+  S->Player.Fd = -1;
+
+  reader_detach(&S->Player);
+
+  if (S->State != SESSION_DONE)
+  {
+    make_ready(S);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: watcher_show_list
+ *
+ * DESCRIPTION:
+ * Stop a watcher watching, and show them the players they can watch.
+ *
+ * PARAMETERS:
+ *
+ *   R   : The watcher
+ *
+ *   Msg : A message to show above the list, or NULL
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void watcher_show_list(ReaderType *R, char *Msg)
+{
+  static char ClearSeq[] = "\033[0m\017\033[H\033[2J";
+  char Line[USERNAME_LENGTH + 40];
+  SessionType *S;
+  int Count;
+  int Len;
+
+  reader_detach(R);
+
+  R->Prefix.Len -= R->PrefixSent;
+  memmove(R->Prefix.Data, R->Prefix.Data + R->PrefixSent, R->Prefix.Len);
+  R->PrefixSent = 0;
+
+  vterm_buf_add(&R->Prefix, ClearSeq, strlen(ClearSeq));
+
+  if (Msg != NULL)
+  {
+    vterm_buf_add(&R->Prefix, Msg, strlen(Msg));
+    vterm_buf_add(&R->Prefix, "\r\n\r\n", 4);
+  }
+
+  vterm_buf_add(&R->Prefix, "Players:\r\n", 10);
+
+  Count = 0;
+  for (S = Sessions ; S != NULL ; S = S->Next)
+  {
+    if ((S->Name[0] == 0) || (S->State == SESSION_DONE)) continue;
+
+    if (Count < MAX_LISTED)
+    {
+      Len = sprintf(Line, "  %s", S->Name);
+      if (S->Stream->WatcherCount > 0)
+      {
+        Len += sprintf(Line + Len, " (%d watching)", S->Stream->WatcherCount);
+      }
+      Len += sprintf(Line + Len, "\r\n");
+      vterm_buf_add(&R->Prefix, Line, Len);
+    }
+    Count++;
+  }
+
+  if (Count == 0)
+  {
+    Len = sprintf(Line, "  Nobody is playing.\r\n");
+  }
+  else if (Count > MAX_LISTED)
+  {
+    Len = sprintf(Line, "  and %d more.\r\n", Count - MAX_LISTED);
+  }
+  else
+  {
+    Len = 0;
+  }
+  vterm_buf_add(&R->Prefix, Line, Len);
+
+  Len = sprintf(Line, "\r\nWatch which player (q stops watching)? ");
+  vterm_buf_add(&R->Prefix, Line, Len);
+
+  R->LineLen = 0;
+}
+
+/* =============================================================================
+ * FUNCTION: reader_close
+ *
+ * DESCRIPTION:
+ * Close the connection of a player or watcher. Watchers are freed later,
+ * by the event loop.
+ *
+ * PARAMETERS:
+ *
+ *   R : The reader
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void reader_close(ReaderType *R)
+{
+  if (R->Kind == READER_PLAYER)
+  {
+    hang_up(R->Session);
+    return;
+  }
+
+  if (R->Fd < 0) return;
+
+  epoll_ctl(Epoll, EPOLL_CTL_DEL, R->Fd, NULL);
+  close(R->Fd);
+  R->Fd = -1;
+
+  reader_detach(R);
+}
+
+/* =============================================================================
+ * FUNCTION: reader_write
+ *
+ * DESCRIPTION:
+ * Send as much of a reader's output as is due and the socket will take.
+ * The output is sent straight from the shared stream chunks, so each extra
+ * watcher costs a system call rather than a copy of the output.
+ *
+ * PARAMETERS:
+ *
+ *   R : The reader
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void reader_write(ReaderType *R)
+{
+  struct iovec Iov[MAX_IOV];
+  struct msghdr Msg;
+  struct epoll_event Event;
+  ChunkType *Chunk;
+  ChunkType *Next;
+  long long Now;
+  size_t Offset;
+  size_t Total;
+  size_t Len;
+  ssize_t Sent;
+  int Count;
+  int WantWrite;
+
+  R->WakeAt = 0;
+  if (R->Fd < 0) return;
+
+  Now = now_ms();
+  WantWrite = 0;
+
+  for (;;)
+  {
+    //
+    // Gather the output that is due
+    //
+    Count = 0;
+    Total = 0;
+
+    if (R->PrefixSent < R->Prefix.Len)
+    {
+      Iov[Count].iov_base = R->Prefix.Data + R->PrefixSent;
+      Iov[Count].iov_len = R->Prefix.Len - R->PrefixSent;
+      Total += Iov[Count].iov_len;
+      Count++;
+    }
+
+    Chunk = R->Chunk;
+    Offset = R->Offset;
+    while ((Chunk != NULL) && (Count < MAX_IOV))
+    {
+      if ((Offset == 0) && (Chunk->Due > Now))
+      {
+        R->WakeAt = Chunk->Due;
+        break;
+      }
+
+      if (Offset < Chunk->Len)
+      {
+        Iov[Count].iov_base = Chunk->Data + Offset;
+        Iov[Count].iov_len = Chunk->Len - Offset;
+        Total += Iov[Count].iov_len;
+        Count++;
+      }
+
+      Chunk = Chunk->Next;
+      Offset = 0;
+    }
+
+    if (Count == 0) break;
+
+    memset(&Msg, 0, sizeof(Msg));
+    Msg.msg_iov = Iov;
+    Msg.msg_iovlen = Count;
+
+    do
+    {
+      Sent = sendmsg(R->Fd, &Msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while ((Sent < 0) && (errno == EINTR));
+
+    if (Sent < 0)
+    {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      {
+        reader_close(R);
+        return;
+      }
+      Sent = 0;
+    }
+
+    if ((size_t) Sent < Total) WantWrite = 1;
+
+    //
+    // Move past the output sent
+    //
+    Len = R->Prefix.Len - R->PrefixSent;
+    if ((size_t) Sent < Len) Len = Sent;
+    R->PrefixSent += Len;
+    Sent -= Len;
+    if (R->PrefixSent == R->Prefix.Len)
+    {
+      R->Prefix.Len = 0;
+      R->PrefixSent = 0;
+    }
+
+    while (R->Chunk != NULL)
+    {
+      Len = R->Chunk->Len - R->Offset;
+      if ((size_t) Sent < Len) Len = Sent;
+      R->Offset += Len;
+      R->Pos += Len;
+      Sent -= Len;
+
+      if ((R->Offset < R->Chunk->Len) || (R->Chunk->Next == NULL)) break;
+
+      Next = R->Chunk->Next;
+      Next->RefCount++;
+      chunk_release(R->Chunk);
+      R->Chunk = Next;
+      R->Offset = 0;
+    }
+
+    if (WantWrite || (R->WakeAt != 0) || (Chunk == NULL)) break;
+  }
+
+  if (WantWrite != R->WantWrite)
+  {
+    R->WantWrite = WantWrite;
+    Event.events = EPOLLIN | (WantWrite ? EPOLLOUT : 0);
+    Event.data.ptr = R;
+    epoll_ctl(Epoll, EPOLL_CTL_MOD, R->Fd, &Event);
+  }
+
+  if (R->Stream == NULL) return;
+
+  if ((R->Stream->Total - R->Pos) > OUTPUT_LIMIT)
+  {
+    /* The reader isn't keeping up with the output */
+    reader_close(R);
+    return;
+  }
+
+  //
+  // Keep readers with delayed output on the timed list
+  //
+  if ((R->WakeAt != 0) && !R->Timed)
+  {
+    R->Timed = 1;
+    R->NextTimed = TimedList;
+    TimedList = R;
+  }
+
+  //
+  // Show watchers that have seen the end of a game the list again
+  //
+  if ((R->Kind == READER_WATCHER) && R->Stream->Ended &&
+      (R->Pos == R->Stream->Total) && (R->Prefix.Len == 0))
+  {
+    watcher_show_list(R, "The game has ended.");
+    reader_write(R);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: stream_notify
+ *
+ * DESCRIPTION:
+ * Send the new output in a stream to everyone watching it.
+ *
+ * PARAMETERS:
+ *
+ *   Stream : The stream
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void stream_notify(StreamType *Stream)
+{
+  ReaderType *R;
+  ReaderType *Next;
+
+  for (R = Stream->Watchers ; R != NULL ; R = Next)
+  {
+    /* Writing may move the watcher off this stream */
+    Next = R->NextWatcher;
+    reader_write(R);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: stream_publish
+ *
+ * DESCRIPTION:
+ * Add a session's pending output to the end of its output stream, where
+ * the player and watchers can read it.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void stream_publish(SessionType *S)
+{
+  StreamType *Stream;
+  ChunkType *Chunk;
+
+  if ((S->Pending.Len == 0) && (S->NextDue == 0)) return;
+
+  Stream = S->Stream;
+
+  Chunk = chunk_new(S->Pending.Data, S->Pending.Len, S->NextDue);
+  if (Chunk != NULL)
+  {
+    /* One reference from the chunk before it, and one as the tail */
+    Chunk->RefCount = 2;
+    Stream->Tail->Next = Chunk;
+    chunk_release(Stream->Tail);
+    Stream->Tail = Chunk;
+    Stream->Total += S->Pending.Len;
+  }
+
+  S->Pending.Len = 0;
+  S->NextDue = 0;
+
+  //
+  // Keep the pending buffer small between turns
+  //
+  if (S->Pending.Size > 65536) vterm_buf_free(&S->Pending);
+}
+
+/* =============================================================================
+ * FUNCTION: session_free
+ *
+ * DESCRIPTION:
+ * Close a session and free all of its resources.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void session_free(SessionType *S)
+{
+  ReaderType **Link;
+
+  hang_up(S);
+
+  if (S->Prev != NULL)
+  {
+    S->Prev->Next = S->Next;
+  }
+  else
+  {
+    Sessions = S->Next;
+  }
+  if (S->Next != NULL) S->Next->Prev = S->Prev;
+
+  if (S->Player.Timed)
+  {
+    for (Link = &TimedList ; *Link != &S->Player ; Link = &(*Link)->NextTimed) ;
+    *Link = S->Player.NextTimed;
+  }
+
+  if (Resident == S) Resident = NULL;
+
+  if (S->Stack != NULL) munmap(S->Stack, STACK_SIZE);
+  if (S->Game != NULL) snapshot_free(S->Game);
+  if (S->Display != NULL) serv_display_free(S->Display);
+  if (S->Stream != NULL) stream_release(S->Stream);
+  vterm_buf_free(&S->Pending);
+  vterm_buf_free(&S->Player.Prefix);
+  free(S);
+
+  SessionCount--;
+}
+
+/* =============================================================================
+ * FUNCTION: session_end
+ *
+ * DESCRIPTION:
+ * Mark a session's game as ended, and let its watchers know.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void session_end(SessionType *S)
+{
+  S->State = SESSION_DONE;
+  if (Resident == S) Resident = NULL;
+
+  S->Stream->Ended = 1;
+  stream_notify(S->Stream);
+}
+
+/* =============================================================================
+ * FUNCTION: session_abandon
+ *
+ * DESCRIPTION:
+ * End a session whose game cannot be continued.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void session_abandon(SessionType *S)
+{
+  fprintf(stderr, "ularn-server: out of memory, abandoning game of %s\n",
+          S->Name);
+
+  /* Set first, so that hanging up doesn't queue the game to run */
+  S->State = SESSION_DONE;
+
+  hang_up(S);
+  session_end(S);
+}
+
+/* =============================================================================
+ * FUNCTION: session_read
+ *
+ * DESCRIPTION:
+ * Read the keys typed by a session's player into its input queue.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void session_read(SessionType *S)
+{
+  unsigned char Buf[512];
+  ChunkType *Chunk;
+  ssize_t n;
+  int i;
+  int ch;
+
+  n = read(S->Player.Fd, Buf, sizeof(Buf));
+  if (n < 0)
+  {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) return;
+  }
+  if (n <= 0)
+  {
+    hang_up(S);
+    return;
+  }
+
+  for (i = 0 ; i < n ; i++)
+  {
+    ch = Buf[i];
+
+    //
+    // Enter is CR from a raw terminal, but may be LF or CR LF from other
+    // clients.
+    //
+    if ((ch == '\n') && S->LastCR)
+    {
+      S->LastCR = 0;
+      continue;
+    }
+    S->LastCR = (ch == '\r');
+    if (ch == '\n') ch = '\r';
+
+    if (S->InputCount < INPUT_SIZE)
+    {
+      S->Input[(S->InputHead + S->InputCount) % INPUT_SIZE] = (unsigned char) ch;
+      S->InputCount++;
+    }
+  }
+
+  //
+  // A key cuts short any animation still being sent, for the player and
+  // for anyone watching.
+  //
+  if (S->LastDue != 0)
+  {
+    for (Chunk = S->Player.Chunk ; Chunk != NULL ; Chunk = Chunk->Next)
+    {
+      Chunk->Due = 0;
+    }
+    S->LastDue = 0;
+
+    reader_write(&S->Player);
+    stream_notify(S->Stream);
+  }
+
+  if (S->State == SESSION_WAIT_KEY)
+  {
+    make_ready(S);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: watcher_free
+ *
+ * DESCRIPTION:
+ * Free a watcher connection.
+ *
+ * PARAMETERS:
+ *
+ *   R : The watcher
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void watcher_free(ReaderType *R)
+{
+  ReaderType **Link;
+
+  reader_close(R);
+
+  if (R->Timed)
+  {
+    for (Link = &TimedList ; *Link != R ; Link = &(*Link)->NextTimed) ;
+    *Link = R->NextTimed;
+  }
+
+  if (R->PrevConn != NULL)
+  {
+    R->PrevConn->NextConn = R->NextConn;
+  }
+  else
+  {
+    Watchers = R->NextConn;
+  }
+  if (R->NextConn != NULL) R->NextConn->PrevConn = R->PrevConn;
+
+  vterm_buf_free(&R->Prefix);
+  free(R);
+
+  WatcherCount--;
+}
+
+/* =============================================================================
+ * FUNCTION: watcher_choose
+ *
+ * DESCRIPTION:
+ * Start a watcher watching the player whose name they have typed.
+ *
+ * PARAMETERS:
+ *
+ *   R : The watcher
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void watcher_choose(ReaderType *R)
+{
+  char Msg[USERNAME_LENGTH + 40];
+  SessionType *S;
+
+  R->Line[R->LineLen] = 0;
+
+  for (S = Sessions ; S != NULL ; S = S->Next)
+  {
+    if ((S->State != SESSION_DONE) && (strcmp(S->Name, R->Line) == 0)) break;
+  }
+
+  if ((R->LineLen == 0) || (S == NULL))
+  {
+    if (R->LineLen > 0)
+    {
+      sprintf(Msg, "Nobody called %s is playing.", R->Line);
+    }
+    watcher_show_list(R, (R->LineLen > 0) ? Msg : NULL);
+    return;
+  }
+
+  //
+  // The player's session is not running, so everything its display has
+  // drawn is in the stream. Start with a picture of the screen, then send
+  // the stream from here on.
+  //
+  serv_display_keyframe(S->Display, &R->Prefix);
+  reader_attach(R, S->Stream);
+}
+
+/* =============================================================================
+ * FUNCTION: watcher_read
+ *
+ * DESCRIPTION:
+ * Handle the keys typed by a watcher.
+ *
+ * PARAMETERS:
+ *
+ *   R : The watcher
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void watcher_read(ReaderType *R)
+{
+  unsigned char Buf[256];
+  ssize_t n;
+  int i;
+  int ch;
+
+  n = read(R->Fd, Buf, sizeof(Buf));
+  if (n < 0)
+  {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) return;
+  }
+  if (n <= 0)
+  {
+    reader_close(R);
+    return;
+  }
+
+  for (i = 0 ; (i < n) && (R->Fd >= 0) ; i++)
+  {
+    ch = Buf[i];
+
+    if ((ch == 3) || (ch == 4))
+    {
+      /* ^C or ^D */
+      reader_close(R);
+    }
+    else if (R->Stream != NULL)
+    {
+      /* Watching, so the only key that does anything is q */
+      if ((ch == 'q') || (ch == 'Q')) watcher_show_list(R, NULL);
+    }
+    else if ((ch == '\r') || (ch == '\n'))
+    {
+      watcher_choose(R);
+    }
+    else if ((ch == 8) || (ch == 127))
+    {
+      if (R->LineLen > 0)
+      {
+        R->LineLen--;
+        vterm_buf_add(&R->Prefix, "\b \b", 3);
+      }
+    }
+    else if ((isalnum(ch) || (ch == '_') || (ch == '-')) &&
+             (R->LineLen < USERNAME_LENGTH))
+    {
+      R->Line[R->LineLen++] = (char) ch;
+      vterm_buf_add(&R->Prefix, (char *) &Buf[i], 1);
+    }
+  }
+
+  reader_write(R);
+}
+
+/* =============================================================================
+ * FUNCTION: ask_name
+ *
+ * DESCRIPTION:
+ * Ask the player for their name, which must not be in use by another
+ * session. The game ends if the player disconnects.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void ask_name(SessionType *S)
+{
+  char Name[USERNAME_LENGTH + 1];
+  SessionType *Other;
+  int Valid;
+  int i;
+
+  for (;;)
+  {
+    Print("\nWhat is your name? ");
+    serv_get_string(Name, USERNAME_LENGTH);
+
+    if (S->Player.Fd < 0)
+    {
+      /* The player has gone before the game started */
+      endgame();
+    }
+
+    //
+    // The name is used in the save file name
+    //
+    Valid = (Name[0] != 0);
+    for (i = 0 ; Name[i] != 0 ; i++)
+    {
+      if (!isalnum((unsigned char) Name[i]) && (Name[i] != '_') && (Name[i] != '-'))
+      {
+        Valid = 0;
+      }
+    }
+
+    if (!Valid)
+    {
+      Print("\nNames may only use letters, digits, '_' and '-'.");
+      continue;
+    }
+
+    for (Other = Sessions ; Other != NULL ; Other = Other->Next)
+    {
+      if ((Other != S) && (Other->State != SESSION_DONE) &&
+          (strcmp(Other->Name, Name) == 0))
+      {
+        break;
+      }
+    }
+
+    if (Other != NULL)
+    {
+      Print("\nThat name is already playing.");
+      continue;
+    }
+
+    strcpy(S->Name, Name);
+    GetUser(S->Name, &S->UserId);
+    load_globals(S);
+
+    return;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: start_game
+ *
+ * DESCRIPTION:
+ * Start the game for a session: restore the player's saved game if there is
+ * one, otherwise make a new character.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void start_game(SessionType *S)
+{
+  snapshot_restore(InitialState);
+  game_over = 0;
+
+  set_display(DISPLAY_TEXT);
+  ClearText();
+
+  Printf("Welcome to ULarn %s.%s (%s)\n", LARN_VERSION, LARN_PATCHLEVEL, LARN_DATE);
+
+  ask_name(S);
+
+  //
+  // Seed each session differently, so that new games started in the same
+  // second draw different level salts in makeplayer and so get different
+  // dungeons. A restored game keeps the salt from its save file.
+  //
+  newgame();
+  game_srand((unsigned long) initialtime ^ ((unsigned long) S->Id << 16));
+
+  restorflag = 0;
+  char_picked = 0;
+
+  if (access(savefilename, 0) == 0)
+  {
+    restorflag = 1;
+    hitflag = 1;
+    Print("\nRestoring...");
+    restoregame(savefilename);
+  }
+  else
+  {
+    /* make the character that will play */
+    makeplayer();
+    /* make the dungeon */
+    newcavelevel(0);
+
+    if (nowelcome == 0)
+    {
+      /* welcome the player to the game */
+      welcome();
+    }
+  }
+
+  /* set up the desired difficulty  */
+  sethard(Difficulty);
+
+  set_display(DISPLAY_MAP);
+
+  showplayer();
+
+  yrepcount = 0;
+  hit2flag = 0;
+}
+
+/* =============================================================================
+ * FUNCTION: session_main
+ *
+ * DESCRIPTION:
+ * The entry point of a session's coroutine. This plays the game until it
+ * ends, then passes control back to the event loop for the last time.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   Does not return.
+ */
+static void session_main(void)
+{
+  SessionType *S;
+  jmp_buf EndJump;
+
+  S = Current;
+
+  /* When the game ends, endgame returns here instead of exiting */
+  if (setjmp(EndJump) == 0)
+  {
+    S->EndJump = &EndJump;
+    game_end_jump = &EndJump;
+
+    start_game(S);
+
+    while (do_one_turn() != ACTION_QUIT) ;
+
+    endgame();
+  }
+
+  serv_display_flush();
+
+  S->State = SESSION_DONE;
+  swapcontext(&S->Context, &LoopContext);
+}
+
+/* =============================================================================
+ * FUNCTION: session_new
+ *
+ * DESCRIPTION:
+ * Create a session for a new connection and queue it to start its game.
+ *
+ * PARAMETERS:
+ *
+ *   Fd : The player's socket
+ *
+ * RETURN VALUE:
+ *
+ *   The session, or NULL if there is not enough memory.
+ */
+static SessionType *session_new(int Fd)
+{
+  SessionType *S;
+  struct epoll_event Event;
+
+  S = (SessionType *) calloc(1, sizeof(SessionType));
+  if (S == NULL) return NULL;
+
+  S->Id = NextSessionId++;
+  S->State = SESSION_START;
+
+  S->Display = serv_display_new();
+  S->Stream = stream_new();
+
+  S->Stack = (char *) mmap(NULL, STACK_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (S->Stack == MAP_FAILED) S->Stack = NULL;
+
+  if ((S->Display == NULL) || (S->Stream == NULL) || (S->Stack == NULL))
+  {
+    if (S->Stack != NULL) munmap(S->Stack, STACK_SIZE);
+    if (S->Display != NULL) serv_display_free(S->Display);
+    if (S->Stream != NULL) stream_release(S->Stream);
+    free(S);
+    return NULL;
+  }
+
+  /* Guard page, so a stack overflow faults instead of corrupting memory */
+  mprotect(S->Stack, 4096, PROT_NONE);
+
+  getcontext(&S->Context);
+  S->Context.uc_stack.ss_sp = S->Stack;
+  S->Context.uc_stack.ss_size = STACK_SIZE;
+  S->Context.uc_link = NULL;
+  makecontext(&S->Context, session_main, 0);
+
+  S->Player.Kind = READER_PLAYER;
+  S->Player.Fd = Fd;
+  S->Player.Session = S;
+  reader_attach(&S->Player, S->Stream);
+
+  Event.events = EPOLLIN;
+  Event.data.ptr = &S->Player;
+  epoll_ctl(Epoll, EPOLL_CTL_ADD, Fd, &Event);
+
+  S->Next = Sessions;
+  if (Sessions != NULL) Sessions->Prev = S;
+  Sessions = S;
+  SessionCount++;
+
+  make_ready(S);
+
+  return S;
+}
+
+/* =============================================================================
+ * FUNCTION: session_run
+ *
+ * DESCRIPTION:
+ * Make a session's game resident and run it until it waits for a key or
+ * ends, then send its output to the player and watchers.
+ *
+ * PARAMETERS:
+ *
+ *   S : The session
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void session_run(SessionType *S)
+{
+  if (Resident != S)
+  {
+    //
+    // Swap the resident game out for this one
+    //
+    if (Resident != NULL)
+    {
+      Resident->Game = snapshot_take();
+      if (Resident->Game == NULL)
+      {
+        session_abandon(Resident);
+      }
+    }
+
+    if (S->Game != NULL)
+    {
+      if (!snapshot_restore(S->Game))
+      {
+        session_abandon(S);
+        return;
+      }
+
+      snapshot_free(S->Game);
+      S->Game = NULL;
+    }
+
+    load_globals(S);
+    Resident = S;
+  }
+
+  Current = S;
+  serv_display_select(S->Display);
+  game_end_jump = S->EndJump;
+
+  swapcontext(&LoopContext, &S->Context);
+
+  Current = NULL;
+
+  stream_publish(S);
+  reader_write(&S->Player);
+
+  if (S->State == SESSION_DONE)
+  {
+    session_end(S);
+  }
+  else
+  {
+    stream_notify(S->Stream);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: accept_sessions
+ *
+ * DESCRIPTION:
+ * Accept all waiting player connections.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void accept_sessions(void)
+{
+  static char FullMsg[] = "The server is full, please try again later.\r\n";
+  int Fd;
+
+  for (;;)
+  {
+    Fd = accept(Listener, NULL, NULL);
+    if (Fd < 0) return;
+
+    fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK);
+    fcntl(Fd, F_SETFD, FD_CLOEXEC);
+
+    if ((SessionCount >= MaxSessions) || (session_new(Fd) == NULL))
+    {
+      send(Fd, FullMsg, sizeof(FullMsg) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+      close(Fd);
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: accept_watchers
+ *
+ * DESCRIPTION:
+ * Accept all waiting watcher connections, and show them who is playing.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void accept_watchers(void)
+{
+  static char FullMsg[] = "Too many people are watching, please try again later.\r\n";
+  struct epoll_event Event;
+  ReaderType *R;
+  int Fd;
+
+  for (;;)
+  {
+    Fd = accept(WatchListener, NULL, NULL);
+    if (Fd < 0) return;
+
+    fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK);
+    fcntl(Fd, F_SETFD, FD_CLOEXEC);
+
+    R = NULL;
+    if (WatcherCount < MaxWatchers)
+    {
+      R = (ReaderType *) calloc(1, sizeof(ReaderType));
+    }
+
+    if (R == NULL)
+    {
+      send(Fd, FullMsg, sizeof(FullMsg) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+      close(Fd);
+      continue;
+    }
+
+    R->Kind = READER_WATCHER;
+    R->Fd = Fd;
+
+    R->NextConn = Watchers;
+    if (Watchers != NULL) Watchers->PrevConn = R;
+    Watchers = R;
+    WatcherCount++;
+
+    Event.events = EPOLLIN;
+    Event.data.ptr = R;
+    epoll_ctl(Epoll, EPOLL_CTL_ADD, Fd, &Event);
+
+    watcher_show_list(R, NULL);
+    reader_write(R);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: open_listener
+ *
+ * DESCRIPTION:
+ * Create the listening Unix domain socket.
+ *
+ * PARAMETERS:
+ *
+ *   Path : The path of the socket
+ *
+ * RETURN VALUE:
+ *
+ *   The socket, or -1 if it could not be created.
+ */
+static int open_listener(char *Path)
+{
+  struct sockaddr_un Addr;
+  int Fd;
+
+  if (strlen(Path) >= sizeof(Addr.sun_path)) return -1;
+
+  Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Fd < 0) return -1;
+
+  fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK);
+  fcntl(Fd, F_SETFD, FD_CLOEXEC);
+
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  strcpy(Addr.sun_path, Path);
+
+  unlink(Path);
+
+  if ((bind(Fd, (struct sockaddr *) &Addr, sizeof(Addr)) < 0) ||
+      (listen(Fd, SOMAXCONN) < 0))
+  {
+    close(Fd);
+    return -1;
+  }
+
+  return Fd;
+}
+
+/* =============================================================================
+ * FUNCTION: setup_game
+ *
+ * DESCRIPTION:
+ * Perform the once off initialisation shared by all sessions.
+ *
+ * PARAMETERS:
+ *
+ *   LibDir  : The directory holding the game data files
+ *
+ *   SaveDir : The directory for saved games
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the game could not be initialised.
+ */
+static int setup_game(char *LibDir, char *SaveDir)
+{
+  if ((strlen(LibDir) > MAXPATHLEN - 16) ||
+      (strlen(SaveDir) > MAXPATHLEN - 64))
+  {
+    return 0;
+  }
+
+  strcpy(libdir, LibDir);
+  strcpy(savedir, SaveDir);
+  sprintf(scorefile, "%.*s/%s", MAXPATHLEN - 16, libdir, SCORENAME);
+  sprintf(helpfile, "%.*s/%s", MAXPATHLEN - 16, libdir, HELPNAME);
+  sprintf(larnlevels, "%.*s/%s", MAXPATHLEN - 16, libdir, LEVELSNAME);
+  sprintf(fortfile, "%.*s/%s", MAXPATHLEN - 16, libdir, FORTSNAME);
+
+  if (!init_app()) return 0;
+
+  /* Anything printed outside a session goes nowhere */
+  serv_display_select(serv_display_new());
+
+  /* make the scoreboard if it is not there (don't clear) */
+  if ((access(scorefile, 0) == -1) && (makeboard() == -1))
+  {
+    fprintf(stderr, "Cannot create the scoreboard %s\n", scorefile);
+    return 0;
+  }
+
+  init_cells();
+
+  InitialState = snapshot_take();
+
+  return (InitialState != NULL);
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: server_get_key
+ */
+int server_get_key(void)
+{
+  SessionType *S;
+  int Key;
+
+  S = Current;
+
+  while (S->InputCount == 0)
+  {
+    if (S->Player.Fd < 0) return -1;
+
+    serv_display_flush();
+
+    S->State = SESSION_WAIT_KEY;
+    swapcontext(&S->Context, &LoopContext);
+  }
+
+  Key = S->Input[S->InputHead];
+  S->InputHead = (S->InputHead + 1) % INPUT_SIZE;
+  S->InputCount--;
+
+  return Key;
+}
+
+/* =============================================================================
+ * FUNCTION: server_peek_key
+ */
+int server_peek_key(void)
+{
+  if ((Current == NULL) || (Current->InputCount == 0)) return -1;
+
+  return Current->Input[Current->InputHead];
+}
+
+/* =============================================================================
+ * FUNCTION: server_output
+ */
+VTermBufType *server_output(void)
+{
+  if (Current == NULL)
+  {
+    Discard.Len = 0;
+    return &Discard;
+  }
+
+  return &Current->Pending;
+}
+
+/* =============================================================================
+ * FUNCTION: server_delay
+ */
+void server_delay(int Ms)
+{
+  SessionType *S;
+  long long Due;
+
+  S = Current;
+  if ((S == NULL) || (Ms <= 0)) return;
+
+  //
+  // Delays add up, starting from now or the end of the last delay
+  //
+  Due = now_ms();
+  if (S->LastDue > Due) Due = S->LastDue;
+  Due += Ms;
+
+  //
+  // The output so far goes out before the delay, and the output that
+  // follows goes out after it.
+  //
+  if (S->Pending.Len > 0) stream_publish(S);
+
+  S->NextDue = Due;
+  S->LastDue = Due;
+}
+
+/* =============================================================================
+ * FUNCTION: main
+ */
+int main(int argc, char *argv[])
+{
+  struct epoll_event Events[MAX_EVENTS];
+  struct epoll_event Event;
+  struct rlimit Limit;
+  sigset_t StopSignals;
+  sigset_t WaitMask;
+  SessionType *S;
+  SessionType *NextSession;
+  ReaderType *R;
+  ReaderType *NextReader;
+  ReaderType **Link;
+  char *LibDir;
+  char *SaveDir;
+  char *Path;
+  char *WatchPath;
+  long long Now;
+  long long Due;
+  int Timeout;
+  int Count;
+  int i;
+  int opt;
+
+  LibDir = libdir;
+  SaveDir = ".";
+  WatchPath = NULL;
+
+  while ((opt = ugetopt(argc, argv, "l:s:d:m:w:nq")) != -1)
+  {
+    switch (opt)
+    {
+      case 'l':
+        LibDir = optarg;
+        break;
+      case 's':
+        SaveDir = optarg;
+        break;
+      case 'd':
+        Difficulty = atoi(optarg);
+        if (Difficulty > 100) Difficulty = 100;
+        break;
+      case 'm':
+        MaxSessions = atoi(optarg);
+        MaxWatchers = MaxSessions;
+        break;
+      case 'w':
+        WatchPath = optarg;
+        break;
+      case 'n':
+        nowelcome = 1;
+        break;
+      case 'q':
+        nonap = 1;
+        break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    fprintf(stderr,
+      "Usage: %s [-l libdir] [-s savedir] [-d difficulty] [-m sessions] "
+      "[-w watch socket] [-n] [-q] socket\n",
+      argv[0]);
+    return 2;
+  }
+  Path = argv[optind];
+
+  if (!setup_game(LibDir, SaveDir))
+  {
+    fprintf(stderr, "Cannot initialise the game\n");
+    return 1;
+  }
+
+  //
+  // Each player and watcher needs a socket
+  //
+  if (getrlimit(RLIMIT_NOFILE, &Limit) == 0)
+  {
+    Limit.rlim_cur = Limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &Limit);
+  }
+
+  //
+  // The stop signals are only taken while waiting for events, so that the
+  // loop sees the stop request before it waits again.
+  //
+  sigemptyset(&StopSignals);
+  sigaddset(&StopSignals, SIGINT);
+  sigaddset(&StopSignals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &StopSignals, &WaitMask);
+  sigdelset(&WaitMask, SIGINT);
+  sigdelset(&WaitMask, SIGTERM);
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop_handler);
+  signal(SIGTERM, stop_handler);
+
+  Epoll = epoll_create1(EPOLL_CLOEXEC);
+  Listener = open_listener(Path);
+  if ((Epoll < 0) || (Listener < 0))
+  {
+    fprintf(stderr, "Cannot listen on %s\n", Path);
+    return 1;
+  }
+
+  Event.events = EPOLLIN;
+  Event.data.ptr = &Listener;
+  epoll_ctl(Epoll, EPOLL_CTL_ADD, Listener, &Event);
+
+  if (WatchPath != NULL)
+  {
+    WatchListener = open_listener(WatchPath);
+    if (WatchListener < 0)
+    {
+      fprintf(stderr, "Cannot listen on %s\n", WatchPath);
+      return 1;
+    }
+
+    Event.events = EPOLLIN;
+    Event.data.ptr = &WatchListener;
+    epoll_ctl(Epoll, EPOLL_CTL_ADD, WatchListener, &Event);
+  }
+
+  while ((Listener >= 0) || (SessionCount > 0))
+  {
+    //
+    // On a stop request, stop listening, send the watchers away and
+    // disconnect every player so that their games are saved.
+    //
+    if (Stopping && (Listener >= 0))
+    {
+      close(Listener);
+      Listener = -1;
+      unlink(Path);
+
+      if (WatchListener >= 0)
+      {
+        close(WatchListener);
+        WatchListener = -1;
+        unlink(WatchPath);
+      }
+
+      while (Watchers != NULL)
+      {
+        watcher_free(Watchers);
+      }
+
+      for (S = Sessions ; S != NULL ; S = S->Next)
+      {
+        hang_up(S);
+      }
+
+      if (SessionCount == 0) break;
+    }
+
+    //
+    // Wait until the next delayed output is due
+    //
+    Now = now_ms();
+    Timeout = -1;
+    for (R = TimedList ; R != NULL ; R = R->NextTimed)
+    {
+      if (R->WakeAt != 0)
+      {
+        Due = R->WakeAt - Now;
+        if (Due < 0) Due = 0;
+        if ((Timeout < 0) || (Due < Timeout)) Timeout = (int) Due;
+      }
+    }
+    if (ReadyHead != NULL) Timeout = 0;
+
+    Count = epoll_pwait(Epoll, Events, MAX_EVENTS, Timeout, &WaitMask);
+
+    for (i = 0 ; i < Count ; i++)
+    {
+      if (Events[i].data.ptr == &Listener)
+      {
+        accept_sessions();
+        continue;
+      }
+
+      if (Events[i].data.ptr == &WatchListener)
+      {
+        accept_watchers();
+        continue;
+      }
+
+      R = (ReaderType *) Events[i].data.ptr;
+
+      if ((R->Fd >= 0) && (Events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+      {
+        if (R->Kind == READER_PLAYER)
+        {
+          session_read(R->Session);
+        }
+        else
+        {
+          watcher_read(R);
+        }
+      }
+      if ((R->Fd >= 0) && (Events[i].events & EPOLLOUT))
+      {
+        reader_write(R);
+      }
+    }
+
+    //
+    // Run every session that has something to do
+    //
+    while (ReadyHead != NULL)
+    {
+      S = ReadyHead;
+      ReadyHead = S->NextReady;
+      if (ReadyHead == NULL) ReadyTail = NULL;
+      S->Ready = 0;
+
+      if (S->State != SESSION_DONE) session_run(S);
+    }
+
+    //
+    // Send any delayed output that is now due
+    //
+    Now = now_ms();
+    for (R = TimedList ; R != NULL ; R = R->NextTimed)
+    {
+      if ((R->WakeAt != 0) && (R->WakeAt <= Now)) reader_write(R);
+    }
+
+    Link = &TimedList;
+    while (*Link != NULL)
+    {
+      R = *Link;
+      if (R->WakeAt == 0)
+      {
+        *Link = R->NextTimed;
+        R->Timed = 0;
+      }
+      else
+      {
+        Link = &R->NextTimed;
+      }
+    }
+
+    //
+    // Free the watchers that have gone, and close the sessions that have
+    // ended once their output has gone.
+    //
+    for (R = Watchers ; R != NULL ; R = NextReader)
+    {
+      NextReader = R->NextConn;
+      if (R->Fd < 0) watcher_free(R);
+    }
+
+    for (S = Sessions ; S != NULL ; S = NextSession)
+    {
+      NextSession = S->Next;
+
+      if ((S->State == SESSION_DONE) &&
+          ((S->Player.Fd < 0) || (S->Player.Pos == S->Stream->Total)))
+      {
+        session_free(S);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: server.h
+ *
+ * DESCRIPTION:
+ * Multi-session game server module.
+ * The server accepts players on a Unix domain socket and plays all of their
+ * games in one process, from a single epoll event loop.
+ *
+ * The game keeps its state in global variables, so only one game can be
+ * resident at a time. Each session's game runs on its own coroutine stack,
+ * and when the loop switches to a different session the resident game is
+ * saved to an in-memory snapshot (see snapshot.h) and the next one restored.
+ * A game only gives up control while waiting for a key, so between
+ * keypresses a session costs only its snapshot, its screen and the touched
+ * part of its stack. The monster tables, help, fortunes and level maps are
+ * shared by every session.
+ *
+ * The display interface for sessions is in ularn_winserv.c. It renders into
+ * a per-session virtual terminal, and the changes are encoded into the
+ * session's output buffer whenever the game waits for input. The encoded
+ * output is shared by the player and anyone watching them.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * server_get_key  : Get the next input byte for the current session
+ * server_peek_key : Look at the next input byte without removing it
+ * server_output   : Get the output buffer for the current session
+ * server_delay    : Delay the output that follows for the current session
+ *
+ * =============================================================================
+ */
+
+#ifndef __SERVER_H
+#define __SERVER_H
+
+#include "vterm.h"
+
+/* =============================================================================
+ * FUNCTION: server_get_key
+ *
+ * DESCRIPTION:
+ * Get the next input byte typed by the player of the current session.
+ * If none is waiting then the display is flushed and the session gives up
+ * control until one arrives.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The input byte, or -1 if the player has disconnected.
+ */
+int server_get_key(void);
+
+/* =============================================================================
+ * FUNCTION: server_peek_key
+ *
+ * DESCRIPTION:
+ * Look at the next input byte for the current session without removing it.
+ * This never waits.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The next input byte, or -1 if there is none waiting.
+ */
+int server_peek_key(void);
+
+/* =============================================================================
+ * FUNCTION: server_output
+ *
+ * DESCRIPTION:
+ * Get the output buffer for the current session. Bytes added to it are sent
+ * to the player and watchers once the game waits for input.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The output buffer.
+ */
+VTermBufType *server_output(void);
+
+/* =============================================================================
+ * FUNCTION: server_delay
+ *
+ * DESCRIPTION:
+ * Delay sending the output that follows to the player of the current
+ * session. This is used for animation: the game does not stop, but the
+ * frames reach the player and watchers with the delays between them.
+ * Pending delays are cut short when the player presses a key.
+ *
+ * PARAMETERS:
+ *
+ *   Ms : The delay in milliseconds
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void server_delay(int Ms);
+
+#endif
@@ -656,7 +656,7 @@ void seemagic(int arg)
 /* =============================================================================
  * FUNCTION: show1
  */
-void show1 (int idx, char *str2[], int known[])
+void show1 (int idx, char *const str2[], int known[])
 {
   /* standard */
   if (known == 0)
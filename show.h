@@ -206,7 +206,7 @@ void seemagic(int arg);
  *
  *   None.
  */
-void show1 (int idx, char *str2[], int known[]);
+void show1 (int idx, char *const str2[], int known[]);
 
 /* =============================================================================
  * FUNCTION: show3
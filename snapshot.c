@@ -0,0 +1,263 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: snapshot.c
+ *
+ * DESCRIPTION:
+ * Game snapshot module.
+ * This module takes in-memory snapshots of the full game state and restores
+ * them, so that a program searching ahead (such as an agent) can try a
+ * sequence of actions and go back to where it started without a save file.
+ *
+ * The dungeon levels are snapshot by the dungeon module, which shares the
+ * storage of unchanged levels. The rest of the game state is small and is
+ * written to a memory buffer using the same functions as the save file.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * snapshot_take    : Take a snapshot of the game
+ * snapshot_restore : Restore the game from a snapshot
+ * snapshot_free    : Free a snapshot
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "header.h"
+#include "ularn_game.h"
+#include "ularn_win.h"
+#include "snapshot.h"
+#include "savegame.h"
+#include "dungeon.h"
+#include "monster.h"
+#include "player.h"
+#include "sphere.h"
+#include "store.h"
+#include "scores.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+struct GameSnapshotType
+{
+  DungeonSnapshotType *Dungeon;
+
+  /* The monster table, as sethard scales it for the difficulty */
+  struct monst Monsters[MONST_COUNT];
+
+  /* The player, stores, monster data and spheres in save file format */
+  char *Data;
+  size_t Size;
+
+  /* The state carried between turns that is not in the save file */
+  unsigned long RandState;
+  int LastPx;
+  int LastPy;
+  int RepCount;
+  int HasteStep;
+  int LastHitX;
+  int LastHitY;
+  MonsterIdType LastMonst;
+  int GameOver;
+  char HitFlag;
+  char Hit2Flag;
+  char Hit3Flag;
+  char DropFlag;
+  char NoMove;
+};
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: write_data
+ *
+ * DESCRIPTION:
+ * Write the game state that is kept in the save file, apart from the
+ * dungeon levels, to a snapshot's memory buffer.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to write
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the buffer could not be written.
+ */
+static int write_data(GameSnapshotType *Snap)
+{
+  FILE *fp;
+#ifndef UNIX
+  long Size;
+#endif
+
+#ifdef UNIX
+  fp = open_memstream(&Snap->Data, &Snap->Size);
+#else
+  /* No memory streams, so use a temporary file and read it back */
+  fp = tmpfile();
+#endif
+  if (fp == NULL) return 0;
+
+  write_player(fp);
+  write_store(fp);
+  write_monster_data(fp);
+  write_spheres(fp);
+
+#ifndef UNIX
+  Size = ftell(fp);
+  rewind(fp);
+  Snap->Size = (size_t) Size;
+  Snap->Data = (char *) malloc(Snap->Size);
+  if ((Snap->Data != NULL) &&
+      (fread(Snap->Data, 1, Snap->Size, fp) != Snap->Size))
+  {
+    free(Snap->Data);
+    Snap->Data = NULL;
+  }
+#endif
+
+  fclose(fp);
+
+  return (Snap->Data != NULL);
+}
+
+/* =============================================================================
+ * FUNCTION: read_data
+ *
+ * DESCRIPTION:
+ * Read the game state that is kept in the save file, apart from the
+ * dungeon levels, from a snapshot's memory buffer.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to read
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the buffer could not be read.
+ */
+static int read_data(GameSnapshotType *Snap)
+{
+  FILE *fp;
+
+#ifdef UNIX
+  fp = fmemopen(Snap->Data, Snap->Size, "rb");
+#else
+  fp = tmpfile();
+  if (fp != NULL)
+  {
+    fwrite(Snap->Data, 1, Snap->Size, fp);
+    rewind(fp);
+  }
+#endif
+  if (fp == NULL) return 0;
+
+  /* The sphere reader adds to the current spheres, so clear them first */
+  free_spheres();
+
+  read_player(fp, SAVE_VERSION);
+  read_store(fp);
+  read_monster_data(fp);
+  read_spheres(fp);
+
+  fclose(fp);
+
+  return 1;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: snapshot_take
+ */
+GameSnapshotType *snapshot_take(void)
+{
+  GameSnapshotType *Snap;
+
+  Snap = (GameSnapshotType *) malloc(sizeof(GameSnapshotType));
+  if (Snap == NULL) return NULL;
+
+  Snap->Data = NULL;
+  Snap->Size = 0;
+
+  memcpy(Snap->Monsters, monster, sizeof(Snap->Monsters));
+
+  Snap->Dungeon = dungeon_snapshot();
+  if ((Snap->Dungeon == NULL) || !write_data(Snap))
+  {
+    snapshot_free(Snap);
+    return NULL;
+  }
+
+  Snap->RandState = rand_state;
+  Snap->LastPx = lastpx;
+  Snap->LastPy = lastpy;
+  Snap->RepCount = yrepcount;
+  Snap->HasteStep = HasteStep;
+  Snap->LastHitX = last_monst_hx;
+  Snap->LastHitY = last_monst_hy;
+  Snap->LastMonst = last_monst_id;
+  Snap->GameOver = game_over;
+  Snap->HitFlag = hitflag;
+  Snap->Hit2Flag = hit2flag;
+  Snap->Hit3Flag = hit3flag;
+  Snap->DropFlag = dropflag;
+  Snap->NoMove = nomove;
+
+  return Snap;
+}
+
+/* =============================================================================
+ * FUNCTION: snapshot_restore
+ */
+int snapshot_restore(GameSnapshotType *Snap)
+{
+  dungeon_restore(Snap->Dungeon);
+
+  /* This also clears the genocide flags for read_monster_data */
+  memcpy(monster, Snap->Monsters, sizeof(Snap->Monsters));
+
+  if (!read_data(Snap)) return 0;
+
+  rand_state = Snap->RandState;
+  lastpx = Snap->LastPx;
+  lastpy = Snap->LastPy;
+  yrepcount = Snap->RepCount;
+  HasteStep = Snap->HasteStep;
+  last_monst_hx = Snap->LastHitX;
+  last_monst_hy = Snap->LastHitY;
+  last_monst_id = Snap->LastMonst;
+  game_over = Snap->GameOver;
+  hitflag = Snap->HitFlag;
+  hit2flag = Snap->Hit2Flag;
+  hit3flag = Snap->Hit3Flag;
+  dropflag = Snap->DropFlag;
+  nomove = Snap->NoMove;
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: snapshot_free
+ */
+void snapshot_free(GameSnapshotType *Snap)
+{
+  if (Snap == NULL) return;
+
+  dungeon_snapshot_free(Snap->Dungeon);
+  free(Snap->Data);
+  free(Snap);
+}
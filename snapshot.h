@@ -0,0 +1,93 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: snapshot.h
+ *
+ * DESCRIPTION:
+ * Game snapshot module.
+ * This module takes in-memory snapshots of the full game state and restores
+ * them, so that a program searching ahead (such as an agent) can try a
+ * sequence of actions and go back to where it started without a save file.
+ *
+ * A snapshot holds the dungeon levels, the player, the stores, the monster
+ * table and data, the spheres, the random number state and the state carried between
+ * turns. Dungeon levels that the game has not changed since the snapshot
+ * was taken are shared with it rather than copied.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * snapshot_take    : Take a snapshot of the game
+ * snapshot_restore : Restore the game from a snapshot
+ * snapshot_free    : Free a snapshot
+ *
+ * =============================================================================
+ */
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+/*
+ * A game snapshot, as returned by snapshot_take.
+ */
+typedef struct GameSnapshotType GameSnapshotType;
+
+/* =============================================================================
+ * FUNCTION: snapshot_take
+ *
+ * DESCRIPTION:
+ * Take a snapshot of the game. This must only be called between turns, or
+ * while the game is waiting for input in the middle of a turn. In that case
+ * the state held in local variables by the interrupted turn is not included,
+ * so the snapshot must be restored before the turn continues.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The snapshot, or NULL if it could not be taken.
+ */
+GameSnapshotType *snapshot_take(void);
+
+/* =============================================================================
+ * FUNCTION: snapshot_restore
+ *
+ * DESCRIPTION:
+ * Restore the game from a snapshot, so that it continues exactly as it
+ * would have from the point the snapshot was taken.
+ * The snapshot is not changed and may be restored any number of times.
+ * The caller is responsible for redrawing the screen.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to restore
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the snapshot could not be read.
+ */
+int snapshot_restore(GameSnapshotType *Snap);
+
+/* =============================================================================
+ * FUNCTION: snapshot_free
+ *
+ * DESCRIPTION:
+ * Free a snapshot.
+ *
+ * PARAMETERS:
+ *
+ *   Snap : The snapshot to free (may be NULL)
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void snapshot_free(GameSnapshotType *Snap);
+
+#endif
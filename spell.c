@@ -19,6 +19,7 @@
  * EXPORTED FUNCTIONS
  *
  * godirect       : Function to process ranged spell effects (including scrolls)
+ * omnidirect     : Function to process spell effects on all adjacent monsters
  * annihilate     : Function to process the annihilate scroll
  * get_spell_code : Function to get the three letter spell code from the player
  * cast           : Function to cast a spell
@@ -37,19 +38,20 @@
 #include "monster.h"
 #include "player.h"
 #include "itm.h"
+#include "anim.h"
 
 /* =============================================================================
  * Exported variables
  */
 
-char splev[NLEVELS] = {
+const char splev[NLEVELS] = {
    1,  4,  7, 11, 15,
   20, 24, 28, 30, 32,
   33, 34, 35, 36, 37,
   38, 38, 38, 38, 38,
   38};
 
-char *spelcode[SPELL_COUNT] = {
+char *const spelcode[SPELL_COUNT] = {
   "pro",  "mle",  "dex",  "sle",  "chm",  "ssp", /* 0 - 5 */
   "web",  "str",  "enl",  "hel",  "cbl",  "cre",  "pha",  "inv", /*6-13 */
   "bal",  "cld",  "ply",  "can",  "has",  "ckl",  "vpr",  /* 14-20 */
@@ -58,7 +60,7 @@ char *spelcode[SPELL_COUNT] = {
   "sph",  "gen",  "sum",  "wtw",  "alt",  "per"  /* 35 - 38 */
 };
 
-char *spelname[SPELL_COUNT] = {
+char *const spelname[SPELL_COUNT] = {
   "protection", /* 0 */
   "magic missile",
   "dexterity",
@@ -100,7 +102,7 @@ char *spelname[SPELL_COUNT] = {
   "permanence"    /* 38 */
 };
 
-char *speldescript[SPELL_COUNT] = {
+char *const speldescript[SPELL_COUNT] = {
   /* 1 */
   "Generates a +2 protection field",
   "Creates and hurls a magic missile equivalent to a +1 magic arrow",
@@ -158,7 +160,7 @@ char *speldescript[SPELL_COUNT] = {
  *  spell =  index into spelldescript[] and spellname[]
  *  reaction = index into spelmes[]
  */
-static char spelweird[MONST_COUNT][SPELL_COUNT] = {
+static const char spelweird[MONST_COUNT][SPELL_COUNT] = {
 /*p m d s c s    w s e h c c p i    b c p c h c v    d l d g f f    s h s t m    s g s w a p */
 /* None (placeholder) */
 {  0,0,0,0,0,0,   0,0,0,0,0,0,0,0,   0,0,0,0,0,0,0,   0,0,0,0,0,0,   0,0,0,0,0,  0,0,0,0,0,0  } ,
@@ -314,7 +316,7 @@ static char spelweird[MONST_COUNT][SPELL_COUNT] = {
 {  0,13,0,8,3,10,   1,0,0,0,0,0,14,5,  18,0,9,0,0,4,0,   4,18,4,0,0,4,   4,4,0,9,4,   9,0,17,0,0,0  }
 };
 
-static char *spelmes[] = {
+static char *const spelmes[] = {
   /*  0 */  "",   /* spell has no effect on the monster */
   /*  1 */  "the web had no effect on the %s",
   /*  2 */  "the %s changed shape to avoid the web",
@@ -415,7 +417,7 @@ static int nospell(SpellType x, MonsterIdType monst)
  * FUNCTION: do_magic_fx
  *
  * DESCRIPTION:
- * Function to display the magic effect on the map.
+ * Function to queue the magic effect for display on the map.
  *
  * PARAMETERS:
  *
@@ -438,9 +440,10 @@ static void do_magic_fx(int x, int y, MagicEffectsType fx)
 
   for (frame = 0 ; frame < frame_count ; frame++)
   {
-    magic_effect(x, y, fx, frame);
-    nap(75);
+    anim_magic_effect(x, y, fx, frame);
+    anim_delay(75);
   }
+  anim_show_cell(x, y);
 }
 
 /* =============================================================================
@@ -518,11 +521,19 @@ static void vaporize_rock(void)
 
         if (show_effect)
         {
-          magic_effect(i, j, MAGIC_VAPORIZE, frame);
+          anim_magic_effect(i, j, MAGIC_VAPORIZE, frame);
         }
       }
     }
-    nap(75);
+    anim_delay(75);
+  }
+
+  for (i = xl; i <= xh; i++)
+  {
+    for (j = yl; j <= yh; j++)
+    {
+      anim_show_cell(i, j);
+    }
   }
 
   /* process spell effect */
@@ -584,12 +595,12 @@ static void vaporize_rock(void)
           break;
       }
 
-      item[i][j] = it;
+      set_item(i, j, it);
     }
   }
                
   /* Work out the new wall tiles for adjacent walls to those vaporised */
-  AnalyseWalls(playerx-2, playery-2, playerx+2, playery+2);
+  AnalyseWalls(xl, yl, xh, yh);
                 
   for (i = playerx-2 ; i <= playerx+2 ; i++)
   {
@@ -815,11 +826,11 @@ static void makewall(SpellType spnum)
           if ((level != 1) || (x != 33) || (y != MAXY - 1))
           {
             do_magic_fx(x, y, MAGIC_WALL);
-            item[x][y] = OWALL;
+            set_item(x, y, OWALL);
             show1cell(x, y);
             
             /* Work out the new wall tiles for adjacent walls */
-            AnalyseWalls(x-1, y-1, x+1, y+1);
+            UpdateWall(x, y);
                 
             for (tx = x-1 ; tx <= x+1 ; tx++)
             {
@@ -858,100 +869,6 @@ static void makewall(SpellType spnum)
   }
 }
 
-/* =============================================================================
- * FUNCTION: omnidirect
- *
- * DESCRIPTION:
- * Routine to cast a spell and then hit the monster in all directions.
- *
- * PARAMETERS:
- *
- *   spnum : The spell being cast
- *
- *   dam   : The amount of damage
- *
- *   str   : The format string to dislay for monsters hit by the spell.
- *           The string should contains a '%s' for the monster name.
- *
- *   fx    : The magic efect to display.
- *
- * RETURN VALUE:
- *
- *   None.
- */
-static void omnidirect(SpellType spnum, int dam, char *str, MagicEffectsType fx)
-{
-  int xl, yl;
-  int xh, yh;
-  int x, y;
-  MonsterIdType m;
-  int frame;
-  int frame_count;
-
-  /* check for bad args */
-  if (spnum < 0 || spnum >= SPELL_COUNT || str == 0) return;
-
-  /* get the area affected */
-  xl = max(playerx - 1, 0);
-  yl = max(playery - 1, 0);
-  xh = min(playerx + 1, MAXX - 1);
-  yh = min(playery + 1, MAXY - 1);
-
-  /* Show magic effect */
-  frame_count = magic_effect_frames(fx);
-
-  for (frame = 0 ; frame < frame_count ; frame++)
-  {
-    for (x = xl ; x <= xh; x++)
-    {
-      for (y = yl ; y <= yh ; y++)
-      {
-        if ((x != playerx) || (y != playery))
-        {
-          magic_effect(x, y, fx, frame);
-        }
-      }
-    }
-    nap(75);
-  }
-
-  /* Redisplay cell */
-  for (x = xl ; x <= xh ; x++)
-  {
-    for (y = yl ; y <= yh ; y++)
-    {
-      if ((x != playerx) || (y != playery))
-      {
-        show1cell(x, y);
-      }
-    }
-  }
-
-  for (x = xl ; x <= xh ; x++)
-  {
-    for (y = yl ; y <= yh ; y++)
-    {
-      m = mitem[x][y].mon;
-      if (m != MONST_NONE)
-      {
-        if (nospell(spnum, m) == 0)
-        {
-          ifblind(x, y);
-          Printc('\n');
-          Printf(str, lastmonst);
-          hitm(x, y, dam, 1);
-          nap(800);
-        }
-        else
-        {
-          last_monst_hx = (char) x;
-          last_monst_hy = (char) y;
-        }
-      }
-    }
-  }
-}
-
 /* =============================================================================
  * FUNCTION: dirpoly
  *
@@ -1009,7 +926,7 @@ static void dirpoly(SpellType spnum)
   do
   {
     m = rnd(MAXMONST + 7);
-    mitem[x][y].mon = (char) m;
+    set_monst(x, y, m);
   } while ((monster[m].flags & FL_GENOCIDED) != 0);
 
   hitp[x][y] = monster[m].hitpoints;
@@ -1180,7 +1097,7 @@ static void speldamage(SpellType Spell)
       {
         c[MOREDEFENSES] += SPELL_PRO_BOOST; /* protection field +2 */
       }
-      c[PROTECTIONTIME] += 250;
+      add_effect(PROTECTIONTIME, 250);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1198,7 +1115,7 @@ static void speldamage(SpellType Spell)
       {
         adjust_ability(DEXTERITY, SDEXTERITY_BOOST);
       }
-      c[DEXCOUNT] += 400;
+      add_effect(DEXCOUNT, 400);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1211,7 +1128,7 @@ static void speldamage(SpellType Spell)
 
     case SPELL_CHM:
       /* charm monster */
-      c[CHARMCOUNT] += c[CHARISMA] << 1;
+      add_effect(CHARMCOUNT, c[CHARISMA] << 1);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1235,7 +1152,7 @@ static void speldamage(SpellType Spell)
       {
         c[STREXTRA] += SSTRENGTH_BOOST;
       }
-      c[STRCOUNT] += 150 + rnd(100);
+      add_effect(STRCOUNT, 150 + rnd(100));
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1265,7 +1182,7 @@ static void speldamage(SpellType Spell)
 
     case SPELL_CBL:
       /* cure blindness  */
-      c[BLINDCOUNT] = 0;
+      set_effect(BLINDCOUNT, 0);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1305,7 +1222,7 @@ static void speldamage(SpellType Spell)
           j += 1 + ivenarg[i];
         }
       }
-      c[INVISIBILITY] += (j << 7) + 12;
+      add_effect(INVISIBILITY, (j << 7) + 12);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1329,12 +1246,12 @@ static void speldamage(SpellType Spell)
 
     case SPELL_CAN:
       /* cancellation  */
-      c[CANCELLATION] += 5 + clev;
+      add_effect(CANCELLATION, 5 + clev);
       return;
 
     case SPELL_HAS:
       /* haste self  */
-      c[HASTESELF] += 7 + clev;
+      add_effect(HASTESELF, 7 + clev);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1369,7 +1286,7 @@ static void speldamage(SpellType Spell)
     case SPELL_GLO:
       /* globe of invulnerability */
       if (c[GLOBE] == 0) c[MOREDEFENSES] += SPELL_GLOBE_BOOST;
-      c[GLOBE] += 200;
+      add_effect(GLOBE, 200);
       adjust_ability(INTELLIGENCE, -1);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
@@ -1405,14 +1322,14 @@ static void speldamage(SpellType Spell)
     /* ----- LEVEL 5 SPELLS ----- */
     case SPELL_SCA:
       /* scare monster */
-      c[SCAREMONST] += rnd(10) + clev;
+      add_effect(SCAREMONST, rnd(10) + clev);
 
       /* if have HANDofFEAR make last longer */
       for (i = 0; i < IVENSIZE; i++)
       {
         if (iven[i] == OHANDofFEAR)
         {
-          c[SCAREMONST] *= 3;
+          add_effect(SCAREMONST, 2 * c[SCAREMONST]);
           break;
         }
       }
@@ -1421,7 +1338,7 @@ static void speldamage(SpellType Spell)
 
     case SPELL_HLD:
       /* hold monster */
-      c[HOLDMONST] += rnd(10) + clev;
+      add_effect(HOLDMONST, rnd(10) + clev);
       return;
 
     case SPELL_STP:
@@ -1493,7 +1410,7 @@ static void speldamage(SpellType Spell)
 
     case SPELL_WTW:
       /* walk through walls */
-      c[WTW] += rnd(10) + 5;
+      add_effect(WTW, rnd(10) + 5);
       do_magic_fx(playerx, playery, MAGIC_SPARKLE);
       return;
 
@@ -1592,6 +1509,7 @@ static void speldamage(SpellType Spell)
       adjust_ability(INTELLIGENCE, -1);
 
       AnalyseWalls(0, 0, MAXX, MAXY);
+      invalidate_free_cells();
       
       for (i = 0 ; i < MAXX ; i++)
       {
@@ -1661,6 +1579,9 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
   x = playerx;
   y = playery;
 
+  /* Show what the bolt hits as the bolt reaches it */
+  anim_hold_text(1);
+
   while (dam > 0)
   {
     x += dx;
@@ -1674,6 +1595,10 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
     /* if energy hits player */
     if ((x == playerx) && (y == playery))
     {
+      /* The player may die, so show the bolt before it hits */
+      anim_hold_text(0);
+      anim_play();
+
       Print("\nYou are hit by your own magic!");
       UlarnBeep();
       losehp(DIED_OWN_MAGIC, dam);
@@ -1683,9 +1608,10 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
     /* if not blind show effect */
     if (c[BLINDCOUNT] == 0)
     {
-      mapeffect(x, y, cshow, dir);
-      nap(delay);
       show1cell(x, y);
+      anim_dir_effect(x, y, cshow, dir);
+      anim_delay(delay);
+      anim_show_cell(x, y);
     }
 
     /* is there a monster there? */
@@ -1707,13 +1633,15 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
         {
           last_monst_hx = (char) x;
           last_monst_hy = (char) y;
+          anim_hold_text(0);
           return;
         }
         Printc('\n');
         Printf(str, lastmonst);
         dam -= hitm(x, y, dam, 1);
         show1cell(x, y);
-        nap(1000);
+        anim_show_cell(x, y);
+        anim_delay(1000);
         x -= dx;
         y -= dy;
       }
@@ -1735,11 +1663,12 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
               if ((x < MAXX - 1) && (y < MAXY - 1) && (x) && (y))
               {
                 Print("  The wall crumbles.");
-                *it = ONOTHING;
+                set_item(x, y, ONOTHING);
                 show1cell(x, y);
+                anim_show_cell(x, y);
                 
                 /* Work out the new wall tiles for adjacent walls */
-                AnalyseWalls(x-1, y-1, x+1, y+1);
+                UpdateWall(x, y);
                 
                 for (tx = x-1 ; tx <= x+1 ; tx++)
                 {
@@ -1767,8 +1696,26 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
           if (dam >= 40)
           {
             Print("  The door is blasted apart.");
-            *it = ONOTHING;
+            set_item(x, y, ONOTHING);
             show1cell(x, y);
+            anim_show_cell(x, y);
+
+            /* Work out the new wall tiles for adjacent walls */
+            UpdateWall(x, y);
+
+            for (tx = x-1 ; tx <= x+1 ; tx++)
+            {
+              for (ty = y-1 ; ty <= y+1 ; ty++)
+              {
+                if (checkxy(tx, ty))
+                {
+                  if ((know[tx][ty] != OUNKNOWN) && (item[tx][ty] == OWALL))
+                  {
+                    show1cell(tx, ty);
+                  }
+                }
+              }
+            }
           }
           dam = 0;
           break;
@@ -1784,9 +1731,10 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
                * 50% chance of revealing a book if difficulty <= 3
                */
               Print("  The statue crumbles.");
-              *it = OBOOK;
+              set_item(x, y, OBOOK);
               iarg[x][y] = (char) level;
               show1cell(x, y);
+              anim_show_cell(x, y);
             }
           }
           dam = 0;
@@ -1800,10 +1748,11 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
             /*
              * If destroying a throne, a gnome king appears
              */
-            mitem[x][y].mon = GNOMEKING;
+            set_monst(x, y, GNOMEKING);
             hitp[x][y]=monster[GNOMEKING].hitpoints;
-            *it = OTHRONE2;
+            set_item(x, y, OTHRONE2);
             show1cell(x, y);
+            anim_show_cell(x, y);
           }
           dam = 0;
           break;
@@ -1821,6 +1770,90 @@ void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType csh
 
     dam -= 3 + (int) (c[HARDGAME] >> 1);
   }
+
+  anim_hold_text(0);
+}
+
+/* =============================================================================
+ * FUNCTION: omnidirect
+ */
+void omnidirect(SpellType spnum, int dam, char *str, MagicEffectsType fx)
+{
+  int xl, yl;
+  int xh, yh;
+  int x, y;
+  MonsterIdType m;
+  int frame;
+  int frame_count;
+
+  /* check for bad args */
+  if (spnum < 0 || spnum >= SPELL_COUNT || str == 0) return;
+
+  /* get the area affected */
+  xl = max(playerx - 1, 0);
+  yl = max(playery - 1, 0);
+  xh = min(playerx + 1, MAXX - 1);
+  yh = min(playery + 1, MAXY - 1);
+
+  /* Show magic effect */
+  frame_count = magic_effect_frames(fx);
+
+  for (frame = 0 ; frame < frame_count ; frame++)
+  {
+    for (x = xl ; x <= xh; x++)
+    {
+      for (y = yl ; y <= yh ; y++)
+      {
+        if ((x != playerx) || (y != playery))
+        {
+          anim_magic_effect(x, y, fx, frame);
+        }
+      }
+    }
+    anim_delay(75);
+  }
+
+  /* Redisplay cell */
+  for (x = xl ; x <= xh ; x++)
+  {
+    for (y = yl ; y <= yh ; y++)
+    {
+      if ((x != playerx) || (y != playery))
+      {
+        show1cell(x, y);
+        anim_show_cell(x, y);
+      }
+    }
+  }
+
+  for (x = xl ; x <= xh ; x++)
+  {
+    for (y = yl ; y <= yh ; y++)
+    {
+      m = mitem[x][y].mon;
+      if (m != MONST_NONE)
+      {
+        if (nospell(spnum, m) == 0)
+        {
+          ifblind(x, y);
+
+          /* Hold the hit messages so they follow the effect */
+          anim_hold_text(1);
+          Printc('\n');
+          Printf(str, lastmonst);
+          hitm(x, y, dam, 1);
+          anim_hold_text(0);
+          anim_show_cell(x, y);
+          anim_delay(800);
+        }
+        else
+        {
+          last_monst_hx = (char) x;
+          last_monst_hy = (char) y;
+        }
+      }
+    }
+  }
 }
 
 /* =============================================================================
@@ -1852,11 +1885,11 @@ void annihilate(void)
       {
         if ((x != playerx) || (y != playery))
         {
-          magic_effect(x, y, MAGIC_ANNIHILATE, frame);
+          anim_magic_effect(x, y, MAGIC_ANNIHILATE, frame);
         }
       }
     }
-    nap(75);
+    anim_delay(75);
   }
 
   xp = 0;
@@ -1871,7 +1904,7 @@ void annihilate(void)
         if (monst < DEMONLORD)
         {
           xp += monster[monst].experience;
-          mitem[x][y].mon = MONST_NONE;
+          set_monst(x, y, MONST_NONE);
         }
         else
         {
@@ -1898,6 +1931,7 @@ void annihilate(void)
       if ((x != playerx) || (y != playery))
       {
         show1cell(x, y);
+        anim_show_cell(x, y);
       }
     }
   }
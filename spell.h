@@ -19,6 +19,7 @@
  * EXPORTED FUNCTIONS
  *
  * godirect       : Function to process ranged spell effects (including scrolls)
+ * omnidirect     : Function to process spell effects on all adjacent monsters
  * annihilate     : Function to process the annihilate scroll
  * get_spell_code : Function to get the three letter spell code from the player
  * cast           : Function to cast a spell
@@ -89,22 +90,22 @@ typedef enum
  * This array defines the highest spell number that may be learnt from a
  * book found on each level of the dungeon
  */
-extern char splev[NLEVELS];
+extern const char splev[NLEVELS];
 
 /*
  * The spell codes
  */
-extern char *spelcode[SPELL_COUNT];
+extern char *const spelcode[SPELL_COUNT];
 
 /*
  * The spell names
  */
-extern char *spelname[SPELL_COUNT];
+extern char *const spelname[SPELL_COUNT];
 
 /*
  * The spell descriptions
  */
-extern char *speldescript[SPELL_COUNT];
+extern char *const speldescript[SPELL_COUNT];
 
 /* =============================================================================
  * FUNCTION: godirect
@@ -132,6 +133,29 @@ extern char *speldescript[SPELL_COUNT];
  */
 void godirect(SpellType spnum, int dam, char *str, int delay, DirEffectsType cshow);
 
+/* =============================================================================
+ * FUNCTION: omnidirect
+ *
+ * DESCRIPTION:
+ * Routine to cast a spell and then hit the monster in all directions.
+ *
+ * PARAMETERS:
+ *
+ *   spnum : The spell being cast
+ *
+ *   dam   : The amount of damage
+ *
+ *   str   : The format string to dislay for monsters hit by the spell.
+ *           The string should contains a '%s' for the monster name.
+ *
+ *   fx    : The magic efect to display.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void omnidirect(SpellType spnum, int dam, char *str, MagicEffectsType fx);
+
 /* =============================================================================
  * FUNCTION: annihilate
  *
@@ -28,6 +28,7 @@
 #include "ularn_win.h"
 #include "saveutils.h"
 #include "header.h"
+#include "dungeon.h"
 #include "monster.h"
 #include "player.h"
 #include "itm.h"
@@ -90,8 +91,8 @@ static void sphboom (int x, int y)
   have_talisman = player_has_item(OSPHTALISMAN);
 
   /* sphere explosion ends hold monster and cancellation */
-  if (c[HOLDMONST]) c[HOLDMONST] = 1;
-  if (c[CANCELLATION]) c[CANCELLATION] = 1;
+  if (c[HOLDMONST]) set_effect(HOLDMONST, 1);
+  if (c[CANCELLATION]) set_effect(CANCELLATION, 1);
 
   xl = x-2;
   yl = y-2;
@@ -120,12 +121,12 @@ static void sphboom (int x, int y)
   {
     for (i = yl ; i < yh ; i++)
     {
-      item[j][i] = ONOTHING;
+      set_item(j, i, ONOTHING);
 
       if (!mon_has_item(j, i, OSPHTALISMAN))
       {
         /* The monster was caught in the explosion */
-        mitem[j][i].mon = MONST_NONE;
+        set_monst(j, i, MONST_NONE);
       }
       else
       {
@@ -148,7 +149,7 @@ static void sphboom (int x, int y)
   }
   
   /* Analyse wall connections and redisplay */
-  AnalyseWalls(xl-1, yl-1, xh, yh);
+  AnalyseWalls(xl, yl, xh-1, yh-1);
   
   for (i = xl-1 ; i < xh+1 ; i++)
   {
@@ -212,7 +213,7 @@ int msphere(struct sphere *sp, int create)
      * and update the sphere position.
      */
 
-    item[x][y] = ONOTHING;
+    set_item(x, y, ONOTHING);
     know[x][y] = item[x][y];
 
     /* show the now moved sphere */
@@ -329,13 +330,13 @@ int msphere(struct sphere *sp, int create)
   }
 
   /* The sphere still exists, so put it on the map in the new position */
-  item[x][y] = OANNIHILATION;
+  set_item(x, y, OANNIHILATION);
   
   if (it == OWALL)
   {
     /* Destroyed a wall, so analyse wall connections and redisplay */
     
-    AnalyseWalls(x-1, y-1, x+1, y+1);
+    UpdateWall(x, y);
   
     for (i = x-1 ; i <= x+1 ; i++)
     {
@@ -358,7 +359,7 @@ int msphere(struct sphere *sp, int create)
   }
   else
   {
-    mitem[x][y].mon = MONST_NONE;
+    set_monst(x, y, MONST_NONE);
   }
   
   know[x][y] = item[x][y];
@@ -393,7 +394,7 @@ void rmsphere (int x, int y)
        * deleted
        */
 
-      item[x][y] = ONOTHING;
+      set_item(x, y, ONOTHING);
       know[x][y] = item[x][y];
 
       /* show the now missing sphere */
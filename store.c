@@ -204,10 +204,55 @@ static struct _itm itm[DNDSIZE] =  {
 { 10000, 0, OLIFEPRESERVER, 0, 0 }
 };
 
+/*
+ * The index in itm of the first store entry for each object, or -1 if the
+ * object is not sold in the store. This is built on first use.
+ */
+static short StoreIndex[OCOUNT];
+static int StoreIndexBuilt = 0;
+
 /* =============================================================================
  * Local functions
  */
 
+/* =============================================================================
+ * FUNCTION: store_index
+ *
+ * DESCRIPTION:
+ * Get the index of the first DnD store entry for an object.
+ *
+ * PARAMETERS:
+ *
+ *   it : The object to find
+ *
+ * RETURN VALUE:
+ *
+ *   The index in itm of the first entry for the object, or -1 if the object
+ *   is not sold in the DnD store.
+ */
+static int store_index(int it)
+{
+  int i;
+
+  if (!StoreIndexBuilt)
+  {
+    for (i = 0 ; i < OCOUNT ; i++)
+    {
+      StoreIndex[i] = -1;
+    }
+
+    /* Search backwards so the first entry for each object is kept */
+    for (i = DNDSIZE - 1 ; i >= 0 ; i--)
+    {
+      StoreIndex[(int) itm[i].obj] = (short) i;
+    }
+
+    StoreIndexBuilt = 1;
+  }
+
+  return StoreIndex[it];
+}
+
 /* =============================================================================
  * FUNCTION: write_dnd_store
  *
@@ -539,7 +584,7 @@ void dndstore(void)
 /* the list of courses taken and the time required */
 #define MAX_COURSES 8
 char course[MAX_COURSES] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-char coursetime[MAX_COURSES] = { 10, 15, 10, 20, 10, 10, 10, 5 };
+static const char coursetime[MAX_COURSES] = { 10, 15, 10, 20, 10, 10, 10, 5 };
 
 /* =============================================================================
  * Local functions
@@ -800,11 +845,11 @@ void oschool(void)
 
           /* cure blindness too!  */
           if (c[BLINDCOUNT])
-            c[BLINDCOUNT] = 1;
+            set_effect(BLINDCOUNT, 1);
 
           /*  end confusion */
           if (c[CONFUSE])
-            c[CONFUSE] = 1;
+            set_effect(CONFUSE, 1);
 
           /* adjust parameters for time change */
           adjusttime((long) time_used);
@@ -931,6 +976,7 @@ static void appraise(int eye, int order)
       Print("yes");
       c[GOLD]+=amt;
       iven[eye] = ONOTHING;
+      inventory_changed(eye);
       c[EYEOFLARN] = 0;
 
       MoveCursor( (order%2)*40+1 , (order>>1)+4 );
@@ -1103,6 +1149,7 @@ static void obanksub(void)
                 c[EYEOFLARN] = 0;
               c[GOLD] += gemvalue[i];
               iven[i]=ONOTHING;
+              inventory_changed(i);
               gemvalue[i]=0;
               k = gemorder[i];
               MoveCursor( (k%2)*40+1 , (k>>1)+4 );
@@ -1123,6 +1170,7 @@ static void obanksub(void)
               c[EYEOFLARN] = 0;
             c[GOLD]+=gemvalue[i];
             iven[i]=ONOTHING;
+            inventory_changed(i);
             gemvalue[i]=0;
             k = gemorder[i];
             MoveCursor( (k%2)*40+1 , (k>>1)+4 );
@@ -1307,7 +1355,6 @@ int item_value(int it, int itarg)
 {
   int arg;
   int value;
-  int found_item;
   int j;
 
   value = -1;
@@ -1321,48 +1368,40 @@ int item_value(int it, int itarg)
   }
   else
   {
-    found_item = 0;
-    j = 0;
-    while ((j < DNDSIZE) && (!found_item))
+    j = store_index(it);
+    if (j >= 0)
     {
-      if (itm[j].obj == it)
+      if ((itm[j].obj == OSCROLL) || (itm[j].obj == OPOTION))
       {
-        if ((itm[j].obj == OSCROLL) || (itm[j].obj == OPOTION))
-        {
-          value = (long) 2 * itm[j + itarg].price;
-        }
-        else
-        {
-          value = (long) itm[j].price;
+        value = (long) 2 * itm[j + itarg].price;
+      }
+      else
+      {
+        value = (long) itm[j].price;
 
-          arg = itarg;
+        arg = itarg;
 
-          if (arg >= 0) value *= 2;
+        if (arg >= 0) value *= 2;
 
-          while ((arg != 0) && (value < 500000L))
+        while ((arg != 0) && (value < 500000L))
+        {
+          if (arg > 0)
           {
-            if (arg > 0)
-            {
-              /* appreciate if a +n object */
-              value = (14*(value + 67))/10;
-              arg--;
-            }
-            else
-            {
-              /* depreciate -n object */
-              value = (value * 10) / 14;
-              arg++;
-            }
+            /* appreciate if a +n object */
+            value = (14*(value + 67))/10;
+            arg--;
+          }
+          else
+          {
+            /* depreciate -n object */
+            value = (value * 10) / 14;
+            arg++;
           }
         }
-
-        /* always offer at least 1 gp */
-        if (value == 0) value = 1;
-
-        found_item = 1;
       }
 
-      j++;
+      /* always offer at least 1 gp */
+      if (value == 0) value = 1;
     }
   }
 
@@ -1469,6 +1508,7 @@ void otradepost(void)
               if (c[SHIELD] == idx) c[SHIELD] = -1;
               adjustcvalues(it, itarg);
               iven[idx] = ONOTHING;
+              inventory_changed(idx);
             }
             else
             {
@@ -1925,6 +1965,7 @@ void ohome(void)
       if (ivenarg[i]==PCUREDIANTH)
       {
         iven[i] = ONOTHING;
+        inventory_changed(i);
         ClearText();
 
         Print("Congratulations.  You found the potion of cure "
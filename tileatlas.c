@@ -0,0 +1,140 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: tileatlas.c
+ *
+ * DESCRIPTION:
+ * Tile atlas module.
+ * This module maps pre-converted tile graphics into memory so the graphical
+ * displays can use the pixels without decoding an image file.
+ * See tileatlas.h for the file format.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * tileatlas_open  : Map a tile atlas file into memory
+ * tileatlas_close : Unmap a tile atlas
+ *
+ * =============================================================================
+ */
+
+#include <string.h>
+
+#include "tileatlas.h"
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: get_le32
+ *
+ * DESCRIPTION:
+ * Read a 32 bit little endian value.
+ *
+ * PARAMETERS:
+ *
+ *   Buf : The value to read
+ *
+ * RETURN VALUE:
+ *
+ *   The value.
+ */
+static unsigned long get_le32(const unsigned char *Buf)
+{
+  return ((unsigned long) Buf[0]) |
+         ((unsigned long) Buf[1] << 8) |
+         ((unsigned long) Buf[2] << 16) |
+         ((unsigned long) Buf[3] << 24);
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: tileatlas_open
+ */
+int tileatlas_open(char *FileName, TileAtlasType *Atlas)
+{
+  MappedFileType File;
+  const unsigned char *Header;
+  unsigned long Width, Height;
+  unsigned long Stride;
+  unsigned long PixelOffset;
+  unsigned long MaskOffset;
+  unsigned long MaskStride;
+  size_t Size;
+
+  memset(Atlas, 0, sizeof(TileAtlasType));
+
+  if (!mapfile_open(FileName, &File)) return 0;
+
+  Size = File.Len;
+  if (Size < ATLAS_HEADER_SIZE)
+  {
+    mapfile_close(&File);
+    return 0;
+  }
+
+  Header = (const unsigned char *) File.Data;
+
+  Width = get_le32(Header + 12);
+  Height = get_le32(Header + 16);
+  Stride = get_le32(Header + 20);
+  PixelOffset = get_le32(Header + 24);
+  MaskOffset = get_le32(Header + 28);
+  MaskStride = get_le32(Header + 32);
+
+  //
+  // Check the header describes pixels and a mask that lie within the file,
+  // so a truncated or foreign file is rejected rather than read past its end.
+  //
+  if ((memcmp(Header, ATLAS_MAGIC, 4) != 0) ||
+      (get_le32(Header + 4) != ATLAS_VERSION) ||
+      (get_le32(Header + 8) != ATLAS_FORMAT_XRGB8888) ||
+      (Width == 0) || (Height == 0) ||
+      (Width > 65536) || (Height > 65536) ||
+      (Stride < Width * 4) || ((Stride % 4) != 0) ||
+      (PixelOffset < ATLAS_HEADER_SIZE) || ((PixelOffset % 4) != 0) ||
+      (PixelOffset > Size) || (Stride * Height > Size - PixelOffset) ||
+      ((MaskOffset != 0) &&
+       ((MaskStride < (Width + 7) / 8) ||
+        (MaskOffset < ATLAS_HEADER_SIZE) ||
+        (MaskOffset > Size) || (MaskStride * Height > Size - MaskOffset))))
+  {
+    mapfile_close(&File);
+    return 0;
+  }
+
+  Atlas->Width = (int) Width;
+  Atlas->Height = (int) Height;
+  Atlas->Format = ATLAS_FORMAT_XRGB8888;
+  Atlas->Stride = (int) Stride;
+  Atlas->Pixels = Header + PixelOffset;
+  if (MaskOffset != 0)
+  {
+    Atlas->MaskStride = (int) MaskStride;
+    Atlas->Mask = Header + MaskOffset;
+  }
+  Atlas->File = File;
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: tileatlas_close
+ */
+void tileatlas_close(TileAtlasType *Atlas)
+{
+  if (Atlas->File.Data != NULL)
+  {
+    mapfile_close(&Atlas->File);
+  }
+
+  memset(Atlas, 0, sizeof(TileAtlasType));
+}
@@ -0,0 +1,108 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: tileatlas.h
+ *
+ * DESCRIPTION:
+ * Tile atlas module.
+ * A tile atlas is the tile graphics pre-converted to the pixel format the
+ * graphical displays draw from, so it can be mapped into memory and used
+ * directly instead of being decoded from a BMP or XPM file at startup.
+ * Processes that map the same atlas share its pages in the page cache.
+ *
+ * The file is a header followed by the pixels and an optional mask plane.
+ * All header values are 32 bit little endian:
+ *
+ *   0  Magic         : "ULTA"
+ *   4  Version       : ATLAS_VERSION
+ *   8  Format        : The pixel format (ATLAS_FORMAT_XRGB8888)
+ *   12 Width         : The width in pixels
+ *   16 Height        : The height in pixels
+ *   20 Stride        : The number of bytes from one row of pixels to the next
+ *   24 PixelOffset   : The offset of the first row of pixels in the file
+ *   28 MaskOffset    : The offset of the mask plane, or 0 if there is none
+ *   32 MaskStride    : The number of bytes from one row of the mask to the next
+ *
+ * XRGB8888 pixels are 32 bit little endian values of 0x00RRGGBB.
+ * The mask has one bit per pixel, least significant bit first, and a set bit
+ * marks a pixel that is drawn. This is the X bitmap layout. Masked out
+ * pixels are stored as black, which the SDL display uses as its colour key.
+ *
+ * The pixel data is aligned to ATLAS_ALIGN bytes in the file.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * tileatlas_open  : Map a tile atlas file into memory
+ * tileatlas_close : Unmap a tile atlas
+ *
+ * =============================================================================
+ */
+
+#ifndef __TILEATLAS_H
+#define __TILEATLAS_H
+
+#include "mapfile.h"
+
+#define ATLAS_MAGIC       "ULTA"
+#define ATLAS_VERSION     1
+#define ATLAS_HEADER_SIZE 36
+#define ATLAS_ALIGN       64
+
+#define ATLAS_FORMAT_XRGB8888 1
+
+/*
+ * A mapped tile atlas.
+ */
+typedef struct
+{
+  int Width;                   /* The width in pixels                        */
+  int Height;                  /* The height in pixels                       */
+  int Format;                  /* The pixel format                           */
+  int Stride;                  /* The bytes from one row to the next         */
+  const unsigned char *Pixels; /* The first row of pixels                    */
+  int MaskStride;              /* The bytes from one mask row to the next    */
+  const unsigned char *Mask;   /* The mask plane, or NULL if there is none   */
+  MappedFileType File;         /* The mapped file                            */
+} TileAtlasType;
+
+/* =============================================================================
+ * FUNCTION: tileatlas_open
+ *
+ * DESCRIPTION:
+ * Map a tile atlas file into memory read only and check its header.
+ * The pixels stay mapped until tileatlas_close is called.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the atlas file
+ *
+ *   Atlas    : The atlas to fill in
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the file does not exist or is not a valid atlas.
+ */
+int tileatlas_open(char *FileName, TileAtlasType *Atlas);
+
+/* =============================================================================
+ * FUNCTION: tileatlas_close
+ *
+ * DESCRIPTION:
+ * Unmap a tile atlas. Nothing may use its pixels or mask afterwards.
+ *
+ * PARAMETERS:
+ *
+ *   Atlas : The atlas to unmap
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void tileatlas_close(TileAtlasType *Atlas);
+
+#endif
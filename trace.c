@@ -0,0 +1,376 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: trace.c
+ *
+ * DESCRIPTION:
+ * Hot path tracing module.
+ * This module records the start time and duration of the main per-turn
+ * code paths into a ring buffer and writes them out as Chrome trace event
+ * JSON (viewable in chrome://tracing or Perfetto).
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * trace_enabled         : Set when trace events are being recorded
+ * trace_startup_profile : Set to print the startup phase times on exit
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * trace_start        : Start recording trace events
+ * trace_begin        : Record the start of a traced code path
+ * trace_end          : Record the end of a traced code path
+ * trace_poll         : Write the trace if a dump has been requested
+ * trace_dump         : Write the recorded trace events to the trace file
+ * trace_phase        : Record the start of a startup phase
+ * trace_phase_done   : Record the end of startup
+ * trace_phase_report : Print the time taken by each startup phase
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "config.h"
+#include "trace.h"
+
+#ifdef UNIX
+#include <unistd.h>
+#endif
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int trace_enabled = 0;
+int trace_startup_profile = 0;
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The number of completed events kept in the ring buffer.
+ * Once full, the oldest events are overwritten.
+ */
+#define TRACE_EVENTS 65536
+
+/*
+ * The deepest nesting of traced code paths that is recorded.
+ */
+#define TRACE_DEPTH 16
+
+/*
+ * The names of the traced code paths.
+ * The order must match TraceIdType
+ */
+static char *const TraceName[TRACE_COUNT] =
+{
+  "do_one_turn",
+  "get_normal_input",
+  "movemonst",
+  "movemt",
+  "regen",
+  "newcavelevel",
+  "savegame",
+  "PaintMap",
+  "PaintTextWindow",
+  "nap"
+};
+
+/*
+ * A completed trace event.
+ * Times are in microseconds since tracing started.
+ */
+struct TraceEventType
+{
+  double Start;
+  double Duration;
+  TraceIdType Id;
+};
+
+/*
+ * A traced code path that has been entered and not yet left.
+ */
+struct TraceOpenType
+{
+  double Start;
+  TraceIdType Id;
+};
+
+static char *TraceFile = NULL;
+static double TraceOrigin;
+
+static struct TraceEventType *TraceRing = NULL;
+static long TraceHead = 0;
+static long TraceCount = 0;
+
+static struct TraceOpenType TraceOpen[TRACE_DEPTH];
+static int TraceDepth = 0;
+
+static volatile sig_atomic_t DumpRequested = 0;
+
+/*
+ * The startup phases recorded so far.
+ * PhaseStart[n] is the start of phase n and the end of phase n - 1.
+ */
+#define MAX_PHASES 32
+
+static char *PhaseName[MAX_PHASES];
+static double PhaseStart[MAX_PHASES + 1];
+static int PhaseCount = 0;
+static int PhasesDone = 0;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: trace_now
+ *
+ * DESCRIPTION:
+ * Get a monotonic time stamp.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The time in microseconds.
+ */
+static double trace_now(void)
+{
+#ifdef UNIX
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+#else
+  return (double) clock() * (1000000.0 / (double) CLOCKS_PER_SEC);
+#endif
+}
+
+#ifdef UNIX
+
+/* =============================================================================
+ * FUNCTION: dump_signal
+ *
+ * DESCRIPTION:
+ * Signal handler to request a trace dump.
+ * The dump itself is done by trace_poll at the next turn boundary.
+ *
+ * PARAMETERS:
+ *
+ *   sig : The signal received
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void dump_signal(int sig)
+{
+  DumpRequested = 1;
+  signal(sig, dump_signal);
+}
+
+#endif
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: trace_start
+ */
+void trace_start(char *FileName)
+{
+  if (TraceRing == NULL)
+  {
+    TraceRing = (struct TraceEventType *)
+      malloc(TRACE_EVENTS * sizeof(struct TraceEventType));
+
+    if (TraceRing == NULL)
+    {
+      fprintf(stderr, "Not enough memory for the trace buffer\n");
+      return;
+    }
+  }
+
+  if (TraceFile != NULL) free(TraceFile);
+  TraceFile = (char *) malloc(strlen(FileName) + 1);
+  if (TraceFile == NULL)
+  {
+    fprintf(stderr, "Not enough memory for the trace file name\n");
+    return;
+  }
+  strcpy(TraceFile, FileName);
+
+  TraceOrigin = trace_now();
+  TraceHead = 0;
+  TraceCount = 0;
+  TraceDepth = 0;
+
+#ifdef UNIX
+  signal(SIGUSR1, dump_signal);
+#endif
+
+  trace_enabled = 1;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_begin
+ */
+void trace_begin(TraceIdType Id)
+{
+  if (TraceDepth < TRACE_DEPTH)
+  {
+    TraceOpen[TraceDepth].Id = Id;
+    TraceOpen[TraceDepth].Start = trace_now();
+  }
+
+  TraceDepth++;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_end
+ */
+void trace_end(TraceIdType Id)
+{
+  struct TraceEventType *Event;
+
+  if (TraceDepth == 0) return;
+
+  TraceDepth--;
+
+  /*
+   * Paths nested too deeply or left without a matching begin are dropped
+   * rather than recorded with the wrong start time.
+   */
+  if ((TraceDepth >= TRACE_DEPTH) || (TraceOpen[TraceDepth].Id != Id))
+  {
+    return;
+  }
+
+  Event = TraceRing + TraceHead;
+  Event->Id = Id;
+  Event->Start = TraceOpen[TraceDepth].Start - TraceOrigin;
+  Event->Duration = trace_now() - TraceOpen[TraceDepth].Start;
+
+  TraceHead = (TraceHead + 1) % TRACE_EVENTS;
+  if (TraceCount < TRACE_EVENTS) TraceCount++;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_poll
+ */
+void trace_poll(void)
+{
+  if (DumpRequested)
+  {
+    DumpRequested = 0;
+    trace_dump();
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: trace_dump
+ */
+int trace_dump(void)
+{
+  FILE *fp;
+  struct TraceEventType *Event;
+  long First;
+  long i;
+  int pid;
+  int Err;
+
+  if (!trace_enabled) return -1;
+
+  fp = fopen(TraceFile, "w");
+  if (fp == NULL) return -1;
+
+#ifdef UNIX
+  pid = (int) getpid();
+#else
+  pid = 1;
+#endif
+
+  fprintf(fp, "{\"traceEvents\":[\n");
+  fprintf(fp,
+    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+    "\"args\":{\"name\":\"ularn\"}}",
+    pid);
+
+  First = (TraceHead + TRACE_EVENTS - TraceCount) % TRACE_EVENTS;
+
+  for (i = 0 ; i < TraceCount ; i++)
+  {
+    Event = TraceRing + ((First + i) % TRACE_EVENTS);
+
+    fprintf(fp,
+      ",\n{\"name\":\"%s\",\"cat\":\"ularn\",\"ph\":\"X\","
+      "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":1}",
+      TraceName[Event->Id], Event->Start, Event->Duration, pid);
+  }
+
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  Err = ferror(fp);
+  if (fclose(fp) != 0) Err = 1;
+
+  return Err ? -1 : 0;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_phase
+ */
+void trace_phase(char *Name)
+{
+  if (PhasesDone || (PhaseCount == MAX_PHASES)) return;
+
+  PhaseName[PhaseCount] = Name;
+  PhaseStart[PhaseCount] = trace_now();
+  PhaseCount++;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_phase_done
+ */
+void trace_phase_done(void)
+{
+  if (PhasesDone) return;
+
+  PhaseStart[PhaseCount] = trace_now();
+  PhasesDone = 1;
+}
+
+/* =============================================================================
+ * FUNCTION: trace_phase_report
+ */
+void trace_phase_report(void)
+{
+  int i;
+
+  if (!trace_startup_profile || (PhaseCount == 0)) return;
+
+  if (!PhasesDone)
+  {
+    fprintf(stderr, "Startup did not finish\n");
+    return;
+  }
+
+  fprintf(stderr, "Startup profile (ms)\n");
+  for (i = 0 ; i < PhaseCount ; i++)
+  {
+    fprintf(stderr, "  %-16s %9.3f\n", PhaseName[i],
+            (PhaseStart[i + 1] - PhaseStart[i]) / 1000.0);
+  }
+  fprintf(stderr, "  %-16s %9.3f\n", "total",
+          (PhaseStart[PhaseCount] - PhaseStart[0]) / 1000.0);
+}
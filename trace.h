@@ -0,0 +1,208 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: trace.h
+ *
+ * DESCRIPTION:
+ * Hot path tracing module.
+ * This module records the start time and duration of the main per-turn
+ * code paths into a ring buffer and writes them out as Chrome trace event
+ * JSON (viewable in chrome://tracing or Perfetto).
+ * When tracing is not enabled each trace point costs a single test of
+ * trace_enabled.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * trace_enabled         : Set when trace events are being recorded
+ * trace_startup_profile : Set to print the startup phase times on exit
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * trace_start        : Start recording trace events
+ * trace_begin        : Record the start of a traced code path
+ * trace_end          : Record the end of a traced code path
+ * trace_poll         : Write the trace if a dump has been requested
+ * trace_dump         : Write the recorded trace events to the trace file
+ * trace_phase        : Record the start of a startup phase
+ * trace_phase_done   : Record the end of startup
+ * trace_phase_report : Print the time taken by each startup phase
+ *
+ * =============================================================================
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+/*
+ * The traced code paths.
+ * The order must match the names in trace.c
+ */
+typedef enum
+{
+  TRACE_TURN,
+  TRACE_INPUT,
+  TRACE_MOVEMONST,
+  TRACE_MOVEMT,
+  TRACE_REGEN,
+  TRACE_NEWCAVELEVEL,
+  TRACE_SAVEGAME,
+  TRACE_PAINTMAP,
+  TRACE_PAINTTEXT,
+  TRACE_NAP,
+  TRACE_COUNT
+} TraceIdType;
+
+extern int trace_enabled;
+extern int trace_startup_profile;
+
+/*
+ * Trace point macros.
+ * Every TRACE_BEGIN must be matched by a TRACE_END for the same id on all
+ * paths out of the traced code.
+ */
+#define TRACE_BEGIN(id) { if (trace_enabled) trace_begin(id); }
+#define TRACE_END(id)   { if (trace_enabled) trace_end(id); }
+
+/* =============================================================================
+ * FUNCTION: trace_start
+ *
+ * DESCRIPTION:
+ * Start recording trace events.
+ * The trace is written to the named file when trace_dump is called, when
+ * a dump is requested (SIGUSR1 on UNIX) and at the end of the game.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the file to write the trace to
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_start(char *FileName);
+
+/* =============================================================================
+ * FUNCTION: trace_begin
+ *
+ * DESCRIPTION:
+ * Record the start of a traced code path.
+ *
+ * PARAMETERS:
+ *
+ *   Id : The code path being entered
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_begin(TraceIdType Id);
+
+/* =============================================================================
+ * FUNCTION: trace_end
+ *
+ * DESCRIPTION:
+ * Record the end of a traced code path and store the completed event in
+ * the ring buffer. The oldest events are overwritten once it is full.
+ *
+ * PARAMETERS:
+ *
+ *   Id : The code path being left
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_end(TraceIdType Id);
+
+/* =============================================================================
+ * FUNCTION: trace_poll
+ *
+ * DESCRIPTION:
+ * Write the trace file if a dump has been requested since the last poll.
+ * This is called once per turn so that the dump never happens in the middle
+ * of a traced code path.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_poll(void);
+
+/* =============================================================================
+ * FUNCTION: trace_dump
+ *
+ * DESCRIPTION:
+ * Write the events currently in the ring buffer to the trace file as
+ * Chrome trace event JSON.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   0 if the trace was written, -1 if tracing is not enabled or the file
+ *   could not be written.
+ */
+int trace_dump(void);
+
+/* =============================================================================
+ * FUNCTION: trace_phase
+ *
+ * DESCRIPTION:
+ * Record the end of the current startup phase and the start of the next.
+ * Phases are always recorded, as the display is set up before the command
+ * line is read, and cost one clock read each. Calls after trace_phase_done
+ * are ignored.
+ *
+ * PARAMETERS:
+ *
+ *   Name : The name of the phase being started
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_phase(char *Name);
+
+/* =============================================================================
+ * FUNCTION: trace_phase_done
+ *
+ * DESCRIPTION:
+ * Record the end of the last startup phase. This is called when the first
+ * screen the player can respond to has been drawn. Later calls are ignored.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_phase_done(void);
+
+/* =============================================================================
+ * FUNCTION: trace_phase_report
+ *
+ * DESCRIPTION:
+ * Print the time taken by each startup phase to stderr, if
+ * trace_startup_profile is set. This is called after the display is closed
+ * so the report is not drawn over.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void trace_phase_report(void);
+
+#endif
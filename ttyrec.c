@@ -0,0 +1,302 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ttyrec.c
+ *
+ * DESCRIPTION:
+ * Session recording module.
+ * This module records the output sent to the terminal as timestamped frames
+ * in ttyrec format. Frames are added to a memory buffer by the game and
+ * written to the file in large blocks by a background thread.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * ttyrec_enabled : Set while the terminal output is being recorded
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * ttyrec_start  : Start recording to a file
+ * ttyrec_frame  : Record a frame of output
+ * ttyrec_stop   : Write the remaining frames and close the recording
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+#include "ttyrec.h"
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int ttyrec_enabled = 0;
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * The writer is woken early once this much output is waiting.
+ */
+#define RECORD_BLOCK_SIZE (256 * 1024)
+
+/*
+ * Otherwise the waiting output is written this often, in seconds.
+ */
+#define RECORD_INTERVAL 1
+
+#define FRAME_HEADER_SIZE 12
+
+static int RecordFd = -1;
+
+/*
+ * The game adds frames to the fill buffer. The writer thread swaps it with
+ * the write buffer, and writes that without holding the lock.
+ */
+static char *FillBuffer = NULL;
+static size_t FillLen = 0;
+static size_t FillSize = 0;
+static char *WriteBuffer = NULL;
+static size_t WriteSize = 0;
+
+static pthread_t WriterThread;
+static pthread_mutex_t RecordLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RecordCond = PTHREAD_COND_INITIALIZER;
+static int Stopping = 0;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: write_all
+ *
+ * DESCRIPTION:
+ * Write a block to a file descriptor, retrying partial writes.
+ *
+ * PARAMETERS:
+ *
+ *   Fd   : The file descriptor
+ *
+ *   Data : The data to write
+ *
+ *   Len  : The length of the data
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the write failed.
+ */
+static int write_all(int Fd, const char *Data, size_t Len)
+{
+  ssize_t n;
+
+  while (Len > 0)
+  {
+    n = write(Fd, Data, Len);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    Data += n;
+    Len -= n;
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: put_le32
+ *
+ * DESCRIPTION:
+ * Store a 32 bit value in little endian byte order.
+ *
+ * PARAMETERS:
+ *
+ *   Buf   : Where to store the value
+ *
+ *   Value : The value
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void put_le32(char *Buf, unsigned long Value)
+{
+  Buf[0] = (char) (Value & 0xff);
+  Buf[1] = (char) ((Value >> 8) & 0xff);
+  Buf[2] = (char) ((Value >> 16) & 0xff);
+  Buf[3] = (char) ((Value >> 24) & 0xff);
+}
+
+/* =============================================================================
+ * FUNCTION: writer_thread
+ *
+ * DESCRIPTION:
+ * The background thread that writes the recorded frames to the file.
+ *
+ * PARAMETERS:
+ *
+ *   Arg : Not used
+ *
+ * RETURN VALUE:
+ *
+ *   NULL
+ */
+static void *writer_thread(void *Arg)
+{
+  struct timespec Wake;
+  char *Buffer;
+  size_t Size;
+  size_t Len;
+
+  pthread_mutex_lock(&RecordLock);
+
+  for (;;)
+  {
+    if (!Stopping && (FillLen < RECORD_BLOCK_SIZE))
+    {
+      clock_gettime(CLOCK_REALTIME, &Wake);
+      Wake.tv_sec += RECORD_INTERVAL;
+      pthread_cond_timedwait(&RecordCond, &RecordLock, &Wake);
+    }
+
+    if (FillLen > 0)
+    {
+      //
+      // Take the waiting frames, and let the game carry on filling the
+      // other buffer while they are written.
+      //
+      Buffer = FillBuffer;
+      Size = FillSize;
+      Len = FillLen;
+
+      FillBuffer = WriteBuffer;
+      FillSize = WriteSize;
+      FillLen = 0;
+
+      WriteBuffer = Buffer;
+      WriteSize = Size;
+
+      pthread_mutex_unlock(&RecordLock);
+      write_all(RecordFd, Buffer, Len);
+      pthread_mutex_lock(&RecordLock);
+    }
+    else if (Stopping)
+    {
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&RecordLock);
+
+  return NULL;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: ttyrec_start
+ */
+int ttyrec_start(char *FileName)
+{
+  if (ttyrec_enabled) return 0;
+
+  RecordFd = open(FileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (RecordFd < 0) return -1;
+
+  Stopping = 0;
+  if (pthread_create(&WriterThread, NULL, writer_thread, NULL) != 0)
+  {
+    close(RecordFd);
+    RecordFd = -1;
+    return -1;
+  }
+
+  ttyrec_enabled = 1;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: ttyrec_frame
+ */
+void ttyrec_frame(const char *Data, size_t Len)
+{
+  struct timeval Now;
+  char *Buffer;
+  size_t Size;
+
+  if (!ttyrec_enabled || (Len == 0)) return;
+
+  gettimeofday(&Now, NULL);
+
+  pthread_mutex_lock(&RecordLock);
+
+  if (FillLen + FRAME_HEADER_SIZE + Len > FillSize)
+  {
+    Size = (FillSize == 0) ? RECORD_BLOCK_SIZE : FillSize;
+    while (Size < FillLen + FRAME_HEADER_SIZE + Len) Size *= 2;
+
+    Buffer = (char *) realloc(FillBuffer, Size);
+    if (Buffer == NULL)
+    {
+      pthread_mutex_unlock(&RecordLock);
+      return;
+    }
+
+    FillBuffer = Buffer;
+    FillSize = Size;
+  }
+
+  put_le32(FillBuffer + FillLen, (unsigned long) Now.tv_sec);
+  put_le32(FillBuffer + FillLen + 4, (unsigned long) Now.tv_usec);
+  put_le32(FillBuffer + FillLen + 8, (unsigned long) Len);
+  memcpy(FillBuffer + FillLen + FRAME_HEADER_SIZE, Data, Len);
+  FillLen += FRAME_HEADER_SIZE + Len;
+
+  if (FillLen >= RECORD_BLOCK_SIZE) pthread_cond_signal(&RecordCond);
+
+  pthread_mutex_unlock(&RecordLock);
+}
+
+/* =============================================================================
+ * FUNCTION: ttyrec_stop
+ */
+void ttyrec_stop(void)
+{
+  if (!ttyrec_enabled) return;
+
+  ttyrec_enabled = 0;
+
+  pthread_mutex_lock(&RecordLock);
+  Stopping = 1;
+  pthread_cond_signal(&RecordCond);
+  pthread_mutex_unlock(&RecordLock);
+
+  pthread_join(WriterThread, NULL);
+
+  close(RecordFd);
+  RecordFd = -1;
+
+  free(FillBuffer);
+  free(WriteBuffer);
+  FillBuffer = NULL;
+  WriteBuffer = NULL;
+  FillLen = 0;
+  FillSize = 0;
+  WriteSize = 0;
+}
@@ -0,0 +1,90 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ttyrec.h
+ *
+ * DESCRIPTION:
+ * Session recording module.
+ * This module records the output sent to the terminal as timestamped frames
+ * in ttyrec format, which ttyplay, ipbt and most game recording players can
+ * replay. Each frame is a 12 byte header (seconds, microseconds and length,
+ * as 32 bit little endian values) followed by the output.
+ *
+ * Frames are added to a memory buffer and written to the file by a
+ * background thread in large blocks, so recording never waits for the disk.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * ttyrec_enabled : Set while the terminal output is being recorded
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * ttyrec_start  : Start recording to a file
+ * ttyrec_frame  : Record a frame of output
+ * ttyrec_stop   : Write the remaining frames and close the recording
+ *
+ * =============================================================================
+ */
+
+#ifndef __TTYREC_H
+#define __TTYREC_H
+
+#include <stddef.h>
+
+extern int ttyrec_enabled;
+
+/* =============================================================================
+ * FUNCTION: ttyrec_start
+ *
+ * DESCRIPTION:
+ * Start recording to a file. The display should record a frame showing the
+ * whole screen first, as players start from a blank terminal.
+ *
+ * PARAMETERS:
+ *
+ *   FileName : The name of the file to record to
+ *
+ * RETURN VALUE:
+ *
+ *   0 if recording has started, -1 if the file could not be created.
+ */
+int ttyrec_start(char *FileName);
+
+/* =============================================================================
+ * FUNCTION: ttyrec_frame
+ *
+ * DESCRIPTION:
+ * Record a frame of terminal output, timestamped with the current time.
+ * The frame is dropped if there is not enough memory to hold it.
+ *
+ * PARAMETERS:
+ *
+ *   Data : The output
+ *
+ *   Len  : The length of the output
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void ttyrec_frame(const char *Data, size_t Len);
+
+/* =============================================================================
+ * FUNCTION: ttyrec_stop
+ *
+ * DESCRIPTION:
+ * Stop recording, waiting for the background thread to write the frames
+ * that are still in memory.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void ttyrec_stop(void);
+
+#endif
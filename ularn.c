@@ -14,7 +14,8 @@
  * =============================================================================
  * EXPORTED FUNCTIONS
  *
- * None.
+ * parse       : Perform a player action
+ * do_one_turn : Process one turn of the game
  *
  * =============================================================================
  */
@@ -45,6 +46,14 @@
 #include "help.h"
 #include "diag.h"
 #include "itm.h"
+#include "anim.h"
+#include "trace.h"
+#include "sphere.h"
+#include "ularn.h"
+
+#ifdef UNIX_TTY
+#include "ttyrec.h"
+#endif
 
 #ifdef WINDOWS
 #include <windows.h>
@@ -66,7 +75,7 @@ static char copyright[]=
   "  Rewrite and Windows32/X11/Amiga graphics conversion by Julian Olds";
 
 static char cmdhelp[] = "\
-Cmd line format: Ularn [-sicnh] [-o <optsfile>] [-d #] [-r]\n\
+Cmd line format: Ularn [-sicnh] [-o <optsfile>] [-d #] [-r] [-t <tracefile>]\n\
   -s   show the scoreboard\n\
   -i   show scoreboard with inventories\n\
   -c   create new scoreboard (wizard only)\n\
@@ -74,9 +83,19 @@ Cmd line format: Ularn [-sicnh] [-o <optsfile>] [-d #] [-r]\n\
   -h   print this help text\n\
   -o <optsfile> specify .Ularnopts file to be used instead of \"~/.Ularnopts\"\n\
   -d # specify level of difficulty (example: Ularn -d 5)\n\
-  -r   restore checkpoint (.ckp) file\n";
+  -r   restore checkpoint (.ckp) file\n\
+  -t <tracefile> record per-turn timings as Chrome trace JSON\n\
+  --startup-profile print the time taken by each startup phase on exit\n"
+#ifdef UNIX_TTY
+  "  -R <recordfile> record the session in ttyrec format\n"
+#endif
+  ;
 
-static char *optstring = "sicnhro:d:";
+#ifdef UNIX_TTY
+static char *optstring = "sicnhro:d:t:R:";
+#else
+static char *optstring = "sicnhro:d:t:";
+#endif
 
 static short viewflag;
 
@@ -188,8 +207,6 @@ void ULarnSetup(int argc, char *argv[])
   set_display(DISPLAY_TEXT);
   ClearText();
 
-  nap(100);
-
 #ifdef UNIX
 
   home = getenv("HOME");
@@ -213,8 +230,12 @@ void ULarnSetup(int argc, char *argv[])
 
   /* initialize dungeon storage */
 
+  trace_phase("cells");
   init_cells();
 
+  /* allow state dumps to be requested while the game is running */
+  diag_start();
+
   /* set the initial clock and initialise the random number generator*/
   newgame();
   hard = -1;
@@ -226,6 +247,20 @@ void ULarnSetup(int argc, char *argv[])
   /*
    * now process the command line arguments
    */
+  trace_phase("options");
+
+  /* remove the long options, which ugetopt does not understand */
+  for (i = 1 ; i < argc ; i++)
+  {
+    if (strcmp(argv[i], "--startup-profile") == 0)
+    {
+      trace_startup_profile = 1;
+      memmove(&argv[i], &argv[i + 1], (argc - i) * sizeof(char *));
+      argc--;
+      i--;
+    }
+  }
+
   opterr = 0;
   while ((i = ugetopt(argc, argv, optstring)) != -1)
   {
@@ -283,6 +318,21 @@ void ULarnSetup(int argc, char *argv[])
         restore_ckp = 1;
         break;
 
+      case 't':
+        /* record a trace of the hot paths */
+        trace_start(optarg);
+        break;
+
+#ifdef UNIX_TTY
+      case 'R':
+        /* record the session for replays */
+        if (ttyrec_start(optarg) != 0)
+        {
+          Printf("Cannot record to %s\n", optarg);
+        }
+        break;
+#endif
+
       default:
         if (!opterr)
         {
@@ -315,6 +365,7 @@ void ULarnSetup(int argc, char *argv[])
   /*
    * Process scorefile initialisation
    */
+  trace_phase("scoreboard");
 
   /* the Ularn scoreboard filename */
   sprintf(scorefile, "%s/%s", libdir, SCORENAME);
@@ -363,6 +414,7 @@ void ULarnSetup(int argc, char *argv[])
    * Get the user name and id.
    * For OS without usernames, use the logname, if it is specified.
    */
+  trace_phase("user");
   strcpy(loginname, logname);
   GetUser(loginname, &userid);
 
@@ -391,6 +443,7 @@ void ULarnSetup(int argc, char *argv[])
   /* the checkpoint file */
   sprintf(ckpfile, "%s/ularn_%s.ckp", home, loginname);
 
+  trace_phase("restore");
   if (restore_ckp)
   {
     if (access(ckpfile, 0) == -1)
@@ -417,29 +470,105 @@ void ULarnSetup(int argc, char *argv[])
   if (restorflag == 0)
   {
     /* make the character that will play */
+    trace_phase("player");
     makeplayer();
     /* make the dungeon */
+    trace_phase("level");
     newcavelevel(0);
 
     if (nowelcome == 0)
     {
+      trace_phase("welcome");
       /* welcome the player to the game */
       welcome();
     }
   }
 
   /* set up the desired difficulty  */
+  trace_phase("difficulty");
   sethard(hard);
 
+  trace_phase("first frame");
   set_display(DISPLAY_MAP);
 
   showplayer();
+  trace_phase_done();
 
   yrepcount = 0;
   hit2flag = 0;
 
 }
 
+/* =============================================================================
+ * FUNCTION: message_history
+ *
+ * DESCRIPTION:
+ * Let the player page back through the message history.
+ *   k / j     : Scroll back / forward one line
+ *   - / space : Scroll back / forward one page
+ *   ESC / CR  : Return to the current messages
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+#define HISTORY_PAGE 4
+
+static void message_history(void)
+{
+  int Lines;
+  int Offset;
+  char ch;
+
+  Lines = MessageHistoryLines();
+  if (Lines == 0)
+  {
+    Print("\nNo message history.");
+    return;
+  }
+
+  Offset = 0;
+
+  do
+  {
+    ShowMessageHistory(Offset);
+
+    ch = get_prompt_input("", "kj- \033\015", 0);
+
+    switch (ch)
+    {
+      case 'k':
+        Offset++;
+        break;
+
+      case 'j':
+        Offset--;
+        break;
+
+      case '-':
+        Offset += HISTORY_PAGE;
+        break;
+
+      case ' ':
+        Offset -= HISTORY_PAGE;
+        break;
+
+      default:
+        break;
+    }
+
+    if (Offset < 0) Offset = 0;
+    if (Offset > Lines) Offset = Lines;
+
+  } while ((ch != ESC) && (ch != '\015'));
+
+  ShowMessageHistory(0);
+}
+
 /* =============================================================================
  * FUNCTION: parse
  *
@@ -763,6 +892,7 @@ void parse (ActionType Action)
       }
       iven[0] = ONOTHING;
       iven[1] = ONOTHING;
+      inventory_changed(-1);
       take(OPROTRING,50);
       take(OLANCE,25);
       for (i=0; i<IVENSIZE; i++)
@@ -776,7 +906,7 @@ void parse (ActionType Action)
       c[LANCEDEATH]=1;
       c[WEAR] = c[SHIELD] = -1;
       raiseexperience(370*1000000);
-      c[AWARENESS] += 25000;
+      add_effect(AWARENESS, 25000);
 
       /* learn all spells, scrolls and potions */
       for (i = 0; i < SPELL_COUNT ; i++) spelknow[i]=1;
@@ -910,17 +1040,34 @@ void parse (ActionType Action)
       }
       return;
 
+    case ACTION_MESSAGE_HISTORY:
+      yrepcount=0;
+      nomove=1;
+      message_history();
+      return;
+
+    case ACTION_TRAVEL:
+      yrepcount = 0;
+      travel();
+      return;
+
     default:
       Print("HELP! unknown command\n");
       break;
   }
 }
 
-static ActionType
-do_one_turn(void)
+/* =============================================================================
+ * FUNCTION: do_one_turn
+ */
+ActionType do_one_turn(void)
 {
     ActionType Action = ACTION_NULL;
 
+    trace_poll();
+    diag_poll();
+    TRACE_BEGIN(TRACE_TURN);
+
     if (dropflag==0)
     {
       lookforobject(); /* see if there is an object here*/
@@ -955,12 +1102,19 @@ do_one_turn(void)
     while (nomove)
     {
       nomove = 0;
+      TRACE_BEGIN(TRACE_INPUT);
       Action = get_normal_input();
+      TRACE_END(TRACE_INPUT);
       parse(Action);  /* may reset nomove=1 */
+
+      /* present any effects queued while processing the command */
+      anim_play();
     }
 
     /* regenerate hp and spells */
+    TRACE_BEGIN(TRACE_REGEN);
     regen();
+    TRACE_END(TRACE_REGEN);
 
     if (c[TIMESTOP]==0)
     {
@@ -972,9 +1126,13 @@ do_one_turn(void)
       }
     }
 
+    TRACE_END(TRACE_TURN);
+
     return Action;
 }
 
+#ifndef ULARN_NO_MAIN
+
 #ifdef WINDOWS
 
 /* windows uses WinMain instead of main */
@@ -1031,6 +1189,7 @@ int main(int argc, char *argv[])
 
 {
   ActionType Action;
+  jmp_buf EndJump;
 
 #ifdef WINDOWS
 
@@ -1048,6 +1207,7 @@ int main(int argc, char *argv[])
   char *fake_argv[1] = { "ularn" };
 #endif
 
+  trace_phase("display");
 
 #if defined(UNIX_X11)
 
@@ -1117,6 +1277,21 @@ int main(int argc, char *argv[])
 
 #endif
 
+  /*
+   * endgame returns here when the game is over, so that the program exits
+   * from main.
+   */
+  if (setjmp(EndJump) != 0)
+  {
+    free_cells();
+    free_spheres();
+    close_app();
+    trace_phase_report();
+
+    return (0);
+  }
+  game_end_jump = &EndJump;
+
 #ifdef AMIGA_WIN
 
   if (!StartedFromWB)
@@ -1146,7 +1321,7 @@ int main(int argc, char *argv[])
   } while (Action != ACTION_QUIT);
 
   /*
-   * tidyup and exit
+   * tidyup and exit (endgame returns to the setjmp above)
    */
   endgame();
 
@@ -1154,3 +1329,5 @@ int main(int argc, char *argv[])
   return (0);
 
 }
+
+#endif /* ULARN_NO_MAIN */
@@ -0,0 +1,65 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ularn.h
+ *
+ * DESCRIPTION:
+ * This is the main module for ularn.
+ * It contains the setup and main processing loop.
+ *
+ * When compiled with ULARN_NO_MAIN the program entry point is left out so
+ * that the game can be driven by another program (see agent.h).
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * parse       : Perform a player action
+ * do_one_turn : Process one turn of the game
+ *
+ * =============================================================================
+ */
+
+#ifndef __ULARN_H
+#define __ULARN_H
+
+#include "ularn_win.h"
+
+/* =============================================================================
+ * FUNCTION: parse
+ *
+ * DESCRIPTION:
+ * Perform the action requested by the player.
+ * Sets nomove if the action did not use up the player's turn.
+ *
+ * PARAMETERS:
+ *
+ *   Action : The action to perform
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void parse(ActionType Action);
+
+/* =============================================================================
+ * FUNCTION: do_one_turn
+ *
+ * DESCRIPTION:
+ * Process one turn of the game: move the monsters, then get and perform
+ * player actions until one uses up the turn, then regenerate and spawn.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The last action performed by the player.
+ */
+ActionType do_one_turn(void);
+
+#endif
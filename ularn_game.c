@@ -27,6 +27,7 @@
  * optsfile       : Ularn options file
  * ckpfile        : Checkpoint file name
  * diagfile       : Diagnostic dump file name
+ * diagjsonfile   : Machine readable diagnostic dump file name
  * userid         : User Id of the player
  * password       : Wizard password
  * loginname      : The login name of the player
@@ -39,6 +40,7 @@
  * diroffy        : Direction offsets for y coordinate
  * ReverseDir     : Lookup for the index of the reverse direction
  * dirname        : The name of each direction.
+ * rand_state     : The state of the game's random number generator
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -46,16 +48,20 @@
  * newgame      : Funtion to initialise a new game.
  * sethard      : Function to set the game difficulty
  * read_options : Function to read the ularn options file
+ * game_srand   : Seed the game's random number generator
+ * game_rand    : Get the next number from the game's random number generator
  *
  * =============================================================================
  */
 
+#include <stdlib.h>
 #include <time.h>
 
 #include "ularn_game.h"
 #include "header.h"
 #include "monster.h"
 #include "player.h"
+#include "anim.h"
 
 /* =============================================================================
  * Exported variables
@@ -102,6 +108,9 @@ char ckpfile[MAXPATHLEN] = "ularn.ckp";
 /* the diagnostic filename  */
 char diagfile[] = "diagfile.txt";
 
+/* the machine readable diagnostic filename */
+char diagjsonfile[] = "diagfile.json";
+
 /* the wizard's password */
 char *password ="fizban";
 
@@ -115,11 +124,13 @@ char dropflag = 0;   /* if 1 then don't lookforobject() next round */
 char restorflag = 0; /* 1 means restore has been done */
 char enhance_interface = 0; /* 1 means use the enhanced command interface */
 
-char diroffx[] = { 0,  0, 1,  0, -1,  1, -1, 1, -1 };
-char diroffy[] = { 0,  1, 0, -1,  0, -1, -1, 1,  1 };
-int  ReverseDir[] = { 0, 3, 4, 1, 2, 8, 7, 6, 5 };
+const char diroffx[] = { 0,  0, 1,  0, -1,  1, -1, 1, -1 };
+const char diroffy[] = { 0,  1, 0, -1,  0, -1, -1, 1,  1 };
+const int  ReverseDir[] = { 0, 3, 4, 1, 2, 8, 7, 6, 5 };
+
+unsigned long rand_state = 1;
 
-char *dirname[] =
+char *const dirname[] =
 {
   "None",
   "South",
@@ -152,10 +163,11 @@ typedef enum
   OPTION_NOENHANCE_INT,
   OPTION_BEEP,
   OPTION_NOBEEP,
+  OPTION_EFFECT_SPEED,
   OPTION_COUNT
 } OptionType;
 
-static char *OptionString[OPTION_COUNT] =
+static char *const OptionString[OPTION_COUNT] =
 {
   "",
   "name",
@@ -168,7 +180,8 @@ static char *OptionString[OPTION_COUNT] =
   "enhanced_interface",
   "noenhanced_interface",
   "beep",
-  "nobeep"
+  "nobeep",
+  "effect_speed"
 };
 
 
@@ -182,7 +195,7 @@ static char *OptionString[OPTION_COUNT] =
 void newgame(void)
 {
   time(&initialtime);
-  srand((unsigned)initialtime);
+  game_srand((unsigned long) initialtime);
 }
 
 
@@ -367,6 +380,15 @@ void read_options(void)
               nobeep = 1;
               break;
 
+            case OPTION_EFFECT_SPEED:
+              tok = strtok(NULL, ":,\n");
+              if (tok != NULL)
+              {
+                effect_speed = atoi(tok);
+                if (effect_speed < 0) effect_speed = 0;
+              }
+              break;
+
             default:
               Printf("\nUnrecognised option '%s'", tok);
               break;
@@ -393,5 +415,33 @@ void read_options(void)
   fclose(fp);
 }
 
+/* =============================================================================
+ * FUNCTION: game_srand
+ */
+void game_srand(unsigned long Seed)
+{
+  /* Mix the seed so that nearby seeds give unrelated sequences */
+  Seed &= 0xffffffffUL;
+  Seed = ((Seed ^ (Seed >> 16)) * 0x45d9f3bUL) & 0xffffffffUL;
+  Seed = ((Seed ^ (Seed >> 16)) * 0x45d9f3bUL) & 0xffffffffUL;
+  Seed ^= Seed >> 16;
+
+  /* xorshift never leaves the zero state */
+  rand_state = (Seed != 0) ? Seed : 1;
+}
+
+/* =============================================================================
+ * FUNCTION: game_rand
+ */
+long game_rand(void)
+{
+  unsigned long x = rand_state;
 
+  x ^= (x << 13) & 0xffffffffUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xffffffffUL;
+  rand_state = x;
+
+  return (long) (x >> 1);
+}
 
@@ -27,6 +27,7 @@
  * optsfile       : Ularn options file
  * ckpfile        : Checkpoint file name
  * diagfile       : Diagnostic dump file name
+ * diagjsonfile   : Machine readable diagnostic dump file name
  * userid         : User Id of the player
  * password       : Wizard password
  * loginname      : The login name of the player
@@ -39,6 +40,7 @@
  * diroffy        : Direction offsets for y coordinate
  * ReverseDir     : Lookup for the index of the reverse direction
  * dirname        : The name of each direction.
+ * rand_state     : The state of the game's random number generator
  *
  * =============================================================================
  * EXPORTED FUNCTIONS
@@ -46,6 +48,8 @@
  * newgame      : Funtion to initialise a new game.
  * sethard      : Function to set the game difficulty
  * read_options : Function to read the ularn options file
+ * game_srand   : Seed the game's random number generator
+ * game_rand    : Get the next number from the game's random number generator
  *
  * =============================================================================
  */
@@ -118,6 +122,7 @@ extern char ckpfile[MAXPATHLEN];
 
 /* the diagnostic filename  */
 extern char diagfile[];
+extern char diagjsonfile[];
 
 /* the wizard's password */
 extern char *password;
@@ -135,10 +140,16 @@ extern char enhance_interface; /* 1 means use the enhanced command interface */
 /*
  * Direction deltas
  */
-extern char diroffx[];
-extern char diroffy[];
-extern int  ReverseDir[];
-extern char *dirname[];
+extern const char diroffx[];
+extern const char diroffy[];
+extern const int  ReverseDir[];
+extern char *const dirname[];
+
+/*
+ * The state of the game's random number generator.
+ * This is part of the game state: restoring it repeats the same sequence.
+ */
+extern unsigned long rand_state;
 
 /* =============================================================================
  * Exported functions
@@ -194,5 +205,39 @@ void sethard (int hard);
  */
 void read_options(void);
 
+/* =============================================================================
+ * FUNCTION: game_srand
+ *
+ * DESCRIPTION:
+ * Seed the game's random number generator.
+ *
+ * PARAMETERS:
+ *
+ *   Seed : The seed. Any value, including 0, may be used.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void game_srand(unsigned long Seed);
+
+/* =============================================================================
+ * FUNCTION: game_rand
+ *
+ * DESCRIPTION:
+ * Get the next number from the game's random number generator (xorshift).
+ * This replaces the C library rand() for all game random numbers, so that
+ * the sequence is the same on every platform and its state can be saved.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   A random number in the range 0 to 2^31 - 1.
+ */
+long game_rand(void);
+
 
 #endif
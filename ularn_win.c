@@ -29,6 +29,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -43,6 +44,8 @@
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -51,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get the username and user id.
  *
  * =============================================================================
@@ -69,6 +73,8 @@
 #include "ularnpc.rh"
 #include "monster.h"
 #include "itm.h"
+#include "trace.h"
+#include "anim.h"
 
 //
 // Defines for windows
@@ -172,7 +178,9 @@ static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
   { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
   { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
   { { 'R', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_REDRAW_SCREEN,
-  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_SHOW_TAX
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { { 'P', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
 };
 
 static struct KeyCodeType RunKeyMap = { VK_NUMPAD5, M_NONE };
@@ -1175,7 +1183,7 @@ static void GetTile(int x, int y, int *TileId)
   /* Handle walls */
   if (*TileId == objtilelist[OWALL])
   {
-    *TileId = WALL_TILES + iarg[x][y];
+    *TileId = WALL_TILES + wallmask[x][y];
   }
 }
 
@@ -1202,6 +1210,8 @@ static void PaintMap(HDC DC)
   int TileX;
   int TileY;
 
+  TRACE_BEGIN(TRACE_PAINTMAP);
+
   mx = MapTileLeft + MapTileWidth;
   my = MapTileTop + MapTileHeight;
 
@@ -1257,6 +1267,8 @@ static void PaintMap(HDC DC)
 	   TileWidth, TileHeight,
 	   TileDC, TileX, TileY, SRCPAINT);
   }
+
+  TRACE_END(TRACE_PAINTMAP);
 }
 
 /* =============================================================================
@@ -1280,6 +1292,8 @@ static void PaintTextWindow(HDC DC)
   RECT TextRect;
   HPEN Pen;
 
+  TRACE_BEGIN(TRACE_PAINTTEXT);
+
   TextRect.left = TLeft;
   TextRect.top  = TTop;
   TextRect.right = TLeft + TWidth;
@@ -1351,6 +1365,7 @@ static void PaintTextWindow(HDC DC)
     }
   }
 
+  TRACE_END(TRACE_PAINTTEXT);
 }
 
 /* =============================================================================
@@ -2867,6 +2882,17 @@ void set_display(DisplayModeType Mode)
   InvalidateRect(frame_window_handle, NULL, 1);
 }
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  //
+  // Drawing is presented by the window system as it happens, so there is
+  // nothing to hold.
+  //
+}
+
 /* =============================================================================
  * FUNCTION: IncCursorY
  *
@@ -3014,6 +3040,9 @@ void Printc(char c)
 {
   int incx;
 
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
+
   switch (c)
   {
     case '\t':
@@ -3168,15 +3197,27 @@ void ClearToEOPage(int x, int y)
 
 }
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  /* The message window does not keep a history */
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+}
+
 /* =============================================================================
  * FUNCTION: show1cell
  */
 void show1cell(int x, int y)
 {
-  int TileId;
-  int sx, sy;
-  int TileX, TileY;
-
   /* see nothing if blind   */
   if (c[BLINDCOUNT]) return;
 
@@ -3187,6 +3228,32 @@ void show1cell(int x, int y)
     stealth[x][y] |= STEALTH_SEEN;
   }
 
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+
+  GetTile(x, y, &TileId);
+
+  return TileId;
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  int sx, sy;
+  int TileX, TileY;
+
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
   sx = x - MapTileLeft;
   sy = y - MapTileTop;
 
@@ -3200,16 +3267,13 @@ void show1cell(int x, int y)
     return;
   }
 
-  GetTile(x, y, &TileId);
-
-  TileX = (TileId % 16) * TileWidth;
-  TileY = (TileId / 16) * TileHeight;
+  TileX = (Glyph % 16) * TileWidth;
+  TileY = (Glyph / 16) * TileHeight;
 
   BitBlt(frame_dc,
          MapLeft + sx*TileWidth, MapTop + sy*TileHeight,
          TileWidth, TileHeight,
          TileDC, TileX, TileY, SRCCOPY);
-
 }
 
 /* =============================================================================
@@ -3571,6 +3635,8 @@ void nap(int delay)
   MSG msg;       // generic message
   int time_left;
 
+  TRACE_BEGIN(TRACE_NAP);
+
   time_left = delay;
   while (time_left > 0)
   {
@@ -3604,6 +3670,47 @@ void nap(int delay)
 
     time_left -= 100;
   }
+
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  MSG msg;       // generic message
+  int time_left;
+
+  time_left = delay;
+  while (time_left > 0)
+  {
+    //
+    // Stop if a key is waiting, but leave it for the next input request
+    //
+    if (PeekMessage(&msg, NULL, WM_KEYFIRST, WM_KEYLAST, PM_NOREMOVE))
+    {
+      return 1;
+    }
+
+    //
+    // Keep the window responsive while waiting
+    //
+    if (PeekMessage(&msg, NULL, 0, WM_KEYFIRST - 1, PM_REMOVE) ||
+        PeekMessage(&msg, NULL, WM_KEYLAST + 1, 0xFFFF, PM_REMOVE))
+    {
+      if (msg.message == WM_QUIT)
+        break;
+
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+
+    Sleep((time_left > 10) ? 10 : time_left);
+    time_left -= 10;
+  }
+
+  return 0;
 }
 
 //
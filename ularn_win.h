@@ -27,6 +27,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -40,7 +41,11 @@
  * SetFormat              : Set the output text format
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
+ * MessageHistoryLines    : Get the number of lines in the message history
+ * ShowMessageHistory     : Show the message window scrolled into the history
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -49,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get the username and user id.
  *
  * =============================================================================
@@ -193,6 +199,8 @@ typedef enum ActionType
   ACTION_QUIT,
   ACTION_REDRAW_SCREEN,
   ACTION_SHOW_TAX,
+  ACTION_MESSAGE_HISTORY,
+  ACTION_TRAVEL,
   ACTION_COUNT
 } ActionType;
 
@@ -367,6 +375,25 @@ ActionType get_dir_input(char *prompt, int ShowCursor);
  */
 void set_display(DisplayModeType Mode);
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ *
+ * DESCRIPTION:
+ * Hold or release the presentation of display updates.
+ * While held, drawing is still performed but is not presented on screen.
+ * Releasing the hold presents everything drawn while it was held.
+ * The hold is released automatically when input is requested.
+ *
+ * PARAMETERS:
+ *
+ *   Hold : 1 to hold display updates, 0 to release the hold.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void set_display_hold(int Hold);
+
 
 /* =============================================================================
  * Status and effects display update functions
@@ -594,6 +621,41 @@ void ClearToEOL(void);
  */
 void ClearToEOPage(int x, int y);
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ *
+ * DESCRIPTION:
+ * Get the number of message lines that have scrolled off the top of the
+ * message window and are still held in the scrollback history.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The number of history lines available.
+ */
+int MessageHistoryLines(void);
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ *
+ * DESCRIPTION:
+ * Redraw the message window scrolled back into the message history.
+ * Only valid in DISPLAY_MAP mode.
+ *
+ * PARAMETERS:
+ *
+ *   Offset : The number of lines to scroll back. 0 shows the current
+ *            messages.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void ShowMessageHistory(int Offset);
+
 /* =============================================================================
  * Map display functions
  */
@@ -617,6 +679,47 @@ void ClearToEOPage(int x, int y);
  */
 void show1cell(int x, int y);
 
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ *
+ * DESCRIPTION:
+ * Get the glyph that shows a cell of the map as the player currently knows
+ * it. Unlike show1cell, this doesn't change what the player knows, so the
+ * glyph may be recorded and drawn later with show_cell_glyph.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the cell.
+ *
+ *   y : The y coordinate of the cell.
+ *
+ * RETURN VALUE:
+ *
+ *   The display specific glyph for the cell.
+ */
+int get_cell_glyph(int x, int y);
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ *
+ * DESCRIPTION:
+ * Draw a glyph returned by get_cell_glyph in a single cell of the map.
+ * Nothing is drawn if the player is blind.
+ *
+ * PARAMETERS:
+ *
+ *   x     : The x coordinate of the cell.
+ *
+ *   y     : The y coordinate of the cell.
+ *
+ *   Glyph : The glyph to draw.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void show_cell_glyph(int x, int y, int Glyph);
+
 /* =============================================================================
  * FUNCTION: showplayer
  *
@@ -771,6 +874,23 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame);
  */
 void nap(int delay);
 
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ *
+ * DESCRIPTION:
+ * Delay for a number of milliseconds, stopping early if a key is pressed.
+ * The key is not consumed and will be returned by the next input request.
+ *
+ * PARAMETERS:
+ *
+ *   delay : The maximum number of milliseconds to delay
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the delay was ended by a key press, otherwise 0.
+ */
+int nap_until_key(int delay);
+
 /* =============================================================================
  * User name functions
  */
@@ -0,0 +1,558 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ularn_winagent.c
+ *
+ * DESCRIPTION:
+ * This module contains all operating system dependant code for input and
+ * display update.
+ * Each version of ularn should provide a different implementation of this
+ * module.
+ *
+ * This is the headless display module used by the agent interface.
+ * Nothing is drawn. Commands and prompt answers come from the agent action
+ * queue (see agent.h). The map knowledge updates made by the other display
+ * modules when cells are shown are kept, as they are part of the game state.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * nonap         : Set to true if no time delays are to be used.
+ * nosignal      : Set if ctrl-C is to be trapped to prevent exit.
+ * enable_scroll : Probably superfluous
+ * yrepcount     : Repeat count for input commands.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * init_app               : Initialise the app
+ * close_app              : Close the app and free resources
+ * get_normal_input       : Get the next command input
+ * get_prompt_input       : Get input in response to a question
+ * get_password_input     : Get a password
+ * get_num_input          : Geta number
+ * get_dir_input          : Get a direction
+ * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
+ * UpdateStatus           : Update the status display
+ * UpdateEffects          : Update the effects display
+ * UpdateStatusAndEffects : Update both status and effects display
+ * ClearText              : Clear the text output area
+ * beep                   : Make a beep
+ * Cursor                 : Set the cursor location
+ * Printc                 : Print a single character
+ * Print                  : Print a string
+ * Printf                 : Print a formatted string
+ * Standout               : Print a string is standout format
+ * SetFormat              : Set the output text format
+ * ClearEOL               : Clear to end of line
+ * ClearEOPage            : Clear to end of page
+ * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
+ * showplayer             : Show the player on the map
+ * showcell               : Show the area around the player
+ * drawscreen             : Redraw the screen
+ * draws                  : Redraw a section of the screen
+ * mapeffect              : Draw a directional effect
+ * magic_effect_frames    : Get the number of animation frames in a magic fx
+ * magic_effect           : Draw a frame in a magic fx
+ * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
+ * GetUser                : Get the username and user id.
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "header.h"
+#include "ularn_game.h"
+
+#include "dungeon.h"
+#include "player.h"
+#include "ularn_win.h"
+#include "monster.h"
+#include "itm.h"
+#include "agent.h"
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int nonap = 1;
+int nosignal = 0;
+
+char enable_scroll = 0;
+
+int yrepcount = 0;
+
+/* =============================================================================
+ * Local variables
+ */
+
+#define NUM_DIRS 8
+
+/*
+ * The movement keys and the direction each selects.
+ */
+static char DirKeys[NUM_DIRS + 1] = "hljkuynb";
+
+static ActionType DirActions[NUM_DIRS] =
+{
+  ACTION_MOVE_WEST,
+  ACTION_MOVE_EAST,
+  ACTION_MOVE_SOUTH,
+  ACTION_MOVE_NORTH,
+  ACTION_MOVE_NORTHEAST,
+  ACTION_MOVE_NORTHWEST,
+  ACTION_MOVE_SOUTHEAST,
+  ACTION_MOVE_SOUTHWEST
+};
+
+static DisplayModeType CurrentDisplayMode = DISPLAY_MAP;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: know_cell
+ *
+ * DESCRIPTION:
+ * Update the player's knowledge of a cell when it is shown.
+ *
+ * PARAMETERS:
+ *
+ *   x : The x coordinate of the cell
+ *
+ *   y : The y coordinate of the cell
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void know_cell(int x, int y)
+{
+  know[x][y] = item[x][y];
+  if (mitem[x][y].mon != MONST_NONE)
+  {
+    stealth[x][y] |= STEALTH_SEEN;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: get_answer_line
+ *
+ * DESCRIPTION:
+ * Get a line of text from the prompt answers, up to the next '\r'.
+ *
+ * PARAMETERS:
+ *
+ *   string : The buffer for the text
+ *
+ *   Len    : The maximum length of the text
+ *
+ * RETURN VALUE:
+ *
+ *   The length of the text.
+ */
+static int get_answer_line(char *string, int Len)
+{
+  int ch;
+  int Pos;
+
+  Pos = 0;
+  while (((ch = agent_next_answer()) != -1) && (ch != '\015'))
+  {
+    if (Pos < Len)
+    {
+      string[Pos] = (char) ch;
+      Pos++;
+    }
+  }
+
+  string[Pos] = 0;
+
+  return Pos;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: init_app
+ */
+int init_app(void)
+{
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: close_app
+ */
+void close_app(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: get_normal_input
+ */
+ActionType get_normal_input(void)
+{
+  return agent_next_action();
+}
+
+/* =============================================================================
+ * FUNCTION: get_prompt_input
+ */
+char get_prompt_input(char *prompt, char *answers, int ShowCursor)
+{
+  int ch;
+
+  //
+  // Skip queued answers that are not valid for this prompt, as the
+  // other display modules ignore keys that are not answers.
+  //
+  while ((ch = agent_next_answer()) != -1)
+  {
+    if ((ch != 0) && (strchr(answers, ch) != NULL))
+    {
+      return (char) ch;
+    }
+  }
+
+  //
+  // No answer given, so take the most cautious one.
+  //
+  if (strchr(answers, '\033') != NULL)
+  {
+    return '\033';
+  }
+
+  return answers[0];
+}
+
+/* =============================================================================
+ * FUNCTION: get_password_input
+ */
+void get_password_input(char *password, int Len)
+{
+  get_answer_line(password, Len);
+}
+
+/* =============================================================================
+ * FUNCTION: get_num_input
+ */
+int get_num_input(int defval)
+{
+  char Line[32];
+
+  if (get_answer_line(Line, sizeof(Line) - 1) == 0)
+  {
+    return defval;
+  }
+
+  if (Line[0] == '*')
+  {
+    return defval;
+  }
+
+  return atoi(Line);
+}
+
+/* =============================================================================
+ * FUNCTION: get_dir_input
+ */
+ActionType get_dir_input(char *prompt, int ShowCursor)
+{
+  int ch;
+  char *Key;
+
+  while ((ch = agent_next_answer()) != -1)
+  {
+    Key = (ch != 0) ? strchr(DirKeys, ch) : NULL;
+    if (Key != NULL)
+    {
+      return DirActions[Key - DirKeys];
+    }
+  }
+
+  return DirActions[0];
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateStatus
+ */
+void UpdateStatus(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateEffects
+ */
+void UpdateEffects(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateStatusAndEffects
+ */
+void UpdateStatusAndEffects(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: set_display
+ */
+void set_display(DisplayModeType Mode)
+{
+  CurrentDisplayMode = Mode;
+}
+
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: ClearText
+ */
+void ClearText(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: UlarnBeep
+ */
+void UlarnBeep(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: MoveCursor
+ */
+void MoveCursor(int x, int y)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: Printc
+ */
+void Printc(char c)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: Print
+ */
+void Print(char *string)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: Printf
+ */
+void Printf(char *fmt, ...)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: Standout
+ */
+void Standout(char *String)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: SetFormat
+ */
+void SetFormat(FormatType format)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: ClearToEOL
+ */
+void ClearToEOL(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: ClearToEOPage
+ */
+void ClearToEOPage(int x, int y)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: show1cell
+ */
+void show1cell(int x, int y)
+{
+  /* see nothing if blind		*/
+  if (c[BLINDCOUNT]) return;
+
+  /* we end up knowing about it */
+  know_cell(x, y);
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: showplayer
+ */
+void showplayer(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: showcell
+ */
+void showcell(int x, int y)
+{
+  int minx, maxx;
+  int miny, maxy;
+  int mx, my;
+
+  /*
+   * Decide how much the player knows about around him/her.
+   */
+  if (c[AWARENESS])
+  {
+    minx = x-3;
+    maxx = x+3;
+    miny = y-3;
+    maxy = y+3;
+  }
+  else
+  {
+    minx = x-1;
+    maxx = x+1;
+    miny = y-1;
+    maxy = y+1;
+  }
+
+  if (c[BLINDCOUNT])
+  {
+    minx = x;
+    maxx = x;
+    miny = y;
+    maxy = y;
+  }
+
+  /*
+   * Limit the area to the map extents
+   */
+  if (minx < 0) minx = 0;
+  if (maxx > MAXX-1) maxx = MAXX-1;
+  if (miny < 0) miny=0;
+  if (maxy > MAXY-1) maxy = MAXY-1;
+
+  for (my = miny; my <= maxy; my++)
+  {
+    for (mx = minx; mx <= maxx; mx++)
+    {
+      know_cell(mx, my);
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: drawscreen
+ */
+void drawscreen(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: draws
+ */
+void draws(int minx, int miny, int maxx, int maxy)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: mapeffect
+ */
+void mapeffect(int x, int y, DirEffectsType effect, int dir)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: magic_effect_frames
+ */
+int magic_effect_frames(MagicEffectsType fx)
+{
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: magic_effect
+ */
+void magic_effect(int x, int y, MagicEffectsType fx, int frame)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: nap
+ */
+void nap(int delay)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: GetUser
+ */
+void GetUser(char *username, int *uid)
+{
+  if (username[0] == 0)
+  {
+    strcpy(username, "agent");
+  }
+
+  *uid = 0;
+}
@@ -29,6 +29,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -43,6 +44,8 @@
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -51,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get teh username and user id.
  *
  * =============================================================================
@@ -72,6 +76,9 @@
 #include "ularn_win.h"
 #include "monster.h"
 #include "itm.h"
+#include "trace.h"
+#include "anim.h"
+#include "tileatlas.h"
 
 // Default size of the ularn window in characters
 #define WINDOW_WIDTH    80
@@ -170,7 +177,9 @@ static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
   { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
   { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
   { { 'r', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_REDRAW_SCREEN,
-  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_SHOW_TAX
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { { 'p', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
 };
 
 static struct KeyCodeType RunKeyMap = { SDLK_KP5, M_NONE };
@@ -210,6 +219,12 @@ char * font_name = "lib/ularn_font.ttf";
 
 static SDL_Surface* TilePixmap = NULL;
 static SDL_Surface* TilePixmapKeyed = NULL;
+
+//
+// The mapped tile atlas the tile surfaces use as their pixels, if there is
+// one.
+//
+static TileAtlasType TileAtlas;
 static SDL_Surface* MenuPixmap = NULL;
 
 static int CaretActive = 0;
@@ -226,6 +241,11 @@ static int MinWindowHeight;
 
 static int Runkey;
 static ActionType Event;
+
+//
+// Set while presentation of display updates is held
+//
+static int DisplayHold = 0;
 static int GotChar;
 static char EventChar;
 
@@ -233,6 +253,7 @@ static char EventChar;
 // Bitmaps for tiles
 //
 
+static char *AtlasFilename = "lib/ularn_gfx.atl";
 static char *TileFilename = "lib/ularn_gfx.bmp";
 static char *MenuFilename = "lib/ularn_menu.bmp";
 
@@ -440,13 +461,18 @@ typedef FormatType FormatLine[LINE_LENGTH + 1];
 
 //
 // Messages
+// The message buffer holds MAX_MSG_HISTORY lines so that lines scrolled
+// off the message window can be paged back through.
 //
 #define MAX_MSG_LINES    5
-static TextLine MessageChr[MAX_MSG_LINES];
-static FormatLine MessageFmt[MAX_MSG_LINES];
+#define MAX_MSG_HISTORY  500
+static TextLine MessageChr[MAX_MSG_HISTORY];
+static FormatLine MessageFmt[MAX_MSG_HISTORY];
 static FormatType CurrentMsgFormat;
 static int MsgCursorX = 1;
 static int MsgCursorY = 1;
+static int MsgTopLine = 0;
+static int MsgHistoryLines = 0;
 
 //
 // Text
@@ -458,17 +484,30 @@ static FormatLine TextFmt[MAX_TEXT_LINES];
 static FormatType CurrentTextFormat;
 static int TextCursorX = 1;
 static int TextCursorY = 1;
+static int TextTopLine = 0;
 
 //
 // Generalised text buffer
 // Top left corner is x=1, y=1
 //
+// Text and Format are ring buffers of RingLines lines, so scrolling only
+// moves TopLine, the ring index of the line at the top of the window.
+// HistoryLines is the number of lines above TopLine still held in the ring
+// and ViewOffset is how far the display is scrolled back into them.
+// Use TEXT_ROW to get the ring index of a window line.
+//
 static TextLine   *Text;
 static FormatLine *Format;
 static FormatType CurrentFormat;
 static int CursorX = 1;
 static int CursorY = 1;
 static int MaxLine;
+static int RingLines;
+static int TopLine;
+static int HistoryLines;
+static int ViewOffset = 0;
+
+#define TEXT_ROW(y) ((TopLine + RingLines - ViewOffset + (y)) % RingLines)
 static int TTop;
 static int TLeft;
 static int TWidth;
@@ -483,6 +522,29 @@ static int mimicmonst = MIMIC;
  * Local functions
  */
 
+/* =============================================================================
+ * FUNCTION: PresentWindow
+ *
+ * DESCRIPTION:
+ * Present the contents of the window surface on the screen, unless the
+ * display is currently held.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PresentWindow(void)
+{
+  if (!DisplayHold)
+  {
+    SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  }
+}
+
 /* =============================================================================
  * FUNCTION: calc_scroll
  *
@@ -598,6 +660,143 @@ static void CalcMinWindowSize(void)
 static int Repaint = 0;
 
 
+/*
+ * Glyph atlas.
+ * Each printable character is rendered once per text format after the font
+ * is opened, so drawing text is just a blit from this surface.
+ * Row n of the atlas holds the glyphs for FormatType n.
+ */
+#define FIRST_GLYPH  32
+#define LAST_GLYPH   126
+#define NUM_GLYPHS   (LAST_GLYPH - FIRST_GLYPH + 1)
+#define NUM_GLYPH_FORMATS (FORMAT_INVERSE + 1)
+
+static SDL_Surface *GlyphAtlas = NULL;
+
+/* The foreground colour used for each text format */
+static SDL_Color *FormatColour[NUM_GLYPH_FORMATS] =
+{
+  &Black,  /* FORMAT_NORMAL    */
+  &Red,    /* FORMAT_STANDOUT  */
+  &Green,  /* FORMAT_STANDOUT2 */
+  &Blue,   /* FORMAT_STANDOUT3 */
+  &Black,  /* FORMAT_BOLD      */
+  &Black   /* FORMAT_INVERSE   */
+};
+
+/* =============================================================================
+ * FUNCTION: BuildGlyphAtlas
+ *
+ * DESCRIPTION:
+ * Render every printable character in every text format into the glyph
+ * atlas. Must be called after the font is opened and the character size
+ * is known.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   0 if the atlas could not be created, or 1 if success.
+ */
+static int BuildGlyphAtlas(void)
+{
+  SDL_Surface *tmp;
+  SDL_Surface *glyph;
+  SDL_Rect dst;
+  char cbuf[2];
+  int fmt;
+  int ch;
+
+  tmp = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                             NUM_GLYPHS * CharWidth,
+                             NUM_GLYPH_FORMATS * CharHeight,
+                             ularn_window->format->BitsPerPixel,
+                             ularn_window->format->Rmask,
+                             ularn_window->format->Gmask,
+                             ularn_window->format->Bmask,
+                             ularn_window->format->Amask);
+  if (tmp == NULL)
+  {
+    return 0;
+  }
+
+  GlyphAtlas = SDL_DisplayFormat(tmp);
+  SDL_FreeSurface(tmp);
+
+  if (GlyphAtlas == NULL)
+  {
+    return 0;
+  }
+
+  SDL_FillRect(GlyphAtlas, NULL, white_pixel);
+
+  cbuf[1] = 0;
+
+  for (fmt = 0 ; fmt < NUM_GLYPH_FORMATS ; fmt++)
+  {
+    for (ch = FIRST_GLYPH ; ch <= LAST_GLYPH ; ch++)
+    {
+      cbuf[0] = (char) ch;
+
+      glyph = TTF_RenderText_Shaded(font_info, cbuf, *FormatColour[fmt], White);
+      if (glyph != NULL)
+      {
+        dst.x = (ch - FIRST_GLYPH) * CharWidth;
+        dst.y = fmt * CharHeight;
+        dst.w = CharWidth;
+        dst.h = CharHeight;
+        SDL_SetClipRect(GlyphAtlas, &dst);
+        SDL_BlitSurface(glyph, NULL, GlyphAtlas, &dst);
+        SDL_FreeSurface(glyph);
+      }
+    }
+  }
+
+  SDL_SetClipRect(GlyphAtlas, NULL);
+
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: DrawChar
+ *
+ * DESCRIPTION:
+ * Draw a single character at position x, y from the glyph atlas.
+ * Characters not in the atlas are drawn as blanks.
+ *
+ * PARAMETERS:
+ *
+ *   x, y = upper left corner of the character
+ *   ch   = character (ASCII encoded)
+ *   fmt  = text format
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void
+DrawChar(int x, int y, char ch, FormatType fmt)
+{
+  SDL_Rect src;
+  SDL_Rect dst;
+
+  if ((ch < FIRST_GLYPH) || (ch > LAST_GLYPH))
+  {
+    ch = ' ';
+  }
+
+  src.x = (ch - FIRST_GLYPH) * CharWidth;
+  src.y = fmt * CharHeight;
+  src.w = dst.w = CharWidth;
+  src.h = dst.h = CharHeight;
+  dst.x = x;
+  dst.y = y;
+
+  SDL_BlitSurface(GlyphAtlas, &src, ularn_window, &dst);
+}
+
 /* =============================================================================
  * FUNCTION: DrawString
  *
@@ -608,28 +807,22 @@ static int Repaint = 0;
  *
  *   x, y = upper left corner of string
  *   str  = string (ASCII encoded)
- *   fg   = foreground color
- *   bg   = background color
+ *   len  = number of characters to draw
+ *   fmt  = text format
  *
  * RETURN VALUE:
  *
  *   None.
  */
 static void
-DrawString(int x, int y, const char *str, SDL_Color fg, SDL_Color bg)
+DrawString(int x, int y, const char *str, int len, FormatType fmt)
 {
-    SDL_Surface *text;
-
-    text = TTF_RenderText_Shaded(font_info, str, fg, bg);
-//    text = TTF_RenderText_Solid(font_info, str, fg);
-    if (text) {
-        SDL_Rect dst;
+  int i;
 
-        dst.x = x; dst.y = y;
-        dst.w = text->w; dst.h = text->h;
-        SDL_BlitSurface(text, NULL, ularn_window, &dst);
-        SDL_FreeSurface(text);
-    }
+  for (i = 0 ; i < len ; i++)
+  {
+    DrawChar(x + i * CharWidth, y, str[i], fmt);
+  }
 }
 
 static void
@@ -706,7 +899,7 @@ static void PaintStatus(void)
   sprintf(Buf, " Exp: %-9ld %s", c[EXPERIENCE], class[c[LEVEL]-1]);
   strcat(Line, Buf);
 
-  DrawString(StatusRect.x, StatusRect.y, Line, Black, White);
+  DrawString(StatusRect.x, StatusRect.y, Line, strlen(Line), FORMAT_NORMAL);
 
   //
   // Format the second line of the status
@@ -733,7 +926,8 @@ static void PaintStatus(void)
   sprintf(Buf, "  Gold: %-8ld", c[GOLD]);
   strcat(Line, Buf);
 
-  DrawString(StatusRect.x, StatusRect.y + CharHeight, Line, Black, White);
+  DrawString(StatusRect.x, StatusRect.y + CharHeight, Line, strlen(Line),
+             FORMAT_NORMAL);
 
   //
   // Mark all character values as displayed.
@@ -805,8 +999,9 @@ static void PaintEffects(void)
     {
       if (IsSet)
       {
-          DrawString(EffectsRect.x, EffectsRect.y + i * CharHeight, bot_data[i].string,
-                     Black, White);
+          DrawString(EffectsRect.x, EffectsRect.y + i * CharHeight,
+                     bot_data[i].string, strlen(bot_data[i].string),
+                     FORMAT_NORMAL);
       }
       else
       {
@@ -922,7 +1117,7 @@ static void GetTile(int x, int y, int *TileId)
   /* Handle walls */
   if (*TileId == objtilelist[OWALL])
   {
-    *TileId = WALL_TILES + iarg[x][y];
+    *TileId = WALL_TILES + wallmask[x][y];
   }
 }
 
@@ -949,6 +1144,7 @@ static void PaintMap(void)
   int TileX;
   int TileY;
 
+  TRACE_BEGIN(TRACE_PAINTMAP);
 
   if (Repaint)
     {
@@ -1004,6 +1200,8 @@ static void PaintMap(void)
 		MapRect.x + sx*TileWidth, 
 		MapRect.y + sy*TileHeight);
     }
+
+  TRACE_END(TRACE_PAINTMAP);
 }
 
 /* =============================================================================
@@ -1022,11 +1220,12 @@ static void PaintMap(void)
  */
 static void PaintTextWindow(void)
 {
-  int sx, ex, y;
-  FormatType Fmt;
+  int x, y;
+  int Row;
   int FillX, FillY;
   int FillWidth, FillHeight;
-  SDL_Color fgcolor, bgcolor;
+
+  TRACE_BEGIN(TRACE_PAINTTEXT);
 
   FillX = TLeft;
   FillY  = TTop;
@@ -1111,50 +1310,18 @@ static void PaintTextWindow(void)
 
   FillRectangle(FillX, FillY, FillWidth, FillHeight, white_pixel);
 
-  fgcolor = Black;
-  bgcolor = White;
-
   for (y = 0 ; y < MaxLine ; y++)
     {
-      sx = 0;
-      char sbuf[LINE_LENGTH+1];
+      Row = TEXT_ROW(y);
 
-      while (sx < LINE_LENGTH)
+      for (x = 0 ; x < LINE_LENGTH ; x++)
 	{
-	  Fmt = Format[y][sx];
-	  ex = sx;
-	  
-	  while ((ex < LINE_LENGTH) && (Format[y][ex] == Fmt)) ex++;
-	  
-	  switch (Fmt)
-	    {
-	    case FORMAT_NORMAL:
-              fgcolor = Black;
-	      break;
-	    case FORMAT_STANDOUT:
-	      fgcolor = Red;
-	      break;
-	    case FORMAT_STANDOUT2:
-	      fgcolor = Green;
-	      break;
-	    case FORMAT_STANDOUT3:
-	      fgcolor = Blue;
-	      break;
-	    default:
-	      break;
-	    }
-
-          strncpy(sbuf, Text[y]+sx, ex - sx);
-          sbuf[ex - sx] = 0;
-
-	  DrawString( TLeft + sx * CharWidth,
-		      TTop + y * CharHeight,
-		      sbuf, fgcolor, bgcolor );
-	  
-	  sx = ex;
+	  DrawChar(TLeft + x * CharWidth, TTop + y * CharHeight,
+		   Text[Row][x], Format[Row][x]);
 	}
     }
-  
+
+  TRACE_END(TRACE_PAINTTEXT);
 }
 
 /* =============================================================================
@@ -1517,6 +1684,8 @@ handle_mouse(SDL_MouseButtonEvent *button)
         bx = (bx - TLeft) / CharWidth;
         by = (by - TTop) / CharHeight;
 
+        by = TEXT_ROW(by);
+
         ch = Text[by][bx];
         if (ch == '(' && bx < LINE_LENGTH-1)
             ch = Text[by][bx+1];
@@ -1690,6 +1859,74 @@ static int MaskTiles[MASK_TILES][2] =
 };
 #endif
 
+/* =============================================================================
+ * FUNCTION: LoadTiles
+ *
+ * DESCRIPTION:
+ * Load the tile graphics.
+ * The pre-converted tile atlas is mapped and used as the surface pixels
+ * directly if it exists, otherwise the BMP is decoded. The keyed surface
+ * for overlay tiles shares the pixels of the plain one.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   1 if successful, 0 if the tiles could not be loaded.
+ */
+static int LoadTiles(void)
+{
+  Uint32 Rmask, Gmask, Bmask;
+
+  if (tileatlas_open(AtlasFilename, &TileAtlas))
+  {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    Rmask = 0x00ff0000;
+    Gmask = 0x0000ff00;
+    Bmask = 0x000000ff;
+#else
+    Rmask = 0x0000ff00;
+    Gmask = 0x00ff0000;
+    Bmask = 0xff000000;
+#endif
+
+    //
+    // The surfaces are only ever blitted from, so the read only mapping is
+    // never written.
+    //
+    TilePixmap = SDL_CreateRGBSurfaceFrom(
+      (void *) TileAtlas.Pixels, TileAtlas.Width, TileAtlas.Height,
+      32, TileAtlas.Stride, Rmask, Gmask, Bmask, 0);
+    TilePixmapKeyed = SDL_CreateRGBSurfaceFrom(
+      (void *) TileAtlas.Pixels, TileAtlas.Width, TileAtlas.Height,
+      32, TileAtlas.Stride, Rmask, Gmask, Bmask, 0);
+  }
+  else
+  {
+    TilePixmap = SDL_LoadBMP(TileFilename);
+    if (TilePixmap != NULL)
+    {
+      TilePixmapKeyed = SDL_CreateRGBSurfaceFrom(
+        TilePixmap->pixels, TilePixmap->w, TilePixmap->h,
+        TilePixmap->format->BitsPerPixel, TilePixmap->pitch,
+        TilePixmap->format->Rmask, TilePixmap->format->Gmask,
+        TilePixmap->format->Bmask, TilePixmap->format->Amask);
+    }
+  }
+
+  if (TilePixmap == NULL || TilePixmapKeyed == NULL)
+  {
+    fprintf(stderr, "Error reading pixmap: %s\n", TileFilename);
+    return 0;
+  }
+
+  SDL_SetColorKey(TilePixmapKeyed, SDL_SRCCOLORKEY|SDL_RLEACCEL, 0);
+
+  return 1;
+}
+
 /* =============================================================================
  * Exported functions
  */
@@ -1735,6 +1972,7 @@ int init_app(void)
   SDL_WM_SetCaption( "UVLarn", NULL );
 
   /* Set up font */
+  trace_phase("font");
   font_info = TTF_OpenFont(font_name, FONT_SIZE);
   if (!font_info)
     {
@@ -1742,17 +1980,13 @@ int init_app(void)
       return 0;
     }
 
-  TilePixmap = SDL_LoadBMP(TileFilename);
-  TilePixmapKeyed = SDL_LoadBMP(TileFilename);
-
-  if (TilePixmap == NULL || TilePixmapKeyed == NULL)
+  trace_phase("tiles");
+  if (!LoadTiles())
     {
-        fprintf(stderr, "Error reading pixmap: %s\n", TileFilename);
         return 0;
     }
 
-  SDL_SetColorKey(TilePixmapKeyed, SDL_SRCCOLORKEY|SDL_RLEACCEL, 0);
-
+  trace_phase("menu");
   MenuPixmap = SDL_LoadBMP(MenuFilename);
   if (MenuPixmap == NULL)
     {
@@ -1769,7 +2003,7 @@ int init_app(void)
   //
   // Clear the text buffers
   //
-  for (y = 0 ; y < MAX_MSG_LINES ; y++)
+  for (y = 0 ; y < MAX_MSG_HISTORY ; y++)
   {
     for (x = 0 ; x < LINE_LENGTH ; x++)
     {
@@ -1796,6 +2030,13 @@ int init_app(void)
   //
   CalcMinWindowSize();
 
+  trace_phase("glyphs");
+  if (!BuildGlyphAtlas())
+    {
+        fprintf(stderr, "Error: Cannot create glyph atlas\n");
+        return 0;
+    }
+
   Resize(LarnWindowWidth, LarnWindowHeight);
 
   return 1;
@@ -1807,12 +2048,30 @@ int init_app(void)
 void close_app(void)
 {
 
+  //
+  // The keyed surface shares the pixels of the plain one, so it is freed
+  // first and the atlas is unmapped last.
+  //
+  if (TilePixmapKeyed != NULL)
+    {
+      SDL_FreeSurface(TilePixmapKeyed);
+      TilePixmapKeyed = NULL;
+    }
+
   if (TilePixmap != NULL)
     {
       SDL_FreeSurface(TilePixmap);
       TilePixmap = NULL;
     }
 
+  tileatlas_close(&TileAtlas);
+
+  if (GlyphAtlas != NULL)
+    {
+      SDL_FreeSurface(GlyphAtlas);
+      GlyphAtlas = NULL;
+    }
+
     SDL_Quit();
 }
 
@@ -1825,6 +2084,8 @@ ActionType get_normal_input(void)
   int idx;
   int got_dir;
 
+  if (DisplayHold) set_display_hold(0);
+
   Event = ACTION_NULL;
   Runkey = 0;
 
@@ -1883,6 +2144,8 @@ char get_prompt_input(char *prompt, char *answers, int ShowCursor)
   SDL_Event xevent;       // The X event
   char *ch;
 
+  if (DisplayHold) set_display_hold(0);
+
   Print(prompt);
 
   if (ShowCursor)
@@ -1966,6 +2229,8 @@ void get_password_input(char *password, int Len)
   int Pos;
   int value;
 
+  if (DisplayHold) set_display_hold(0);
+
   /* get the printable characters on this system */
   Pos = 0;
   for (value = 0 ; value < 256 ; value++)
@@ -2098,6 +2363,8 @@ ActionType get_dir_input(char *prompt, int ShowCursor)
   int got_dir;
   int idx;
 
+  if (DisplayHold) set_display_hold(0);
+
   //
   // Display the prompt at the current position
   //
@@ -2187,7 +2454,7 @@ void UpdateStatus(void)
   }
 
   PaintStatus();
-  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  PresentWindow();
 }
 
 /* =============================================================================
@@ -2202,7 +2469,7 @@ void UpdateEffects(void)
   }
 
   PaintEffects();
-  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  PresentWindow();
 
 }
 
@@ -2238,12 +2505,15 @@ void set_display(DisplayModeType Mode)
     MsgCursorX = CursorX;
     MsgCursorY = CursorY;
     CurrentMsgFormat = CurrentFormat;
+    MsgTopLine = TopLine;
+    MsgHistoryLines = HistoryLines;
   }
   else if (CurrentDisplayMode == DISPLAY_TEXT)
   {
     TextCursorX = CursorX;
     TextCursorY = CursorY;
     CurrentTextFormat = CurrentFormat;
+    TextTopLine = TopLine;
   }
 
   CurrentDisplayMode = Mode;
@@ -2260,6 +2530,9 @@ void set_display(DisplayModeType Mode)
     Text = MessageChr;
     Format = MessageFmt;
     MaxLine = MAX_MSG_LINES;
+    RingLines = MAX_MSG_HISTORY;
+    TopLine = MsgTopLine;
+    HistoryLines = MsgHistoryLines;
 
     TLeft = MessageRect.x;
     TTop = MessageRect.y;
@@ -2276,6 +2549,9 @@ void set_display(DisplayModeType Mode)
     Text = TextChr;
     Format = TextFmt;
     MaxLine = MAX_TEXT_LINES;
+    RingLines = MAX_TEXT_LINES;
+    TopLine = TextTopLine;
+    HistoryLines = 0;
 
     TLeft = TextRect.x;
     TTop = TextRect.y;
@@ -2288,6 +2564,49 @@ void set_display(DisplayModeType Mode)
   SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
 }
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  DisplayHold = Hold;
+
+  if (!Hold)
+  {
+    SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: ScrollTextWindow
+ *
+ * DESCRIPTION:
+ * Scroll the text window display up one line and clear the bottom line.
+ * The display is only moved, the text buffer must already be scrolled.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void ScrollTextWindow(void)
+{
+  //
+  // The blit copies rows top to bottom, so moving the area up over itself
+  // is safe.
+  //
+  CopyArea(ularn_window, ularn_window,
+           TLeft, TTop + CharHeight,
+           TWidth, (MaxLine - 1) * CharHeight,
+           TLeft, TTop);
+
+  FillRectangle(TLeft, TTop + (MaxLine - 1) * CharHeight,
+                TWidth, CharHeight, white_pixel);
+}
+
 /* =============================================================================
  * FUNCTION: IncCursorY
  *
@@ -2304,13 +2623,11 @@ void set_display(DisplayModeType Mode)
  */
 static void IncCursorY(int Count)
 {
-  int Scroll;
   int inc;
-  int Line;
+  int Row;
   int x;
 
   inc = Count;
-  Scroll = 0;
 
   while (inc > 0)
   {
@@ -2318,31 +2635,30 @@ static void IncCursorY(int Count)
 
     if (CursorY > MaxLine)
     {
-      Scroll = 1;
-      for (Line = 0 ; Line < (MaxLine - 1) ; Line++)
+      CursorY--;
+
+      //
+      // Advance the top of the ring. The line scrolled off the top is kept
+      // as history if the ring is bigger than the window.
+      //
+      TopLine = (TopLine + 1) % RingLines;
+      if (HistoryLines < (RingLines - MaxLine))
       {
-        for (x = 0 ; x < LINE_LENGTH ; x++)
-        {
-          Text[Line][x] = Text[Line+1][x];
-          Format[Line][x] = Format[Line+1][x];
-        }
+        HistoryLines++;
       }
-      CursorY--;
 
+      Row = TEXT_ROW(MaxLine - 1);
       for (x = 0 ; x < LINE_LENGTH ; x++)
       {
-        Text[MaxLine-1][x] = ' ';
-        Format[MaxLine-1][x] = FORMAT_NORMAL;
+        Text[Row][x] = ' ';
+        Format[Row][x] = FORMAT_NORMAL;
       }
+
+      ScrollTextWindow();
     }
 
     inc--;
   }
-
-  if (Scroll)
-  {
-    PaintTextWindow();
-  }
 }
 
 /* =============================================================================
@@ -2375,6 +2691,23 @@ static void IncCursorX(int Count)
 void ClearText(void)
 {
   int x, y;
+  int Row;
+  int Used;
+
+  //
+  // Keep the lines written so far in the history
+  //
+  if (RingLines > MaxLine)
+  {
+    Used = (CursorX > 1) ? CursorY : CursorY - 1;
+
+    TopLine = (TopLine + Used) % RingLines;
+    HistoryLines += Used;
+    if (HistoryLines > (RingLines - MaxLine))
+    {
+      HistoryLines = RingLines - MaxLine;
+    }
+  }
 
   //
   // Clear the text buffer
@@ -2382,13 +2715,15 @@ void ClearText(void)
 
   for (y = 0 ; y < MaxLine ; y++)
   {
+    Row = TEXT_ROW(y);
+
     for (x = 0 ; x < LINE_LENGTH ; x++)
     {
-      Text[y][x] = ' ';
-      Format[y][x] = FORMAT_NORMAL;
+      Text[Row][x] = ' ';
+      Format[Row][x] = FORMAT_NORMAL;
     }
 
-    Text[y][LINE_LENGTH] = 0;
+    Text[Row][LINE_LENGTH] = 0;
   }
 
   CursorX = 1;
@@ -2399,7 +2734,7 @@ void ClearText(void)
   //
   PaintTextWindow();
 
-  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  PresentWindow();
 
 }
 
@@ -2434,9 +2769,10 @@ void MoveCursor(int x, int y)
 void Printc(char c)
 {
   int incx;
-  char lc;
-  SDL_Color fgcolor, bgcolor;
-  char cbuf[2];
+  int Row;
+
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
 
   switch (c)
     {
@@ -2455,45 +2791,13 @@ void Printc(char c)
       
     default:
 
-      lc = Text[CursorY-1][CursorX-1];
+      Row = TEXT_ROW(CursorY-1);
+      Text[Row][CursorX-1] = c;
+      Format[Row][CursorX-1] = CurrentFormat;
 
-      if (lc != c)
-	{
-	  /* Erase the char that was here */
-	  FillRectangle( TLeft + (CursorX - 1) * CharWidth,
-			 TTop + (CursorY - 1) * CharHeight,
-			 CharWidth, CharHeight, white_pixel);
-	}
-      
-      Text[CursorY-1][CursorX-1] = c;
-      Format[CursorY-1][CursorX-1] = CurrentFormat;
-
-      fgcolor = Black;
-      bgcolor = White;
-
-      switch (CurrentFormat)
-	{
-        case FORMAT_NORMAL:
-	  fgcolor = Black;
-          break;
-        case FORMAT_STANDOUT:
-	  fgcolor = Red;
-          break;
-        case FORMAT_STANDOUT2:
-          fgcolor = Green;
-          break;
-        case FORMAT_STANDOUT3:
-	  fgcolor = Blue;
-          break;
-        default:
-          break;
-	}
-
-      cbuf[0] = c;
-      cbuf[1] = 0;
-      DrawString( TLeft + (CursorX - 1) * CharWidth,
-		  TTop + (CursorY - 1) * CharHeight,
-		  cbuf, fgcolor, bgcolor);
+      DrawChar( TLeft + (CursorX - 1) * CharWidth,
+		TTop + (CursorY - 1) * CharHeight,
+		c, CurrentFormat);
 
       IncCursorX(1);
       break;
@@ -2519,7 +2823,7 @@ void Print(char *string)
     Printc(string[pos]);
   }
 
-  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  PresentWindow();
 
 }
 
@@ -2564,11 +2868,14 @@ void SetFormat(FormatType format)
 void ClearToEOL(void)
 {
   int x;
+  int Row;
+
+  Row = TEXT_ROW(CursorY-1);
 
   for (x = CursorX ; x <= LINE_LENGTH ; x++)
   {
-    Text[CursorY-1][x-1] = ' ';
-    Format[CursorY-1][x-1] = FORMAT_NORMAL;
+    Text[Row][x-1] = ' ';
+    Format[Row][x-1] = FORMAT_NORMAL;
   }
 
 
@@ -2586,11 +2893,14 @@ void ClearToEOL(void)
 void ClearToEOPage(int x, int y)
 {
   int tx, ty;
+  int Row;
+
+  Row = TEXT_ROW(y-1);
 
   for (tx = x ; tx <= LINE_LENGTH ; tx++)
   {
-    Text[y-1][tx-1] = ' ';
-    Format[y-1][tx-1] = FORMAT_NORMAL;
+    Text[Row][tx-1] = ' ';
+    Format[Row][tx-1] = FORMAT_NORMAL;
   }
 
   FillRectangle( TLeft + (x - 1) * CharWidth,
@@ -2600,10 +2910,12 @@ void ClearToEOPage(int x, int y)
 
   for (ty = y+1 ; ty <= MaxLine ; ty++)
   {
+    Row = TEXT_ROW(ty-1);
+
     for (tx = 1 ; tx <= LINE_LENGTH ; tx++)
     {
-      Text[ty-1][tx-1] = ' ';
-      Format[ty-1][tx-1] = FORMAT_NORMAL;
+      Text[Row][tx-1] = ' ';
+      Format[Row][tx-1] = FORMAT_NORMAL;
     }
 
     FillRectangle( TLeft,
@@ -2615,15 +2927,46 @@ void ClearToEOPage(int x, int y)
 
 }
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return 0;
+  }
+
+  return HistoryLines;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return;
+  }
+
+  if (Offset > HistoryLines)
+  {
+    Offset = HistoryLines;
+  }
+
+  ViewOffset = Offset;
+  PaintTextWindow();
+  ViewOffset = 0;
+
+  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+}
+
 /* =============================================================================
  * FUNCTION: show1cell
  */
 void show1cell(int x, int y)
 {
-  int TileId;
-  int sx, sy;
-  int TileX, TileY;
-
   /* see nothing if blind		*/
 	if (c[BLINDCOUNT]) return;
 
@@ -2634,6 +2977,32 @@ void show1cell(int x, int y)
     stealth[x][y] |= STEALTH_SEEN;
   }
 
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+
+  GetTile(x, y, &TileId);
+
+  return TileId;
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  int sx, sy;
+  int TileX, TileY;
+
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
   sx = x - MapTileRect.x;
   sy = y - MapTileRect.y;
 
@@ -2647,10 +3016,8 @@ void show1cell(int x, int y)
     return;
   }
 
-  GetTile(x, y, &TileId);
-
-  TileX = (TileId % 16) * TileWidth;
-  TileY = (TileId / 16) * TileHeight;
+  TileX = (Glyph % 16) * TileWidth;
+  TileY = (Glyph / 16) * TileHeight;
 
   CopyArea(TilePixmap, ularn_window,
 	    TileX, TileY,
@@ -2869,7 +3236,7 @@ void showcell(int x, int y)
       PaintMap();
     }
 
-  SDL_UpdateRect(ularn_window, 0, 0, 0, 0);
+  PresentWindow();
 }
 
 /* =============================================================================
@@ -3015,8 +3382,36 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame)
  */
 void nap(int delay)
 {
+  TRACE_BEGIN(TRACE_NAP);
+
   SDL_Flip(ularn_window);
   SDL_Delay(delay);
+
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  SDL_Event event;
+  Uint32 end_time;
+
+  SDL_Flip(ularn_window);
+
+  end_time = SDL_GetTicks() + delay;
+  do
+  {
+    SDL_PumpEvents();
+    if (SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_KEYDOWNMASK) > 0)
+    {
+      return 1;
+    }
+    SDL_Delay(10);
+  } while ((Sint32) (end_time - SDL_GetTicks()) > 0);
+
+  return 0;
 }
 
 /* =============================================================================
@@ -0,0 +1,2241 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ularn_winserv.c
+ *
+ * DESCRIPTION:
+ * This module contains all operating system dependant code for input and
+ * display update.
+ * Each version of ularn should provide a different implementation of this
+ * module.
+ *
+ * This is the display module for game server sessions (see server.h).
+ * It uses the same screen layout as the curses TTY display module, but
+ * renders into a per-session virtual terminal (see vterm.h) instead of the
+ * process's own terminal. Keys come from the session's input queue.
+ *
+ * All of the state of this module is held in the selected session display,
+ * so the server can switch between sessions in the middle of a turn.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * nonap         : Set to true if no time delays are to be used.
+ * nosignal      : Set if ctrl-C is to be trapped to prevent exit.
+ * enable_scroll : Probably superfluous
+ * yrepcount     : Repeat count for input commands.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * serv_display_new       : Create a session display
+ * serv_display_free      : Free a session display
+ * serv_display_select    : Select the display used by the display interface
+ * serv_display_flush     : Send the changes to the selected display
+ * serv_get_string        : Get a string typed by the player
+ * serv_display_keyframe  : Encode the whole of what a display shows
+ * init_app               : Initialise the app
+ * close_app              : Close the app and free resources
+ * get_normal_input       : Get the next command input
+ * get_prompt_input       : Get input in response to a question
+ * get_password_input     : Get a password
+ * get_num_input          : Geta number
+ * get_dir_input          : Get a direction
+ * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
+ * UpdateStatus           : Update the status display
+ * UpdateEffects          : Update the effects display
+ * UpdateStatusAndEffects : Update both status and effects display
+ * ClearText              : Clear the text output area
+ * beep                   : Make a beep
+ * Cursor                 : Set the cursor location
+ * Printc                 : Print a single character
+ * Print                  : Print a string
+ * Printf                 : Print a formatted string
+ * Standout               : Print a string is standout format
+ * SetFormat              : Set the output text format
+ * ClearEOL               : Clear to end of line
+ * ClearEOPage            : Clear to end of page
+ * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
+ * showplayer             : Show the player on the map
+ * showcell               : Show the area around the player
+ * drawscreen             : Redraw the screen
+ * draws                  : Redraw a section of the screen
+ * mapeffect              : Draw a directional effect
+ * magic_effect_frames    : Get the number of animation frames in a magic fx
+ * magic_effect           : Draw a frame in a magic fx
+ * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
+ * GetUser                : Get the username and user id.
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "config.h"
+
+#include "header.h"
+#include "ularn_game.h"
+
+#include "dungeon.h"
+#include "player.h"
+#include "ularn_win.h"
+#include "monster.h"
+#include "itm.h"
+#include "trace.h"
+#include "anim.h"
+#include "vterm.h"
+#include "server.h"
+#include "ularn_winserv.h"
+
+/* =============================================================================
+ * Exported variables
+ */
+
+int nonap = 0;
+int nosignal = 0;
+
+char enable_scroll = 0;
+
+int yrepcount = 0;
+
+/* =============================================================================
+ * Local variables
+ */
+
+//
+// Codes for the special keys decoded from terminal escape sequences.
+// The names follow curses so that the key map matches the TTY module.
+//
+#define KEY_DOWN  0x102
+#define KEY_UP    0x103
+#define KEY_LEFT  0x104
+#define KEY_RIGHT 0x105
+#define KEY_A1    0x1c1
+#define KEY_A3    0x1c3
+#define KEY_B2    0x1c5
+#define KEY_C1    0x1c7
+#define KEY_C3    0x1c9
+
+#define M_NONE 0
+#define M_SHIFT 1
+#define M_CTRL  2
+#define M_ASCII 255
+
+#define MAX_KEY_BINDINGS 3
+
+struct KeyCodeType
+{
+  int VirtKey;
+  int ModKey;
+};
+
+#define NUM_DIRS 8
+static ActionType DirActions[NUM_DIRS] =
+{
+  ACTION_MOVE_WEST,
+  ACTION_MOVE_EAST,
+  ACTION_MOVE_SOUTH,
+  ACTION_MOVE_NORTH,
+  ACTION_MOVE_NORTHEAST,
+  ACTION_MOVE_NORTHWEST,
+  ACTION_MOVE_SOUTHEAST,
+  ACTION_MOVE_SOUTHWEST
+};
+
+/* Default keymap */
+/* Allow up to MAX_KEY_BINDINGS per action */
+static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
+{
+  { { 0, 0 },         { 0, 0 }, { 0, 0 } },                   // ACTION_NULL
+  { { '~', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_DIAG
+  { { 'h', M_ASCII }, { KEY_LEFT,  M_ASCII },  { 0, 0 } },    // ACTION_MOVE_WEST
+  { { 'H', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_WEST
+  { { 'l', M_ASCII }, { KEY_RIGHT, M_ASCII },  { 0, 0 } },    // ACTION_MOVE_EAST,
+  { { 'L', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_EAST,
+  { { 'j', M_ASCII }, { KEY_DOWN,  M_ASCII },  { 0, 0 } },    // ACTION_MOVE_SOUTH,
+  { { 'J', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_SOUTH,
+  { { 'k', M_ASCII }, { KEY_UP,    M_ASCII },  { 0, 0 } },    // ACTION_MOVE_NORTH,
+  { { 'K', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_NORTH,
+  { { 'u', M_ASCII }, { KEY_A3, M_ASCII },     { 0, 0 } },    // ACTION_MOVE_NORTHEAST,
+  { { 'U', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_NORTHEAST,
+  { { 'y', M_ASCII }, { KEY_A1, M_ASCII },     { 0, 0 } },    // ACTION_MOVE_NORTHWEST,
+  { { 'Y', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_NORTHWEST,
+  { { 'n', M_ASCII }, { KEY_C3, M_ASCII },     { 0, 0 } },    // ACTION_MOVE_SOUTHEAST,
+  { { 'N', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_SOUTHEAST,
+  { { 'b', M_ASCII }, { KEY_C1, M_ASCII },     { 0, 0 } },    // ACTION_MOVE_SOUTHWEST,
+  { { 'B', M_ASCII }, { 0, 0 },                { 0, 0 } },    // ACTION_RUN_SOUTHWEST,
+  { { '.', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_WAIT,
+  { { ' ', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_NONE,
+  { { 'w', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_WIELD,
+  { { 'W', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_WEAR,
+  { { 'r', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_READ,
+  { { 'q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUAFF,
+  { { 'd', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_DROP,
+  { { 'c', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_CAST_SPELL,
+  { { 'o', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_OPEN_DOOR
+  { { 'C', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_CLOSE_DOOR,
+  { { 'O', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_OPEN_CHEST
+  { { 'i', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_INVENTORY,
+  { { 'e', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_EAT_COOKIE,
+  { { '\\',M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_LIST_SPELLS,
+  { { '?', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_HELP,
+  { { 'S', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SAVE,
+  { { 'Z', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_TELEPORT,
+  { { '^', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_IDENTIFY_TRAPS,
+  { { '_', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_BECOME_CREATOR,
+  { { '+', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_CREATE_ITEM,
+  { { '-', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_TOGGLE_WIZARD,
+  { { '`', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_DEBUG_MODE,
+  { { 'T', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_REMOVE_ARMOUR,
+  { { 'g', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_PACK_WEIGHT,
+  { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
+  { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
+  { {  18, M_ASCII  }, { 0, 0 }, { 0, 0 } },                  // ACTION_REDRAW_SCREEN,
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { {  16, M_ASCII  }, { 0, 0 }, { 0, 0 } },                  // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
+};
+
+static struct KeyCodeType RunKeyMap = { KEY_B2, M_ASCII };
+
+typedef enum
+{
+  C_BLACK,
+  C_RED,
+  C_GREEN,
+  C_YELLOW,
+  C_BLUE,
+  C_MAGENTA,
+  C_CYAN,
+  C_WHITE,
+  C_COUNT
+} Ularn_Color_Type;
+
+//
+// Characters for tiles.
+// Walls use the DEC special graphics line drawing characters.
+//
+static int WallTile[16] =
+{
+  'a', 'q', 'x', 'k', 'q', 'q', 'l', 'w', 'x', 'j', 'x', 'u', 'm', 'v', 't', 'n'
+};
+
+/* Tiles for directional effects */
+static int EffectTile[EFFECT_COUNT][9] =
+{
+  { '*', '|', '-', '|', '-', '/', '\\', '\\', '/'  },
+  { '*', '|', '-', '|', '-', '/', '\\', '\\', '/'  },
+  { '*', '|', '-', '|', '-', '/', '\\', '\\', '/'  },
+  { '*', '|', '-', '|', '-', '/', '\\', '\\', '/'  },
+  { '*', '|', '-', '|', '-', '/', '\\', '\\', '/'  },
+};
+
+static int EffectColor[EFFECT_COUNT] =
+{
+  C_GREEN,
+  C_CYAN,
+  C_RED,
+  C_YELLOW,
+  C_WHITE
+};
+
+#define MAX_MAGICFX_FRAME 8
+
+struct MagicEffectDataType
+{
+  int Frames;                   /* Number of frames in the effect  */
+  int Tile[MAX_MAGICFX_FRAME];  /* The primary tile for this frame */
+  int Color[MAX_MAGICFX_FRAME]; /* Only used for overlay effects   */
+};
+
+static struct MagicEffectDataType magicfx_tile[MAGIC_COUNT] =
+{
+  /* Sparkle */
+  { 
+    8,
+    {  '-', '\\', '|', '/', '-', '\\', '|', '/' },
+    { C_RED, C_YELLOW, C_GREEN, C_CYAN, C_BLUE, C_MAGENTA, C_RED, C_YELLOW }
+  },
+
+  /* Sleep */
+  {
+    6,
+    { 'z', 'Z', 'z', 'Z', 'z', 'Z', 0, 0 },
+    { C_RED, C_RED, C_GREEN, C_GREEN, C_BLUE, C_BLUE, 0, 0 }
+  },
+
+  /* Web */
+  {
+    6,
+    { '.', 'o', '*', '#', '#', '#', 0, 0 },
+    { C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_GREEN, C_BLUE, 0, 0 }
+  },
+
+  /* Phantasmal forces */
+  {
+    6,
+    { '.', ':', '^', 'A', 'A', 'A', 0, 0 },
+    { C_BLUE, C_BLUE, C_MAGENTA, C_MAGENTA, C_CYAN, C_CYAN, 0, 0 }
+  },
+
+  /* Cloud kill */
+  {
+    6,
+    { '.', 'o', '*', '#', '#', 'O', 0, 0 },
+    { C_GREEN, C_GREEN, C_GREEN, C_GREEN, C_YELLOW, C_GREEN, 0 ,0 }
+  },
+
+  /* Vaporize rock */
+  {
+    6,
+    { '.', 'o', '*', '#', '#', 'O', 0, 0 },
+    { C_RED, C_RED, C_RED, C_RED, C_YELLOW, C_RED, 0, 0 }
+  },
+
+  /* Dehydrate */
+  {
+    6,
+    { '.', ':', '|', 'T', '^', '~', 0, 0 },
+    { C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, 0, 0 }
+  },
+
+  /* Drain life */
+  {
+    6,
+    { '#', '*', '|', ':', 'o', '.', 0, 0 },
+    { C_YELLOW, C_YELLOW, C_YELLOW, C_RED, C_RED, C_RED, 0, 0 }
+  },
+
+  /* Flood */
+  {
+    6,
+    { '.', 'o', 'O', 'o', 'O', 'o', 0, 0 }, 
+    { C_BLUE, C_BLUE, C_BLUE, C_CYAN, C_CYAN, C_BLUE, 0, 0 }
+  },
+
+  /* Finger of death */
+  {
+    6,
+    { '#', '*', '|', ':', 'o', '.', 0, 0 },
+    { C_RED, C_RED, C_MAGENTA, C_MAGENTA, C_BLUE, C_BLUE, 0, 0 }
+  },
+
+  /* Teleport away */
+  {
+    6,
+    { ':', '|', 'H', 'H', '|', ':', 0, 0 },
+    { C_CYAN, C_CYAN, C_CYAN, C_BLUE, C_BLUE, C_BLUE, 0, 0 }
+  },
+
+  /* Magic fire */
+  {
+    6,
+    { '.', 'o', '*', '#', '#', 'O', 0, 0 },
+    { C_RED, C_RED, C_RED, C_RED, C_YELLOW, C_RED, 0 ,0 }
+  },
+
+  /* Make wall */
+  {
+    6,
+    { '.', ':', 'H', '#', '#', '#', 0, 0 },
+    { C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_RED, C_WHITE, 0, 0 }
+  },
+
+  /* Summon demon */
+  {
+    6,
+    { '.', ':', '^', '8', '8', '8', 0, 0 },
+    { C_MAGENTA, C_MAGENTA, C_RED, C_RED, C_YELLOW, C_YELLOW, 0, 0 }
+  },
+
+  /* Annihilate (scroll) */
+  {
+    6,
+    { '-', '|', '-', '|', '-', '|', 0, 0 },
+    { C_RED, C_RED, C_YELLOW, C_YELLOW, C_GREEN, C_GREEN, 0 ,0 }
+  }
+};
+
+//
+// Display attributes and colours
+//
+
+static int ItemAttr[OCOUNT] =
+{ 
+  0, 0,
+  /* Dungeon features */
+  VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE,
+  VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE,
+  0,
+  /* gold piles */
+  0, 0, 0, 0,
+  /* eye of larn */
+  (VT_REVERSE | VT_BOLD),
+  /* armour */
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0,
+  /* weapons */
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0,
+  /* rings */
+  0, 0, 0, 0, 0, 0, 0, 0,
+  /* magic items */
+  0, 0, 0, VT_REVERSE, VT_REVERSE, VT_BOLD, 0, VT_BOLD,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0,
+  /* gems */
+  0, 0, 0, 0,
+  /* buildings/entrances */
+  VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE, VT_REVERSE,
+  VT_REVERSE, VT_REVERSE, VT_REVERSE,
+  /* traps */
+  0, 0, 0, 0, 0, 0, 0,
+  /* misc */
+  0, 0, 0,
+  /* drugs */
+  0, 0, 0, 0, 0
+};
+
+static int ItemColor[OCOUNT] =
+{ 
+  C_WHITE, C_WHITE,
+  /* Dungeon features */
+  C_WHITE, C_YELLOW, C_YELLOW, C_YELLOW, C_WHITE, C_GREEN, C_WHITE, C_BLUE,
+  C_WHITE, C_RED, C_WHITE, C_RED, C_WHITE, C_WHITE, C_WHITE, C_WHITE,
+  C_WHITE,
+  /* gold piles */
+  C_YELLOW, C_YELLOW, C_YELLOW, C_YELLOW,
+  /* eye of larn */
+  C_WHITE,
+  /* armour */
+  C_CYAN, C_CYAN, C_WHITE, C_CYAN, C_WHITE, C_CYAN, C_CYAN, C_CYAN,
+  C_WHITE, C_GREEN,
+  /* weapons */
+  C_CYAN, C_WHITE, C_CYAN, C_CYAN, C_WHITE, C_CYAN, C_CYAN, C_CYAN,
+  C_WHITE, C_WHITE, C_MAGENTA, C_YELLOW,
+  /* rings */
+  C_WHITE, C_GREEN, C_BLUE, C_WHITE, C_CYAN, C_RED, C_MAGENTA, C_WHITE,
+  /* magic items */
+  C_WHITE, C_WHITE, C_YELLOW, C_CYAN, C_YELLOW, C_CYAN, C_WHITE, C_RED,
+  C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE,
+  C_WHITE,
+  /* gems */
+  C_WHITE, C_RED, C_GREEN, C_BLUE,
+  /* buildings/entrances */
+  C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE,
+  C_WHITE, C_WHITE, C_WHITE,
+  /* traps */
+  C_RED, C_RED, C_RED, C_RED, C_RED, C_RED, C_RED,
+  /* misc */
+  C_WHITE, C_WHITE, C_WHITE,
+  /* drugs */
+  C_WHITE, C_WHITE, C_WHITE, C_WHITE, C_WHITE
+};
+
+static int MonstColor[MONST_COUNT] =
+{
+  C_WHITE, 
+  C_WHITE, C_GREEN, C_GREEN, C_WHITE, C_WHITE, C_RED,   C_GREEN, C_GREEN, 
+  C_RED,   C_RED,   C_RED,   C_CYAN,  C_GREEN, C_WHITE, C_BLUE,  C_RED, 
+  C_WHITE, C_WHITE, C_RED,   C_RED,   C_CYAN,  C_GREEN, C_YELLOW, C_WHITE, 
+  C_WHITE, C_GREEN, C_WHITE, C_CYAN,  C_YELLOW, C_RED,  C_MAGENTA, C_WHITE, 
+  C_YELLOW, C_YELLOW, C_YELLOW, C_YELLOW, C_RED, C_WHITE, C_WHITE, C_WHITE, 
+  C_CYAN,  C_GREEN, C_YELLOW, C_MAGENTA, C_GREEN, C_BLUE, C_BLUE,  C_MAGENTA, 
+  C_GREEN, C_MAGENTA, C_RED, C_YELLOW, C_CYAN,  C_YELLOW, C_GREEN, C_RED, 
+  C_WHITE, C_YELLOW, C_GREEN, C_CYAN, C_BLUE, C_RED, C_MAGENTA, C_CYAN, 
+  C_MAGENTA
+};
+
+
+//
+//
+// Screen layout
+//
+#define MAP_ROWS      17
+#define EFFECTS_COL   67
+#define STATUS_ROW    17
+#define MSG_TOP       19
+
+#define LINE_LENGTH 80
+
+//
+// Messages
+// The message window is the bottom MAX_MSG_LINES rows of the map screen.
+// The lines are also kept in a ring buffer of MAX_MSG_HISTORY lines so that
+// lines scrolled off the message window can be paged back through.
+// The history is shorter than in the TTY module as there is one per session.
+//
+#define MAX_MSG_LINES    5
+#define MAX_MSG_HISTORY  100
+
+#define MSG_ROW(y) ((D->MsgTopLine + (y)) % MAX_MSG_HISTORY)
+
+//
+// Text
+//
+#define MAX_TEXT_LINES 24
+
+typedef enum
+{
+  TEXT_MESSAGE,
+  TEXT_PAGE
+} TextWindowType;
+
+struct ServDisplayType
+{
+  //
+  // The screen shown in map mode (map, effects, status and messages) and
+  // the screen shown in text mode.
+  //
+  VTermScreenType MapScreen;
+  VTermScreenType TextScreen;
+
+  //
+  // What the session's terminal is showing
+  //
+  VTermType Term;
+
+  DisplayModeType Mode;
+
+  //
+  // Generalised text buffer
+  // Top left corner is x=1, y=1
+  //
+  TextWindowType TextWindow;
+  FormatType CurrentFormat;
+  int CursorX;
+  int CursorY;
+  int MaxLine;
+
+  //
+  // The saved text buffer settings for the mode not being shown
+  //
+  FormatType CurrentMsgFormat;
+  int MsgCursorX;
+  int MsgCursorY;
+  FormatType CurrentTextFormat;
+  int TextCursorX;
+  int TextCursorY;
+
+  //
+  // Message history
+  // MsgTopLine is the ring index of the line at the top of the window.
+  //
+  VTermCellType MessageRing[MAX_MSG_HISTORY][LINE_LENGTH];
+  int MsgTopLine;
+  int MsgHistoryLines;
+
+  //
+  // Set when the terminal cursor is to be left on the player
+  //
+  int CursorOnPlayer;
+};
+
+//
+// The selected session display
+//
+static ServDisplayType *D = NULL;
+
+static int Runkey;
+static ActionType Event;
+
+//
+// The monster to use for showing mimics. Changes every 10 turns.
+//
+static int mimicmonst = MIMIC;
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: FormatAttr
+ *
+ * DESCRIPTION:
+ * Get the cell attributes for a text format.
+ *
+ * PARAMETERS:
+ *
+ *   Format : The text format.
+ *
+ * RETURN VALUE:
+ *
+ *   The cell attributes.
+ */
+static int FormatAttr(FormatType Format)
+{
+  switch (Format)
+  {
+    case FORMAT_STANDOUT:
+      return C_RED;
+    case FORMAT_STANDOUT2:
+      return C_GREEN;
+    case FORMAT_STANDOUT3:
+      return C_BLUE;
+    case FORMAT_BOLD:
+      return C_WHITE | VT_BOLD;
+    case FORMAT_INVERSE:
+      return C_WHITE | VT_REVERSE;
+    default:
+      return C_WHITE;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: SetCell
+ *
+ * DESCRIPTION:
+ * Set a cell on a screen.
+ *
+ * PARAMETERS:
+ *
+ *   Cell : The cell to set
+ *
+ *   Ch   : The character for the cell
+ *
+ *   Attr : The cell attributes
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void SetCell(VTermCellType *Cell, int Ch, int Attr)
+{
+  Cell->Ch = (unsigned char) Ch;
+  Cell->Attr = (unsigned char) Attr;
+}
+
+/* =============================================================================
+ * FUNCTION: PutString
+ *
+ * DESCRIPTION:
+ * Write a string to a row of the map screen, padding it with spaces.
+ *
+ * PARAMETERS:
+ *
+ *   y      : The row
+ *
+ *   x      : The column to start at
+ *
+ *   String : The string to write
+ *
+ *   Width  : The number of cells to fill
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PutString(int y, int x, char *String, int Width)
+{
+  int i;
+  int Ch;
+
+  for (i = 0 ; i < Width ; i++)
+  {
+    Ch = (*String != 0) ? *String++ : ' ';
+    SetCell(&D->MapScreen[y][x + i], Ch, C_WHITE);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: TextCell
+ *
+ * DESCRIPTION:
+ * Get a cell in the current text window.
+ *
+ * PARAMETERS:
+ *
+ *   x : The column (1 based)
+ *
+ *   y : The row (1 based)
+ *
+ * RETURN VALUE:
+ *
+ *   The cell.
+ */
+static VTermCellType *TextCell(int x, int y)
+{
+  if (D->TextWindow == TEXT_MESSAGE)
+  {
+    return &D->MapScreen[MSG_TOP + y - 1][x - 1];
+  }
+
+  return &D->TextScreen[y - 1][x - 1];
+}
+
+/* =============================================================================
+ * FUNCTION: GetKey
+ *
+ * DESCRIPTION:
+ * Get the next key from the session input, decoding the escape sequences
+ * sent for the cursor and keypad keys.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The key, or -1 if the player has disconnected.
+ */
+static int GetKey(void)
+{
+  int ch;
+  int Param;
+
+  ch = server_get_key();
+
+  if (ch == 127)
+  {
+    /* Most terminals send DEL for backspace */
+    return '\010';
+  }
+
+  if ((ch != '\033') ||
+      ((server_peek_key() != '[') && (server_peek_key() != 'O')))
+  {
+    return ch;
+  }
+
+  server_get_key();
+
+  /* Get the numeric parameter, if there is one */
+  Param = 0;
+  while (((ch = server_get_key()) >= '0') && (ch <= '9'))
+  {
+    Param = Param * 10 + (ch - '0');
+  }
+
+  switch (ch)
+  {
+    case 'A':
+      return KEY_UP;
+    case 'B':
+      return KEY_DOWN;
+    case 'C':
+      return KEY_RIGHT;
+    case 'D':
+      return KEY_LEFT;
+    case 'H':
+      return KEY_A1;
+    case 'F':
+      return KEY_C1;
+    case 'E':
+    case 'G':
+    case 'u':
+      return KEY_B2;
+    case '~':
+      /* Home, end, page up and page down are the keypad corners */
+      switch (Param)
+      {
+        case 1:
+        case 7:
+          return KEY_A1;
+        case 4:
+        case 8:
+          return KEY_C1;
+        case 5:
+          return KEY_A3;
+        case 6:
+          return KEY_C3;
+        default:
+          return 0;
+      }
+    case -1:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: CautiousAnswer
+ *
+ * DESCRIPTION:
+ * Get the answer to use for a prompt once the player has disconnected:
+ * escape if allowed, otherwise return if allowed, otherwise the first.
+ * This lets the game get back to the command prompt, where it is saved.
+ *
+ * PARAMETERS:
+ *
+ *   answers : The allowed answers
+ *
+ * RETURN VALUE:
+ *
+ *   The answer.
+ */
+static char CautiousAnswer(char *answers)
+{
+  if (strchr(answers, '\033') != NULL) return '\033';
+  if (strchr(answers, '\015') != NULL) return '\015';
+
+  return answers[0];
+}
+
+/* =============================================================================
+ * FUNCTION: KeyAction
+ *
+ * DESCRIPTION:
+ * Get the action bound to a key.
+ *
+ * PARAMETERS:
+ *
+ *   Key : The key
+ *
+ * RETURN VALUE:
+ *
+ *   The action, or ACTION_NULL if no action is bound to the key.
+ */
+static ActionType KeyAction(int Key)
+{
+  ActionType Action;
+  int i;
+
+  for (Action = ACTION_NULL ; Action < ACTION_COUNT ; Action++)
+  {
+    for (i = 0 ; i < MAX_KEY_BINDINGS ; i++)
+    {
+      if ((KeyMap[Action][i].ModKey == M_ASCII) &&
+          (KeyMap[Action][i].VirtKey == Key))
+      {
+        return Action;
+      }
+    }
+  }
+
+  return ACTION_NULL;
+}
+
+/* =============================================================================
+ * FUNCTION: PaintStatus
+ *
+ * DESCRIPTION:
+ * Paint the status area.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PaintStatus(void)
+{
+  char Line[81];
+  char Buf[81];
+  char HPBuf[12];   /* Sized for the 11 character HP field */
+  int i;
+
+  //
+  // Build the top status line
+  //
+  Line[0] = 0;
+
+  /* Spells */
+  if (c[SPELLMAX]>99)
+    sprintf(Buf, "Spells:%3ld(%3ld)", c[SPELLS],c[SPELLMAX]);
+  else
+    sprintf(Buf, "Spells:%3ld(%2ld) ",c[SPELLS],c[SPELLMAX]);
+
+  strcat(Line, Buf);
+
+  /* AC, WC */
+  sprintf(Buf, " AC: %-3ld  WC: %-3ld  Level", c[AC], c[WCLASS]);
+  strcat(Line, Buf);
+
+  /* Level */
+  if (c[LEVEL]>99)
+    sprintf(Buf, "%3ld", c[LEVEL]);
+  else
+    sprintf(Buf, " %-2ld", c[LEVEL]);
+  strcat(Line, Buf);
+
+  /* Exp, class */
+  sprintf(Buf, " Exp: %-9ld %s", c[EXPERIENCE], class[c[LEVEL]-1]);
+  strncat(Line, Buf, 80 - strlen(Line));
+
+  PutString(STATUS_ROW, 0, Line, LINE_LENGTH);
+
+  //
+  // Format the second line of the status
+  //
+  snprintf(HPBuf, sizeof(HPBuf), "%ld (%ld)", c[HP], c[HPMAX]);
+
+  sprintf(Line, "HP: %11s STR=%-2ld INT=%-2ld WIS=%-2ld CON=%-2ld DEX=%-2ld CHA=%-2ld LV:",
+      HPBuf,
+      c[STRENGTH]+c[STREXTRA],
+      c[INTELLIGENCE],
+      c[WISDOM],
+      c[CONSTITUTION],
+      c[DEXTERITY],
+      c[CHARISMA]);
+
+  if ((level==0) || (wizard))
+    c[TELEFLAG]=0;
+
+  if (c[TELEFLAG])
+    strcat(Line, " ?");
+  else
+    strcat(Line, levelname[level]);
+
+  sprintf(Buf, "  Gold: %-8ld", c[GOLD]);
+  strncat(Line, Buf, 80 - strlen(Line));
+
+  PutString(STATUS_ROW + 1, 0, Line, LINE_LENGTH);
+
+  //
+  // Mark all character values as displayed.
+  //
+  c[TMP] = c[STRENGTH]+c[STREXTRA];
+  for (i=0; i<100; i++)
+    cbak[i]=c[i];
+
+}
+
+/* Effects strings */
+static struct bot_side_def
+{
+  int typ;
+  char *string;
+} bot_data[] =
+{
+  { STEALTH,        "  Stealth    " },
+  { UNDEADPRO,      "  Undead Pro " },
+  { SPIRITPRO,      "  Spirit Pro " },
+  { CHARMCOUNT,     "  Charm      " },
+  { TIMESTOP,       "  Time Stop  " },
+  { HOLDMONST,      "  Hold Monst " },
+  { GIANTSTR,       "  Giant Str  " },
+  { FIRERESISTANCE, "  Fire Resit " },
+  { DEXCOUNT,       "  Dexterity  " },
+  { STRCOUNT,       "  Strength   " },
+  { SCAREMONST,     "  Scare      " },
+  { HASTESELF,      "  Haste Self " },
+  { CANCELLATION,   "  Cancel     " },
+  { INVISIBILITY,   "  Invisible  " },
+  { ALTPRO,         "  Protect 3  " },
+  { PROTECTIONTIME, "  Protect 2  " },
+  { WTW,            "  Wall-Walk  " }
+};
+
+/* =============================================================================
+ * FUNCTION: PaintEffects
+ *
+ * DESCRIPTION:
+ * Paint the effects display.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PaintEffects(void)
+{
+  int i, idx;
+
+  for (i=0; i < 17; i++)
+  {
+    idx = bot_data[i].typ;
+
+    PutString(i, EFFECTS_COL, (c[idx] != 0) ? bot_data[i].string : "",
+              LINE_LENGTH - EFFECTS_COL);
+
+    cbak[idx] = c[idx];
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: GetTile
+ *
+ * DESCRIPTION:
+ * Get the tile to be displayed for a location on the map.
+ *
+ * PARAMETERS:
+ *
+ *   x      : The x coordinate for the tile
+ *
+ *   y      : The y coordiante for the tile
+ *
+ *   TileId : This is set to the tile to be displayed for (x, y).
+ *
+ *   Attr   : This is set to the cell attributes for this tile
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void GetTile(int x, int y, int *TileId, int *Attr)
+{
+  MonsterIdType k;
+  int Obj;
+  int ObjAttr;
+
+  if ((x == playerx) && (y == playery) && (c[BLINDCOUNT] == 0))
+  {
+    //
+    // This is the square containing the player and the players isn't
+    // blind, so return the player tile.
+    //
+    *TileId = '@';
+    *Attr = C_RED;
+    return;
+  }
+
+  Obj = know[x][y];
+  ObjAttr = ItemAttr[Obj] | ItemColor[Obj];
+
+  //
+  // Work out what is here
+  //
+  if (Obj == OUNKNOWN)
+  {
+    //
+    // The player doesn't know what is at this position.
+    //
+    *TileId = objnamelist[OUNKNOWN];
+    *Attr = ItemAttr[OUNKNOWN] | C_BLACK;
+  }
+  else
+  {
+    k = mitem[x][y].mon;
+    if ((k != 0) &&
+        (c[BLINDCOUNT] == 0) &&
+        (((stealth[x][y] & STEALTH_SEEN) != 0) ||
+         ((stealth[x][y] & STEALTH_AWAKE) != 0)))
+    {
+      //
+      // There is a monster here and the player is not blind and the
+      // monster is seen or awake.
+      //
+      if (k == MIMIC)
+      {
+        if ((gtime % 10) == 0)
+        {
+          while ((mimicmonst = rnd(MAXMONST))==INVISIBLESTALKER);
+        }
+
+        *TileId = monstnamelist[mimicmonst];
+        *Attr = MonstColor[mimicmonst];
+      }
+      else if (((k==INVISIBLESTALKER) && (c[SEEINVISIBLE]==0)) ||
+               ((k>=DEMONLORD) && (k<=LUCIFER) && (c[EYEOFLARN]==0)))
+      {
+        /* demons are invisible if not have the eye */
+        *TileId = objnamelist[Obj];
+        *Attr = ObjAttr;
+      }
+      else
+      {
+        *TileId = monstnamelist[k];
+        *Attr = MonstColor[k];
+      }
+    }
+    else
+    {
+      //
+      // No monster known to the player here, so show the item
+      //
+      *TileId = objnamelist[Obj];
+      *Attr = ObjAttr;
+    }
+  }
+
+  /* Handle walls */
+  if (*TileId == objnamelist[OWALL])
+  {
+    *TileId = WallTile[wallmask[x][y]];
+    *Attr |= VT_ACS;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: PaintMap
+ *
+ * DESCRIPTION:
+ * Repaint the map.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PaintMap(void)
+{
+  int x, y;
+  int TileId;
+  int Attr;
+
+  TRACE_BEGIN(TRACE_PAINTMAP);
+
+  for (y = 0 ; y < MAXY ; y++)
+  {
+    for (x = 0 ; x < MAXX ; x++)
+    {
+      GetTile(x, y, &TileId, &Attr);
+      SetCell(&D->MapScreen[y][x], TileId, Attr);
+    }
+  }
+
+  TRACE_END(TRACE_PAINTMAP);
+}
+
+/* =============================================================================
+ * FUNCTION: PaintWindow
+ *
+ * DESCRIPTION:
+ * Repaint the window. The text windows hold their contents, so only the
+ * parts of the map screen drawn from the game state need to be repainted.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void PaintWindow(void)
+{
+  if (D->Mode == DISPLAY_MAP)
+  {
+    PaintStatus();
+    PaintEffects();
+    PaintMap();
+
+    showplayer();
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: IncCursorY
+ *
+ * DESCRIPTION:
+ * Increae the cursor y position, scrolling the text window if requried.
+ *
+ * PARAMETERS:
+ *
+ *   Count : The number of lines to increase the cursor y position
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void IncCursorY(int Count)
+{
+  int inc;
+  int Row;
+  int x, y;
+
+  inc = Count;
+
+  while (inc > 0)
+  {
+    D->CursorY = D->CursorY + 1;
+
+    if (D->CursorY > D->MaxLine)
+    {
+      D->CursorY--;
+
+      if (D->TextWindow == TEXT_MESSAGE)
+      {
+        //
+        // Advance the top of the message ring, keeping the line that
+        // scrolled off as history.
+        //
+        D->MsgTopLine = (D->MsgTopLine + 1) % MAX_MSG_HISTORY;
+        if (D->MsgHistoryLines < (MAX_MSG_HISTORY - MAX_MSG_LINES))
+        {
+          D->MsgHistoryLines++;
+        }
+
+        Row = MSG_ROW(D->MaxLine - 1);
+        for (x = 0 ; x < LINE_LENGTH ; x++)
+        {
+          SetCell(&D->MessageRing[Row][x], ' ', C_WHITE);
+        }
+      }
+
+      for (y = 1 ; y < D->MaxLine ; y++)
+      {
+        memcpy(TextCell(1, y), TextCell(1, y + 1),
+               LINE_LENGTH * sizeof(VTermCellType));
+      }
+
+      for (x = 1 ; x <= LINE_LENGTH ; x++)
+      {
+        SetCell(TextCell(x, D->CursorY), ' ', C_WHITE);
+      }
+    }
+
+    inc--;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: IncCursorX
+ *
+ * DESCRIPTION:
+ * Increase the cursor x position, handling line wrap.
+ *
+ * PARAMETERS:
+ *
+ *   Count : The amount to increase the cursor x position.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void IncCursorX(int Count)
+{
+  D->CursorX = D->CursorX + Count;
+  if (D->CursorX > LINE_LENGTH)
+  {
+    D->CursorX = 1;
+    IncCursorY(1);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: get_string_input
+ *
+ * DESCRIPTION:
+ * Get a string typed by the player, echoing it.
+ *
+ * PARAMETERS:
+ *
+ *   string : The buffer for the string
+ *
+ *   Len    : The maximum length of the string
+ *
+ *   Echo   : The character to echo, or 0 to echo the typed characters
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void get_string_input(char *string, int Len, char Echo)
+{
+  char ch;
+  char inputchars[256];
+  int Pos;
+  int value;
+
+  /* get the printable characters on this system */
+  Pos = 0;
+  for (value = 1 ; value < 256 ; value++)
+  {
+    if (isprint(value))
+    {
+      inputchars[Pos] = (char) value;
+      Pos++;
+    }
+  }
+
+  /* add CR, BS and null terminator */
+  inputchars[Pos++] = '\010';
+  inputchars[Pos++] = '\015';
+  inputchars[Pos] = '\0';
+
+  Pos = 0;
+  do
+  {
+    ch = get_prompt_input("", inputchars, 1);
+
+    if (isprint((int) ch) && (Pos < Len))
+    {
+      string[Pos] = ch;
+      Pos++;
+      Printc((Echo != 0) ? Echo : ch);
+    }
+    else if (ch == '\010')
+    {
+      //
+      // Backspace
+      //
+
+      if (Pos > 0)
+      {
+        D->CursorX--;
+        Printc(' ');
+        D->CursorX--;
+        Pos--;
+      }
+    }
+
+  } while (ch != '\015');
+
+  string[Pos] = 0;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: serv_display_new
+ */
+ServDisplayType *serv_display_new(void)
+{
+  ServDisplayType *Display;
+  int x, y;
+
+  Display = (ServDisplayType *) malloc(sizeof(ServDisplayType));
+  if (Display == NULL) return NULL;
+
+  for (y = 0 ; y < VTERM_ROWS ; y++)
+  {
+    for (x = 0 ; x < VTERM_COLS ; x++)
+    {
+      SetCell(&Display->MapScreen[y][x], ' ', C_WHITE);
+      SetCell(&Display->TextScreen[y][x], ' ', C_WHITE);
+    }
+  }
+
+  for (y = 0 ; y < MAX_MSG_HISTORY ; y++)
+  {
+    for (x = 0 ; x < LINE_LENGTH ; x++)
+    {
+      SetCell(&Display->MessageRing[y][x], ' ', C_WHITE);
+    }
+  }
+
+  vterm_init(&Display->Term);
+
+  Display->Mode = DISPLAY_TEXT;
+  Display->TextWindow = TEXT_PAGE;
+  Display->CurrentFormat = FORMAT_NORMAL;
+  Display->CursorX = 1;
+  Display->CursorY = 1;
+  Display->MaxLine = MAX_TEXT_LINES;
+
+  Display->CurrentMsgFormat = FORMAT_NORMAL;
+  Display->MsgCursorX = 1;
+  Display->MsgCursorY = 1;
+  Display->CurrentTextFormat = FORMAT_NORMAL;
+  Display->TextCursorX = 1;
+  Display->TextCursorY = 1;
+
+  Display->MsgTopLine = 0;
+  Display->MsgHistoryLines = 0;
+  Display->CursorOnPlayer = 0;
+
+  return Display;
+}
+
+/* =============================================================================
+ * FUNCTION: serv_display_free
+ */
+void serv_display_free(ServDisplayType *Display)
+{
+  if (D == Display) D = NULL;
+
+  free(Display);
+}
+
+/* =============================================================================
+ * FUNCTION: serv_display_select
+ */
+void serv_display_select(ServDisplayType *Display)
+{
+  D = Display;
+}
+
+/* =============================================================================
+ * FUNCTION: serv_display_flush
+ */
+void serv_display_flush(void)
+{
+  int x, y;
+
+  if ((D->Mode == DISPLAY_MAP) && D->CursorOnPlayer)
+  {
+    x = playerx;
+    y = playery;
+  }
+  else
+  {
+    x = (D->CursorX > LINE_LENGTH) ? LINE_LENGTH - 1 : D->CursorX - 1;
+    y = D->CursorY - 1;
+    if (D->TextWindow == TEXT_MESSAGE) y += MSG_TOP;
+  }
+
+  vterm_update(&D->Term,
+               (D->Mode == DISPLAY_MAP) ? D->MapScreen : D->TextScreen,
+               x, y, server_output());
+}
+
+/* =============================================================================
+ * FUNCTION: serv_get_string
+ */
+void serv_get_string(char *String, int Len)
+{
+  get_string_input(String, Len, 0);
+}
+
+/* =============================================================================
+ * FUNCTION: serv_display_keyframe
+ */
+int serv_display_keyframe(ServDisplayType *Display, VTermBufType *Buf)
+{
+  return vterm_keyframe(&Display->Term, Buf);
+}
+
+/* =============================================================================
+ * FUNCTION: init_app
+ */
+int init_app(void)
+{
+  return 1;
+}
+
+/* =============================================================================
+ * FUNCTION: close_app
+ */
+void close_app(void)
+{
+}
+
+/* =============================================================================
+ * FUNCTION: get_normal_input
+ */
+ActionType get_normal_input(void)
+{
+  int idx;
+  int got_dir;
+  int Key;
+
+  Event = ACTION_NULL;
+  Runkey = 0;
+
+  D->CursorOnPlayer = 1;
+
+  while (Event == ACTION_NULL)
+    {
+      Key = GetKey();
+
+      if (Key < 0)
+	{
+	  /* The player has gone, so save the game for them */
+	  return ACTION_SAVE;
+	}
+
+      /* Decode key press as a ULarn Action */
+      Event = KeyAction(Key);
+
+      /* check run key */
+      if ((Event == ACTION_NULL) &&
+	  (Key == RunKeyMap.VirtKey) &&
+	  (RunKeyMap.ModKey == M_ASCII))
+	{
+	  Runkey = 1;
+	}
+
+      //
+      // Clear enhanced interface events in enhanced interface is not active
+      //
+      if (!enhance_interface)
+	{
+	  if ((Event == ACTION_OPEN_DOOR) ||
+	      (Event == ACTION_OPEN_CHEST))
+	    {
+	      Event = ACTION_NULL;
+	    }
+	}
+    }
+
+  D->CursorOnPlayer = 0;
+
+  if (Runkey)
+    {
+      idx = 0;
+      got_dir = 0;
+
+      while ((idx < NUM_DIRS) && (!got_dir))
+	{
+	  if (DirActions[idx] == Event)
+	    {
+	      got_dir = 1;
+	    }
+	  else
+	    {
+	      idx++;
+	    }
+	}
+
+    if (got_dir)
+      {
+	/* modify into a run event */
+	Event = Event + 1;
+      }
+    }
+
+  return Event;
+}
+
+/* =============================================================================
+ * FUNCTION: get_prompt_input
+ */
+char get_prompt_input(char *prompt, char *answers, int ShowCursor)
+{
+  int Key;
+
+  Print(prompt);
+
+  //
+  // Process keys until a character in answers has been pressed.
+  //
+  for (;;)
+    {
+      Key = GetKey();
+
+      if (Key < 0)
+	{
+	  return CautiousAnswer(answers);
+	}
+
+      if ((Key > 0) && (Key < 256) && (strchr(answers, Key) != NULL))
+	{
+	  return (char) Key;
+	}
+    }
+}
+
+/* =============================================================================
+ * FUNCTION: get_password_input
+ */
+void get_password_input(char *password, int Len)
+{
+  get_string_input(password, Len, '*');
+}
+
+/* =============================================================================
+ * FUNCTION: get_num_input
+ */
+int get_num_input(int defval)
+{
+  char ch;
+  int Pos = 0;
+  int value = 0;
+  int neg = 0;
+
+  do
+  {
+    ch = get_prompt_input("", "-*0123456789\010\015", 1);
+
+    if ((ch == '-') && (Pos == 0))
+    {
+      //
+      // Minus
+      //
+      neg = 1;
+      Printc(ch);
+      Pos++;
+    }
+    if (ch == '*')
+    {
+      return defval;
+    }
+    else if (ch == '\010')
+    {
+      //
+      // Backspace
+      //
+
+      if (Pos > 0)
+      {
+        if ((Pos == 1) && neg)
+        {
+          neg = 0;
+        }
+        else
+        {
+          value = value / 10;
+        }
+
+        D->CursorX--;
+        Printc(' ');
+        D->CursorX--;
+        Pos--;
+      }
+    }
+    else if ((ch >= '0') && (ch <= '9'))
+    {
+      //
+      // digit
+      //
+      value = value * 10 + (ch - '0');
+      Printc(ch);
+      Pos++;
+    }
+
+  } while (ch != '\015');
+
+  if (Pos == 0)
+  {
+    return defval;
+  }
+  else
+  {
+    if (neg) value = -value;
+
+    return value;
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: get_dir_input
+ */
+ActionType get_dir_input(char *prompt, int ShowCursor)
+{
+  int Key;
+  int idx;
+  ActionType Action;
+
+  //
+  // Display the prompt at the current position
+  //
+  Print(prompt);
+
+  for (;;)
+  {
+    Key = GetKey();
+
+    if (Key < 0)
+    {
+      return DirActions[0];
+    }
+
+    Action = KeyAction(Key);
+
+    for (idx = 0 ; idx < NUM_DIRS ; idx++)
+    {
+      if (DirActions[idx] == Action)
+      {
+        return Action;
+      }
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateStatus
+ */
+void UpdateStatus(void)
+{
+  if (D->Mode == DISPLAY_TEXT)
+  {
+    /* Don't redisplay if in text mode */
+    return;
+  }
+
+  PaintStatus();
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateEffects
+ */
+void UpdateEffects(void)
+{
+  if (D->Mode == DISPLAY_TEXT)
+  {
+    /* Don't redisplay if in text mode */
+    return;
+  }
+
+  PaintEffects();
+}
+
+/* =============================================================================
+ * FUNCTION: UpdateStatusAndEffects
+ */
+void UpdateStatusAndEffects(void)
+{
+  if (D->Mode == DISPLAY_TEXT)
+  {
+    /* Don't redisplay if in text mode */
+    return;
+  }
+
+  //
+  // Do effects first as update status will mark all effects as current
+  //
+  PaintEffects();
+  PaintStatus();
+}
+
+/* =============================================================================
+ * FUNCTION: set_display
+ */
+void set_display(DisplayModeType Mode)
+{
+  //
+  // Save the current settings
+  //
+  if (D->Mode == DISPLAY_MAP)
+  {
+    D->MsgCursorX = D->CursorX;
+    D->MsgCursorY = D->CursorY;
+    D->CurrentMsgFormat = D->CurrentFormat;
+  }
+  else if (D->Mode == DISPLAY_TEXT)
+  {
+    D->TextCursorX = D->CursorX;
+    D->TextCursorY = D->CursorY;
+    D->CurrentTextFormat = D->CurrentFormat;
+  }
+
+  D->Mode = Mode;
+
+  //
+  // Set the text buffer settings for the new display mode
+  //
+  if (D->Mode == DISPLAY_MAP)
+  {
+    D->CursorX = D->MsgCursorX;
+    D->CursorY = D->MsgCursorY;
+    D->CurrentFormat = D->CurrentMsgFormat;
+
+    D->MaxLine = MAX_MSG_LINES;
+
+    D->TextWindow = TEXT_MESSAGE;
+  }
+  else if (D->Mode == DISPLAY_TEXT)
+  {
+    D->CursorX = D->TextCursorX;
+    D->CursorY = D->TextCursorY;
+    D->CurrentFormat = D->CurrentTextFormat;
+
+    D->MaxLine = MAX_TEXT_LINES;
+
+    D->TextWindow = TEXT_PAGE;
+  }
+
+  PaintWindow();
+}
+
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  /* Nothing is sent until the game waits, so there is nothing to hold */
+}
+
+/* =============================================================================
+ * FUNCTION: ClearText
+ */
+void ClearText(void)
+{
+  int x, y;
+  int Row;
+  int Used;
+
+  if (D->TextWindow == TEXT_MESSAGE)
+  {
+    //
+    // Keep the lines written so far in the history
+    //
+    Used = (D->CursorX > 1) ? D->CursorY : D->CursorY - 1;
+
+    D->MsgTopLine = (D->MsgTopLine + Used) % MAX_MSG_HISTORY;
+    D->MsgHistoryLines += Used;
+    if (D->MsgHistoryLines > (MAX_MSG_HISTORY - MAX_MSG_LINES))
+    {
+      D->MsgHistoryLines = MAX_MSG_HISTORY - MAX_MSG_LINES;
+    }
+
+    for (y = 0 ; y < MAX_MSG_LINES ; y++)
+    {
+      Row = MSG_ROW(y);
+
+      for (x = 0 ; x < LINE_LENGTH ; x++)
+      {
+        SetCell(&D->MessageRing[Row][x], ' ', C_WHITE);
+      }
+    }
+  }
+
+  //
+  // Clear the text buffer
+  //
+  for (y = 1 ; y <= D->MaxLine ; y++)
+  {
+    for (x = 1 ; x <= LINE_LENGTH ; x++)
+    {
+      SetCell(TextCell(x, y), ' ', C_WHITE);
+    }
+  }
+
+  D->CursorX = 1;
+  D->CursorY = 1;
+}
+
+/* =============================================================================
+ * FUNCTION: beep
+ */
+void UlarnBeep(void)
+{
+  //
+  // Play a beep
+  //
+  if (!nobeep)
+  {
+    serv_display_flush();
+    vterm_buf_add(server_output(), "\007", 1);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: Cursor
+ */
+void MoveCursor(int x, int y)
+{
+  D->CursorX = x;
+  D->CursorY = y;
+}
+
+/* =============================================================================
+ * FUNCTION: Printc
+ */
+void Printc(char c)
+{
+  int incx;
+  int Row;
+
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
+
+  switch (c)
+    {
+    case '\t':
+      incx = ((((D->CursorX - 1) / 8) + 1) * 8 + 1) - D->CursorX;
+      IncCursorX(incx);
+      break;
+
+    case '\n':
+      D->CursorX = 1;
+      IncCursorY(1);
+      break;
+
+    case '\015':
+      break;
+
+    default:
+
+      if (D->TextWindow == TEXT_MESSAGE)
+	{
+	  Row = MSG_ROW(D->CursorY-1);
+	  SetCell(&D->MessageRing[Row][D->CursorX-1], c,
+		  FormatAttr(D->CurrentFormat));
+	}
+
+      SetCell(TextCell(D->CursorX, D->CursorY), c,
+	      FormatAttr(D->CurrentFormat));
+
+      IncCursorX(1);
+      break;
+    }
+}
+
+/* =============================================================================
+ * FUNCTION: Print
+ */
+void Print(char *string)
+{
+  if (string == NULL) return;
+
+  TRACE_BEGIN(TRACE_PAINTTEXT);
+
+  while (*string != 0)
+  {
+    Printc(*string++);
+  }
+
+  TRACE_END(TRACE_PAINTTEXT);
+}
+
+/* =============================================================================
+ * FUNCTION: Printf
+ */
+void Printf(char *fmt, ...)
+{
+  char buf[2048];
+  va_list argptr;
+
+  va_start(argptr, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, argptr);
+  va_end(argptr);
+
+  Print(buf);
+}
+
+/* =============================================================================
+ * FUNCTION: Standout
+ */
+void Standout(char *String)
+{
+  D->CurrentFormat = FORMAT_STANDOUT;
+
+  Print(String);
+
+  D->CurrentFormat = FORMAT_NORMAL;
+}
+
+/* =============================================================================
+ * FUNCTION: SetFormat
+ */
+void SetFormat(FormatType format)
+{
+  D->CurrentFormat = format;
+}
+
+/* =============================================================================
+ * FUNCTION: ClearToEOL
+ */
+void ClearToEOL(void)
+{
+  int x;
+  int Row;
+
+  if (D->TextWindow == TEXT_MESSAGE)
+  {
+    Row = MSG_ROW(D->CursorY-1);
+
+    for (x = D->CursorX ; x <= LINE_LENGTH ; x++)
+    {
+      SetCell(&D->MessageRing[Row][x-1], ' ', C_WHITE);
+    }
+  }
+
+  for (x = D->CursorX ; x <= LINE_LENGTH ; x++)
+  {
+    SetCell(TextCell(x, D->CursorY), ' ', C_WHITE);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: ClearToEOPage
+ */
+void ClearToEOPage(int x, int y)
+{
+  int tx, ty;
+  int Row;
+
+  for (ty = y ; ty <= D->MaxLine ; ty++)
+  {
+    if (D->TextWindow == TEXT_MESSAGE)
+    {
+      Row = MSG_ROW(ty-1);
+    }
+    else
+    {
+      Row = -1;
+    }
+
+    for (tx = (ty == y) ? x : 1 ; tx <= LINE_LENGTH ; tx++)
+    {
+      if (Row >= 0)
+      {
+        SetCell(&D->MessageRing[Row][tx-1], ' ', C_WHITE);
+      }
+
+      SetCell(TextCell(tx, ty), ' ', C_WHITE);
+    }
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  if (D->Mode != DISPLAY_MAP)
+  {
+    return 0;
+  }
+
+  return D->MsgHistoryLines;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+  int y;
+  int Row;
+
+  if (D->Mode != DISPLAY_MAP)
+  {
+    return;
+  }
+
+  if (Offset > D->MsgHistoryLines)
+  {
+    Offset = D->MsgHistoryLines;
+  }
+
+  for (y = 0 ; y < MAX_MSG_LINES ; y++)
+  {
+    Row = (D->MsgTopLine + MAX_MSG_HISTORY - Offset + y) % MAX_MSG_HISTORY;
+
+    memcpy(D->MapScreen[MSG_TOP + y], D->MessageRing[Row],
+           LINE_LENGTH * sizeof(VTermCellType));
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: show1cell
+ */
+void show1cell(int x, int y)
+{
+  /* see nothing if blind		*/
+  if (c[BLINDCOUNT]) return;
+
+  /* we end up knowing about it */
+  know[x][y] = item[x][y];
+  if (mitem[x][y].mon != MONST_NONE)
+  {
+    stealth[x][y] |= STEALTH_SEEN;
+  }
+
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+  int Attr;
+
+  GetTile(x, y, &TileId, &Attr);
+
+  /* The glyph holds the cell's character and attributes */
+  return ((Attr & 0xff) << 8) | (TileId & 0xff);
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
+  SetCell(&D->MapScreen[y][x], Glyph & 0xff, (Glyph >> 8) & 0xff);
+}
+
+/* =============================================================================
+ * FUNCTION: showplayer
+ */
+void showplayer(void)
+{
+  int TileId;
+  int Attr;
+
+  if (c[BLINDCOUNT] == 0)
+  {
+    TileId = '@';
+    Attr = C_RED;
+  }
+  else
+  {
+    GetTile(playerx, playery, &TileId, &Attr);
+  }
+
+  SetCell(&D->MapScreen[playery][playerx], TileId, Attr);
+}
+
+/* =============================================================================
+ * FUNCTION: showcell
+ */
+void showcell(int x, int y)
+{
+  int minx, maxx;
+  int miny, maxy;
+  int mx, my;
+  int TileId;
+  int Attr;
+
+  /*
+   * Decide how much the player knows about around him/her.
+   */
+  if (c[AWARENESS])
+  {
+    minx = x-3;
+    maxx = x+3;
+    miny = y-3;
+    maxy = y+3;
+  }
+  else
+  {
+    minx = x-1;
+    maxx = x+1;
+    miny = y-1;
+    maxy = y+1;
+  }
+
+  if (c[BLINDCOUNT])
+  {
+    minx = x;
+    maxx = x;
+    miny = y;
+    maxy = y;
+  }
+
+  /*
+   * Limit the area to the map extents
+   */
+  if (minx < 0) minx = 0;
+  if (maxx > MAXX-1) maxx = MAXX-1;
+  if (miny < 0) miny=0;
+  if (maxy > MAXY-1) maxy = MAXY-1;
+
+  for (my = miny; my <= maxy; my++)
+  {
+    for (mx = minx; mx <= maxx; mx++)
+    {
+      if ((mx == playerx) && (my == playery))
+      {
+        know[mx][my] = item[mx][my];
+      }
+      else if ((know[mx][my] != item[mx][my]) ||       /* item changed    */
+               ((mx == lastpx) && (my == lastpy)) ||   /* last player pos */
+               ((mitem[mx][my].mon != MONST_NONE) &&   /* unseen monster  */
+                ((stealth[mx][my] & STEALTH_SEEN) == 0)))
+      {
+        //
+        // Only draw areas not already known (and hence displayed)
+        //
+        know[mx][my] = item[mx][my];
+        if (mitem[mx][my].mon != MONST_NONE)
+        {
+          stealth[mx][my] |= STEALTH_SEEN;
+        }
+
+        GetTile(mx, my, &TileId, &Attr);
+        SetCell(&D->MapScreen[my][mx], TileId, Attr);
+      }
+    }
+  }
+
+  showplayer();
+}
+
+/* =============================================================================
+ * FUNCTION: drawscreen
+ */
+void drawscreen(void)
+{
+  PaintWindow();
+}
+
+/* =============================================================================
+ * FUNCTION: draws
+ */
+void draws(int minx, int miny, int maxx, int maxy)
+{
+  PaintWindow();
+}
+
+/* =============================================================================
+ * FUNCTION: mapeffect
+ */
+void mapeffect(int x, int y, DirEffectsType effect, int dir)
+{
+  SetCell(&D->MapScreen[y][x], EffectTile[effect][dir], EffectColor[effect]);
+}
+
+/* =============================================================================
+ * FUNCTION: magic_effect_frames
+ */
+int magic_effect_frames(MagicEffectsType fx)
+{
+  return magicfx_tile[fx].Frames;
+}
+
+/* =============================================================================
+ * FUNCTION: magic_effect
+ */
+void magic_effect(int x, int y, MagicEffectsType fx, int frame)
+{
+  SetCell(&D->MapScreen[y][x], magicfx_tile[fx].Tile[frame],
+          magicfx_tile[fx].Color[frame]);
+}
+
+/* =============================================================================
+ * FUNCTION: nap
+ */
+void nap(int delay)
+{
+  if (nonap) return;
+
+  TRACE_BEGIN(TRACE_NAP);
+
+  //
+  // The game carries on, and the player sees the frame drawn so far for
+  // the length of the delay.
+  //
+  serv_display_flush();
+  server_delay(delay);
+
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  if (server_peek_key() != -1)
+  {
+    /* Leave the key for the next input request */
+    return 1;
+  }
+
+  nap(delay);
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: GetUser
+ */
+void GetUser(char *username, int *uid)
+{
+  unsigned long Hash;
+  char *Str;
+
+  if (username[0] == 0)
+  {
+    strcpy(username, "Anon");
+  }
+
+  //
+  // Players have no user id on the server, so make a stable one from the
+  // name for the scoreboard.
+  //
+  Hash = 5381;
+  for (Str = username ; *Str != 0 ; Str++)
+  {
+    Hash = Hash * 33 + (unsigned char) *Str;
+  }
+
+  *uid = (int) (Hash & 0x7fffffff);
+}
@@ -0,0 +1,144 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: ularn_winserv.h
+ *
+ * DESCRIPTION:
+ * Server session display module.
+ * This is the display interface used by the game server (see server.h).
+ * Each session has its own display, which renders the tty layout into a
+ * virtual terminal. The server selects the display of the session that is
+ * running before passing control to its game.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * serv_display_new      : Create a session display
+ * serv_display_free     : Free a session display
+ * serv_display_select   : Select the display used by the display interface
+ * serv_display_flush    : Send the changes to the selected display
+ * serv_get_string       : Get a string typed by the player
+ * serv_display_keyframe : Encode the whole of what a display shows
+ *
+ * =============================================================================
+ */
+
+#ifndef __ULARN_WINSERV_H
+#define __ULARN_WINSERV_H
+
+#include "vterm.h"
+
+/*
+ * A session display.
+ */
+typedef struct ServDisplayType ServDisplayType;
+
+/* =============================================================================
+ * FUNCTION: serv_display_new
+ *
+ * DESCRIPTION:
+ * Create a session display with a blank screen in text mode.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   The display, or NULL if there is not enough memory.
+ */
+ServDisplayType *serv_display_new(void);
+
+/* =============================================================================
+ * FUNCTION: serv_display_free
+ *
+ * DESCRIPTION:
+ * Free a session display.
+ *
+ * PARAMETERS:
+ *
+ *   Display : The display to free
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void serv_display_free(ServDisplayType *Display);
+
+/* =============================================================================
+ * FUNCTION: serv_display_select
+ *
+ * DESCRIPTION:
+ * Select the display that the display interface functions draw on.
+ *
+ * PARAMETERS:
+ *
+ *   Display : The display to select
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void serv_display_select(ServDisplayType *Display);
+
+/* =============================================================================
+ * FUNCTION: serv_display_flush
+ *
+ * DESCRIPTION:
+ * Encode the changes to the selected display since the last flush into the
+ * current session's output buffer.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void serv_display_flush(void);
+
+/* =============================================================================
+ * FUNCTION: serv_get_string
+ *
+ * DESCRIPTION:
+ * Get a line typed by the player of the current session, echoing it on the
+ * selected display. Input ends at Enter, or when the player disconnects.
+ *
+ * PARAMETERS:
+ *
+ *   String : The buffer for the string
+ *
+ *   Len    : The maximum length of the string
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void serv_get_string(char *String, int Len);
+
+/* =============================================================================
+ * FUNCTION: serv_display_keyframe
+ *
+ * DESCRIPTION:
+ * Encode the output that shows a newly connected watcher what has been sent
+ * to a display's player so far. The watcher can then be sent the same
+ * output as the player.
+ *
+ * PARAMETERS:
+ *
+ *   Display : The display
+ *
+ *   Buf     : The buffer to add the output to
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+int serv_display_keyframe(ServDisplayType *Display, VTermBufType *Buf);
+
+#endif
@@ -29,6 +29,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -43,6 +44,8 @@
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -51,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get the username and user id.
  *
  * =============================================================================
@@ -71,6 +75,10 @@
 #include "ularn_win.h"
 #include "monster.h"
 #include "itm.h"
+#include "trace.h"
+#include "anim.h"
+#include "ttyrec.h"
+#include "vterm.h"
 
 //
 // player id file
@@ -96,6 +104,15 @@ int yrepcount = 0;
 int UseColor = 0;
 int CaretActive = 0;
 
+/*
+ * The screen as the session recording has drawn it. Curses writes straight
+ * to the terminal, so after each screen update the recording is brought up
+ * to date with the screen curses has just sent (curscr).
+ */
+static VTermType RecordTerm;
+static VTermScreenType RecordScreen;
+static VTermBufType RecordBuf;
+
 #define M_NONE 0
 #define M_SHIFT 1
 #define M_CTRL  2
@@ -171,7 +188,9 @@ static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
   { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
   { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
   { {  18, M_ASCII  }, { 0, 0 }, { 0, 0 } },                  // ACTION_REDRAW_SCREEN,
-  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_SHOW_TAX
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { {  16, M_ASCII  }, { 0, 0 }, { 0, 0 } },                  // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
 };
 
 static struct KeyCodeType RunKeyMap = { KEY_B2, M_ASCII };
@@ -203,6 +222,11 @@ static int ColorPairs[C_COUNT][2] =
 
 static int Runkey;
 static ActionType Event;
+
+//
+// Set while presentation of display updates is held
+//
+static int DisplayHold = 0;
 static int GotChar;
 static int EventChar;
 
@@ -461,13 +485,27 @@ WINDOW *TextWindow;
 
 #define LINE_LENGTH 80
 
+typedef char TextLine[LINE_LENGTH + 1];
+typedef FormatType FormatLine[LINE_LENGTH + 1];
+
 //
 // Messages
+// Curses holds the message window contents, but the lines are also kept in
+// a ring buffer of MAX_MSG_HISTORY lines so that lines scrolled off the
+// message window can be paged back through.
+// MsgTopLine is the ring index of the line at the top of the window.
 //
 #define MAX_MSG_LINES    5
+#define MAX_MSG_HISTORY  500
+static TextLine MessageChr[MAX_MSG_HISTORY];
+static FormatLine MessageFmt[MAX_MSG_HISTORY];
 static FormatType CurrentMsgFormat;
 static int MsgCursorX = 1;
 static int MsgCursorY = 1;
+static int MsgTopLine = 0;
+static int MsgHistoryLines = 0;
+
+#define MSG_ROW(y) ((MsgTopLine + (y)) % MAX_MSG_HISTORY)
 
 //
 // Text
@@ -496,6 +534,124 @@ static int mimicmonst = MIMIC;
  * Local functions
  */
 
+/* =============================================================================
+ * FUNCTION: RecordFrame
+ *
+ * DESCRIPTION:
+ * Add the changes to the screen since the last frame to the session
+ * recording, if one is being made.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void RecordFrame(void)
+{
+  chtype ch;
+  short fg, bg;
+  int x, y;
+  int cx, cy;
+  int Attr;
+
+  if (!ttyrec_enabled) return;
+
+  getyx(curscr, cy, cx);
+
+  for (y = 0 ; y < VTERM_ROWS ; y++)
+  {
+    for (x = 0 ; x < VTERM_COLS ; x++)
+    {
+      if ((y < LINES) && (x < COLS))
+      {
+        ch = mvwinch(curscr, y, x);
+      }
+      else
+      {
+        ch = ' ';
+      }
+
+      Attr = VT_WHITE;
+      if (UseColor && (PAIR_NUMBER(ch) != 0) &&
+          (pair_content(PAIR_NUMBER(ch), &fg, &bg) == OK) && (fg >= 0))
+      {
+        Attr = fg & VT_COLOR_MASK;
+      }
+      if (ch & A_BOLD) Attr |= VT_BOLD;
+      if (ch & A_STANDOUT) Attr |= VT_REVERSE | VT_BOLD;
+      if (ch & A_REVERSE) Attr |= VT_REVERSE;
+      if (ch & A_UNDERLINE) Attr |= VT_UNDERLINE;
+      if (ch & A_ALTCHARSET) Attr |= VT_ACS;
+
+      RecordScreen[y][x].Ch = (unsigned char) (ch & A_CHARTEXT);
+      RecordScreen[y][x].Attr = (unsigned char) Attr;
+    }
+  }
+
+  /* reading curscr moves its cursor, which curses takes as the terminal's */
+  wmove(curscr, cy, cx);
+
+  if ((cx >= VTERM_COLS) || (cy >= VTERM_ROWS))
+  {
+    cx = 0;
+    cy = 0;
+  }
+
+  RecordBuf.Len = 0;
+  vterm_update(&RecordTerm, RecordScreen, cx, cy, &RecordBuf);
+  ttyrec_frame(RecordBuf.Data, RecordBuf.Len);
+}
+
+/* =============================================================================
+ * FUNCTION: TermRefresh
+ *
+ * DESCRIPTION:
+ * Refresh a curses window on the terminal now.
+ *
+ * PARAMETERS:
+ *
+ *   win : The window to refresh
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void TermRefresh(WINDOW *win)
+{
+  wrefresh(win);
+  RecordFrame();
+}
+
+/* =============================================================================
+ * FUNCTION: RefreshWindow
+ *
+ * DESCRIPTION:
+ * Refresh a curses window. If the display is held then the window is only
+ * staged for the next update of the screen.
+ *
+ * PARAMETERS:
+ *
+ *   win : The window to refresh
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void RefreshWindow(WINDOW *win)
+{
+  if (DisplayHold)
+  {
+    wnoutrefresh(win);
+  }
+  else
+  {
+    TermRefresh(win);
+  }
+}
+
 
 /* =============================================================================
  * FUNCTION: SetWallTiles
@@ -672,6 +828,7 @@ static void PaintStatus(void)
 {
   char Line[81];
   char Buf[81];
+  char HPBuf[12];   /* Sized for the 11 character HP field */
   int i;
 
 #ifdef W32_TTY
@@ -727,10 +884,10 @@ static void PaintStatus(void)
   //
   // Format the second line of the status
   //
-  sprintf(Buf, "%ld (%ld)", c[HP], c[HPMAX]);
+  snprintf(HPBuf, sizeof(HPBuf), "%ld (%ld)", c[HP], c[HPMAX]);
 
   sprintf(Line, "HP: %11s STR=%-2ld INT=%-2ld WIS=%-2ld CON=%-2ld DEX=%-2ld CHA=%-2ld LV:",
-      Buf,
+      HPBuf,
       c[STRENGTH]+c[STREXTRA],
       c[INTELLIGENCE],
       c[WISDOM],
@@ -751,7 +908,7 @@ static void PaintStatus(void)
 
   mvwaddstr(StatusWindow, 1, 0, Line);
 
-  wrefresh(StatusWindow);
+  RefreshWindow(StatusWindow);
 
   //
   // Mark all character values as displayed.
@@ -844,7 +1001,7 @@ static void PaintEffects(void)
     cbak[idx] = c[idx];
   }
 
-  wrefresh(EffectsWindow);
+  RefreshWindow(EffectsWindow);
 
 }
 
@@ -965,7 +1122,7 @@ static void GetTile(int x, int y, int *TileId, int *Attr, int *ColorPair)
   /* Handle walls */
   if (*TileId == objnamelist[OWALL])
   {
-    *TileId = WallTile[iarg[x][y]];
+    *TileId = WallTile[wallmask[x][y]];
   }
   
 #ifdef W32_TTY
@@ -1007,6 +1164,8 @@ static void PaintMap(void)
   int Attr;
   int Color;
 
+  TRACE_BEGIN(TRACE_PAINTMAP);
+
   if (Repaint)
     {
       wclear(MapWindow);
@@ -1031,7 +1190,9 @@ static void PaintMap(void)
 	}
     }
 
-  wrefresh(MapWindow);
+  RefreshWindow(MapWindow);
+
+  TRACE_END(TRACE_PAINTMAP);
 }
 
 /* =============================================================================
@@ -1050,8 +1211,12 @@ static void PaintMap(void)
  */
 static void PaintTextWindow(void)
 {
+  TRACE_BEGIN(TRACE_PAINTTEXT);
+
   touchwin(TextWindow);
-  wrefresh(TextWindow);
+  RefreshWindow(TextWindow);
+
+  TRACE_END(TRACE_PAINTTEXT);
 }
 
 /* =============================================================================
@@ -1125,6 +1290,7 @@ int init_app(void)
   /* Initialise curses app */
 
   initscr();
+  vterm_init(&RecordTerm);
   cbreak();
   noecho();
 
@@ -1151,11 +1317,11 @@ int init_app(void)
   mvwaddch(stdscr, 0, 0, '*');
   
   touchwin(stdscr);
-  wrefresh(stdscr);
+  TermRefresh(stdscr);
   
   UseColor = has_colors();
 
-  refresh();
+  TermRefresh(stdscr);
 
   //
   // Clear the text buffers
@@ -1173,7 +1339,18 @@ int init_app(void)
     }
 
   }
-  wrefresh(TextWindow);
+  TermRefresh(TextWindow);
+
+  for (y = 0 ; y < MAX_MSG_HISTORY ; y++)
+  {
+    for (x = 0 ; x < LINE_LENGTH ; x++)
+    {
+      MessageChr[y][x] = ' ';
+      MessageFmt[y][x] = FORMAT_NORMAL;
+    }
+
+    MessageChr[y][LINE_LENGTH] = 0;
+  }
 
   TextWindow = stdscr;
 
@@ -1187,7 +1364,7 @@ int init_app(void)
     }
 
   }
-  wrefresh(TextWindow);
+  TermRefresh(TextWindow);
 
   return 1;
 }
@@ -1210,6 +1387,10 @@ void close_app(void)
 
   endwin();
 
+  /* write out the session recording */
+  ttyrec_stop();
+  vterm_buf_free(&RecordBuf);
+
 }
 
 /* =============================================================================
@@ -1223,12 +1404,14 @@ ActionType get_normal_input(void)
   ActionType Action;
   int i;
 
+  if (DisplayHold) set_display_hold(0);
+
   Event = ACTION_NULL;
   Runkey = 0;
 
   while (Event == ACTION_NULL)
     {
-      wrefresh(MapWindow);
+      TermRefresh(MapWindow);
       EventChar = getch();
       GotChar = 1;
 
@@ -1331,6 +1514,8 @@ char get_prompt_input(char *prompt, char *answers, int ShowCursor)
 {
   char *ch;
 
+  if (DisplayHold) set_display_hold(0);
+
   Print(prompt);
 
   if (ShowCursor)
@@ -1344,7 +1529,7 @@ char get_prompt_input(char *prompt, char *answers, int ShowCursor)
   GotChar = 0;
   while (!GotChar)
     {
-      wrefresh(TextWindow);
+      TermRefresh(TextWindow);
       
       EventChar = getch();
       GotChar = 1;
@@ -1385,6 +1570,8 @@ void get_password_input(char *password, int Len)
   int Pos;
   int value;
 
+  if (DisplayHold) set_display_hold(0);
+
   /* get the printable characters on this system */
   Pos = 0;
   for (value = 0 ; value < 256 ; value++)
@@ -1426,7 +1613,7 @@ void get_password_input(char *password, int Len)
         Pos--;
 
 	wmove(TextWindow, CursorY-1, CursorX-1);
-	wrefresh(TextWindow);
+	TermRefresh(TextWindow);
       }
     }
 
@@ -1488,7 +1675,7 @@ static void get_string_input(char *string, int Len)
         Pos--;
 
 	wmove(TextWindow, CursorY-1, CursorX-1);
-	wrefresh(TextWindow);
+	TermRefresh(TextWindow);
       }
     }
 
@@ -1547,7 +1734,7 @@ int get_num_input(int defval)
         CursorX--;
         Pos--;
 	wmove(TextWindow, CursorY-1, CursorX-1);
-	wrefresh(TextWindow);
+	TermRefresh(TextWindow);
       }
     }
     else if ((ch >= '0') && (ch <= '9'))
@@ -1582,6 +1769,8 @@ ActionType get_dir_input(char *prompt, int ShowCursor)
   int got_dir;
   int idx;
 
+  if (DisplayHold) set_display_hold(0);
+
   //
   // Display the prompt at the current position
   //
@@ -1729,6 +1918,20 @@ void set_display(DisplayModeType Mode)
   PaintWindow();
 }
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  DisplayHold = Hold;
+
+  if (!Hold)
+  {
+    doupdate();
+    RecordFrame();
+  }
+}
+
 /* =============================================================================
  * FUNCTION: IncCursorY
  *
@@ -1745,12 +1948,11 @@ void set_display(DisplayModeType Mode)
  */
 static void IncCursorY(int Count)
 {
-  int Scroll;
   int inc;
+  int Row;
   int x;
 
   inc = Count;
-  Scroll = 0;
 
   while (inc > 0)
   {
@@ -1758,9 +1960,28 @@ static void IncCursorY(int Count)
 
     if (CursorY > MaxLine)
     {
-      Scroll = 1;
       CursorY--;
 
+      if (TextWindow == MessageWindow)
+      {
+        //
+        // Advance the top of the message ring, keeping the line that
+        // scrolled off as history.
+        //
+        MsgTopLine = (MsgTopLine + 1) % MAX_MSG_HISTORY;
+        if (MsgHistoryLines < (MAX_MSG_HISTORY - MAX_MSG_LINES))
+        {
+          MsgHistoryLines++;
+        }
+
+        Row = MSG_ROW(MaxLine - 1);
+        for (x = 0 ; x < LINE_LENGTH ; x++)
+        {
+          MessageChr[Row][x] = ' ';
+          MessageFmt[Row][x] = FORMAT_NORMAL;
+        }
+      }
+
       scrollok(TextWindow, 1);
 
       scroll(TextWindow);
@@ -1778,7 +1999,7 @@ static void IncCursorY(int Count)
     inc--;
   }
   
-  wrefresh(TextWindow);
+  RefreshWindow(TextWindow);
 }
 
 /* =============================================================================
@@ -1811,6 +2032,34 @@ static void IncCursorX(int Count)
 void ClearText(void)
 {
   int x, y;
+  int Row;
+  int Used;
+
+  if (TextWindow == MessageWindow)
+  {
+    //
+    // Keep the lines written so far in the history
+    //
+    Used = (CursorX > 1) ? CursorY : CursorY - 1;
+
+    MsgTopLine = (MsgTopLine + Used) % MAX_MSG_HISTORY;
+    MsgHistoryLines += Used;
+    if (MsgHistoryLines > (MAX_MSG_HISTORY - MAX_MSG_LINES))
+    {
+      MsgHistoryLines = MAX_MSG_HISTORY - MAX_MSG_LINES;
+    }
+
+    for (y = 0 ; y < MAX_MSG_LINES ; y++)
+    {
+      Row = MSG_ROW(y);
+
+      for (x = 0 ; x < LINE_LENGTH ; x++)
+      {
+        MessageChr[Row][x] = ' ';
+        MessageFmt[Row][x] = FORMAT_NORMAL;
+      }
+    }
+  }
 
   //
   // Clear the text buffer
@@ -1826,7 +2075,7 @@ void ClearText(void)
 
   }
 
-  wrefresh(TextWindow);
+  RefreshWindow(TextWindow);
 
   CursorX = 1;
   CursorY = 1;
@@ -1871,6 +2120,10 @@ static int RefreshEachChar = 1;
 void Printc(char c)
 {
   int incx;
+  int Row;
+
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
 
   switch (c)
     {
@@ -1889,12 +2142,19 @@ void Printc(char c)
       
     default:
 
+      if (TextWindow == MessageWindow)
+	{
+	  Row = MSG_ROW(CursorY-1);
+	  MessageChr[Row][CursorX-1] = c;
+	  MessageFmt[Row][CursorX-1] = CurrentFormat;
+	}
+
       SetCursesAttr(CurrentFormat);
       mvwaddch(TextWindow, CursorY-1, CursorX - 1, c);
 
       if (RefreshEachChar)
 	{
-	  wrefresh(TextWindow);
+	  RefreshWindow(TextWindow);
 	}
 
       IncCursorX(1);
@@ -1925,7 +2185,7 @@ void Print(char *string)
 
   RefreshEachChar = 1;
 
-  wrefresh(TextWindow);
+  RefreshWindow(TextWindow);
 }
 
 /* =============================================================================
@@ -1969,6 +2229,18 @@ void SetFormat(FormatType format)
 void ClearToEOL(void)
 {
   int x;
+  int Row;
+
+  if (TextWindow == MessageWindow)
+  {
+    Row = MSG_ROW(CursorY-1);
+
+    for (x = CursorX ; x <= LINE_LENGTH ; x++)
+    {
+      MessageChr[Row][x-1] = ' ';
+      MessageFmt[Row][x-1] = FORMAT_NORMAL;
+    }
+  }
 
   for (x = CursorX ; x <= LINE_LENGTH ; x++)
   {
@@ -1984,6 +2256,21 @@ void ClearToEOL(void)
 void ClearToEOPage(int x, int y)
 {
   int tx, ty;
+  int Row;
+
+  if (TextWindow == MessageWindow)
+  {
+    for (ty = y ; ty <= MaxLine ; ty++)
+    {
+      Row = MSG_ROW(ty-1);
+
+      for (tx = (ty == y) ? x : 1 ; tx <= LINE_LENGTH ; tx++)
+      {
+        MessageChr[Row][tx-1] = ' ';
+        MessageFmt[Row][tx-1] = FORMAT_NORMAL;
+      }
+    }
+  }
 
   SetCursesAttr(FORMAT_NORMAL);
 
@@ -2002,15 +2289,56 @@ void ClearToEOPage(int x, int y)
 
 }
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return 0;
+  }
+
+  return MsgHistoryLines;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+  int x, y;
+  int Row;
+
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return;
+  }
+
+  if (Offset > MsgHistoryLines)
+  {
+    Offset = MsgHistoryLines;
+  }
+
+  for (y = 0 ; y < MAX_MSG_LINES ; y++)
+  {
+    Row = (MsgTopLine + MAX_MSG_HISTORY - Offset + y) % MAX_MSG_HISTORY;
+
+    for (x = 0 ; x < LINE_LENGTH ; x++)
+    {
+      SetCursesAttr(MessageFmt[Row][x]);
+      mvwaddch(MessageWindow, y, x, MessageChr[Row][x]);
+    }
+  }
+
+  TermRefresh(MessageWindow);
+}
+
 /* =============================================================================
  * FUNCTION: show1cell
  */
 void show1cell(int x, int y)
 {
-  int TileId;
-  int Attr;
-  int Color;
-
   /* see nothing if blind		*/
 	if (c[BLINDCOUNT]) return;
 
@@ -2021,13 +2349,36 @@ void show1cell(int x, int y)
     stealth[x][y] |= STEALTH_SEEN;
   }
 
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+  int Attr;
+  int Color;
 
   GetTile(x, y, &TileId, &Attr, &Color);
 
-  wattrset(MapWindow, Attr | COLOR_PAIR(Color));
-  mvwaddch(MapWindow, y, x, TileId);
+  /* The glyph is the curses character with its attributes */
+  return (int) ((TileId & A_CHARTEXT) | Attr | COLOR_PAIR(Color));
+}
 
-  wrefresh(MapWindow);
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
+  wattrset(MapWindow, Glyph & ~A_CHARTEXT);
+  mvwaddch(MapWindow, y, x, Glyph & A_CHARTEXT);
+
+  RefreshWindow(MapWindow);
 }
 
 /* =============================================================================
@@ -2061,7 +2412,7 @@ void showplayer(void)
   wattrset(MapWindow, Attr | COLOR_PAIR(Color));
   mvwaddch(MapWindow, playery, playerx, TileId);
   wmove(MapWindow, playery, playerx);
-  wrefresh(MapWindow);
+  RefreshWindow(MapWindow);
 }
 
 /* =============================================================================
@@ -2172,7 +2523,7 @@ void mapeffect(int x, int y, DirEffectsType effect, int dir)
   wmove(MapWindow, 0, 0);
 
   touchwin(MapWindow);
-  wrefresh(MapWindow);
+  RefreshWindow(MapWindow);
 }
 
 /* =============================================================================
@@ -2193,7 +2544,7 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame)
   wmove(MapWindow, 0, 0);
 
   touchwin(MapWindow);
-  wrefresh(MapWindow);
+  RefreshWindow(MapWindow);
 }
 
 /* =============================================================================
@@ -2201,11 +2552,36 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame)
  */
 void nap(int delay)
 {
+  TRACE_BEGIN(TRACE_NAP);
+
 #ifdef UNIX
   usleep(delay * 1000);
 #else
   napms(delay);
 #endif
+
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  int ch;
+
+  timeout(delay);
+  ch = getch();
+  timeout(-1);
+
+  if (ch == ERR)
+  {
+    return 0;
+  }
+
+  /* Leave the key for the next input request */
+  ungetch(ch);
+  return 1;
 }
 
 /* =============================================================================
@@ -29,6 +29,7 @@
  * get_num_input          : Geta number
  * get_dir_input          : Get a direction
  * set_display            : Set the display mode
+ * set_display_hold       : Hold/release presentation of display updates
  * UpdateStatus           : Update the status display
  * UpdateEffects          : Update the effects display
  * UpdateStatusAndEffects : Update both status and effects display
@@ -43,6 +44,8 @@
  * ClearEOL               : Clear to end of line
  * ClearEOPage            : Clear to end of page
  * show1cell              : Show 1 cell on the map
+ * get_cell_glyph         : Get the glyph showing a cell of the map
+ * show_cell_glyph        : Draw a glyph in 1 cell of the map
  * showplayer             : Show the player on the map
  * showcell               : Show the area around the player
  * drawscreen             : Redraw the screen
@@ -51,6 +54,7 @@
  * magic_effect_frames    : Get the number of animation frames in a magic fx
  * magic_effect           : Draw a frame in a magic fx
  * nap                    : Delay for a specified number of milliseconds
+ * nap_until_key          : Delay, stopping early if a key is pressed
  * GetUser                : Get teh username and user id.
  *
  * =============================================================================
@@ -75,6 +79,9 @@
 #include "ularn_win.h"
 #include "monster.h"
 #include "itm.h"
+#include "trace.h"
+#include "anim.h"
+#include "tileatlas.h"
 
 // Default size of the ularn window in characters
 #define WINDOW_WIDTH    80
@@ -173,7 +180,9 @@ static struct KeyCodeType KeyMap[ACTION_COUNT][MAX_KEY_BINDINGS] =
   { { 'v', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_VERSION,
   { { 'Q', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_QUIT,
   { { 'r', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_REDRAW_SCREEN,
-  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_SHOW_TAX
+  { { 'P', M_ASCII }, { 0, 0 }, { 0, 0 } },                   // ACTION_SHOW_TAX
+  { { 'p', M_CTRL  }, { 0, 0 }, { 0, 0 } },                   // ACTION_MESSAGE_HISTORY
+  { { 't', M_ASCII }, { 0, 0 }, { 0, 0 } }                    // ACTION_TRAVEL
 };
 
 static struct KeyCodeType RunKeyMap = { XK_KP_Begin, M_NONE };
@@ -423,6 +432,11 @@ static int MinWindowHeight;
 
 static int Runkey;
 static ActionType Event;
+
+//
+// Set while presentation of display updates is held
+//
+static int DisplayHold = 0;
 static int GotChar;
 static char EventChar;
 
@@ -430,6 +444,7 @@ static char EventChar;
 // Bitmaps for tiles
 //
 
+static char *AtlasFilename = LIBDIR "/ularn_gfx.atl";
 static char *TileFilename = LIBDIR "/ularn_gfx.xpm";
 
 /* Tiles for different character classes, (female, male) */
@@ -655,13 +670,18 @@ typedef FormatType FormatLine[LINE_LENGTH + 1];
 
 //
 // Messages
+// The message buffer holds MAX_MSG_HISTORY lines so that lines scrolled
+// off the message window can be paged back through.
 //
 #define MAX_MSG_LINES    5
-static TextLine MessageChr[MAX_MSG_LINES];
-static FormatLine MessageFmt[MAX_MSG_LINES];
+#define MAX_MSG_HISTORY  500
+static TextLine MessageChr[MAX_MSG_HISTORY];
+static FormatLine MessageFmt[MAX_MSG_HISTORY];
 static FormatType CurrentMsgFormat;
 static int MsgCursorX = 1;
 static int MsgCursorY = 1;
+static int MsgTopLine = 0;
+static int MsgHistoryLines = 0;
 
 //
 // Text
@@ -673,17 +693,30 @@ static FormatLine TextFmt[MAX_TEXT_LINES];
 static FormatType CurrentTextFormat;
 static int TextCursorX = 1;
 static int TextCursorY = 1;
+static int TextTopLine = 0;
 
 //
 // Generalised text buffer
 // Top left corner is x=1, y=1
 //
+// Text and Format are ring buffers of RingLines lines, so scrolling only
+// moves TopLine, the ring index of the line at the top of the window.
+// HistoryLines is the number of lines above TopLine still held in the ring
+// and ViewOffset is how far the display is scrolled back into them.
+// Use TEXT_ROW to get the ring index of a window line.
+//
 static TextLine   *Text;
 static FormatLine *Format;
 static FormatType CurrentFormat;
 static int CursorX = 1;
 static int CursorY = 1;
 static int MaxLine;
+static int RingLines;
+static int TopLine;
+static int HistoryLines;
+static int ViewOffset = 0;
+
+#define TEXT_ROW(y) ((TopLine + RingLines - ViewOffset + (y)) % RingLines)
 static int TTop;
 static int TLeft;
 static int TWidth;
@@ -698,6 +731,30 @@ static int mimicmonst = MIMIC;
  * Local functions
  */
 
+/* =============================================================================
+ * FUNCTION: FlushDisplay
+ *
+ * DESCRIPTION:
+ * Flush the drawing requests to the X server, unless the display is
+ * currently held.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void FlushDisplay(void)
+{
+  if (!DisplayHold)
+  {
+    XFlush(display);
+    XSync(display, 0);
+  }
+}
+
 /* =============================================================================
  * FUNCTION: calc_scroll
  *
@@ -1117,7 +1174,7 @@ static void GetTile(int x, int y, int *TileId)
   /* Handle walls */
   if (*TileId == objtilelist[OWALL])
   {
-    *TileId = WALL_TILES + iarg[x][y];
+    *TileId = WALL_TILES + wallmask[x][y];
   }
 }
 
@@ -1144,6 +1201,7 @@ static void PaintMap(void)
   int TileX;
   int TileY;
 
+  TRACE_BEGIN(TRACE_PAINTMAP);
 
   if (Repaint)
     {
@@ -1213,6 +1271,8 @@ static void PaintMap(void)
       XSetClipMask(display, ularn_gc, None);
       
     }
+
+  TRACE_END(TRACE_PAINTMAP);
 }
 
 /* =============================================================================
@@ -1232,11 +1292,14 @@ static void PaintMap(void)
 static void PaintTextWindow(void)
 {
   int sx, ex, y;
+  int Row;
   FormatType Fmt;
   int FillX, FillY;
   int FillWidth, FillHeight;
   XGCValues values;
 
+  TRACE_BEGIN(TRACE_PAINTTEXT);
+
   FillX = TLeft;
   FillY  = TTop;
   FillWidth = TWidth;
@@ -1336,13 +1399,14 @@ static void PaintTextWindow(void)
   for (y = 0 ; y < MaxLine ; y++)
     {
       sx = 0;
+      Row = TEXT_ROW(y);
       
       while (sx < LINE_LENGTH)
 	{
-	  Fmt = Format[y][sx];
+	  Fmt = Format[Row][sx];
 	  ex = sx;
 	  
-	  while ((ex < LINE_LENGTH) && (Format[y][ex] == Fmt)) ex++;
+	  while ((ex < LINE_LENGTH) && (Format[Row][ex] == Fmt)) ex++;
 	  
 	  switch (Fmt)
 	    {
@@ -1365,13 +1429,14 @@ static void PaintTextWindow(void)
 	  XDrawString(display, ularn_window, ularn_gc,
 		      TLeft + sx * CharWidth,
 		      TTop + y * CharHeight + CharAscent,
-		      Text[y] + sx,
+		      Text[Row] + sx,
 		      ex - sx);
 	  
 	  sx = ex;
 	}
     }
-  
+
+  TRACE_END(TRACE_PAINTTEXT);
 }
 
 /* =============================================================================
@@ -1987,6 +2052,98 @@ void MakeTileMasks(void)
   XFreeGC(display, gc);
 }
 
+/* =============================================================================
+ * FUNCTION: LoadTileAtlas
+ *
+ * DESCRIPTION:
+ * Load the tile pixmap and shape mask from the pre-converted tile atlas.
+ * The atlas pixels are sent to the server as they are, so this only works
+ * on 24 bit TrueColor displays. Other displays use the XPM file.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the tiles were loaded, 0 if the XPM file should be used.
+ */
+static int LoadTileAtlas(void)
+{
+  TileAtlasType Atlas;
+  Visual *visual;
+  XImage *Image;
+  GC gc;
+  XGCValues values;
+  int depth;
+
+  visual = DefaultVisual(display, screen_num);
+  depth = DefaultDepth(display, screen_num);
+
+  if ((visual->class != TrueColor) ||
+      ((depth != 24) && (depth != 32)) ||
+      (visual->red_mask != 0xff0000) ||
+      (visual->green_mask != 0x00ff00) ||
+      (visual->blue_mask != 0x0000ff))
+  {
+    return 0;
+  }
+
+  if (!tileatlas_open(AtlasFilename, &Atlas)) return 0;
+
+  Image = XCreateImage(display, visual, depth, ZPixmap, 0,
+                       (char *) Atlas.Pixels, Atlas.Width, Atlas.Height,
+                       32, Atlas.Stride);
+  if (Image == NULL)
+  {
+    tileatlas_close(&Atlas);
+    return 0;
+  }
+
+  // The atlas pixels are little endian whatever the display's byte order.
+  Image->byte_order = LSBFirst;
+  XInitImage(Image);
+
+  TilePixmap = XCreatePixmap(display, ularn_window,
+                             Atlas.Width, Atlas.Height, depth);
+  XPutImage(display, TilePixmap, ularn_gc, Image, 0, 0, 0, 0,
+            Atlas.Width, Atlas.Height);
+
+  // The image data is the mapped atlas, which XDestroyImage must not free.
+  Image->data = NULL;
+  XDestroyImage(Image);
+
+  if (Atlas.Mask != NULL)
+  {
+    TilePShape = XCreateBitmapFromData(display, ularn_window,
+                                       (char *) Atlas.Mask,
+                                       Atlas.Width, Atlas.Height);
+  }
+  else
+  {
+    //
+    // No transparent pixels: everything is drawn except where
+    // MakeTileMasks clears the shape for overlay tiles.
+    //
+    TilePShape = XCreatePixmap(display, ularn_window,
+                               Atlas.Width, Atlas.Height, 1);
+
+    values.foreground = 1;
+    gc = XCreateGC(display, TilePShape, GCForeground, &values);
+    XFillRectangle(display, TilePShape, gc, 0, 0, Atlas.Width, Atlas.Height);
+    XFreeGC(display, gc);
+  }
+
+  //
+  // The server has its own copy of the pixels now, so the atlas is only
+  // mapped while it is sent.
+  //
+  XSync(display, 0);
+  tileatlas_close(&Atlas);
+
+  return 1;
+}
+
 /* =============================================================================
  * Exported functions
  */
@@ -2105,6 +2262,7 @@ int init_app(char *DisplayName)
   Blue.blue = 255 * 256;
   XAllocColor(display, colormap, &Blue);
 
+  trace_phase("font");
   font_info = XLoadQueryFont(display, font_name);
   if (!font_info)
     {
@@ -2122,15 +2280,23 @@ int init_app(char *DisplayName)
   CursorPixmap = XCreateBitmapFromData(display, ularn_window, 
 				       cursor_bits, cursor_width, cursor_height);
 
-  TileAttributes.valuemask = XpmCloseness;
-  TileAttributes.closeness = 25000;
+  trace_phase("tiles");
+  if (LoadTileAtlas())
+    {
+      rc = XpmSuccess;
+    }
+  else
+    {
+      TileAttributes.valuemask = XpmCloseness;
+      TileAttributes.closeness = 25000;
 
-  rc = XpmReadFileToPixmap(display, 
-			   ularn_window, 
-			   TileFilename,
-			   &TilePixmap,
-			   &TilePShape,
-			   &TileAttributes);
+      rc = XpmReadFileToPixmap(display, 
+			       ularn_window, 
+			       TileFilename,
+			       &TilePixmap,
+			       &TilePShape,
+			       &TileAttributes);
+    }
 
   if (rc < XpmSuccess)
     {
@@ -2152,12 +2318,13 @@ int init_app(char *DisplayName)
 	}
     }
 
+  trace_phase("tile masks");
   MakeTileMasks();
 
   //
   // Clear the text buffers
   //
-  for (y = 0 ; y < MAX_MSG_LINES ; y++)
+  for (y = 0 ; y < MAX_MSG_HISTORY ; y++)
   {
     for (x = 0 ; x < LINE_LENGTH ; x++)
     {
@@ -2252,6 +2419,8 @@ ActionType get_normal_input(void)
   int idx;
   int got_dir;
 
+  if (DisplayHold) set_display_hold(0);
+
   Event = ACTION_NULL;
   Runkey = 0;
 
@@ -2309,6 +2478,8 @@ char get_prompt_input(char *prompt, char *answers, int ShowCursor)
   XEvent xevent;       // The X event
   char *ch;
 
+  if (DisplayHold) set_display_hold(0);
+
   Print(prompt);
 
   if (ShowCursor)
@@ -2392,6 +2563,8 @@ void get_password_input(char *password, int Len)
   int Pos;
   int value;
 
+  if (DisplayHold) set_display_hold(0);
+
   /* get the printable characters on this system */
   Pos = 0;
   for (value = 0 ; value < 256 ; value++)
@@ -2524,6 +2697,8 @@ ActionType get_dir_input(char *prompt, int ShowCursor)
   int got_dir;
   int idx;
 
+  if (DisplayHold) set_display_hold(0);
+
   //
   // Display the prompt at the current position
   //
@@ -2663,12 +2838,15 @@ void set_display(DisplayModeType Mode)
     MsgCursorX = CursorX;
     MsgCursorY = CursorY;
     CurrentMsgFormat = CurrentFormat;
+    MsgTopLine = TopLine;
+    MsgHistoryLines = HistoryLines;
   }
   else if (CurrentDisplayMode == DISPLAY_TEXT)
   {
     TextCursorX = CursorX;
     TextCursorY = CursorY;
     CurrentTextFormat = CurrentFormat;
+    TextTopLine = TopLine;
   }
 
   CurrentDisplayMode = Mode;
@@ -2685,6 +2863,9 @@ void set_display(DisplayModeType Mode)
     Text = MessageChr;
     Format = MessageFmt;
     MaxLine = MAX_MSG_LINES;
+    RingLines = MAX_MSG_HISTORY;
+    TopLine = MsgTopLine;
+    HistoryLines = MsgHistoryLines;
 
     TLeft = MessageLeft;
     TTop = MessageTop;
@@ -2701,6 +2882,9 @@ void set_display(DisplayModeType Mode)
     Text = TextChr;
     Format = TextFmt;
     MaxLine = MAX_TEXT_LINES;
+    RingLines = MAX_TEXT_LINES;
+    TopLine = TextTopLine;
+    HistoryLines = 0;
 
     TLeft = TextLeft;
     TTop = TextTop;
@@ -2712,6 +2896,50 @@ void set_display(DisplayModeType Mode)
   PaintWindow();
 }
 
+/* =============================================================================
+ * FUNCTION: set_display_hold
+ */
+void set_display_hold(int Hold)
+{
+  DisplayHold = Hold;
+
+  if (!Hold)
+  {
+    XFlush(display);
+  }
+}
+
+/* =============================================================================
+ * FUNCTION: ScrollTextWindow
+ *
+ * DESCRIPTION:
+ * Scroll the text window display up one line and clear the bottom line.
+ * The display is only moved, the text buffer must already be scrolled.
+ *
+ * PARAMETERS:
+ *
+ *   None.
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+static void ScrollTextWindow(void)
+{
+  XCopyArea(display, ularn_window, ularn_window, ularn_gc,
+	    TLeft, TTop + CharHeight,
+	    TWidth, (MaxLine - 1) * CharHeight,
+	    TLeft, TTop);
+
+  XSetForeground(display, ularn_gc, white_pixel);
+  XSetBackground(display, ularn_gc, black_pixel);
+  XSetFillStyle(display, ularn_gc, FillSolid);
+
+  XFillRectangle(display, ularn_window, ularn_gc, 
+		 TLeft, TTop + (MaxLine - 1) * CharHeight,
+		 TWidth, CharHeight);
+}
+
 /* =============================================================================
  * FUNCTION: IncCursorY
  *
@@ -2728,13 +2956,11 @@ void set_display(DisplayModeType Mode)
  */
 static void IncCursorY(int Count)
 {
-  int Scroll;
   int inc;
-  int Line;
+  int Row;
   int x;
 
   inc = Count;
-  Scroll = 0;
 
   while (inc > 0)
   {
@@ -2742,31 +2968,30 @@ static void IncCursorY(int Count)
 
     if (CursorY > MaxLine)
     {
-      Scroll = 1;
-      for (Line = 0 ; Line < (MaxLine - 1) ; Line++)
+      CursorY--;
+
+      //
+      // Advance the top of the ring. The line scrolled off the top is kept
+      // as history if the ring is bigger than the window.
+      //
+      TopLine = (TopLine + 1) % RingLines;
+      if (HistoryLines < (RingLines - MaxLine))
       {
-        for (x = 0 ; x < LINE_LENGTH ; x++)
-        {
-          Text[Line][x] = Text[Line+1][x];
-          Format[Line][x] = Format[Line+1][x];
-        }
+        HistoryLines++;
       }
-      CursorY--;
 
+      Row = TEXT_ROW(MaxLine - 1);
       for (x = 0 ; x < LINE_LENGTH ; x++)
       {
-        Text[MaxLine-1][x] = ' ';
-        Format[MaxLine-1][x] = FORMAT_NORMAL;
+        Text[Row][x] = ' ';
+        Format[Row][x] = FORMAT_NORMAL;
       }
+
+      ScrollTextWindow();
     }
 
     inc--;
   }
-
-  if (Scroll)
-  {
-    PaintTextWindow();
-  }
 }
 
 /* =============================================================================
@@ -2799,6 +3024,23 @@ static void IncCursorX(int Count)
 void ClearText(void)
 {
   int x, y;
+  int Row;
+  int Used;
+
+  //
+  // Keep the lines written so far in the history
+  //
+  if (RingLines > MaxLine)
+  {
+    Used = (CursorX > 1) ? CursorY : CursorY - 1;
+
+    TopLine = (TopLine + Used) % RingLines;
+    HistoryLines += Used;
+    if (HistoryLines > (RingLines - MaxLine))
+    {
+      HistoryLines = RingLines - MaxLine;
+    }
+  }
 
   //
   // Clear the text buffer
@@ -2806,13 +3048,15 @@ void ClearText(void)
 
   for (y = 0 ; y < MaxLine ; y++)
   {
+    Row = TEXT_ROW(y);
+
     for (x = 0 ; x < LINE_LENGTH ; x++)
     {
-      Text[y][x] = ' ';
-      Format[y][x] = FORMAT_NORMAL;
+      Text[Row][x] = ' ';
+      Format[Row][x] = FORMAT_NORMAL;
     }
 
-    Text[y][LINE_LENGTH] = 0;
+    Text[Row][LINE_LENGTH] = 0;
   }
 
   CursorX = 1;
@@ -2823,8 +3067,7 @@ void ClearText(void)
   //
   PaintTextWindow();
 
-  XFlush(display);
-  XSync(display, 0);   
+  FlushDisplay();
 
 }
 
@@ -2857,8 +3100,12 @@ void MoveCursor(int x, int y)
 void Printc(char c)
 {
   int incx;
+  int Row;
   char lc;
 
+  /* Messages held for a queued spell effect are printed during playback */
+  if (anim_printc(c)) return;
+
   switch (c)
     {
     case '\t':
@@ -2876,7 +3123,8 @@ void Printc(char c)
       
     default:
 
-      lc = Text[CursorY-1][CursorX-1];
+      Row = TEXT_ROW(CursorY-1);
+      lc = Text[Row][CursorX-1];
 
       if (lc != c)
 	{
@@ -2891,8 +3139,8 @@ void Printc(char c)
 			 CharWidth, CharHeight);
 	}
       
-      Text[CursorY-1][CursorX-1] = c;
-      Format[CursorY-1][CursorX-1] = CurrentFormat;
+      Text[Row][CursorX-1] = c;
+      Format[Row][CursorX-1] = CurrentFormat;
       
       switch (CurrentFormat)
 	{
@@ -2941,8 +3189,7 @@ void Print(char *string)
     Printc(string[pos]);
   }
 
-  XFlush(display);
-  XSync(display, 0);   
+  FlushDisplay();
 
 }
 
@@ -2987,11 +3234,14 @@ void SetFormat(FormatType format)
 void ClearToEOL(void)
 {
   int x;
+  int Row;
+
+  Row = TEXT_ROW(CursorY-1);
 
   for (x = CursorX ; x <= LINE_LENGTH ; x++)
   {
-    Text[CursorY-1][x-1] = ' ';
-    Format[CursorY-1][x-1] = FORMAT_NORMAL;
+    Text[Row][x-1] = ' ';
+    Format[Row][x-1] = FORMAT_NORMAL;
   }
 
 
@@ -3013,11 +3263,14 @@ void ClearToEOL(void)
 void ClearToEOPage(int x, int y)
 {
   int tx, ty;
+  int Row;
+
+  Row = TEXT_ROW(y-1);
 
   for (tx = x ; tx <= LINE_LENGTH ; tx++)
   {
-    Text[y-1][tx-1] = ' ';
-    Format[y-1][tx-1] = FORMAT_NORMAL;
+    Text[Row][tx-1] = ' ';
+    Format[Row][tx-1] = FORMAT_NORMAL;
   }
 
   XSetForeground(display, ularn_gc, white_pixel);
@@ -3032,10 +3285,12 @@ void ClearToEOPage(int x, int y)
 
   for (ty = y+1 ; ty <= MaxLine ; ty++)
   {
+    Row = TEXT_ROW(ty-1);
+
     for (tx = 1 ; tx <= LINE_LENGTH ; tx++)
     {
-      Text[ty-1][tx-1] = ' ';
-      Format[ty-1][tx-1] = FORMAT_NORMAL;
+      Text[Row][tx-1] = ' ';
+      Format[Row][tx-1] = FORMAT_NORMAL;
     }
 
     XFillRectangle(display, ularn_window, ularn_gc, 
@@ -3048,15 +3303,47 @@ void ClearToEOPage(int x, int y)
 
 }
 
+/* =============================================================================
+ * FUNCTION: MessageHistoryLines
+ */
+int MessageHistoryLines(void)
+{
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return 0;
+  }
+
+  return HistoryLines;
+}
+
+/* =============================================================================
+ * FUNCTION: ShowMessageHistory
+ */
+void ShowMessageHistory(int Offset)
+{
+  if (CurrentDisplayMode != DISPLAY_MAP)
+  {
+    return;
+  }
+
+  if (Offset > HistoryLines)
+  {
+    Offset = HistoryLines;
+  }
+
+  ViewOffset = Offset;
+  PaintTextWindow();
+  ViewOffset = 0;
+
+  XFlush(display);
+  XSync(display, 0);   
+}
+
 /* =============================================================================
  * FUNCTION: show1cell
  */
 void show1cell(int x, int y)
 {
-  int TileId;
-  int sx, sy;
-  int TileX, TileY;
-
   /* see nothing if blind		*/
 	if (c[BLINDCOUNT]) return;
 
@@ -3067,6 +3354,32 @@ void show1cell(int x, int y)
     stealth[x][y] |= STEALTH_SEEN;
   }
 
+  show_cell_glyph(x, y, get_cell_glyph(x, y));
+}
+
+/* =============================================================================
+ * FUNCTION: get_cell_glyph
+ */
+int get_cell_glyph(int x, int y)
+{
+  int TileId;
+
+  GetTile(x, y, &TileId);
+
+  return TileId;
+}
+
+/* =============================================================================
+ * FUNCTION: show_cell_glyph
+ */
+void show_cell_glyph(int x, int y, int Glyph)
+{
+  int sx, sy;
+  int TileX, TileY;
+
+  /* see nothing if blind */
+  if (c[BLINDCOUNT]) return;
+
   sx = x - MapTileLeft;
   sy = y - MapTileTop;
 
@@ -3080,16 +3393,13 @@ void show1cell(int x, int y)
     return;
   }
 
-  GetTile(x, y, &TileId);
-
-  TileX = (TileId % 16) * TileWidth;
-  TileY = (TileId / 16) * TileHeight;
+  TileX = (Glyph % 16) * TileWidth;
+  TileY = (Glyph / 16) * TileHeight;
 
   XCopyArea(display, TilePixmap, ularn_window, ularn_gc,
 	    TileX, TileY,
 	    TileWidth, TileHeight,
 	    MapLeft + sx*TileWidth, MapTop + sy*TileHeight);
-
 }
 
 /* =============================================================================
@@ -3461,9 +3771,39 @@ void magic_effect(int x, int y, MagicEffectsType fx, int frame)
  */
 void nap(int delay)
 {
+  TRACE_BEGIN(TRACE_NAP);
+
   XFlush(display);
   XSync(display, 0);
   usleep(delay * 1000);
+
+  TRACE_END(TRACE_NAP);
+}
+
+/* =============================================================================
+ * FUNCTION: nap_until_key
+ */
+int nap_until_key(int delay)
+{
+  XEvent event;
+
+  XFlush(display);
+  XSync(display, 0);
+
+  while (delay > 0)
+  {
+    if (XCheckTypedEvent(display, KeyPress, &event))
+    {
+      /* Leave the key for the next input request */
+      XPutBackEvent(display, &event);
+      return 1;
+    }
+
+    usleep(10000);
+    delay -= 10;
+  }
+
+  return 0;
 }
 
 /* =============================================================================
@@ -0,0 +1,349 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: vterm.c
+ *
+ * DESCRIPTION:
+ * Virtual terminal module.
+ * This module keeps a copy of what an ANSI terminal is showing and encodes
+ * the escape sequences needed to bring it up to date with a screen of
+ * character cells. Only the cells that have changed since the last update
+ * are sent, so the output for a typical turn is a few dozen bytes.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * vterm_init     : Initialise a virtual terminal
+ * vterm_update   : Encode the changes needed to show a screen
+ * vterm_keyframe : Encode the whole of what a terminal is showing
+ * vterm_buf_add  : Add bytes to an output buffer
+ * vterm_buf_free : Free the memory used by an output buffer
+ *
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vterm.h"
+
+/* =============================================================================
+ * Local variables
+ */
+
+/*
+ * Reset the attributes, designate DEC special graphics as G1, shift to G0,
+ * home the cursor and clear the screen.
+ */
+static char ClearSeq[] = "\033[0m\033)0\017\033[H\033[2J";
+
+/*
+ * The largest gap between changed cells on a row that is filled by
+ * rewriting the unchanged cells rather than by moving the cursor.
+ */
+#define MAX_REWRITE_GAP 4
+
+/* =============================================================================
+ * Local functions
+ */
+
+/* =============================================================================
+ * FUNCTION: cells_match
+ *
+ * DESCRIPTION:
+ * Check if two cells look the same on the terminal.
+ * The colour of a space cannot be seen unless it is reversed or underlined.
+ *
+ * PARAMETERS:
+ *
+ *   a : The first cell
+ *
+ *   b : The second cell
+ *
+ * RETURN VALUE:
+ *
+ *   1 if the cells look the same, 0 otherwise.
+ */
+static int cells_match(VTermCellType *a, VTermCellType *b)
+{
+  if (a->Ch != b->Ch) return 0;
+  if (a->Attr == b->Attr) return 1;
+
+  return ((a->Ch == ' ') &&
+          (((a->Attr | b->Attr) & (VT_REVERSE | VT_UNDERLINE | VT_ACS)) == 0));
+}
+
+/* =============================================================================
+ * FUNCTION: set_attr
+ *
+ * DESCRIPTION:
+ * Add the output to change the terminal attributes, if they differ.
+ *
+ * PARAMETERS:
+ *
+ *   Term : The virtual terminal
+ *
+ *   Attr : The attributes required
+ *
+ *   Buf  : The output buffer
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+static int set_attr(VTermType *Term, int Attr, VTermBufType *Buf)
+{
+  char Seq[32];
+  int Len;
+
+  if (((Attr ^ Term->Attr) & ~VT_ACS) != 0)
+  {
+    Len = sprintf(Seq, "\033[0%s%s%s;3%dm",
+                  (Attr & VT_BOLD) ? ";1" : "",
+                  (Attr & VT_UNDERLINE) ? ";4" : "",
+                  (Attr & VT_REVERSE) ? ";7" : "",
+                  Attr & VT_COLOR_MASK);
+    if (vterm_buf_add(Buf, Seq, Len) < 0) return -1;
+  }
+
+  if (((Attr & VT_ACS) != 0) != Term->Shift)
+  {
+    Term->Shift = ((Attr & VT_ACS) != 0);
+    if (vterm_buf_add(Buf, Term->Shift ? "\016" : "\017", 1) < 0) return -1;
+  }
+
+  Term->Attr = Attr;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: move_to
+ *
+ * DESCRIPTION:
+ * Add the output to move the terminal cursor, if it is not already there.
+ *
+ * PARAMETERS:
+ *
+ *   Term : The virtual terminal
+ *
+ *   x    : The column to move to
+ *
+ *   y    : The row to move to
+ *
+ *   Buf  : The output buffer
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+static int move_to(VTermType *Term, int x, int y, VTermBufType *Buf)
+{
+  char Seq[32];
+  int Len;
+
+  if ((Term->CursorX == x) && (Term->CursorY == y)) return 0;
+
+  Len = sprintf(Seq, "\033[%d;%dH", y + 1, x + 1);
+  if (vterm_buf_add(Buf, Seq, Len) < 0) return -1;
+
+  Term->CursorX = x;
+  Term->CursorY = y;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: put_cell
+ *
+ * DESCRIPTION:
+ * Add the output to write a cell at the terminal cursor.
+ *
+ * PARAMETERS:
+ *
+ *   Term : The virtual terminal
+ *
+ *   Cell : The cell to write
+ *
+ *   Buf  : The output buffer
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+static int put_cell(VTermType *Term, VTermCellType *Cell, VTermBufType *Buf)
+{
+  char Ch;
+
+  if (set_attr(Term, Cell->Attr, Buf) < 0) return -1;
+
+  Ch = (char) Cell->Ch;
+  if (vterm_buf_add(Buf, &Ch, 1) < 0) return -1;
+
+  Term->Sent[Term->CursorY][Term->CursorX] = *Cell;
+
+  Term->CursorX++;
+  if (Term->CursorX == VTERM_COLS)
+  {
+    /* The terminal may or may not have wrapped, so the cursor is unknown */
+    Term->CursorX = -1;
+    Term->CursorY = -1;
+  }
+
+  return 0;
+}
+
+/* =============================================================================
+ * Exported functions
+ */
+
+/* =============================================================================
+ * FUNCTION: vterm_init
+ */
+void vterm_init(VTermType *Term)
+{
+  Term->Valid = 0;
+  Term->CursorX = -1;
+  Term->CursorY = -1;
+  Term->Attr = -1;
+  Term->Shift = 0;
+}
+
+/* =============================================================================
+ * FUNCTION: vterm_update
+ */
+int vterm_update(VTermType *Term, VTermScreenType Screen,
+                 int CursorX, int CursorY, VTermBufType *Buf)
+{
+  int x, y;
+  int Gap;
+  int Rewrite;
+
+  if (!Term->Valid)
+  {
+    if (vterm_buf_add(Buf, ClearSeq, strlen(ClearSeq)) < 0) return -1;
+
+    for (y = 0 ; y < VTERM_ROWS ; y++)
+    {
+      for (x = 0 ; x < VTERM_COLS ; x++)
+      {
+        Term->Sent[y][x].Ch = ' ';
+        Term->Sent[y][x].Attr = VT_WHITE;
+      }
+    }
+
+    Term->Valid = 1;
+    Term->CursorX = 0;
+    Term->CursorY = 0;
+    Term->Attr = VT_WHITE;
+    Term->Shift = 0;
+  }
+
+  for (y = 0 ; y < VTERM_ROWS ; y++)
+  {
+    for (x = 0 ; x < VTERM_COLS ; x++)
+    {
+      if (cells_match(&Screen[y][x], &Term->Sent[y][x])) continue;
+
+      //
+      // If the cursor is a few cells to the left on this row then it is
+      // cheaper to rewrite the cells in between than to move it.
+      //
+      Gap = x - Term->CursorX;
+      Rewrite = ((Term->CursorY == y) && (Gap > 0) && (Gap <= MAX_REWRITE_GAP));
+
+      while (Rewrite && (Term->CursorX < x))
+      {
+        if (Screen[y][Term->CursorX].Attr != Term->Attr) break;
+        if (put_cell(Term, &Screen[y][Term->CursorX], Buf) < 0) return -1;
+      }
+
+      if (move_to(Term, x, y, Buf) < 0) return -1;
+      if (put_cell(Term, &Screen[y][x], Buf) < 0) return -1;
+    }
+  }
+
+  if (move_to(Term, CursorX, CursorY, Buf) < 0) return -1;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: vterm_keyframe
+ */
+int vterm_keyframe(VTermType *Term, VTermBufType *Buf)
+{
+  VTermType Copy;
+
+  //
+  // If nothing has been sent yet then the next update clears the screen
+  //
+  if (!Term->Valid)
+  {
+    return vterm_buf_add(Buf, ClearSeq, strlen(ClearSeq));
+  }
+
+  vterm_init(&Copy);
+
+  if (Term->CursorX < 0)
+  {
+    /* Updates move the cursor before writing when its position is unknown */
+    if (vterm_update(&Copy, Term->Sent, 0, 0, Buf) < 0) return -1;
+  }
+  else
+  {
+    if (vterm_update(&Copy, Term->Sent, Term->CursorX, Term->CursorY, Buf) < 0)
+    {
+      return -1;
+    }
+  }
+
+  //
+  // Updates only send the attributes when they change, so they must match
+  //
+  if ((Term->Attr >= 0) && (set_attr(&Copy, Term->Attr, Buf) < 0)) return -1;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: vterm_buf_add
+ */
+int vterm_buf_add(VTermBufType *Buf, const char *Data, size_t Len)
+{
+  size_t Size;
+  char *NewData;
+
+  if (Buf->Len + Len > Buf->Size)
+  {
+    Size = (Buf->Size == 0) ? 1024 : Buf->Size;
+    while (Size < Buf->Len + Len) Size *= 2;
+
+    NewData = (char *) realloc(Buf->Data, Size);
+    if (NewData == NULL) return -1;
+
+    Buf->Data = NewData;
+    Buf->Size = Size;
+  }
+
+  memcpy(Buf->Data + Buf->Len, Data, Len);
+  Buf->Len += Len;
+
+  return 0;
+}
+
+/* =============================================================================
+ * FUNCTION: vterm_buf_free
+ */
+void vterm_buf_free(VTermBufType *Buf)
+{
+  free(Buf->Data);
+  Buf->Data = NULL;
+  Buf->Len = 0;
+  Buf->Size = 0;
+}
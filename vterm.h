@@ -0,0 +1,197 @@
+/* =============================================================================
+ * PROGRAM:  ularn
+ * FILENAME: vterm.h
+ *
+ * DESCRIPTION:
+ * Virtual terminal module.
+ * This module keeps a copy of what an ANSI terminal is showing and encodes
+ * the escape sequences needed to bring it up to date with a screen of
+ * character cells. Only the cells that have changed since the last update
+ * are sent, so the output for a typical turn is a few dozen bytes.
+ *
+ * The encoded output goes into a growable byte buffer owned by the caller.
+ *
+ * =============================================================================
+ * EXPORTED VARIABLES
+ *
+ * None.
+ *
+ * =============================================================================
+ * EXPORTED FUNCTIONS
+ *
+ * vterm_init     : Initialise a virtual terminal
+ * vterm_update   : Encode the changes needed to show a screen
+ * vterm_keyframe : Encode the whole of what a terminal is showing
+ * vterm_buf_add  : Add bytes to an output buffer
+ * vterm_buf_free : Free the memory used by an output buffer
+ *
+ * =============================================================================
+ */
+
+#ifndef __VTERM_H
+#define __VTERM_H
+
+#include <stddef.h>
+
+/*
+ * The terminal size.
+ */
+#define VTERM_ROWS 24
+#define VTERM_COLS 80
+
+/*
+ * Cell attributes.
+ * The low three bits are the ANSI foreground colour (0 = black .. 7 = white).
+ * Cells with VT_ACS set hold a DEC special graphics character, such as
+ * 'q' for a horizontal line.
+ */
+#define VT_COLOR_MASK 0x07
+#define VT_BOLD       0x08
+#define VT_REVERSE    0x10
+#define VT_UNDERLINE  0x20
+#define VT_ACS        0x40
+
+#define VT_BLACK   0
+#define VT_RED     1
+#define VT_GREEN   2
+#define VT_YELLOW  3
+#define VT_BLUE    4
+#define VT_MAGENTA 5
+#define VT_CYAN    6
+#define VT_WHITE   7
+
+/*
+ * A character cell.
+ */
+typedef struct
+{
+  unsigned char Ch;
+  unsigned char Attr;
+} VTermCellType;
+
+typedef VTermCellType VTermScreenType[VTERM_ROWS][VTERM_COLS];
+
+/*
+ * A growable output buffer.
+ */
+typedef struct
+{
+  char *Data;
+  size_t Len;
+  size_t Size;
+} VTermBufType;
+
+/*
+ * The state of a terminal as far as the encoder knows it.
+ */
+typedef struct
+{
+  VTermScreenType Sent;  /* The cells the terminal is showing             */
+  int Valid;             /* Set once the terminal has been cleared        */
+  int CursorX;           /* The terminal cursor, or -1 if not known       */
+  int CursorY;
+  int Attr;              /* The current attributes, or -1 if not known    */
+  int Shift;             /* Set while the DEC graphics set is shifted in  */
+} VTermType;
+
+/* =============================================================================
+ * FUNCTION: vterm_init
+ *
+ * DESCRIPTION:
+ * Initialise a virtual terminal. Nothing is known about what the real
+ * terminal is showing, so the next update clears it and sends every cell.
+ *
+ * PARAMETERS:
+ *
+ *   Term : The virtual terminal to initialise
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void vterm_init(VTermType *Term);
+
+/* =============================================================================
+ * FUNCTION: vterm_update
+ *
+ * DESCRIPTION:
+ * Encode the output needed to change what the terminal shows to a screen,
+ * and leave the terminal cursor at the given position.
+ *
+ * PARAMETERS:
+ *
+ *   Term    : The virtual terminal
+ *
+ *   Screen  : The screen to show
+ *
+ *   CursorX : The column to leave the cursor in (0 based)
+ *
+ *   CursorY : The row to leave the cursor in (0 based)
+ *
+ *   Buf     : The buffer to add the output to
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+int vterm_update(VTermType *Term, VTermScreenType Screen,
+                 int CursorX, int CursorY, VTermBufType *Buf);
+
+/* =============================================================================
+ * FUNCTION: vterm_keyframe
+ *
+ * DESCRIPTION:
+ * Encode the output that brings a newly connected terminal to the same
+ * state as an existing one: the same cells, cursor, attributes and
+ * character set. The output from later updates of the existing terminal can
+ * then be sent to both.
+ *
+ * PARAMETERS:
+ *
+ *   Term : The virtual terminal to copy
+ *
+ *   Buf  : The buffer to add the output to
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+int vterm_keyframe(VTermType *Term, VTermBufType *Buf);
+
+/* =============================================================================
+ * FUNCTION: vterm_buf_add
+ *
+ * DESCRIPTION:
+ * Add bytes to the end of an output buffer, growing it if required.
+ *
+ * PARAMETERS:
+ *
+ *   Buf  : The buffer
+ *
+ *   Data : The bytes to add
+ *
+ *   Len  : The number of bytes to add
+ *
+ * RETURN VALUE:
+ *
+ *   0 if successful, -1 if the buffer could not be grown.
+ */
+int vterm_buf_add(VTermBufType *Buf, const char *Data, size_t Len);
+
+/* =============================================================================
+ * FUNCTION: vterm_buf_free
+ *
+ * DESCRIPTION:
+ * Free the memory used by an output buffer and set it to empty.
+ *
+ * PARAMETERS:
+ *
+ *   Buf : The buffer
+ *
+ * RETURN VALUE:
+ *
+ *   None.
+ */
+void vterm_buf_free(VTermBufType *Buf);
+
+#endif